@@ -0,0 +1,71 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../helpers/cvector.h"
+#include "../helpers/vector.h"
+
+// Throughput of concurrent appends: the same pushes into a cvector and into
+// a struct vector guarded by a mutex, for 1 to 8 writer threads.
+//
+//     make bench/cvector && bench/cvector [pushes per thread]
+
+static struct cvector *shared;
+static struct vector *guarded;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static long pushes = 1000000;
+
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static void *push_shared(void *arg) {
+    for (long i = 0; i < pushes; i++) {
+        long value = (long)arg * pushes + i;
+        cvector_push(shared, &value);
+    }
+    return NULL;
+}
+
+static void *push_guarded(void *arg) {
+    for (long i = 0; i < pushes; i++) {
+        long value = (long)arg * pushes + i;
+        pthread_mutex_lock(&lock);
+        vector_push(guarded, &value);
+        pthread_mutex_unlock(&lock);
+    }
+    return NULL;
+}
+
+// Seconds `threads` threads running `push` take.
+static double run(int threads, void *(*push)(void *)) {
+    pthread_t workers[threads];
+    double start = now();
+    for (long i = 0; i < threads; i++)
+        pthread_create(&workers[i], NULL, push, (void *)i);
+    for (int i = 0; i < threads; i++) pthread_join(workers[i], NULL);
+    return now() - start;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc > 1) pushes = atol(argv[1]);
+    printf("%-8s %14s %14s %8s\n", "threads", "cvector Mop/s", "mutex Mop/s",
+           "speedup");
+    for (int threads = 1; threads <= 8; threads *= 2) {
+        shared = cvector_create(sizeof(long));
+        double lock_free = run(threads, push_shared);
+        cvector_free(shared);
+
+        guarded = vector_create(sizeof(long));
+        double locked = run(threads, push_guarded);
+        vector_free(guarded);
+
+        double ops = (double)threads * pushes / 1e6;
+        printf("%-8d %14.1f %14.1f %7.2fx\n", threads, ops / lock_free,
+               ops / locked, locked / lock_free);
+    }
+    return 0;
+}
@@ -0,0 +1,27 @@
+#!/bin/sh
+# Times the programs of bench/programs built by main at -O0 and at -O1.
+
+cd "$(dirname "$0")/.." || exit 1
+main="$(pwd)/main"
+dir=$(mktemp -d) || exit 1
+trap 'rm -rf "$dir"' EXIT
+
+# Milliseconds running $1 takes, its output is dropped.
+run_time() {
+    start=$(date +%s%N)
+    "$1" > /dev/null || return 1
+    echo $((($(date +%s%N) - start) / 1000000))
+}
+
+printf '%-10s %10s %10s %8s\n' program "-O0 ms" "-O1 ms" speedup
+for source in bench/programs/*.c; do
+    name=$(basename "$source" .c)
+    for level in -O0 -O1; do
+        "$main" $level -o "$dir/$name$level.o" "$source" > /dev/null &&
+            cc -o "$dir/$name$level" "$dir/$name$level.o" || exit 1
+    done
+    unoptimized=$(run_time "$dir/$name-O0") || exit 1
+    optimized=$(run_time "$dir/$name-O1") || exit 1
+    printf '%-10s %10d %10d %7sx\n' "$name" "$unoptimized" "$optimized" \
+        "$(awk "BEGIN { printf \"%.2f\", $unoptimized / $optimized }")"
+done
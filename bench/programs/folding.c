@@ -0,0 +1,20 @@
+// A loop whose flags and scales are constants -O1 folds away.
+
+int printf(const char *fmt, ...);
+long kernel(long n) {
+    int debug = 0;
+    int scale = 8, unit = 1, shift = scale / 4;
+    long h = 0;
+    for (long i = 0; i < n; i++) {
+        long x = i * unit + 0;
+        if (debug) printf("%ld\n", x);
+        x = x * scale + (scale - 8) * x;
+        h += (x >> shift) ^ (i & (scale * 2 - 1));
+        if (scale == 8) h += 3; else h -= 3;
+    }
+    return h;
+}
+int main(void) {
+    printf("%ld\n", kernel(300000000));
+    return 0;
+}
@@ -0,0 +1,28 @@
+// Calls, a sieve over a static array and a long integer loop.
+
+int printf(const char *fmt, ...);
+int fib(int n) { return n < 2 ? n : fib(n - 1) + fib(n - 2); }
+long sieve(int n) {
+    static char comp[2000000];
+    long s = 0;
+    for (int i = 2; i < n; i++) {
+        if (comp[i]) continue;
+        s += i;
+        for (long j = (long)i * i; j < n; j += i) comp[j] = 1;
+    }
+    return s;
+}
+long mix(long n) {
+    long a = 1, b = 2, c = 3, h = 0;
+    for (long i = 0; i < n; i++) {
+        a = a * 6364136223846793005L + 1442695040888963407L;
+        b ^= a >> 17;
+        c += (b << 3) - a;
+        h += (a ^ b ^ c) & 0xff;
+    }
+    return h;
+}
+int main(void) {
+    printf("%d %ld %ld\n", fib(32), sieve(2000000), mix(100000000));
+    return 0;
+}
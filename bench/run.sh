@@ -0,0 +1,16 @@
+#!/bin/sh
+# Runs the benchmarks, built by `make bench`.
+
+cd "$(dirname "$0")/.." || exit 1
+
+echo "== concurrent appends"
+bench/cvector
+
+echo "== UTF-8 validation"
+bench/utf8
+
+echo "== -O0 against -O1"
+bench/optimize.sh
+
+echo "== switches against chains of compares"
+bench/switch.sh
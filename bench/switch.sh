@@ -0,0 +1,117 @@
+#!/bin/sh
+# Times switches lowered by main -O1 against the chain of compares of the
+# same cases written as ifs. Each program dispatches on keys drawn from a
+# table of 4096, either at random, so that no branch predictor learns them,
+# or as a short pattern repeated, which predictors do learn:
+# - dense: 32 cases 0 to 31, a jump table,
+# - sparse: 64 cases spread over 150000 values, the search tree,
+# - bits: character classes, bit tests.
+#
+#     bench/switch.sh [iterations]
+
+cd "$(dirname "$0")/.." || exit 1
+main=${MAIN:-$(pwd)/main}
+iterations=${1:-30000000}
+dir=$(mktemp -d) || exit 1
+trap 'rm -rf "$dir"' EXIT
+
+# Writes the program of kind $1 with keys $2 (uniform or repeating),
+# dispatching with a switch when $3 is switch and with ifs otherwise.
+generate() {
+    awk -v kind="$1" -v keys="$2" -v form="$3" -v n="$iterations" '
+    function value(i) {
+        if (kind == "dense") return i
+        if (kind == "sparse") return i * i * 37 + i * 11 + 3
+        return substr(chars, i + 1, 1)
+    }
+    function label(i) {
+        return kind == "bits" ? "'"'"'" value(i) "'"'"'" : value(i)
+    }
+    function body(i) {
+        if (kind == "bits") return i < 10 ? "a++;" : "b++;"
+        return "acc = acc * " (i + 3) " + " i "; x ^= acc >> " (i % 13 + 1) ";"
+    }
+    BEGIN {
+        chars = "aeiouAEIOU +-*"
+        cases = kind == "dense" ? 32 : kind == "sparse" ? 64 : 14
+        print "int printf(const char *f, ...);"
+        print "static int keys[4096];"
+        print "long run(long n) {"
+        print "    unsigned seed = 1;"
+        print "    long acc = 1, x = 0, a = 0, b = 0;"
+        print "    for (long i = 0; i < n; i++) {"
+        if (keys == "uniform") {
+            print "        seed = seed * 1103515245u + 12345u;"
+            print "        int key = keys[seed >> 20];"
+        } else {
+            print "        int key = keys[i & 4095];"
+        }
+        if (form == "switch") {
+            print "        switch (key) {"
+            for (i = 0; i < cases; i++) {
+                # the labels of a character class share their statement.
+                last = i + 1 == cases || body(i + 1) != body(i)
+                print "        case " label(i) ":" (last ? " " body(i) " break;" : "")
+            }
+            print "        default: acc++;"
+            print "        }"
+        } else {
+            for (i = 0; i < cases; i++)
+                print "        " (i ? "else if" : "if") " (key == " label(i) ") { " body(i) " }"
+            print "        else acc++;"
+        }
+        print "    }"
+        print "    return acc ^ x ^ a * 1000003 ^ b * 1009;"
+        print "}"
+        print "int main(void) {"
+        printf "    int values[] = {"
+        for (i = 0; i < cases; i++) printf "%s%s", (i ? ", " : ""), label(i)
+        print "};"
+        print "    unsigned seed = 12345;"
+        print "    for (int i = 0; i < 4096; i++) {"
+        print "        seed = seed * 1103515245u + 12345u;"
+        if (kind == "bits")
+            print "        keys[i] = (seed >> 16) % 8 ? 32 + (seed >> 8) % 96 : values[(seed >> 16) % " cases "];"
+        else
+            print "        keys[i] = (seed >> 16) % 16 ? values[(seed >> 16) % " cases "] : (int)seed;"
+        if (keys == "repeating")
+            print "        if (i >= 50) keys[i] = keys[i % 50];"
+        print "    }"
+        print "    printf(\"%ld\\n\", run(" n "));"
+        print "    return 0;"
+        print "}"
+    }'
+}
+
+# Least milliseconds running $1 takes over 3 runs, its output is kept in
+# $1.out.
+run_time() {
+    best=
+    for run in 1 2 3; do
+        start=$(date +%s%N)
+        "$1" > "$1.out" || return 1
+        time=$((($(date +%s%N) - start) / 1000000))
+        [ -z "$best" ] || [ $time -lt $best ] && best=$time
+    done
+    echo $best
+}
+
+printf '%-8s %-10s %10s %10s %8s\n' program keys "ifs ms" "switch ms" speedup
+for kind in dense sparse bits; do
+    for keys in uniform repeating; do
+        for form in ifs switch; do
+            program="$dir/$kind-$keys-$form"
+            generate $kind $keys $form > "$program.c"
+            "$main" -O1 -o "$program.o" "$program.c" > /dev/null &&
+                cc -o "$program" "$program.o" || exit 1
+        done
+        chain=$(run_time "$dir/$kind-$keys-ifs") || exit 1
+        lowered=$(run_time "$dir/$kind-$keys-switch") || exit 1
+        cmp -s "$dir/$kind-$keys-ifs.out" "$dir/$kind-$keys-switch.out" || {
+            echo "switch: $kind $keys doesn't compute what the ifs do"
+            exit 1
+        }
+        printf '%-8s %-10s %10d %10d %7sx\n' $kind $keys "$chain" "$lowered" \
+            "$(awk "BEGIN { printf \"%.2f\", $chain / $lowered }")"
+    done
+done
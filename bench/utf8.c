@@ -0,0 +1,84 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../helpers/utf8.h"
+
+// Throughput of validating UTF-8: utf8_validate, the vectorized check alone
+// and the scalar fallback over pure ASCII, source code with a few non ASCII
+// characters in comments, and text that is mostly multi byte.
+//
+//     make bench/utf8 && bench/utf8 [megabytes]
+
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static uint32_t seed = 12345;
+
+static uint32_t next(void) {
+    seed = seed * 1103515245u + 12345u;
+    return seed >> 8;
+}
+
+// Fills `data` with `len` bytes of text, one character in `rate` being
+// the encoding of a code point of 2 to 4 bytes, the others ASCII.
+static void fill(char *data, size_t len, unsigned rate) {
+    static const char *wide[] = {"\xC3\xA9", "\xE2\x82\xAC", "\xF0\x9F\x98\x80",
+                                 "\xD0\x96", "\xE4\xB8\xAD"};
+    size_t i = 0;
+    while (i < len) {
+        const char *c = wide[next() % 5];
+        size_t n = strlen(c);
+        if (rate && next() % rate == 0 && i + n <= len) {
+            memcpy(data + i, c, n);
+            i += n;
+        } else {
+            data[i++] = 32 + next() % 95;
+        }
+    }
+}
+
+static volatile int sink;
+
+// Gigabytes a second `validate` checks `data` at, best of 5 runs.
+static double run(const char *data, size_t len, int validate) {
+    double best = 0;
+    for (int run = 0; run < 5; run++) {
+        double start = now();
+        int valid = validate == 0   ? utf8_validate(data, len, NULL)
+                    : validate == 1 ? utf8_validate_vector(data, len)
+                                    : utf8_validate_scalar(data, len, NULL);
+        double rate = len / (now() - start) / 1e9;
+        if (!valid) {
+            fprintf(stderr, "utf8: the text isn't valid\n");
+            exit(1);
+        }
+        sink += valid;
+        if (rate > best) best = rate;
+    }
+    return best;
+}
+
+int main(int argc, char *argv[]) {
+    size_t len = (argc > 1 ? atol(argv[1]) : 64) << 20;
+    char *data = malloc(len);
+    static const struct {
+        const char *name;
+        unsigned rate;
+    } texts[] = {{"ascii", 0}, {"source", 200}, {"wide", 1}};
+
+    printf("%-8s %14s %14s %14s\n", "text", "validate GB/s", "vector GB/s",
+           "scalar GB/s");
+    for (size_t i = 0; i < sizeof(texts) / sizeof(*texts); i++) {
+        fill(data, len, texts[i].rate);
+        printf("%-8s %14.2f %14.2f %14.2f\n", texts[i].name,
+               run(data, len, 0), run(data, len, 1), run(data, len, 2));
+    }
+    free(data);
+    return 0;
+}
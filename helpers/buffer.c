@@ -2,69 +2,142 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdarg.h>
+#include <string.h>
+#include <assert.h>
+
+void buffer_init(struct buffer* buffer)
+{
+    buffer->heap = NULL;
+    buffer->rindex = 0;
+    buffer->len = 0;
+    buffer->msize = BUFFER_INLINE_SIZE;
+}
 
 struct buffer* buffer_create()
 {
     struct buffer* buf = calloc(sizeof(struct buffer), 1);
-    buf->data = calloc(BUFFER_REALLOC_AMOUNT, 1);
-    buf->len = 0;
-    buf->msize = BUFFER_REALLOC_AMOUNT;
+    buffer_init(buf);
     return buf;
 }
 
+static char* buffer_data(struct buffer* buffer)
+{
+    return buffer->heap ? buffer->heap : buffer->inline_data;
+}
+
+static void buffer_resize(struct buffer* buffer, size_t msize)
+{
+    if (!buffer->heap)
+    {
+        char* heap = malloc(msize);
+        assert(heap);
+        memcpy(heap, buffer->inline_data, buffer->len);
+        buffer->heap = heap;
+    }
+    else
+    {
+        buffer->heap = realloc(buffer->heap, msize);
+        assert(buffer->heap);
+    }
+    buffer->msize = msize;
+}
+
 void buffer_extend(struct buffer* buffer, size_t size)
 {
-    buffer->data = realloc(buffer->data, buffer->msize+size);
-    buffer->msize+=size;
+    buffer_resize(buffer, buffer->msize + size);
 }
 
-void buffer_need(struct buffer* buffer, size_t size)
+void buffer_reserve(struct buffer* buffer, size_t size)
 {
-    if (buffer->msize <= (buffer->len+size))
+    size_t needed = buffer->len + size;
+    if (needed <= buffer->msize)
+    {
+        return;
+    }
+
+    size_t msize = buffer->msize * 2;
+    if (msize < needed)
     {
-        size += BUFFER_REALLOC_AMOUNT;
-        buffer_extend(buffer, size);
+        msize = needed;
     }
+    buffer_resize(buffer, msize);
 }
 
+// Formats into the spare capacity, if the output doesn't fit the exact size
+// vsnprintf reported is reserved and formatting is done a second time.
+// Returns the amount of characters written, excluding the terminator.
+static size_t buffer_vformat(struct buffer* buffer, const char* fmt, va_list args)
+{
+    va_list retry;
+    va_copy(retry, args);
+
+    size_t available = buffer->msize - buffer->len;
+    int actual_len = vsnprintf(&buffer_data(buffer)[buffer->len], available, fmt, args);
+    assert(actual_len >= 0);
+    if ((size_t)actual_len >= available)
+    {
+        buffer_reserve(buffer, actual_len + 1);
+        vsnprintf(&buffer_data(buffer)[buffer->len], actual_len + 1, fmt, retry);
+    }
+
+    va_end(retry);
+    return actual_len;
+}
 
 void buffer_printf(struct buffer* buffer, const char* fmt, ...)
 {
     va_list args;
     va_start(args, fmt);
-    int index = buffer->len;
-    // Temporary, this is a limitation we are guessing the size is no more than 2048
-    int len = 2048;
-    buffer_extend(buffer, len);
-    int actual_len = vsnprintf(&buffer->data[index], len, fmt, args);
-    buffer->len += actual_len;
+    buffer->len += buffer_vformat(buffer, fmt, args);
     va_end(args);
 }
 
-void buffer_printf_no_terminator(struct buffer* buffer, const char* fmt, ...)
+void buffer_vprintf(struct buffer* buffer, const char* fmt, va_list args)
 {
-    va_list args;
-    va_start(args, fmt);
-    int index = buffer->len;
-    // Temporary, this is a limitation we are guessing the size is no more than 2048
-    int len = 2048;
-    buffer_extend(buffer, len);
-    int actual_len = vsnprintf(&buffer->data[index], len, fmt, args);
-    buffer->len += actual_len-1;
-    va_end(args);
+    buffer->len += buffer_vformat(buffer, fmt, args);
 }
 
 void buffer_write(struct buffer* buffer, char c)
 {
-    buffer_need(buffer, sizeof(char));
+    if (buffer->len == buffer->msize)
+    {
+        buffer_reserve(buffer, 1);
+    }
 
-    buffer->data[buffer->len] = c;
+    buffer_data(buffer)[buffer->len] = c;
     buffer->len++;
 }
 
+void buffer_write_bytes(struct buffer* buffer, const void* bytes, size_t len)
+{
+    buffer_reserve(buffer, len);
+    memcpy(&buffer_data(buffer)[buffer->len], bytes, len);
+    buffer->len += len;
+}
+
 void* buffer_ptr(struct buffer* buffer)
 {
-    return buffer->data;
+    return buffer_data(buffer);
+}
+
+size_t buffer_len(struct buffer* buffer)
+{
+    return buffer->len;
+}
+
+char* buffer_strdup(struct buffer* buffer)
+{
+    char* str = malloc(buffer->len + 1);
+    assert(str);
+    memcpy(str, buffer_data(buffer), buffer->len);
+    str[buffer->len] = '\0';
+    return str;
+}
+
+void buffer_clear(struct buffer* buffer)
+{
+    buffer->len = 0;
+    buffer->rindex = 0;
 }
 
 char buffer_read(struct buffer* buffer)
@@ -73,7 +146,7 @@ char buffer_read(struct buffer* buffer)
     {
         return -1;
     }
-    char c = buffer->data[buffer->rindex];
+    char c = buffer_data(buffer)[buffer->rindex];
     buffer->rindex++;
     return c;
 }
@@ -84,12 +157,18 @@ char buffer_peek(struct buffer* buffer)
     {
         return -1;
     }
-    char c = buffer->data[buffer->rindex];
+    char c = buffer_data(buffer)[buffer->rindex];
     return c;
 }
 
+void buffer_release(struct buffer* buffer)
+{
+    free(buffer->heap);
+    buffer_init(buffer);
+}
+
 void buffer_free(struct buffer* buffer)
 {
-    free(buffer->data);
+    buffer_release(buffer);
     free(buffer);
-}
\ No newline at end of file
+}
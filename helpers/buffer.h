@@ -3,28 +3,71 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <stdarg.h>
 
-#define BUFFER_REALLOC_AMOUNT 2000
+// Amount of bytes stored inside the struct buffer itself. Short contents, like
+// most token spellings, never touch the heap when the buffer lives on the
+// stack, see buffer_init.
+#define BUFFER_INLINE_SIZE 64
+/**
+ * The contents are in inline_data until they outgrow it, then on the heap.
+ * No pointer into the struct itself is kept, the address of the contents is
+ * worked out on each access, so a buffer may be copied by value: the copy of
+ * a buffer still inline has its own contents. The copy of a grown buffer
+ * shares its heap storage, it's a move, only one of the two may be used and
+ * released afterwards.
+ */
 struct buffer
 {
-    char* data;
+    // NULL while the contents are in inline_data.
+    char* heap;
     // Read index
-    int rindex;
-    int len;
-    int msize;
+    size_t rindex;
+    size_t len;
+    size_t msize;
+    char inline_data[BUFFER_INLINE_SIZE];
 };
 
 struct buffer* buffer_create();
+/**
+ * Initialises a buffer embedded in another struct or living on the stack,
+ * it must be released with buffer_release.
+ */
+void buffer_init(struct buffer* buffer);
+/**
+ * Frees the heap storage of a buffer initialised with buffer_init.
+ */
+void buffer_release(struct buffer* buffer);
 
 char buffer_read(struct buffer* buffer);
 char buffer_peek(struct buffer* buffer);
 
 void buffer_extend(struct buffer* buffer, size_t size);
+/**
+ * Ensures at least "size" more bytes can be written without reallocating.
+ * Capacity at least doubles on every reallocation.
+ */
+void buffer_reserve(struct buffer* buffer, size_t size);
+/**
+ * Appends the formatted string, the buffer stays NULL terminated but the
+ * terminator is not counted in len so the next write replaces it.
+ */
 void buffer_printf(struct buffer* buffer, const char* fmt, ...);
-void buffer_printf_no_terminator(struct buffer* buffer, const char* fmt, ...);
+void buffer_vprintf(struct buffer* buffer, const char* fmt, va_list args);
 void buffer_write(struct buffer* buffer, char c);
+void buffer_write_bytes(struct buffer* buffer, const void* bytes, size_t len);
 void* buffer_ptr(struct buffer* buffer);
+size_t buffer_len(struct buffer* buffer);
+/**
+ * Returns a heap allocated, NULL terminated copy of the buffer contents which
+ * outlives the buffer.
+ */
+char* buffer_strdup(struct buffer* buffer);
+/**
+ * Empties the buffer, keeping its capacity for reuse.
+ */
+void buffer_clear(struct buffer* buffer);
 void buffer_free(struct buffer* buffer);
 
 
-#endif
\ No newline at end of file
+#endif
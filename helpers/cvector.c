@@ -0,0 +1,127 @@
+#include "cvector.h"
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+struct cvector* cvector_create(size_t esize)
+{
+    struct cvector* cvector = calloc(1, sizeof(struct cvector));
+    cvector->esize = esize;
+    return cvector;
+}
+
+void cvector_free(struct cvector* cvector)
+{
+    for (int i = 0; i < CVECTOR_MAX_SEGMENTS; i++)
+    {
+        struct cvector_segment* segment = atomic_load_explicit(&cvector->segments[i], memory_order_relaxed);
+        if (!segment)
+        {
+            continue;
+        }
+        free(segment->ready);
+        free(segment->data);
+        free(segment);
+    }
+    free(cvector);
+}
+
+static size_t cvector_segment_elements(int segment)
+{
+    return CVECTOR_FIRST_SEGMENT_ELEMENTS << segment;
+}
+
+// Maps an index to its segment and the offset within that segment.
+// Segment k covers the indexes [F*(2^k - 1), F*(2^(k+1) - 1)) where F is
+// CVECTOR_FIRST_SEGMENT_ELEMENTS, so the segment is the position of the highest
+// set bit of index + F.
+static int cvector_locate(size_t index, size_t* offset)
+{
+    size_t biased = index + CVECTOR_FIRST_SEGMENT_ELEMENTS;
+    int segment = (63 - __builtin_clzll(biased)) - CVECTOR_FIRST_SEGMENT_SHIFT;
+    *offset = biased - (CVECTOR_FIRST_SEGMENT_ELEMENTS << segment);
+    return segment;
+}
+
+static struct cvector_segment* cvector_segment_get_or_create(struct cvector* cvector, int index)
+{
+    struct cvector_segment* segment = atomic_load_explicit(&cvector->segments[index], memory_order_acquire);
+    if (segment)
+    {
+        return segment;
+    }
+
+    size_t elements = cvector_segment_elements(index);
+    struct cvector_segment* created = malloc(sizeof(struct cvector_segment));
+    created->ready = calloc(elements, sizeof(unsigned char));
+    created->data = malloc(elements * cvector->esize);
+    assert(created->ready && created->data);
+
+    // Several pushers may race to create the same segment, the loser frees its
+    // allocation and uses the winner's.
+    if (atomic_compare_exchange_strong_explicit(&cvector->segments[index], &segment, created,
+                                                memory_order_acq_rel, memory_order_acquire))
+    {
+        return created;
+    }
+
+    free(created->ready);
+    free(created->data);
+    free(created);
+    return segment;
+}
+
+size_t cvector_push(struct cvector* cvector, void* elem)
+{
+    size_t index = atomic_fetch_add_explicit(&cvector->reserved, 1, memory_order_relaxed);
+    size_t offset;
+    int segment_index = cvector_locate(index, &offset);
+    assert(segment_index < CVECTOR_MAX_SEGMENTS);
+
+    struct cvector_segment* segment = cvector_segment_get_or_create(cvector, segment_index);
+    memcpy(segment->data + offset * cvector->esize, elem, cvector->esize);
+    atomic_store_explicit(&segment->ready[offset], 1, memory_order_release);
+    return index;
+}
+
+static bool cvector_is_ready(struct cvector* cvector, size_t index)
+{
+    size_t offset;
+    int segment_index = cvector_locate(index, &offset);
+    struct cvector_segment* segment = atomic_load_explicit(&cvector->segments[segment_index], memory_order_acquire);
+    if (!segment)
+    {
+        return false;
+    }
+
+    return atomic_load_explicit(&segment->ready[offset], memory_order_acquire);
+}
+
+size_t cvector_snapshot(struct cvector* cvector)
+{
+    size_t published = atomic_load_explicit(&cvector->published, memory_order_acquire);
+    size_t reserved = atomic_load_explicit(&cvector->reserved, memory_order_relaxed);
+    size_t count = published;
+    while (count < reserved && cvector_is_ready(cvector, count))
+    {
+        count++;
+    }
+
+    // Publish the longer prefix so the next snapshot doesn't have to rescan it,
+    // if another reader got further we keep theirs.
+    while (count > published &&
+           !atomic_compare_exchange_weak_explicit(&cvector->published, &published, count,
+                                                  memory_order_release, memory_order_acquire))
+    {
+    }
+
+    return count;
+}
+
+void* cvector_at(struct cvector* cvector, size_t index)
+{
+    size_t offset;
+    int segment_index = cvector_locate(index, &offset);
+    struct cvector_segment* segment = atomic_load_explicit(&cvector->segments[segment_index], memory_order_acquire);
+    return segment->data + offset * cvector->esize;
+}
@@ -0,0 +1,72 @@
+#ifndef CVECTOR_H
+#define CVECTOR_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Segment 0 holds 2^CVECTOR_FIRST_SEGMENT_SHIFT elements, every following
+// segment holds twice as many elements as the one before it.
+#define CVECTOR_FIRST_SEGMENT_SHIFT 6
+#define CVECTOR_FIRST_SEGMENT_ELEMENTS ((size_t)1 << CVECTOR_FIRST_SEGMENT_SHIFT)
+#define CVECTOR_MAX_SEGMENTS (64 - CVECTOR_FIRST_SEGMENT_SHIFT)
+
+struct cvector_segment
+{
+    // Set to 1 with release ordering once the element at the same offset has
+    // been fully copied in.
+    _Atomic unsigned char* ready;
+    char* data;
+};
+
+/**
+ * Append-only vector which may be pushed to from any amount of threads at
+ * once.
+ *
+ * A push reserves its index with a single atomic add and copies the element
+ * into a power of two sized segment, segments are allocated lazily and never
+ * move, so element addresses are stable. Readers are never blocked: they take
+ * a snapshot with cvector_snapshot which returns the length of the prefix of
+ * elements that are completely written, every index below it may be read.
+ *
+ * Elements can not be popped or modified through the cvector API.
+ */
+struct cvector
+{
+    _Atomic(struct cvector_segment*) segments[CVECTOR_MAX_SEGMENTS];
+    // Amount of indexes handed out to pushers.
+    atomic_size_t reserved;
+    // Length of the known fully written prefix, only ever grows.
+    atomic_size_t published;
+    size_t esize;
+};
+
+struct cvector* cvector_create(size_t esize);
+
+/**
+ * Frees the cvector, no other thread may be using it.
+ */
+void cvector_free(struct cvector* cvector);
+
+/**
+ * Copies the element pointed to by "elem" into the cvector.
+ * Safe to call concurrently from any thread.
+ * \return The index the element was stored at.
+ */
+size_t cvector_push(struct cvector* cvector, void* elem);
+
+/**
+ * Returns the amount of elements which are completely written, every index
+ * below the returned value can be read with cvector_at. Elements pushed after
+ * the snapshot was taken are not part of it.
+ */
+size_t cvector_snapshot(struct cvector* cvector);
+
+/**
+ * Returns the element at "index", "index" must be below a value returned by
+ * cvector_snapshot.
+ */
+void* cvector_at(struct cvector* cvector, size_t index);
+
+#endif
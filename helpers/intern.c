@@ -0,0 +1,164 @@
+#include "intern.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INTERNER_INITIAL_CAPACITY 1024
+
+struct interner* interner_create()
+{
+    struct interner* interner = calloc(1, sizeof(struct interner));
+    interner->capacity = INTERNER_INITIAL_CAPACITY;
+    interner->slots = calloc(interner->capacity, sizeof(struct interner_slot));
+    interner->strings_capacity = INTERNER_INITIAL_CAPACITY;
+    interner->strings = malloc(interner->strings_capacity * sizeof(char*));
+    interner->lengths = malloc(interner->strings_capacity * sizeof(uint32_t));
+    return interner;
+}
+
+static void interner_free_blocks(struct interner* interner, int keep)
+{
+    for (int i = keep; i < interner->block_count; i++)
+    {
+        free(interner->blocks[i]);
+    }
+    interner->block_count = keep < interner->block_count ? keep : interner->block_count;
+}
+
+void interner_free(struct interner* interner)
+{
+    interner_free_blocks(interner, 0);
+    free(interner->blocks);
+    free(interner->slots);
+    free(interner->strings);
+    free(interner->lengths);
+    free(interner);
+}
+
+// FNV-1a
+static uint32_t interner_hash(const char* str, size_t len)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++)
+    {
+        hash ^= (unsigned char)str[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Returns the slot holding the string or the empty slot it belongs in.
+static struct interner_slot* interner_slot(struct interner* interner, const char* str,
+                                           size_t len, uint32_t hash)
+{
+    uint32_t mask = interner->capacity - 1;
+    for (uint32_t i = hash & mask;; i = (i + 1) & mask)
+    {
+        struct interner_slot* slot = &interner->slots[i];
+        if (!slot->id)
+        {
+            return slot;
+        }
+        if (slot->hash == hash && interner->lengths[slot->id] == len &&
+            memcmp(interner->strings[slot->id], str, len) == 0)
+        {
+            return slot;
+        }
+    }
+}
+
+static void interner_grow(struct interner* interner)
+{
+    struct interner_slot* old = interner->slots;
+    uint32_t old_capacity = interner->capacity;
+    interner->capacity *= 2;
+    interner->slots = calloc(interner->capacity, sizeof(struct interner_slot));
+
+    uint32_t mask = interner->capacity - 1;
+    for (uint32_t i = 0; i < old_capacity; i++)
+    {
+        if (!old[i].id)
+        {
+            continue;
+        }
+        // ids are unique, no need to compare strings while reinserting.
+        uint32_t j = old[i].hash & mask;
+        while (interner->slots[j].id)
+        {
+            j = (j + 1) & mask;
+        }
+        interner->slots[j] = old[i];
+    }
+    free(old);
+}
+
+// Copies the string into block storage, returns the stable copy.
+static const char* interner_store(struct interner* interner, const char* str, size_t len)
+{
+    bool fits = interner->block_count && interner->block_used + len + 1 <= INTERNER_BLOCK_SIZE;
+    if (!fits)
+    {
+        size_t size = len + 1 > INTERNER_BLOCK_SIZE ? len + 1 : INTERNER_BLOCK_SIZE;
+        interner->blocks = realloc(interner->blocks, (interner->block_count + 1) * sizeof(char*));
+        interner->blocks[interner->block_count++] = malloc(size);
+        interner->block_used = 0;
+    }
+
+    char* copy = interner->blocks[interner->block_count - 1] + interner->block_used;
+    memcpy(copy, str, len);
+    copy[len] = 0;
+    interner->block_used += len + 1;
+    return copy;
+}
+
+uint32_t interner_intern(struct interner* interner, const char* str, size_t len)
+{
+    uint32_t hash = interner_hash(str, len);
+    struct interner_slot* slot = interner_slot(interner, str, len, hash);
+    if (slot->id)
+    {
+        return slot->id;
+    }
+
+    uint32_t id = ++interner->count;
+    if (id == interner->strings_capacity)
+    {
+        interner->strings_capacity *= 2;
+        interner->strings = realloc(interner->strings, interner->strings_capacity * sizeof(char*));
+        interner->lengths = realloc(interner->lengths, interner->strings_capacity * sizeof(uint32_t));
+    }
+    interner->strings[id] = interner_store(interner, str, len);
+    interner->lengths[id] = len;
+    slot->hash = hash;
+    slot->id = id;
+
+    // keep the load factor under 3/4.
+    if ((interner->count + 1) * 4 > interner->capacity * 3)
+    {
+        interner_grow(interner);
+    }
+    return id;
+}
+
+uint32_t interner_find(struct interner* interner, const char* str, size_t len)
+{
+    return interner_slot(interner, str, len, interner_hash(str, len))->id;
+}
+
+const char* interner_string(struct interner* interner, uint32_t id)
+{
+    return interner->strings[id];
+}
+
+uint32_t interner_count(struct interner* interner)
+{
+    return interner->count;
+}
+
+void interner_clear(struct interner* interner)
+{
+    memset(interner->slots, 0, interner->capacity * sizeof(struct interner_slot));
+    interner->count = 0;
+    interner_free_blocks(interner, 1);
+    interner->block_used = 0;
+}
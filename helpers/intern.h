@@ -0,0 +1,76 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Strings are copied into blocks of this size, longer strings get a block of
+// their own.
+#define INTERNER_BLOCK_SIZE 16384
+
+struct interner_slot
+{
+    uint32_t hash;
+    // Id of the string stored in the slot, 0 for an empty slot.
+    uint32_t id;
+};
+
+/**
+ * Maps strings to small dense ids: interning the same characters twice gives
+ * the same id, so names can be compared and indexed by id afterwards.
+ *
+ * Ids start at 1, 0 never names a string. Lookups probe an open addressing
+ * table of ids, the strings themselves are kept in large blocks which never
+ * move, a string returned by interner_string stays valid until the interner
+ * is cleared or freed.
+ */
+struct interner
+{
+    struct interner_slot* slots;
+    // Power of two.
+    uint32_t capacity;
+
+    // Indexed by id, strings[0] is unused.
+    const char** strings;
+    uint32_t* lengths;
+    uint32_t count;
+    uint32_t strings_capacity;
+
+    // Blocks holding the string characters, the last one is filled.
+    char** blocks;
+    int block_count;
+    size_t block_used;
+};
+
+struct interner* interner_create();
+void interner_free(struct interner* interner);
+
+/**
+ * Returns the id of the "len" characters at "str", adding them if they were
+ * never interned.
+ */
+uint32_t interner_intern(struct interner* interner, const char* str, size_t len);
+
+/**
+ * Returns the id of the "len" characters at "str" or 0 if they were never
+ * interned. The interner is only read, any amount of threads may look up
+ * strings at once as long as none is interning.
+ */
+uint32_t interner_find(struct interner* interner, const char* str, size_t len);
+
+/**
+ * Returns the NULL terminated string of "id".
+ */
+const char* interner_string(struct interner* interner, uint32_t id);
+
+/**
+ * Returns the amount of interned strings, the highest id handed out.
+ */
+uint32_t interner_count(struct interner* interner);
+
+/**
+ * Forgets every string, the table and the first block are kept for reuse.
+ */
+void interner_clear(struct interner* interner);
+
+#endif
@@ -0,0 +1,112 @@
+#include "segvector.h"
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+struct segvector* segvector_create(size_t esize)
+{
+    struct segvector* segvector = calloc(1, sizeof(struct segvector));
+    segvector->blocks = calloc(SEGVECTOR_DIRECTORY_INCREMENT, sizeof(void*));
+    segvector->block_capacity = SEGVECTOR_DIRECTORY_INCREMENT;
+    segvector->esize = esize;
+    return segvector;
+}
+
+void segvector_free(struct segvector* segvector)
+{
+    for (int i = 0; i < segvector->block_count; i++)
+    {
+        free(segvector->blocks[i]);
+    }
+    free(segvector->blocks);
+    free(segvector);
+}
+
+static void segvector_grow_directory(struct segvector* segvector)
+{
+    // Only the directory of pointers moves, the blocks themselves stay put.
+    segvector->block_capacity *= 2;
+    segvector->blocks = realloc(segvector->blocks, segvector->block_capacity * sizeof(void*));
+    assert(segvector->blocks);
+}
+
+static void segvector_add_block(struct segvector* segvector)
+{
+    if (segvector->block_count == segvector->block_capacity)
+    {
+        segvector_grow_directory(segvector);
+    }
+
+    void* block = malloc(segvector->esize * SEGVECTOR_BLOCK_ELEMENTS);
+    assert(block);
+    segvector->blocks[segvector->block_count] = block;
+    segvector->block_count++;
+}
+
+void* segvector_at(struct segvector* segvector, int index)
+{
+    char* block = segvector->blocks[index >> SEGVECTOR_BLOCK_SHIFT];
+    return block + (index & SEGVECTOR_BLOCK_MASK) * segvector->esize;
+}
+
+void* segvector_push(struct segvector* segvector, void* elem)
+{
+    int block = segvector->count >> SEGVECTOR_BLOCK_SHIFT;
+    if (block == segvector->block_count)
+    {
+        segvector_add_block(segvector);
+    }
+
+    void* ptr = segvector_at(segvector, segvector->count);
+    memcpy(ptr, elem, segvector->esize);
+    segvector->count++;
+    return ptr;
+}
+
+void* segvector_peek_at(struct segvector* segvector, int index)
+{
+    if (index < 0 || index >= segvector->count)
+    {
+        return NULL;
+    }
+
+    return segvector_at(segvector, index);
+}
+
+void* segvector_back_or_null(struct segvector* segvector)
+{
+    return segvector_peek_at(segvector, segvector->count - 1);
+}
+
+void segvector_pop(struct segvector* segvector)
+{
+    segvector->count--;
+}
+
+void segvector_clear(struct segvector* segvector)
+{
+    segvector->count = 0;
+}
+
+int segvector_count(struct segvector* segvector)
+{
+    return segvector->count;
+}
+
+bool segvector_empty(struct segvector* segvector)
+{
+    return segvector->count == 0;
+}
+
+int segvector_block_count(struct segvector* segvector)
+{
+    return (segvector->count + SEGVECTOR_BLOCK_MASK) >> SEGVECTOR_BLOCK_SHIFT;
+}
+
+void* segvector_block(struct segvector* segvector, int block, int* elements)
+{
+    int first = block << SEGVECTOR_BLOCK_SHIFT;
+    int left = segvector->count - first;
+    *elements = left < SEGVECTOR_BLOCK_ELEMENTS ? left : SEGVECTOR_BLOCK_ELEMENTS;
+    return segvector->blocks[block];
+}
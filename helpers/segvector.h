@@ -0,0 +1,97 @@
+#ifndef SEGVECTOR_H
+#define SEGVECTOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Every block holds 2^SEGVECTOR_BLOCK_SHIFT elements, indexing is a shift and
+// a mask into the block directory.
+#define SEGVECTOR_BLOCK_SHIFT 8
+#define SEGVECTOR_BLOCK_ELEMENTS (1 << SEGVECTOR_BLOCK_SHIFT)
+#define SEGVECTOR_BLOCK_MASK (SEGVECTOR_BLOCK_ELEMENTS - 1)
+
+// Initial amount of block pointers the directory can hold before it has to
+// grow.
+#define SEGVECTOR_DIRECTORY_INCREMENT 16
+
+/**
+ * A segmented vector stores its elements in fixed size blocks which are never
+ * reallocated, only the directory of block pointers grows.
+ *
+ * Unlike struct vector, a pointer returned by any segvector function stays
+ * valid for the lifetime of the segvector no matter how many elements are
+ * pushed afterwards. This lets later stages hold raw element pointers, for
+ * example a struct token* inside an AST node.
+ */
+struct segvector
+{
+    // Directory of blocks, each block holds SEGVECTOR_BLOCK_ELEMENTS elements.
+    void** blocks;
+    // Amount of allocated blocks in the directory.
+    int block_count;
+    // Amount of block pointers the directory can hold.
+    int block_capacity;
+    // Amount of elements pushed.
+    int count;
+    size_t esize;
+};
+
+struct segvector* segvector_create(size_t esize);
+void segvector_free(struct segvector* segvector);
+
+/**
+ * Copies the element pointed to by "elem" to the back of the segvector.
+ * \return The stable address of the stored element.
+ */
+void* segvector_push(struct segvector* segvector, void* elem);
+
+/**
+ * Returns the element at "index", no bounds checking is done.
+ */
+void* segvector_at(struct segvector* segvector, int index);
+
+/**
+ * Returns the element at "index" or NULL if "index" is out of bounds.
+ */
+void* segvector_peek_at(struct segvector* segvector, int index);
+
+/**
+ * Returns the last pushed element or NULL if the segvector is empty.
+ */
+void* segvector_back_or_null(struct segvector* segvector);
+
+/**
+ * Removes the last element, the segvector must not be empty.
+ */
+void segvector_pop(struct segvector* segvector);
+
+/**
+ * Removes every element, the blocks are kept and reused by later pushes.
+ */
+void segvector_clear(struct segvector* segvector);
+
+int segvector_count(struct segvector* segvector);
+bool segvector_empty(struct segvector* segvector);
+
+/**
+ * Returns the amount of blocks holding at least one element.
+ */
+int segvector_block_count(struct segvector* segvector);
+
+/**
+ * Returns the first element of block "block" and writes the amount of
+ * elements stored in that block to "elements".
+ *
+ * Elements within a block are contiguous, iterating block by block touches
+ * memory sequentially:
+ *
+ *   for (int b = 0; b < segvector_block_count(vec); b++) {
+ *       int n;
+ *       struct token* toks = segvector_block(vec, b, &n);
+ *       for (int i = 0; i < n; i++) ...
+ *   }
+ */
+void* segvector_block(struct segvector* segvector, int block, int* elements);
+
+#endif
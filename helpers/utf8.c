@@ -0,0 +1,308 @@
+#include "utf8.h"
+#include <string.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#define UTF8_HAVE_SSSE3 1
+#endif
+
+// Scalar check of a single sequence starting at "p", returns the length of
+// the sequence or 0 if it's malformed. Follows table 3-7 of the Unicode
+// standard, the second byte ranges exclude overlong forms, surrogates and
+// code points past U+10FFFF.
+static int utf8_sequence_length(const unsigned char* p, const unsigned char* end)
+{
+    unsigned char c = p[0];
+    if (c < 0x80)
+    {
+        return 1;
+    }
+
+    int len;
+    unsigned char lo = 0x80, hi = 0xBF;
+    if (c >= 0xC2 && c <= 0xDF)
+    {
+        len = 2;
+    }
+    else if (c >= 0xE0 && c <= 0xEF)
+    {
+        len = 3;
+        if (c == 0xE0) lo = 0xA0;
+        if (c == 0xED) hi = 0x9F;
+    }
+    else if (c >= 0xF0 && c <= 0xF4)
+    {
+        len = 4;
+        if (c == 0xF0) lo = 0x90;
+        if (c == 0xF4) hi = 0x8F;
+    }
+    else
+    {
+        return 0;
+    }
+
+    if (end - p < len || p[1] < lo || p[1] > hi)
+    {
+        return 0;
+    }
+
+    for (int i = 2; i < len; i++)
+    {
+        if ((p[i] & 0xC0) != 0x80)
+        {
+            return 0;
+        }
+    }
+    return len;
+}
+
+static bool utf8_validate_range(const unsigned char* p, const unsigned char* end, const unsigned char* start, size_t* error_offset)
+{
+    while (p < end)
+    {
+        // ASCII runs are skipped 8 bytes at a time.
+        uint64_t word;
+        while (end - p >= 8 && (memcpy(&word, p, 8), !(word & 0x8080808080808080ULL)))
+        {
+            p += 8;
+        }
+        if (p == end)
+        {
+            break;
+        }
+
+        int len = utf8_sequence_length(p, end);
+        if (!len)
+        {
+            if (error_offset)
+            {
+                *error_offset = p - start;
+            }
+            return false;
+        }
+        p += len;
+    }
+    return true;
+}
+
+#ifdef UTF8_HAVE_SSSE3
+// Lookup based validation by Keiser and Lemire, "Validating UTF-8 In Less
+// Than One Instruction Per Byte". Every byte is classified by the high
+// nibble of the previous byte, the low nibble of the previous byte and the
+// high nibble of itself, each lookup yields a set of error bits which can
+// only all be set together for an invalid pair of bytes. Third and fourth
+// bytes of longer sequences are checked separately against the lead two and
+// three bytes back.
+
+#define UTF8_TOO_SHORT (1 << 0)
+#define UTF8_TOO_LONG (1 << 1)
+#define UTF8_OVERLONG_3 (1 << 2)
+#define UTF8_TOO_LARGE (1 << 3)
+#define UTF8_SURROGATE (1 << 4)
+#define UTF8_OVERLONG_2 (1 << 5)
+#define UTF8_TOO_LARGE_1000 (1 << 6)
+#define UTF8_OVERLONG_4 (1 << 6)
+#define UTF8_TWO_CONTS (1 << 7)
+#define UTF8_CARRY (UTF8_TOO_SHORT | UTF8_TOO_LONG | UTF8_TWO_CONTS)
+
+__attribute__((target("ssse3")))
+static inline __m128i utf8_lookup(__m128i table, __m128i nibbles)
+{
+    return _mm_shuffle_epi8(table, nibbles);
+}
+
+__attribute__((target("ssse3")))
+static inline __m128i utf8_high_nibbles(__m128i v)
+{
+    return _mm_and_si128(_mm_srli_epi16(v, 4), _mm_set1_epi8(0x0F));
+}
+
+__attribute__((target("ssse3")))
+static __m128i utf8_check_block(__m128i input, __m128i prev_input)
+{
+    const __m128i byte_1_high_table = _mm_setr_epi8(
+        // 0_______ ASCII lead
+        UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+        UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+        // 10______ continuation
+        UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS,
+        // 1100____, 1101____ two byte lead
+        UTF8_TOO_SHORT | UTF8_OVERLONG_2,
+        UTF8_TOO_SHORT,
+        // 1110____ three byte lead
+        UTF8_TOO_SHORT | UTF8_OVERLONG_3 | UTF8_SURROGATE,
+        // 1111____ four byte lead
+        UTF8_TOO_SHORT | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4);
+
+    const __m128i byte_1_low_table = _mm_setr_epi8(
+        UTF8_CARRY | UTF8_OVERLONG_3 | UTF8_OVERLONG_2 | UTF8_OVERLONG_4,
+        UTF8_CARRY | UTF8_OVERLONG_2,
+        UTF8_CARRY,
+        UTF8_CARRY,
+        UTF8_CARRY | UTF8_TOO_LARGE,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_SURROGATE,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000);
+
+    const __m128i byte_2_high_table = _mm_setr_epi8(
+        // ________ 0_______ ASCII
+        UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+        UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+        // ________ 1000____
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4,
+        // ________ 1001____
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE,
+        // ________ 101_____
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE | UTF8_TOO_LARGE,
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE | UTF8_TOO_LARGE,
+        // ________ 11______ lead
+        UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT);
+
+    __m128i prev1 = _mm_alignr_epi8(input, prev_input, 15);
+    __m128i special = _mm_and_si128(
+        _mm_and_si128(utf8_lookup(byte_1_high_table, utf8_high_nibbles(prev1)),
+                      utf8_lookup(byte_1_low_table, _mm_and_si128(prev1, _mm_set1_epi8(0x0F)))),
+        utf8_lookup(byte_2_high_table, utf8_high_nibbles(input)));
+
+    // Bytes two and three positions after a three or four byte lead must be
+    // continuations, which is exactly where the TWO_CONTS bit got set.
+    __m128i prev2 = _mm_alignr_epi8(input, prev_input, 14);
+    __m128i prev3 = _mm_alignr_epi8(input, prev_input, 13);
+    __m128i is_third = _mm_subs_epu8(prev2, _mm_set1_epi8((char)(0xE0 - 0x80)));
+    __m128i is_fourth = _mm_subs_epu8(prev3, _mm_set1_epi8((char)(0xF0 - 0x80)));
+    __m128i must_be_continuation = _mm_and_si128(_mm_or_si128(is_third, is_fourth), _mm_set1_epi8((char)0x80));
+    return _mm_xor_si128(must_be_continuation, special);
+}
+
+// Non zero where a lead byte in the last three positions of a block needs
+// more bytes than the block has left.
+__attribute__((target("ssse3")))
+static __m128i utf8_incomplete(__m128i input)
+{
+    const __m128i max_value = _mm_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        (char)(0xF0 - 1), (char)(0xE0 - 1), (char)(0xC0 - 1));
+    return _mm_subs_epu8(input, max_value);
+}
+
+__attribute__((target("ssse3")))
+static bool utf8_validate_ssse3(const unsigned char* data, size_t len)
+{
+    __m128i error = _mm_setzero_si128();
+    __m128i prev_input = _mm_setzero_si128();
+    __m128i prev_incomplete = _mm_setzero_si128();
+
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16)
+    {
+        __m128i input = _mm_loadu_si128((const __m128i*)(data + i));
+        if (!_mm_movemask_epi8(input))
+        {
+            // An ASCII block is only an error if the previous one ended in
+            // the middle of a sequence.
+            error = _mm_or_si128(error, prev_incomplete);
+        }
+        else
+        {
+            error = _mm_or_si128(error, utf8_check_block(input, prev_input));
+            prev_incomplete = utf8_incomplete(input);
+        }
+        prev_input = input;
+    }
+
+    if (i < len)
+    {
+        // The tail is padded with zeroes, an ASCII NUL after a truncated
+        // sequence fails like any other ASCII byte would.
+        unsigned char tail[16] = {0};
+        memcpy(tail, data + i, len - i);
+        __m128i input = _mm_loadu_si128((const __m128i*)tail);
+        error = _mm_or_si128(error, utf8_check_block(input, prev_input));
+        prev_incomplete = utf8_incomplete(input);
+    }
+    error = _mm_or_si128(error, prev_incomplete);
+
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(error, _mm_setzero_si128())) == 0xFFFF;
+}
+#endif
+
+bool utf8_validate(const char* data, size_t len, size_t* error_offset)
+{
+    const unsigned char* start = (const unsigned char*)data;
+    const unsigned char* end = start + len;
+
+#ifdef UTF8_HAVE_SSSE3
+    static int has_ssse3 = -1;
+    if (has_ssse3 < 0)
+    {
+        has_ssse3 = __builtin_cpu_supports("ssse3");
+    }
+    if (has_ssse3)
+    {
+        if (utf8_validate_ssse3(start, len))
+        {
+            return true;
+        }
+        // Only the scalar pass knows where the error is, it only runs on
+        // input that is known to be bad.
+        return utf8_validate_range(start, end, start, error_offset);
+    }
+
+    // Without SSSE3 pure ASCII blocks are still skipped 16 bytes at a time.
+    const unsigned char* p = start;
+    while (end - p >= 16 && !_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)p)))
+    {
+        p += 16;
+    }
+    return utf8_validate_range(p, end, start, error_offset);
+#else
+    return utf8_validate_range(start, end, start, error_offset);
+#endif
+}
+
+bool utf8_validate_scalar(const char* data, size_t len, size_t* error_offset)
+{
+    const unsigned char* start = (const unsigned char*)data;
+    return utf8_validate_range(start, start + len, start, error_offset);
+}
+
+bool utf8_validate_vector(const char* data, size_t len)
+{
+#ifdef UTF8_HAVE_SSSE3
+    if (__builtin_cpu_supports("ssse3"))
+    {
+        return utf8_validate_ssse3((const unsigned char*)data, len);
+    }
+#endif
+    return utf8_validate_scalar(data, len, NULL);
+}
+
+uint32_t utf8_decode(const char* p, const char* end, int* len)
+{
+    const unsigned char* s = (const unsigned char*)p;
+    if (s[0] < 0x80 || end - p < 2)
+    {
+        *len = 1;
+        return s[0];
+    }
+    if (s[0] < 0xE0)
+    {
+        *len = 2;
+        return ((uint32_t)(s[0] & 0x1F) << 6) | (s[1] & 0x3F);
+    }
+    if (s[0] < 0xF0)
+    {
+        *len = 3;
+        return ((uint32_t)(s[0] & 0x0F) << 12) | ((uint32_t)(s[1] & 0x3F) << 6) | (s[2] & 0x3F);
+    }
+    *len = 4;
+    return ((uint32_t)(s[0] & 0x07) << 18) | ((uint32_t)(s[1] & 0x3F) << 12) | ((uint32_t)(s[2] & 0x3F) << 6) | (s[3] & 0x3F);
+}
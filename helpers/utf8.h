@@ -0,0 +1,42 @@
+#ifndef UTF8_H
+#define UTF8_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * Validates that [data, data+len) is well formed UTF-8: no overlong
+ * encodings, surrogates, code points past U+10FFFF or truncated sequences.
+ *
+ * Runs 16 bytes at a time, pure ASCII blocks only cost a movemask. On x86-64
+ * CPUs with SSSE3 non ASCII blocks are checked with table lookups as well,
+ * otherwise they fall back to a scalar check.
+ *
+ * \param error_offset If not NULL and the input is invalid, receives the
+ * offset of the first byte of the first invalid sequence.
+ * \return true if the input is valid.
+ */
+bool utf8_validate(const char* data, size_t len, size_t* error_offset);
+
+/**
+ * The scalar check utf8_validate falls back to, whatever the CPU. For
+ * testing and benchmarking the vectorized check against.
+ */
+bool utf8_validate_scalar(const char* data, size_t len, size_t* error_offset);
+
+/**
+ * The vectorized check alone, without the scalar pass that locates errors.
+ * Is the scalar check where SSSE3 isn't available.
+ */
+bool utf8_validate_vector(const char* data, size_t len);
+
+/**
+ * Decodes the sequence at "p", which must be valid UTF-8 and not run past
+ * "end".
+ * \param len Receives the amount of bytes of the sequence.
+ * \return The code point.
+ */
+uint32_t utf8_decode(const char* p, const char* end, int* len);
+
+#endif
@@ -64,6 +64,10 @@ struct vector *vector_create(size_t esize)
 
 void vector_free(struct vector *vector)
 {
+    if (vector->saves)
+    {
+        vector_free(vector->saves);
+    }
     free(vector->data);
     free(vector);
 }
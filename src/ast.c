@@ -0,0 +1,164 @@
+#include "ast.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// What node::a and node::b of each kind hold, for ast_splice to renumber.
+enum {
+    AST_FIELD_NONE,
+    AST_FIELD_NODE,
+    // extra index of a list.
+    AST_FIELD_LIST,
+    // extra index of two or three optional nodes.
+    AST_FIELD_PAIR,
+    AST_FIELD_TRIPLE,
+};
+
+// The node indices set by the resolver are not listed, see ast_splice.
+static const uint8_t ast_fields[NODE_KIND_COUNT][2] = {
+    [NODE_UNARY] = {AST_FIELD_NODE},
+    [NODE_POSTFIX] = {AST_FIELD_NODE},
+    [NODE_BINARY] = {AST_FIELD_NODE, AST_FIELD_NODE},
+    [NODE_CONDITIONAL] = {AST_FIELD_NODE, AST_FIELD_PAIR},
+    [NODE_CALL] = {AST_FIELD_NODE, AST_FIELD_LIST},
+    [NODE_INDEX] = {AST_FIELD_NODE, AST_FIELD_NODE},
+    [NODE_MEMBER] = {AST_FIELD_NODE},
+    [NODE_CAST] = {AST_FIELD_NODE, AST_FIELD_NODE},
+    [NODE_SIZEOF_EXPR] = {AST_FIELD_NODE},
+    [NODE_SIZEOF_TYPE] = {AST_FIELD_NODE},
+    [NODE_INIT_LIST] = {AST_FIELD_LIST},
+    [NODE_COMPOUND] = {AST_FIELD_LIST},
+    [NODE_EXPRESSION_STMT] = {AST_FIELD_NODE},
+    [NODE_IF] = {AST_FIELD_NODE, AST_FIELD_PAIR},
+    [NODE_WHILE] = {AST_FIELD_NODE, AST_FIELD_NODE},
+    [NODE_DO] = {AST_FIELD_NODE, AST_FIELD_NODE},
+    [NODE_FOR] = {AST_FIELD_TRIPLE, AST_FIELD_NODE},
+    [NODE_SWITCH] = {AST_FIELD_NODE, AST_FIELD_NODE},
+    [NODE_CASE] = {AST_FIELD_NODE, AST_FIELD_NODE},
+    [NODE_DEFAULT] = {AST_FIELD_NONE, AST_FIELD_NODE},
+    [NODE_LABEL] = {AST_FIELD_NODE},
+    [NODE_RETURN] = {AST_FIELD_NODE},
+    [NODE_DECLARATION] = {AST_FIELD_LIST, AST_FIELD_NODE},
+    [NODE_VAR] = {AST_FIELD_NODE, AST_FIELD_NODE},
+    [NODE_PARAM] = {AST_FIELD_NODE},
+    [NODE_FUNCTION] = {AST_FIELD_NODE, AST_FIELD_NODE},
+    [NODE_TRANSLATION_UNIT] = {AST_FIELD_LIST},
+    [NODE_TYPE_POINTER] = {AST_FIELD_NODE},
+    [NODE_TYPE_ARRAY] = {AST_FIELD_NODE, AST_FIELD_NODE},
+    [NODE_TYPE_FUNCTION] = {AST_FIELD_NODE, AST_FIELD_LIST},
+    [NODE_TYPE_STRUCT] = {AST_FIELD_LIST},
+};
+
+void ast_init(struct ast *ast) {
+    memset(ast, 0, sizeof(*ast));
+    ast_reset(ast);
+}
+
+void ast_free(struct ast *ast) {
+    free(ast->nodes);
+    free(ast->extra);
+    memset(ast, 0, sizeof(*ast));
+}
+
+void ast_reset(struct ast *ast) {
+    // index 0 stands for "none" in both arrays.
+    ast->count = 0;
+    ast->extra_count = 0;
+    ast->root = 0;
+    ast_add(ast, NODE_NONE, 0, 0, 0, 0);
+    uint32_t none = 0;
+    ast_add_extra(ast, &none, 1);
+}
+
+uint32_t ast_add(struct ast *ast, int kind, int op, uint32_t token, uint32_t a,
+                 uint32_t b) {
+    if (ast->count == ast->capacity) {
+        ast->capacity = ast->capacity ? ast->capacity * 2 : 1024;
+        ast->nodes = realloc(ast->nodes, ast->capacity * sizeof(struct node));
+    }
+    ast->nodes[ast->count] = (struct node){
+        .kind = kind, .op = op, .token = token, .a = a, .b = b};
+    return ast->count++;
+}
+
+uint32_t ast_add_extra(struct ast *ast, const uint32_t *values, uint32_t n) {
+    if (ast->extra_count + n > ast->extra_capacity) {
+        uint32_t capacity = ast->extra_capacity ? ast->extra_capacity : 1024;
+        while (capacity < ast->extra_count + n) capacity *= 2;
+        ast->extra = realloc(ast->extra, capacity * sizeof(uint32_t));
+        ast->extra_capacity = capacity;
+    }
+    uint32_t index = ast->extra_count;
+    if (n) memcpy(&ast->extra[index], values, n * sizeof(uint32_t));
+    ast->extra_count += n;
+    return index;
+}
+
+uint32_t ast_add_list(struct ast *ast, const uint32_t *items, uint32_t n) {
+    uint32_t index = ast_add_extra(ast, &n, 1);
+    ast_add_extra(ast, items, n);
+    return index;
+}
+
+void ast_extend(struct ast *ast, uint32_t nodes, uint32_t extra) {
+    uint32_t capacity = ast->capacity ? ast->capacity : 1024;
+    while (capacity < ast->count + nodes) capacity *= 2;
+    if (capacity != ast->capacity) {
+        ast->nodes = realloc(ast->nodes, capacity * sizeof(struct node));
+        ast->capacity = capacity;
+    }
+    ast->count += nodes;
+
+    capacity = ast->extra_capacity ? ast->extra_capacity : 1024;
+    while (capacity < ast->extra_count + extra) capacity *= 2;
+    if (capacity != ast->extra_capacity) {
+        ast->extra = realloc(ast->extra, capacity * sizeof(uint32_t));
+        ast->extra_capacity = capacity;
+    }
+    ast->extra_count += extra;
+}
+
+// Renumbers the `n` optional nodes at `values`.
+static void ast_splice_nodes(uint32_t *values, uint32_t n, uint32_t delta) {
+    for (uint32_t i = 0; i < n; i++)
+        if (values[i]) values[i] += delta;
+}
+
+// Renumbers `*field` of the kind `what`, the extra values it refers to were
+// already copied to `extra`.
+static void ast_splice_field(uint32_t *field, int what, uint32_t *extra,
+                             uint32_t node_delta, uint32_t extra_delta) {
+    if (!*field || what == AST_FIELD_NONE) return;
+    if (what == AST_FIELD_NODE) {
+        *field += node_delta;
+        return;
+    }
+
+    *field += extra_delta;
+    uint32_t *values = &extra[*field];
+    if (what == AST_FIELD_LIST)
+        ast_splice_nodes(values + 1, values[0], node_delta);
+    else
+        ast_splice_nodes(values, what == AST_FIELD_PAIR ? 2 : 3, node_delta);
+}
+
+void ast_splice(struct ast *dst, uint32_t node_at, uint32_t extra_at,
+                const struct ast *src) {
+    uint32_t node_delta = node_at - 1;
+    uint32_t extra_delta = extra_at - 1;
+    memcpy(&dst->nodes[node_at], &src->nodes[1],
+           (src->count - 1) * sizeof(struct node));
+    memcpy(&dst->extra[extra_at], &src->extra[1],
+           (src->extra_count - 1) * sizeof(uint32_t));
+
+    // every extra range belongs to exactly one node, it's renumbered along
+    // with that node.
+    for (uint32_t i = node_at; i < node_at + src->count - 1; i++) {
+        struct node *node = &dst->nodes[i];
+        const uint8_t *fields = ast_fields[node->kind];
+        ast_splice_field(&node->a, fields[0], dst->extra, node_delta,
+                         extra_delta);
+        ast_splice_field(&node->b, fields[1], dst->extra, node_delta,
+                         extra_delta);
+    }
+}
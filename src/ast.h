@@ -0,0 +1,213 @@
+#ifndef PEACHAST_H
+#define PEACHAST_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// The AST is a flat array of fixed size nodes. Nodes refer to their children
+// and to tokens of lexer::token_vec by 32-bit index, never by pointer, so the
+// array can grow by reallocation and the whole tree is released at once.
+//
+// Node 0 and extra slot 0 are reserved, an index of 0 means "none".
+// Children which don't fit in node::a and node::b, lists in particular, are
+// stored in ast::extra. A list is an extra index holding the item count
+// followed by the items, see ast_list.
+
+enum {
+    NODE_NONE,
+
+    // Expressions.
+    // token is the literal.
+    NODE_NUMBER,
+    // token is the first of `b` adjacent string literals, concatenated.
+    NODE_STRING,
+    // token is the name.
+    NODE_IDENTIFIER,
+    // prefix operator `op` applied to `a`: + - ! ~ * & ++ --.
+    NODE_UNARY,
+    // postfix ++ or -- applied to `a`.
+    NODE_POSTFIX,
+    // `a` op `b`, assignments and ',' included.
+    NODE_BINARY,
+    // `a` ? extra[b] : extra[b + 1].
+    NODE_CONDITIONAL,
+    // call of `a` with the argument list `b`.
+    NODE_CALL,
+    // `a`[`b`].
+    NODE_INDEX,
+    // `a`.name or `a`->name, op is OPERATOR_DOT or OPERATOR_ARROW and token
+    // is the member name.
+    NODE_MEMBER,
+    // (type `a`) `b`.
+    NODE_CAST,
+    // sizeof expression `a`.
+    NODE_SIZEOF_EXPR,
+    // sizeof(type `a`).
+    NODE_SIZEOF_TYPE,
+    // { ... } initializer, `a` is the list of initializers.
+    NODE_INIT_LIST,
+
+    // Statements.
+    // { ... }, `a` is the list of statements and declarations.
+    NODE_COMPOUND,
+    // expression statement of `a`.
+    NODE_EXPRESSION_STMT,
+    NODE_EMPTY,
+    // if (`a`) extra[b] else extra[b + 1], the else branch may be none.
+    NODE_IF,
+    // while (`a`) `b`.
+    NODE_WHILE,
+    // do `a` while (`b`).
+    NODE_DO,
+    // for (extra[a]; extra[a + 1]; extra[a + 2]) `b`, any of the three may
+    // be none and the first may be a declaration.
+    NODE_FOR,
+    // switch (`a`) `b`.
+    NODE_SWITCH,
+    // case `a`: `b`.
+    NODE_CASE,
+    // default: `b`.
+    NODE_DEFAULT,
+    // token is the label, name: `a`.
+    NODE_LABEL,
+    // goto, token is the label.
+    NODE_GOTO,
+    // return with the optional value `a`.
+    NODE_RETURN,
+    NODE_BREAK,
+    NODE_CONTINUE,
+
+    // Declarations.
+    // declaration of the variables in list `a` sharing the base type `b`,
+    // the list is empty for a lone struct or union declaration.
+    NODE_DECLARATION,
+    // variable or function declaration, token is the name, `a` the type and
+    // `b` the optional initializer.
+    NODE_VAR,
+    // function parameter, token is the name and `a` the type. An unnamed
+    // parameter has NODE_FLAG_UNNAMED and token is where its type starts.
+    NODE_PARAM,
+    // function definition, token is the name, `a` the function type and `b`
+    // the body. While NODE_FLAG_BODY_PENDING is set the body isn't parsed yet
+    // and `b` is the index of its '{' token, see parser_parse_body.
+    NODE_FUNCTION,
+    // root of the tree, `a` is the list of external declarations.
+    NODE_TRANSLATION_UNIT,
+
+    // Types.
+    // op is the AST_TYPE_* of the type, token is where the specifiers start.
+    NODE_TYPE_BASE,
+    // pointer to `a`.
+    NODE_TYPE_POINTER,
+    // array of `a`, `b` is the optional size expression.
+    NODE_TYPE_ARRAY,
+    // function returning `a`, `b` is the list of NODE_PARAM.
+    NODE_TYPE_FUNCTION,
+    // struct or union, op tells which. token is the tag, `a` the optional
+    // list of member NODE_DECLARATION. Without a tag token is the keyword and
+    // NODE_FLAG_UNNAMED is set.
+    NODE_TYPE_STRUCT,
+
+    NODE_KIND_COUNT
+};
+
+// Base types of NODE_TYPE_BASE and NODE_TYPE_STRUCT, stored in node::op.
+enum {
+    AST_TYPE_VOID,
+    AST_TYPE_CHAR,
+    AST_TYPE_SHORT,
+    AST_TYPE_INT,
+    AST_TYPE_LONG,
+    AST_TYPE_LONG_LONG,
+    AST_TYPE_FLOAT,
+    AST_TYPE_DOUBLE,
+    AST_TYPE_LONG_DOUBLE,
+    AST_TYPE_STRUCT,
+    AST_TYPE_UNION,
+};
+
+// node::flags
+enum {
+    // type nodes.
+    NODE_FLAG_CONST = 0b00000001,
+    NODE_FLAG_UNSIGNED = 0b00000010,
+    // NODE_TYPE_FUNCTION ending its parameters with '...'.
+    NODE_FLAG_VARIADIC = 0b00000100,
+    // NODE_VAR and NODE_FUNCTION storage classes.
+    NODE_FLAG_STATIC = 0b00001000,
+    NODE_FLAG_EXTERN = 0b00010000,
+    // NODE_PARAM and NODE_TYPE_STRUCT without a name.
+    NODE_FLAG_UNNAMED = 0b00100000,
+    // NODE_TYPE_BASE spelled with 'signed', only matters for char.
+    NODE_FLAG_SIGNED = 0b01000000,
+    // NODE_FUNCTION whose body is still a token range.
+    NODE_FLAG_BODY_PENDING = 0b10000000,
+};
+
+struct node {
+    uint8_t kind;
+    uint8_t flags;
+    // operator or type the node stands for, see the NODE_* kinds.
+    uint16_t op;
+    // index in lexer::token_vec of the token the node is reported at.
+    uint32_t token;
+    uint32_t a;
+    uint32_t b;
+};
+
+_Static_assert(sizeof(struct node) == 16, "AST nodes must stay 16 bytes");
+
+struct ast {
+    struct node *nodes;
+    uint32_t count;
+    uint32_t capacity;
+
+    // children of nodes with more than two of them, and lists.
+    uint32_t *extra;
+    uint32_t extra_count;
+    uint32_t extra_capacity;
+
+    // NODE_TRANSLATION_UNIT of the last parse, 0 before it.
+    uint32_t root;
+};
+
+void ast_init(struct ast *ast);
+// Releases every node at once.
+void ast_free(struct ast *ast);
+// Drops every node, the storage is kept for the next tree.
+void ast_reset(struct ast *ast);
+
+// Appends a node and returns its index. Pointers into ast::nodes are
+// invalidated, indices never are.
+uint32_t ast_add(struct ast *ast, int kind, int op, uint32_t token, uint32_t a,
+                 uint32_t b);
+
+// Appends `n` values to ast::extra, returns the index of the first.
+uint32_t ast_add_extra(struct ast *ast, const uint32_t *values, uint32_t n);
+// Stores a list of `n` node indices, returns the list's index.
+uint32_t ast_add_list(struct ast *ast, const uint32_t *items, uint32_t n);
+
+// Appends `nodes` nodes and `extra` extra values left for the caller to fill
+// with ast_splice.
+void ast_extend(struct ast *ast, uint32_t nodes, uint32_t extra);
+
+// Copies the nodes and extra values of `src`, all but the reserved ones, to
+// `dst` at node `node_at` and extra index `extra_at`, renumbering the indices
+// they hold: node `i` of `src` becomes node `i - 1 + node_at`. `src` must not
+// be resolved yet, resolved names may refer to nodes outside of it.
+// Splices into disjoint ranges of `dst` may run on several threads at once.
+void ast_splice(struct ast *dst, uint32_t node_at, uint32_t extra_at,
+                const struct ast *src);
+
+static inline struct node *ast_node(struct ast *ast, uint32_t index) {
+    return &ast->nodes[index];
+}
+
+// Returns the items of the list at `list` and writes their amount to `count`.
+static inline uint32_t *ast_list(struct ast *ast, uint32_t list,
+                                 uint32_t *count) {
+    *count = ast->extra[list];
+    return &ast->extra[list + 1];
+}
+
+#endif  // PEACHAST_H
@@ -0,0 +1,160 @@
+#include "backend.h"
+
+#include <setjmp.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "ast.h"
+#include "codegen.h"
+#include "ir.h"
+#include "lexer.h"
+#include "lower.h"
+#include "opt.h"
+#include "parser.h"
+
+// Workers don't print their errors, as in bodies.c: each one stops at its
+// first failure, and the earliest failing function is then generated again
+// on the calling thread with diagnostics on.
+
+static struct parser *backend_parser(struct backend *b) {
+    return b->compiler->parser;
+}
+
+static uint32_t backend_token_count(struct backend *b, uint32_t function) {
+    struct parser *p = backend_parser(b);
+    struct node *body = ast_node(&p->ast, ast_node(&p->ast, function)->b);
+    return parser_token(p, body->token)->bracket_match - body->token + 1;
+}
+
+// Returns how many workers the functions are worth.
+static int backend_worker_count(struct backend *b) {
+    struct compiler *c = b->compiler;
+    if (c->flags & (COMPILER_FLAG_DUMP_IR | COMPILER_FLAG_DUMP_ASM)) return 1;
+    struct parser *p = backend_parser(b);
+    uint64_t tokens = 0;
+    for (uint32_t i = 0; i < p->function_count; i++)
+        tokens += backend_token_count(b, p->functions[i]);
+
+    long threads = c->threads;
+    if (threads <= 0) threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads > (long)(tokens / BACKEND_MIN_TOKENS_PER_WORKER))
+        threads = tokens / BACKEND_MIN_TOKENS_PER_WORKER;
+    return threads > 1 ? threads : 1;
+}
+
+static void backend_reserve_workers(struct backend *b, int count) {
+    struct compiler *c = b->compiler;
+    if (count > b->worker_count) {
+        b->workers = realloc(b->workers, count * sizeof(struct backend_worker));
+        for (int i = b->worker_count; i < count; i++) {
+            struct backend_worker *w = &b->workers[i];
+            *w = (struct backend_worker){.backend = b};
+            w->lower = lower_create(c);
+            w->lower->quiet = true;
+            w->codegen = codegen_create(c);
+            w->codegen->quiet = true;
+        }
+        b->worker_count = count;
+    }
+    for (int i = 0; i < count; i++)
+        if (!b->workers[i].opt && (c->flags & COMPILER_FLAG_OPTIMIZE))
+            b->workers[i].opt = opt_create();
+}
+
+// Splits parser::functions into `count` runs of about as many tokens.
+static void backend_partition(struct backend *b, int count) {
+    struct parser *p = backend_parser(b);
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < p->function_count; i++)
+        total += backend_token_count(b, p->functions[i]);
+
+    uint64_t tokens = 0;
+    uint32_t next = 0;
+    for (int i = 0; i < count; i++) {
+        struct backend_worker *w = &b->workers[i];
+        uint64_t share = total * (i + 1) / count;
+        w->first = next;
+        while (next < p->function_count && (tokens < share || i == count - 1))
+            tokens += backend_token_count(b, p->functions[next++]);
+        w->end = next;
+    }
+}
+
+// Lowers, optimizes and generates the function `i` of parser::functions
+// with the passes given.
+static void backend_function(struct compiler *c, struct lower *lower,
+                             struct opt *opt, struct codegen *codegen,
+                             uint32_t i) {
+    struct ir_function *fn = lower_function(lower, c->parser->functions[i]);
+    if (c->flags & COMPILER_FLAG_OPTIMIZE) opt_function(opt, fn);
+    if (c->flags & COMPILER_FLAG_DUMP_IR) ir_print(fn, stdout);
+    codegen_function(codegen, fn);
+}
+
+static void *backend_run(void *arg) {
+    struct backend_worker *w = arg;
+    struct compiler *c = w->backend->compiler;
+    codegen_fork(w->codegen, c->codegen);
+
+    jmp_buf jmp;
+    if (setjmp(jmp)) {
+        w->failed = w->current;
+        compiler_catch_errors(NULL);
+        return NULL;
+    }
+    compiler_catch_errors(&jmp);
+    for (w->current = w->first; w->current < w->end; w->current++)
+        backend_function(c, w->lower, w->opt, w->codegen, w->current);
+    compiler_catch_errors(NULL);
+    return NULL;
+}
+
+int backend_generate_all(struct backend *b) {
+    struct compiler *c = b->compiler;
+    struct parser *p = backend_parser(b);
+    int count = backend_worker_count(b);
+    if (count == 1) {
+        for (uint32_t i = 0; i < p->function_count; i++)
+            backend_function(c, c->lower, c->opt, c->codegen, i);
+        return BACKEND_ALL_OK;
+    }
+    backend_reserve_workers(b, count);
+    backend_partition(b, count);
+
+    // the last worker runs on the calling thread.
+    for (int i = 0; i < count; i++) b->workers[i].failed = UINT32_MAX;
+    for (int i = 0; i < count - 1; i++)
+        pthread_create(&b->workers[i].thread, NULL, backend_run,
+                       &b->workers[i]);
+    backend_run(&b->workers[count - 1]);
+    uint32_t failed = UINT32_MAX;
+    for (int i = 0; i < count; i++) {
+        if (i < count - 1) pthread_join(b->workers[i].thread, NULL);
+        if (b->workers[i].failed < failed) failed = b->workers[i].failed;
+    }
+
+    if (failed != UINT32_MAX) {
+        // reported by the compiler's own passes, which fail the compile.
+        backend_function(c, c->lower, c->opt, c->codegen, failed);
+        return BACKEND_GENERAL_ERROR;
+    }
+    for (int i = 0; i < count; i++)
+        codegen_join(c->codegen, b->workers[i].codegen);
+    return BACKEND_ALL_OK;
+}
+
+struct backend *backend_create(struct compiler *c) {
+    struct backend *b = calloc(1, sizeof(struct backend));
+    b->compiler = c;
+    return b;
+}
+
+void backend_free(struct backend *b) {
+    for (int i = 0; i < b->worker_count; i++) {
+        lower_free(b->workers[i].lower);
+        if (b->workers[i].opt) opt_free(b->workers[i].opt);
+        codegen_free(b->workers[i].codegen);
+    }
+    free(b->workers);
+    free(b);
+}
@@ -0,0 +1,65 @@
+#ifndef PEACHBACKEND_H
+#define PEACHBACKEND_H
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include "compiler.h"
+
+// Function bodies of at least this many tokens go to each worker thread,
+// smaller sources are generated on the calling thread only.
+#define BACKEND_MIN_TOKENS_PER_WORKER 4096
+
+enum backend_errors {
+    BACKEND_ALL_OK,
+    BACKEND_GENERAL_ERROR,
+};
+
+// Lowers, optimizes and generates a contiguous run of parser::functions
+// into a codegen of its own, joined to the compiler's once every worker is
+// done.
+struct backend_worker {
+    struct backend *backend;
+    struct lower *lower;
+    struct opt *opt;
+    struct codegen *codegen;
+
+    // functions [first, end) of parser::functions, and the one being worked
+    // on.
+    uint32_t first;
+    uint32_t end;
+    uint32_t current;
+
+    // function that failed to lower or generate, UINT32_MAX if none did.
+    uint32_t failed;
+
+    pthread_t thread;
+};
+
+// Phase three, run once the tree is typed and codegen_begin laid out the
+// file scope: functions only depend on it and on themselves, so they're
+// generated in parallel like bodies.h parses them, each worker taking a run
+// of consecutive functions. The workers' code, data and symbols are joined
+// in source order by codegen_join, the object is byte for byte the same
+// for any amount of workers.
+//
+// Printing the IR or the code of the functions takes a single worker, they
+// come out in order.
+struct backend {
+    struct compiler *compiler;
+
+    struct backend_worker *workers;
+    int worker_count;
+};
+
+struct backend *backend_create(struct compiler *c);
+void backend_free(struct backend *backend);
+
+// Generates every function of parser::functions into compiler::codegen,
+// using up to compiler::threads threads.
+// Returns BACKEND_ALL_OK if no errors were encountered. The first error in
+// source order is reported on stdout and fails the compile, see
+// compiler_fail.
+int backend_generate_all(struct backend *backend);
+
+#endif  // PEACHBACKEND_H
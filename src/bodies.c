@@ -0,0 +1,219 @@
+#include "bodies.h"
+
+#include <setjmp.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "ast.h"
+#include "lexer.h"
+#include "parser.h"
+#include "resolver.h"
+
+// Workers don't print their errors: several of them may fail at once and
+// the output would depend on timing. Each one stops at its first failure,
+// and the earliest failing function is then redone on the calling thread
+// with diagnostics on, reporting exactly what a serial compile would.
+
+static struct parser *bodies_parser(struct bodies *b) {
+    return b->compiler->parser;
+}
+
+static uint32_t bodies_token_count(struct bodies *b, uint32_t function) {
+    struct parser *p = bodies_parser(b);
+    uint32_t open = ast_node(&p->ast, function)->b;
+    return parser_token(p, open)->bracket_match - open + 1;
+}
+
+// Returns how many workers the pending bodies are worth.
+static int bodies_worker_count(struct bodies *b) {
+    struct parser *p = bodies_parser(b);
+    uint64_t tokens = 0;
+    for (uint32_t i = 0; i < p->function_count; i++)
+        tokens += bodies_token_count(b, p->functions[i]);
+
+    long threads = b->compiler->threads;
+    if (threads <= 0) threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads > (long)(tokens / BODIES_MIN_TOKENS_PER_WORKER))
+        threads = tokens / BODIES_MIN_TOKENS_PER_WORKER;
+    return threads > 1 ? threads : 1;
+}
+
+static void bodies_reserve_workers(struct bodies *b, int count) {
+    if (count <= b->worker_count) return;
+    b->workers = realloc(b->workers, count * sizeof(struct body_worker));
+    for (int i = b->worker_count; i < count; i++) {
+        struct body_worker *w = &b->workers[i];
+        *w = (struct body_worker){.bodies = b};
+        w->parser = parser_create(b->compiler);
+        w->parser->quiet = true;
+        w->resolver = resolver_create_body(b->compiler->resolver);
+        w->resolver->quiet = true;
+    }
+    b->worker_count = count;
+}
+
+// Splits parser::functions into `count` runs of about as many tokens.
+static void bodies_partition(struct bodies *b, int count) {
+    struct parser *p = bodies_parser(b);
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < p->function_count; i++)
+        total += bodies_token_count(b, p->functions[i]);
+
+    uint64_t tokens = 0;
+    uint32_t next = 0;
+    for (int i = 0; i < count; i++) {
+        struct body_worker *w = &b->workers[i];
+        uint64_t share = total * (i + 1) / count;
+        w->first = next;
+        while (next < p->function_count && (tokens < share || i == count - 1))
+            tokens += bodies_token_count(b, p->functions[next++]);
+        w->end = next;
+
+        uint32_t needed = w->end - w->first;
+        if (needed > w->root_capacity) {
+            w->root_capacity = needed;
+            w->roots = realloc(w->roots, needed * sizeof(uint32_t));
+        }
+    }
+}
+
+static void *bodies_parse_run(void *arg) {
+    struct body_worker *w = arg;
+    struct parser *p = bodies_parser(w->bodies);
+    ast_reset(&w->parser->ast);
+
+    jmp_buf jmp;
+    if (setjmp(jmp)) {
+        w->failed = w->current;
+        compiler_catch_errors(NULL);
+        return NULL;
+    }
+    compiler_catch_errors(&jmp);
+    for (w->current = w->first; w->current < w->end; w->current++) {
+        uint32_t open = ast_node(&p->ast, p->functions[w->current])->b;
+        w->roots[w->current - w->first] = parser_parse_body(w->parser, open);
+    }
+    compiler_catch_errors(NULL);
+    return NULL;
+}
+
+static void *bodies_resolve_run(void *arg) {
+    struct body_worker *w = arg;
+    struct parser *p = bodies_parser(w->bodies);
+    ast_splice(&p->ast, w->node_at, w->extra_at, &w->parser->ast);
+    for (uint32_t i = w->first; i < w->end; i++) {
+        struct node *function = ast_node(&p->ast, p->functions[i]);
+        function->b = w->roots[i - w->first] - 1 + w->node_at;
+        function->flags &= ~NODE_FLAG_BODY_PENDING;
+    }
+
+    jmp_buf jmp;
+    if (setjmp(jmp)) {
+        w->failed = w->current;
+        compiler_catch_errors(NULL);
+        return NULL;
+    }
+    compiler_catch_errors(&jmp);
+    for (w->current = w->first; w->current < w->end; w->current++)
+        resolver_resolve_body(w->resolver, p->functions[w->current]);
+    compiler_catch_errors(NULL);
+    return NULL;
+}
+
+// Runs `run` for the first `count` workers, the last one on the calling
+// thread, and returns the earliest function that failed, UINT32_MAX if none
+// did.
+static uint32_t bodies_run(struct bodies *b, int count, void *(*run)(void *)) {
+    for (int i = 0; i < count; i++) b->workers[i].failed = UINT32_MAX;
+    for (int i = 0; i < count - 1; i++)
+        pthread_create(&b->workers[i].thread, NULL, run, &b->workers[i]);
+    run(&b->workers[count - 1]);
+
+    uint32_t failed = UINT32_MAX;
+    for (int i = 0; i < count; i++) {
+        if (i < count - 1) pthread_join(b->workers[i].thread, NULL);
+        if (b->workers[i].failed < failed) failed = b->workers[i].failed;
+    }
+    return failed;
+}
+
+int bodies_parse_all(struct bodies *b) {
+    struct parser *p = bodies_parser(b);
+    int count = bodies_worker_count(b);
+    bodies_reserve_workers(b, count);
+    bodies_partition(b, count);
+
+    uint32_t failed = bodies_run(b, count, bodies_parse_run);
+    if (failed != UINT32_MAX) {
+        // reported by the compiler's own parser, which is done with the file
+        // scope.
+        uint32_t open = ast_node(&p->ast, p->functions[failed])->b;
+        parser_parse_body(p, open);
+        return BODIES_GENERAL_ERROR;
+    }
+
+    // the workers' trees follow each other in the order of their runs.
+    uint32_t node_at = p->ast.count;
+    uint32_t extra_at = p->ast.extra_count;
+    for (int i = 0; i < count; i++) {
+        struct body_worker *w = &b->workers[i];
+        w->node_at = node_at;
+        w->extra_at = extra_at;
+        node_at += w->parser->ast.count - 1;
+        extra_at += w->parser->ast.extra_count - 1;
+    }
+    ast_extend(&p->ast, node_at - p->ast.count, extra_at - p->ast.extra_count);
+
+    failed = bodies_run(b, count, bodies_resolve_run);
+    if (failed != UINT32_MAX) {
+        struct resolver *r = b->workers[0].resolver;
+        r->quiet = false;
+        resolver_resolve_body(r, p->functions[failed]);
+        r->quiet = true;
+        return BODIES_GENERAL_ERROR;
+    }
+    return BODIES_ALL_OK;
+}
+
+uint32_t bodies_parse_function(struct bodies *b, uint32_t function) {
+    struct compiler *c = b->compiler;
+    struct parser *p = bodies_parser(b);
+    struct node *node = ast_node(&p->ast, function);
+    if (!(node->flags & NODE_FLAG_BODY_PENDING)) return node->b;
+
+    if (!b->resolver) b->resolver = resolver_create_body(c->resolver);
+    uint32_t open = node->b;
+    if (setjmp(c->error_jmp)) {
+        // left pending, asking again reports the errors again.
+        c->recovering = false;
+        ast_node(&p->ast, function)->b = open;
+        return 0;
+    }
+    c->recovering = true;
+
+    // the body goes straight into the compiler's tree.
+    uint32_t body = parser_parse_body(p, open);
+    ast_node(&p->ast, function)->b = body;
+    resolver_resolve_body(b->resolver, function);
+    ast_node(&p->ast, function)->flags &= ~NODE_FLAG_BODY_PENDING;
+
+    c->recovering = false;
+    return body;
+}
+
+struct bodies *bodies_create(struct compiler *c) {
+    struct bodies *b = calloc(1, sizeof(struct bodies));
+    b->compiler = c;
+    return b;
+}
+
+void bodies_free(struct bodies *b) {
+    for (int i = 0; i < b->worker_count; i++) {
+        parser_free(b->workers[i].parser);
+        resolver_free(b->workers[i].resolver);
+        free(b->workers[i].roots);
+    }
+    free(b->workers);
+    if (b->resolver) resolver_free(b->resolver);
+    free(b);
+}
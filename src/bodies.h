@@ -0,0 +1,76 @@
+#ifndef PEACHBODIES_H
+#define PEACHBODIES_H
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include "compiler.h"
+
+// Bodies of at least this many tokens go to each worker thread, smaller
+// sources are parsed on the calling thread only.
+#define BODIES_MIN_TOKENS_PER_WORKER 16384
+
+enum body_errors {
+    BODIES_ALL_OK,
+    BODIES_GENERAL_ERROR,
+};
+
+// Parses and resolves a contiguous run of parser::functions into a tree of
+// its own, spliced into the compiler's tree once every worker is done.
+struct body_worker {
+    struct bodies *bodies;
+    struct parser *parser;
+    struct resolver *resolver;
+
+    // functions [first, end) of parser::functions, and the one being worked
+    // on.
+    uint32_t first;
+    uint32_t end;
+    uint32_t current;
+
+    // root of each body in the worker's tree, indexed from `first`.
+    uint32_t *roots;
+    uint32_t root_capacity;
+
+    // where the worker's tree goes in the compiler's tree.
+    uint32_t node_at;
+    uint32_t extra_at;
+
+    // function that failed to parse or resolve, UINT32_MAX if none did.
+    uint32_t failed;
+
+    pthread_t thread;
+};
+
+// Phase two of the front end. parser_parse and resolver_resolve only handle
+// the file scope, bodies are independent once it's known: they're parsed in
+// parallel, each worker taking a run of consecutive functions, and spliced
+// into the tree in source order. The tree comes out identical for any
+// amount of workers.
+struct bodies {
+    struct compiler *compiler;
+
+    struct body_worker *workers;
+    int worker_count;
+
+    // resolves the bodies parsed on demand, see bodies_parse_function.
+    struct resolver *resolver;
+};
+
+struct bodies *bodies_create(struct compiler *c);
+void bodies_free(struct bodies *bodies);
+
+// Parses and resolves every pending body of parser::functions, using up to
+// compiler::threads threads.
+// Returns BODIES_ALL_OK if no errors were encountered. The first error in
+// source order is reported on stdout and fails the compile, see
+// compiler_fail.
+int bodies_parse_all(struct bodies *bodies);
+
+// Parses and resolves the body of `function` on the calling thread unless
+// it already is, for tools which only look into some functions of a compile
+// made with COMPILER_FLAG_LAZY_BODIES. Returns the body, or 0 if it has
+// errors, they're reported on stdout.
+uint32_t bodies_parse_function(struct bodies *bodies, uint32_t function);
+
+#endif  // PEACHBODIES_H
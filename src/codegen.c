@@ -0,0 +1,770 @@
+#include "codegen.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "ast.h"
+#include "output.h"
+#include "parser.h"
+#include "types.h"
+
+// Instructions are selected one IR instruction at a time, with the
+// registers of regalloc.h: operands are read where they live, a register, a
+// home on the stack or an immediate, and the result is computed in its own
+// register, or in rax for the values spilled and stored to their home.
+// Operands with no location are materialized in a scratch register, rax or
+// rcx, rdx takes remainders and r11 the address of indirect calls.
+//
+// Values change places together at calls, for the arguments, at the
+// prologue, for the parameters, and at jumps, for the phis of the blocks
+// jumped to. These parallel moves are ordered so that no location is written
+// before it's read, cycles are broken through rax.
+
+// Registers of the first six integer arguments.
+static const uint8_t codegen_arg_regs[6] = {X86_RDI, X86_RSI, X86_RDX,
+                                            X86_RCX, X86_R8,  X86_R9};
+
+// Size in bytes of each IR type.
+static const uint8_t codegen_type_sizes[] = {
+    [IR_VOID] = 0, [IR_I8] = 1, [IR_I16] = 2, [IR_I32] = 4, [IR_I64] = 8};
+
+static const uint8_t codegen_binary_ops[IR_OP_COUNT] = {
+    [IR_ADD] = X86_ADD, [IR_SUB] = X86_SUB, [IR_MUL] = X86_IMUL,
+    [IR_AND] = X86_AND, [IR_OR] = X86_OR,   [IR_XOR] = X86_XOR,
+    [IR_SHL] = X86_SHL, [IR_SHR] = X86_SHR, [IR_SAR] = X86_SAR,
+};
+
+static const uint8_t codegen_conditions[IR_OP_COUNT] = {
+    [IR_EQ] = X86_CC_E,   [IR_NE] = X86_CC_NE,  [IR_LT] = X86_CC_L,
+    [IR_LE] = X86_CC_LE,  [IR_GT] = X86_CC_G,   [IR_GE] = X86_CC_GE,
+    [IR_ULT] = X86_CC_B,  [IR_ULE] = X86_CC_BE, [IR_UGT] = X86_CC_A,
+    [IR_UGE] = X86_CC_AE,
+};
+
+
+// Callee saved registers, saved at the top of the frame in this order by the
+// functions allocating them.
+static const uint8_t codegen_saved_regs[5] = {X86_RBX, X86_R12, X86_R13,
+                                              X86_R14, X86_R15};
+
+struct codegen *codegen_create(struct compiler *c) {
+    struct codegen *g = calloc(1, sizeof(struct codegen));
+    g->compiler = c;
+    g->parser = c->parser;
+    g->types = c->types;
+    object_init(&g->object);
+    x86_function_init(&g->x86);
+    regalloc_init(&g->regalloc);
+    ir_map_init(&g->names);
+    ir_map_init(&g->symbols);
+    ir_map_init(&g->strings);
+    buffer_init(&g->literal_bytes);
+    ir_map_init(&g->literal_hashes);
+    return g;
+}
+
+void codegen_free(struct codegen *g) {
+    if (!g) return;
+    object_free(&g->object);
+    x86_function_free(&g->x86);
+    regalloc_free(&g->regalloc);
+    ir_map_free(&g->names);
+    ir_map_free(&g->symbols);
+    ir_map_free(&g->strings);
+    free(g->literals);
+    buffer_release(&g->literal_bytes);
+    ir_map_free(&g->literal_hashes);
+    free(g->homes);
+    free(g->moves);
+    free(g->cases);
+    free(g->clusters);
+    free(g->pieces);
+    free(g);
+}
+
+static struct x86_inst *codegen_emit(struct codegen *g, int op, int size,
+                                     struct x86_operand dst,
+                                     struct x86_operand src) {
+    return x86_emit(&g->x86, op, size, dst, src);
+}
+
+static struct x86_operand codegen_home(struct codegen *g, uint32_t v) {
+    return x86_mem(X86_RBP, -(int32_t)g->homes[v]);
+}
+
+// Operation size of values of the IR `type`, narrower values are computed
+// on 32 bits.
+static int codegen_size(int type) {
+    return type == IR_I64 ? 8 : 4;
+}
+
+static int64_t codegen_constant(struct ir_inst *inst) {
+    int64_t value = (int64_t)((uint64_t)inst->a | (uint64_t)inst->b << 32);
+    return inst->type == IR_I64 ? value : (int32_t)value;
+}
+
+// Where the value `v` lives: its register, or its home if it was spilled.
+static struct x86_operand codegen_location(struct codegen *g, uint32_t v) {
+    uint8_t reg = g->regalloc.regs[v];
+    return reg != X86_NO_REG ? x86_reg(reg) : codegen_home(g, v);
+}
+
+static bool codegen_same(struct x86_operand a, struct x86_operand b) {
+    return a.kind == b.kind && a.base == b.base &&
+           (a.kind != X86_OPERAND_MEM || a.disp == b.disp);
+}
+
+// Gives the values spilled their home, and the stack slots their storage,
+// below the callee saved registers.
+static void codegen_frame(struct codegen *g) {
+    struct ir_function *fn = g->fn;
+    if (fn->count > g->home_capacity) {
+        g->home_capacity = fn->count * 2;
+        g->homes = realloc(g->homes, g->home_capacity * sizeof(uint32_t));
+    }
+    uint32_t frame = 8 * __builtin_popcount(g->regalloc.saved);
+    for (uint32_t v = 1; v < fn->count; v++) {
+        struct ir_inst *inst = ir_inst(fn, v);
+        uint32_t size = 8, align = 8;
+        g->homes[v] = 0;
+        if (inst->op == IR_SLOT) {
+            size = inst->a;
+            align = inst->b ? inst->b : 1;
+        } else if (!regalloc_has_location(fn, v) ||
+                   g->regalloc.regs[v] != X86_NO_REG) {
+            continue;
+        }
+        if (!size) continue;
+        frame = (frame + size + align - 1) & ~(align - 1);
+        g->homes[v] = frame;
+    }
+    g->frame_size = (frame + 15) & ~15u;
+}
+
+// Loads the value `v` into the 64-bit `reg`.
+static void codegen_load(struct codegen *g, int reg, uint32_t v) {
+    struct ir_inst *inst = ir_inst(g->fn, v);
+    if (regalloc_has_location(g->fn, v)) {
+        struct x86_operand at = codegen_location(g, v);
+        if (!codegen_same(at, x86_reg(reg)))
+            codegen_emit(g, X86_MOV, 8, x86_reg(reg), at);
+        return;
+    }
+    switch (inst->op) {
+    case IR_CONST:
+        codegen_emit(g, X86_MOV, codegen_size(inst->type), x86_reg(reg),
+                     x86_imm(codegen_constant(inst)));
+        return;
+    case IR_SLOT:
+        codegen_emit(g, X86_LEA, 8, x86_reg(reg), codegen_home(g, v));
+        return;
+    case IR_GLOBAL: {
+        // symbols of other objects may be in a shared library, their
+        // address is read from the GOT.
+        uint32_t symbol = codegen_symbol(g, inst->a);
+        if (codegen_defined(g, symbol))
+            codegen_emit(g, X86_LEA, 8, x86_reg(reg), x86_symbol(symbol, 0));
+        else
+            codegen_emit(g, X86_MOV, 8, x86_reg(reg), x86_got(symbol));
+        return;
+    }
+    case IR_STRING:
+        codegen_emit(g, X86_LEA, 8, x86_reg(reg),
+                     x86_symbol(codegen_string(g, inst->a), 0));
+        return;
+    }
+}
+
+// Returns the operand reading `v`: where it lives, the constant as an
+// immediate if it fits in 32 bits, or `scratch` it's materialized in.
+static struct x86_operand codegen_operand(struct codegen *g, uint32_t v,
+                                          int scratch) {
+    struct ir_inst *inst = ir_inst(g->fn, v);
+    if (regalloc_has_location(g->fn, v)) return codegen_location(g, v);
+    if (inst->op == IR_CONST) {
+        int64_t value = codegen_constant(inst);
+        if (value >= INT32_MIN && value <= INT32_MAX) return x86_imm(value);
+    }
+    codegen_load(g, scratch, v);
+    return x86_reg(scratch);
+}
+
+// Same as codegen_operand for instructions taking no immediate.
+static struct x86_operand codegen_rm(struct codegen *g, uint32_t v,
+                                     int scratch) {
+    struct x86_operand o = codegen_operand(g, v, scratch);
+    if (o.kind != X86_OPERAND_IMM) return o;
+    codegen_load(g, scratch, v);
+    return x86_reg(scratch);
+}
+
+// Returns the register holding `v`, `scratch` unless it lives in one.
+static int codegen_reg(struct codegen *g, uint32_t v, int scratch) {
+    struct x86_operand o = codegen_operand(g, v, scratch);
+    if (o.kind == X86_OPERAND_REG) return o.base;
+    codegen_load(g, scratch, v);
+    return scratch;
+}
+
+// Moves the operand `src` to `reg`.
+static void codegen_move(struct codegen *g, int reg, struct x86_operand src,
+                         int size) {
+    if (codegen_same(src, x86_reg(reg))) return;
+    codegen_emit(g, X86_MOV, size, x86_reg(reg), src);
+}
+
+// Register the result of `v` is computed in: its own, or rax if it was
+// spilled.
+static int codegen_target(struct codegen *g, uint32_t v) {
+    uint8_t reg = g->regalloc.regs[v];
+    return reg != X86_NO_REG ? reg : X86_RAX;
+}
+
+// Stores the result of `v` computed in `reg` to its home if it has one.
+static void codegen_result(struct codegen *g, uint32_t v, int reg) {
+    struct x86_operand at = codegen_location(g, v);
+    if (!codegen_same(at, x86_reg(reg)))
+        codegen_emit(g, X86_MOV, 8, at, x86_reg(reg));
+}
+
+// Adds a move to the parallel move being gathered: of the location `src`,
+// or of the value `value` materialized if it's not 0.
+static void codegen_add_move(struct codegen *g, struct x86_operand dst,
+                             struct x86_operand src, uint32_t value,
+                             int size) {
+    if (!value && codegen_same(dst, src)) return;
+    if (g->move_count == g->move_capacity) {
+        g->move_capacity = g->move_capacity ? g->move_capacity * 2 : 16;
+        g->moves = realloc(g->moves,
+                           g->move_capacity * sizeof(struct codegen_move));
+    }
+    g->moves[g->move_count++] =
+        (struct codegen_move){.dst = dst, .src = src, .value = value,
+                              .size = size};
+}
+
+// Adds a move of the value `v` to `dst`, undefined values aren't moved.
+static void codegen_add_value(struct codegen *g, struct x86_operand dst,
+                              uint32_t v) {
+    struct ir_inst *inst = ir_inst(g->fn, v);
+    int size = codegen_size(inst->type);
+    if (regalloc_has_location(g->fn, v))
+        codegen_add_move(g, dst, codegen_location(g, v), 0, size);
+    else if (inst->op != IR_UNDEF)
+        codegen_add_move(g, dst, (struct x86_operand){0}, v, size);
+}
+
+// Emits one move, through r11 between two homes.
+static void codegen_emit_move(struct codegen *g, struct codegen_move *m) {
+    if (m->value) {
+        if (m->dst.kind == X86_OPERAND_REG) {
+            codegen_load(g, m->dst.base, m->value);
+            return;
+        }
+        struct x86_operand src = codegen_operand(g, m->value, X86_R11);
+        codegen_emit(g, X86_MOV, src.kind == X86_OPERAND_IMM ? m->size : 8,
+                     m->dst, src);
+        return;
+    }
+    if (m->dst.kind == X86_OPERAND_MEM && m->src.kind == X86_OPERAND_MEM) {
+        codegen_emit(g, X86_MOV, 8, x86_reg(X86_R11), m->src);
+        codegen_emit(g, X86_MOV, 8, m->dst, x86_reg(X86_R11));
+        return;
+    }
+    codegen_emit(g, X86_MOV, m->size, m->dst, m->src);
+}
+
+// Emits the moves gathered as if they all happened at once, and clears
+// them. A move waits until no other one still reads its destination; when
+// only cycles are left, one destination is saved to rax first. Values
+// materialized read no location and are moved last.
+static void codegen_parallel(struct codegen *g) {
+    struct codegen_move *moves = g->moves;
+    uint32_t located = 0;
+    for (uint32_t i = 0; i < g->move_count; i++) {
+        if (moves[i].value) continue;
+        struct codegen_move m = moves[i];
+        moves[i] = moves[located];
+        moves[located++] = m;
+    }
+
+    uint32_t pending = located;
+    while (pending) {
+        bool progress = false;
+        for (uint32_t i = 0; i < pending;) {
+            bool read = false;
+            for (uint32_t j = 0; j < pending && !read; j++)
+                read = j != i && codegen_same(moves[j].src, moves[i].dst);
+            if (read) {
+                i++;
+                continue;
+            }
+            codegen_emit_move(g, &moves[i]);
+            moves[i] = moves[--pending];
+            progress = true;
+        }
+        if (progress || !pending) continue;
+        struct x86_operand saved = moves[0].dst;
+        codegen_emit(g, X86_MOV, 8, x86_reg(X86_RAX), saved);
+        for (uint32_t j = 0; j < pending; j++)
+            if (codegen_same(moves[j].src, saved)) moves[j].src = x86_reg(X86_RAX);
+    }
+    for (uint32_t i = located; i < g->move_count; i++)
+        codegen_emit_move(g, &moves[i]);
+    g->move_count = 0;
+}
+
+// Extends the `type` value in `reg` to 32 bits for the operations which
+// depend on its upper bits.
+static void codegen_extend(struct codegen *g, int reg, int type,
+                           bool is_signed) {
+    if (type != IR_I8 && type != IR_I16) return;
+    codegen_emit(g, is_signed ? X86_MOVSX : X86_MOVZX, 4, x86_reg(reg),
+                 x86_reg(reg))
+        ->src_size = codegen_type_sizes[type];
+}
+
+// Memory at the address `v`. Slots and the symbols of this object are
+// addressed directly, other addresses from a register, `scratch` if `v`
+// isn't in one.
+static struct x86_operand codegen_memory(struct codegen *g, uint32_t v,
+                                         int scratch) {
+    struct ir_inst *inst = ir_inst(g->fn, v);
+    switch (inst->op) {
+    case IR_SLOT:
+        return codegen_home(g, v);
+    case IR_GLOBAL: {
+        uint32_t symbol = codegen_symbol(g, inst->a);
+        if (codegen_defined(g, symbol)) return x86_symbol(symbol, 0);
+        break;
+    }
+    case IR_STRING:
+        return x86_symbol(codegen_string(g, inst->a), 0);
+    }
+    return x86_mem(codegen_reg(g, v, scratch), 0);
+}
+
+static void codegen_divide(struct codegen *g, uint32_t v) {
+    struct ir_inst *inst = ir_inst(g->fn, v);
+    bool is_signed = inst->op == IR_SDIV || inst->op == IR_SREM;
+    int size = codegen_size(inst->type);
+    struct x86_operand divisor = codegen_rm(g, inst->b, X86_RCX);
+    if (inst->type == IR_I8 || inst->type == IR_I16) {
+        codegen_move(g, X86_RCX, divisor, 4);
+        codegen_extend(g, X86_RCX, inst->type, is_signed);
+        divisor = x86_reg(X86_RCX);
+    }
+    codegen_move(g, X86_RAX, codegen_operand(g, inst->a, X86_RAX), size);
+    codegen_extend(g, X86_RAX, inst->type, is_signed);
+    if (is_signed) {
+        codegen_emit(g, X86_CQO, size, (struct x86_operand){0},
+                     (struct x86_operand){0});
+    } else {
+        codegen_emit(g, X86_XOR, 4, x86_reg(X86_RDX), x86_reg(X86_RDX));
+    }
+    codegen_emit(g, is_signed ? X86_IDIV : X86_DIV, size, divisor,
+                 (struct x86_operand){0});
+    bool remainder = inst->op == IR_SREM || inst->op == IR_UREM;
+    codegen_result(g, v, remainder ? X86_RDX : X86_RAX);
+}
+
+static void codegen_binary(struct codegen *g, uint32_t v) {
+    struct ir_inst *inst = ir_inst(g->fn, v);
+    int size = codegen_size(inst->type);
+    int target = codegen_target(g, v);
+    // the result's register is none of the operands', their intervals
+    // overlap at the instruction.
+    struct x86_operand b = codegen_operand(g, inst->b, X86_RCX);
+    codegen_move(g, target, codegen_operand(g, inst->a, target), size);
+    codegen_emit(g, codegen_binary_ops[inst->op], size, x86_reg(target), b);
+    codegen_result(g, v, target);
+}
+
+static void codegen_shift(struct codegen *g, uint32_t v) {
+    struct ir_inst *inst = ir_inst(g->fn, v);
+    int size = codegen_size(inst->type);
+    int target = codegen_target(g, v);
+    // a count in a register must be in cl, the hardware masks it either way.
+    struct x86_operand count = codegen_operand(g, inst->b, X86_RCX);
+    if (count.kind == X86_OPERAND_IMM) {
+        count.value &= size == 8 ? 63 : 31;
+    } else {
+        codegen_move(g, X86_RCX, count, 4);
+        count = x86_reg(X86_RCX);
+    }
+    codegen_move(g, target, codegen_operand(g, inst->a, target), size);
+    // the bits shifted in from above are those of the extension.
+    if (inst->op != IR_SHL)
+        codegen_extend(g, target, inst->type, inst->op == IR_SAR);
+    codegen_emit(g, codegen_binary_ops[inst->op], size, x86_reg(target), count);
+    codegen_result(g, v, target);
+}
+
+static void codegen_compare(struct codegen *g, uint32_t v) {
+    struct ir_inst *inst = ir_inst(g->fn, v);
+    // compared at their own width, which needs no extension.
+    int size = codegen_type_sizes[inst->type];
+    struct x86_operand b = codegen_operand(g, inst->b, X86_RCX);
+    struct x86_operand a = codegen_operand(g, inst->a, X86_RAX);
+    if (a.kind == X86_OPERAND_IMM ||
+        (a.kind == X86_OPERAND_MEM && b.kind == X86_OPERAND_MEM)) {
+        codegen_move(g, X86_RAX, a, codegen_size(inst->type));
+        a = x86_reg(X86_RAX);
+    }
+    codegen_emit(g, X86_CMP, size, a, b);
+    // the branch after a fused comparison jumps on the flags, the moves to
+    // the phis in between leave them alone.
+    if (inst->flags & IR_FLAG_FUSED) return;
+    int target = codegen_target(g, v);
+    codegen_emit(g, X86_SETCC, 1, x86_reg(target), (struct x86_operand){0})
+        ->cond = codegen_conditions[inst->op];
+    codegen_emit(g, X86_MOVZX, 4, x86_reg(target), x86_reg(target))
+        ->src_size = 1;
+    codegen_result(g, v, target);
+}
+
+static void codegen_call(struct codegen *g, uint32_t v) {
+    struct ir_function *fn = g->fn;
+    struct ir_inst *inst = ir_inst(fn, v);
+    uint32_t count;
+    uint32_t *args = ir_list(fn, inst->b, &count);
+
+    // arguments past the sixth are pushed last to first, rsp stays 16 byte
+    // aligned at the call.
+    uint32_t stacked = count > 6 ? count - 6 : 0;
+    uint32_t pushed = stacked + (stacked & 1);
+    if (stacked & 1)
+        codegen_emit(g, X86_SUB, 8, x86_reg(X86_RSP), x86_imm(8));
+    for (uint32_t i = count; i-- > 6;) {
+        struct x86_operand arg = codegen_operand(g, args[i], X86_RAX);
+        if (arg.kind == X86_OPERAND_MEM) {
+            codegen_move(g, X86_RAX, arg, 8);
+            arg = x86_reg(X86_RAX);
+        }
+        codegen_emit(g, X86_PUSH, 8, arg, (struct x86_operand){0});
+    }
+
+    // a function of this file or another one is called by name, anything
+    // else through its address.
+    struct ir_inst *callee = ir_inst(fn, inst->a);
+    struct x86_operand target = x86_reg(X86_R11);
+    if (callee->op == IR_GLOBAL &&
+        types_get(g->types, types_type_of(g->types, callee->a))->kind ==
+            TYPE_FUNCTION)
+        target = x86_symbol(codegen_symbol(g, callee->a), 0);
+    else
+        codegen_load(g, X86_R11, inst->a);
+    for (uint32_t i = 0; i < count && i < 6; i++)
+        codegen_add_value(g, x86_reg(codegen_arg_regs[i]), args[i]);
+    codegen_parallel(g);
+    // al holds the amount of vector registers used by a variadic call.
+    if (inst->flags & IR_FLAG_VARIADIC)
+        codegen_emit(g, X86_MOV, 4, x86_reg(X86_RAX), x86_imm(0));
+    codegen_emit(g, X86_CALL, 8, target, (struct x86_operand){0});
+    if (pushed)
+        codegen_emit(g, X86_ADD, 8, x86_reg(X86_RSP), x86_imm(pushed * 8));
+    if (inst->type != IR_VOID) codegen_result(g, v, X86_RAX);
+}
+
+static void codegen_inst(struct codegen *g, uint32_t v) {
+    struct ir_inst *inst = ir_inst(g->fn, v);
+    int size = codegen_size(inst->type);
+    int target = codegen_target(g, v);
+    switch (inst->op) {
+    case IR_CONST:
+    case IR_PARAM:
+    case IR_UNDEF:
+    case IR_SLOT:
+    case IR_GLOBAL:
+    case IR_STRING:
+    case IR_PHI:
+        // materialized where they're used, parameters by the prologue and
+        // phis by the jumps to their block.
+        return;
+    case IR_COPY:
+    case IR_TRUNC:
+        // the upper bits of narrow values are undefined.
+        codegen_move(g, target, codegen_operand(g, inst->a, target), size);
+        codegen_result(g, v, target);
+        return;
+    case IR_NEG:
+    case IR_NOT:
+        codegen_move(g, target, codegen_operand(g, inst->a, target), size);
+        codegen_emit(g, inst->op == IR_NEG ? X86_NEG : X86_NOT, size,
+                     x86_reg(target), (struct x86_operand){0});
+        codegen_result(g, v, target);
+        return;
+    case IR_SEXT:
+    case IR_ZEXT:
+        codegen_emit(g, inst->op == IR_SEXT ? X86_MOVSX : X86_MOVZX, size,
+                     x86_reg(target), codegen_rm(g, inst->a, target))
+            ->src_size = codegen_type_sizes[ir_inst(g->fn, inst->a)->type];
+        codegen_result(g, v, target);
+        return;
+    case IR_LOAD: {
+        struct x86_operand at = codegen_memory(g, inst->a, X86_RAX);
+        if (inst->type == IR_I8 || inst->type == IR_I16)
+            codegen_emit(g, X86_MOVZX, 4, x86_reg(target), at)->src_size =
+                codegen_type_sizes[inst->type];
+        else
+            codegen_emit(g, X86_MOV, size, x86_reg(target), at);
+        codegen_result(g, v, target);
+        return;
+    }
+    case IR_STORE: {
+        struct x86_operand value = codegen_operand(g, inst->b, X86_RCX);
+        if (value.kind == X86_OPERAND_MEM) {
+            codegen_move(g, X86_RCX, value, 8);
+            value = x86_reg(X86_RCX);
+        }
+        codegen_emit(g, X86_MOV, codegen_type_sizes[inst->type],
+                     codegen_memory(g, inst->a, X86_RAX), value);
+        return;
+    }
+    case IR_ADD:
+    case IR_SUB:
+    case IR_MUL:
+    case IR_AND:
+    case IR_OR:
+    case IR_XOR:
+        codegen_binary(g, v);
+        return;
+    case IR_SHL:
+    case IR_SHR:
+    case IR_SAR:
+        codegen_shift(g, v);
+        return;
+    case IR_SDIV:
+    case IR_UDIV:
+    case IR_SREM:
+    case IR_UREM:
+        codegen_divide(g, v);
+        return;
+    case IR_EQ:
+    case IR_NE:
+    case IR_LT:
+    case IR_LE:
+    case IR_GT:
+    case IR_GE:
+    case IR_ULT:
+    case IR_ULE:
+    case IR_UGT:
+    case IR_UGE:
+        codegen_compare(g, v);
+        return;
+    case IR_CALL:
+        codegen_call(g, v);
+        return;
+    }
+}
+
+// Adds the moves to the phis of `to` for the edge from `from`.
+static void codegen_phi_moves(struct codegen *g, uint32_t from, uint32_t to) {
+    struct ir_function *fn = g->fn;
+    struct ir_block *block = &fn->blocks[to];
+    if (block->first == block->body) return;
+    uint32_t pred_count;
+    uint32_t *preds = ir_list(fn, block->preds, &pred_count);
+    uint32_t index = 0;
+    while (preds[index] != from) index++;
+    for (uint32_t phi = block->first; phi < block->body; phi++) {
+        uint32_t count;
+        uint32_t *operands = ir_list(fn, ir_inst(fn, phi)->a, &count);
+        codegen_add_value(g, codegen_location(g, phi), operands[index]);
+    }
+}
+
+// Jumps to `block` unless it's `next`, the block placed after the jump.
+static void codegen_jump(struct codegen *g, uint32_t block, uint32_t next) {
+    if (block != next)
+        codegen_emit(g, X86_JMP, 8, x86_label(block), (struct x86_operand){0});
+}
+
+static void codegen_jcc(struct codegen *g, int cond, uint32_t block) {
+    codegen_emit(g, X86_JCC, 8, x86_label(block), (struct x86_operand){0})
+        ->cond = cond;
+}
+
+// Saves the callee saved registers the function allocated, or restores
+// them.
+static void codegen_save(struct codegen *g, bool restore) {
+    int32_t offset = 0;
+    for (uint32_t i = 0; i < 5; i++) {
+        int reg = codegen_saved_regs[i];
+        if (!(g->regalloc.saved & 1 << reg)) continue;
+        offset -= 8;
+        if (restore)
+            codegen_emit(g, X86_MOV, 8, x86_reg(reg), x86_mem(X86_RBP, offset));
+        else
+            codegen_emit(g, X86_MOV, 8, x86_mem(X86_RBP, offset), x86_reg(reg));
+    }
+}
+
+static bool codegen_has_phis(struct ir_function *fn, uint32_t block) {
+    return fn->blocks[block].first != fn->blocks[block].body;
+}
+
+// Moves the phis of `to` in on the edge from `from` and jumps to it.
+static void codegen_edge(struct codegen *g, uint32_t from, uint32_t to,
+                         uint32_t next) {
+    codegen_phi_moves(g, from, to);
+    codegen_parallel(g);
+    codegen_jump(g, to, next);
+}
+
+// Branches to `then_block` on `cc` and to `else_block` otherwise. The phis of
+// each are only written on the edge to it: those of a loop closed by the
+// branch are still live on the way out of it. A block with phis jumped to on
+// `cc` is reached through moves placed after the branch.
+static void codegen_branch(struct codegen *g, uint32_t block, int cc,
+                           uint32_t then_block, uint32_t else_block,
+                           uint32_t next) {
+    struct ir_function *fn = g->fn;
+    bool then_phis = codegen_has_phis(fn, then_block);
+    bool else_phis = codegen_has_phis(fn, else_block);
+    if (then_phis ? !else_phis : !else_phis && then_block == next) {
+        uint32_t swap = then_block;
+        then_block = else_block;
+        else_block = swap;
+        then_phis = else_phis;
+        cc ^= 1;
+    }
+    if (!then_phis) {
+        codegen_jcc(g, cc, then_block);
+        codegen_edge(g, block, else_block, next);
+        return;
+    }
+    uint32_t edge = x86_new_label(&g->x86);
+    codegen_jcc(g, cc, edge);
+    codegen_edge(g, block, else_block, edge);
+    codegen_emit(g, X86_LABEL, 0, x86_label(edge), (struct x86_operand){0});
+    codegen_edge(g, block, then_block, next);
+}
+
+static void codegen_terminator(struct codegen *g, uint32_t block, uint32_t v) {
+    struct ir_function *fn = g->fn;
+    struct ir_inst *inst = ir_inst(fn, v);
+    uint32_t next = block + 1;
+
+    switch (inst->op) {
+    case IR_JUMP:
+        codegen_edge(g, block, inst->a, next);
+        return;
+    case IR_BRANCH: {
+        uint32_t then_block = fn->extra[inst->b];
+        uint32_t else_block = fn->extra[inst->b + 1];
+        struct ir_inst *compare = ir_inst(fn, inst->a);
+        if (then_block == else_block) {
+            codegen_edge(g, block, then_block, next);
+            return;
+        }
+        if (compare->flags & IR_FLAG_FUSED) {
+            codegen_branch(g, block, codegen_conditions[compare->op],
+                           then_block, else_block, next);
+            return;
+        }
+        int size = codegen_type_sizes[inst->type];
+        struct x86_operand cond = codegen_operand(g, inst->a, X86_RAX);
+        if (cond.kind == X86_OPERAND_IMM) {
+            codegen_edge(g, block, cond.value ? then_block : else_block, next);
+            return;
+        }
+        if (cond.kind == X86_OPERAND_REG)
+            codegen_emit(g, X86_TEST, size, cond, cond);
+        else
+            codegen_emit(g, X86_CMP, size, cond, x86_imm(0));
+        codegen_branch(g, block, X86_CC_NE, then_block, else_block, next);
+        return;
+    }
+    case IR_SWITCH: {
+        // the phis of all the cases are written before the dispatch. The
+        // cases are blocks of their own, none of them dominates the switch,
+        // so no phi written is live past it on another edge.
+        uint32_t count;
+        uint32_t *succs = ir_successors(fn, block, &count);
+        for (uint32_t i = 0; i < count; i++) {
+            // a block reached twice takes the same phi operands both times.
+            bool seen = false;
+            for (uint32_t j = 0; j < i; j++) seen |= succs[j] == succs[i];
+            if (!seen) codegen_phi_moves(g, block, succs[i]);
+        }
+        codegen_parallel(g);
+        // narrower values are dispatched on as 32-bit ones, sign extended.
+        int reg = codegen_reg(g, inst->a, X86_R11);
+        if (inst->type == IR_I8 || inst->type == IR_I16) {
+            codegen_move(g, X86_R11, x86_reg(reg), 4);
+            codegen_extend(g, X86_R11, inst->type, true);
+            reg = X86_R11;
+        }
+        codegen_switch(g, v, reg, next);
+        return;
+    }
+    case IR_RET:
+        if (inst->a)
+            codegen_move(g, X86_RAX, codegen_operand(g, inst->a, X86_RAX),
+                         codegen_size(inst->type));
+        codegen_save(g, true);
+        codegen_emit(g, X86_LEAVE, 8, (struct x86_operand){0},
+                     (struct x86_operand){0});
+        codegen_emit(g, X86_RET, 8, (struct x86_operand){0},
+                     (struct x86_operand){0});
+        return;
+    }
+}
+
+// Sets up the frame, saves the callee saved registers and moves the
+// parameters where they live.
+static void codegen_prologue(struct codegen *g) {
+    struct ir_function *fn = g->fn;
+    codegen_emit(g, X86_PUSH, 8, x86_reg(X86_RBP), (struct x86_operand){0});
+    codegen_emit(g, X86_MOV, 8, x86_reg(X86_RBP), x86_reg(X86_RSP));
+    if (g->frame_size)
+        codegen_emit(g, X86_SUB, 8, x86_reg(X86_RSP), x86_imm(g->frame_size));
+    codegen_save(g, false);
+    struct ir_block *entry = &fn->blocks[0];
+    for (uint32_t v = entry->first; v < entry->end; v++) {
+        struct ir_inst *inst = ir_inst(fn, v);
+        if (inst->op != IR_PARAM) continue;
+        // past the return address and the saved rbp.
+        struct x86_operand src =
+            inst->a < 6 ? x86_reg(codegen_arg_regs[inst->a])
+                        : x86_mem(X86_RBP, 16 + (inst->a - 6) * 8);
+        codegen_add_move(g, codegen_location(g, v), src, 0,
+                         codegen_size(inst->type));
+    }
+    codegen_parallel(g);
+}
+
+void codegen_function(struct codegen *g, struct ir_function *fn) {
+    g->fn = fn;
+    x86_function_reset(&g->x86);
+    // the label of each block is its index.
+    for (uint32_t b = 0; b < fn->block_count; b++) x86_new_label(&g->x86);
+    regalloc_run(&g->regalloc, fn);
+    codegen_frame(g);
+    codegen_prologue(g);
+    for (uint32_t b = 0; b < fn->block_count; b++) {
+        struct ir_block *block = &fn->blocks[b];
+        codegen_emit(g, X86_LABEL, 0, x86_label(b), (struct x86_operand){0});
+        for (uint32_t v = block->first; v < block->end - 1; v++)
+            codegen_inst(g, v);
+        codegen_terminator(g, b, block->end - 1);
+    }
+
+    if (g->compiler->flags & COMPILER_FLAG_OPTIMIZE) x86_peephole(&g->x86);
+    uint32_t symbol = codegen_symbol(g, fn->node);
+    if (g->compiler->flags & COMPILER_FLAG_DUMP_ASM)
+        x86_print(&g->x86, &g->object, fn->name, stdout);
+    uint32_t start = x86_assemble(&g->x86, &g->object, OBJECT_TEXT);
+    object_define(&g->object, symbol, OBJECT_TEXT, start,
+                  g->object.sections[OBJECT_TEXT].size - start);
+    codegen_add_piece(g, symbol, 16);
+}
+
+void codegen_end(struct codegen *g) {
+    codegen_layout_literals(g);
+}
+
+void codegen_finish(struct codegen *g, struct output *out) {
+    object_write(&g->object, out);
+}
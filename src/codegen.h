@@ -0,0 +1,175 @@
+#ifndef PEACHCODEGEN_H
+#define PEACHCODEGEN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../helpers/buffer.h"
+#include "compiler.h"
+#include "ir.h"
+#include "object.h"
+#include "regalloc.h"
+#include "x86.h"
+
+struct output;
+
+// Generates x86-64 code for the functions lowered to SSA form and the data
+// of the file scope, straight into an ELF object, see object.h.
+//
+// Values live in the registers regalloc.h assigns them, those it spills
+// have a home in the stack frame. Constants, stack slot, symbol and string
+// addresses have neither, they're materialized again at each use. The
+// predecessors of a block move the operands of its phis in before they
+// jump.
+//
+// codegen.c selects the instructions of functions, codegen_switch.c those
+// of switches, codegen_data.c names the symbols and lays out the data they
+// refer to, codegen_pool.c pools the string literals.
+
+// A move of a parallel move, see codegen_parallel.
+struct codegen_move {
+    struct x86_operand dst;
+    // location moved, unless the value `value` is materialized instead.
+    struct x86_operand src;
+    uint32_t value;
+    uint8_t size;
+};
+
+// A case of a switch being lowered, see codegen_switch.c.
+struct codegen_case {
+    int64_t value;
+    uint32_t block;
+};
+
+// Cases [first, end) of a switch dispatched together, see codegen_switch.c.
+struct codegen_cluster {
+    uint32_t first;
+    uint32_t end;
+    uint8_t kind;
+};
+
+// A string literal of the pool, see codegen_pool.c.
+struct codegen_literal {
+    // bytes in codegen::literal_bytes, the terminator included.
+    uint32_t start;
+    uint32_t length;
+    uint32_t symbol;
+    // next literal of the same hash plus one, 0 for the last.
+    uint32_t next;
+};
+
+// A function or static local defined by the object, in the order they're
+// laid out, see codegen_join.
+struct codegen_piece {
+    uint32_t symbol;
+    uint32_t align;
+};
+
+struct codegen {
+    struct compiler *compiler;
+    struct parser *parser;
+    struct types *types;
+
+    // object of the compile, written out by codegen_finish.
+    struct object object;
+    // instructions of the function being generated.
+    struct x86_function x86;
+    struct ir_function *fn;
+    struct regalloc regalloc;
+
+    // offset below rbp of each spilled value's home, or of the storage of
+    // an IR_SLOT, 0 for values without one.
+    uint32_t *homes;
+    uint32_t home_capacity;
+    uint32_t frame_size;
+
+    // parallel move being gathered.
+    struct codegen_move *moves;
+    uint32_t move_count;
+    uint32_t move_capacity;
+
+    // cases of the switch being lowered sorted by value, and their
+    // clusters, case_capacity of each.
+    struct codegen_case *cases;
+    struct codegen_cluster *clusters;
+    uint32_t case_capacity;
+
+    // symbol of each file scope name by interned id, plus one.
+    struct ir_map names;
+    // symbol of each declaring node plus one.
+    struct ir_map symbols;
+    // symbol of the literal of each NODE_STRING plus one.
+    struct ir_map strings;
+    // string literals, each content once, and the first literal of each
+    // hash plus one.
+    struct codegen_literal *literals;
+    uint32_t literal_count;
+    uint32_t literal_capacity;
+    struct buffer literal_bytes;
+    struct ir_map literal_hashes;
+    // static locals defined so far, they're named "name.N".
+    uint32_t static_count;
+
+    // the functions and static locals defined since codegen_begin or
+    // codegen_fork.
+    struct codegen_piece *pieces;
+    uint32_t piece_count;
+    uint32_t piece_capacity;
+    // symbols [0, forked_symbols) are those of the codegen forked from, 0
+    // unless forked.
+    uint32_t forked_symbols;
+
+    // errors fail the compile without being printed, set for the codegens
+    // of workers whose failures are reported again, see parser::quiet.
+    bool quiet;
+};
+
+struct codegen *codegen_create(struct compiler *c);
+void codegen_free(struct codegen *g);
+
+// Starts the object of a compile: names the file scope declarations and
+// lays out the variables defined there. The tree must be typed.
+// Errors are reported on stdout and fail the compile, see compiler_fail.
+void codegen_begin(struct codegen *g);
+// Generates the function lowered into `fn`.
+void codegen_function(struct codegen *g, struct ir_function *fn);
+// Ends the object once every function is generated: lays out the string
+// literals.
+void codegen_end(struct codegen *g);
+// Writes the object to `out`.
+void codegen_finish(struct codegen *g, struct output *out);
+
+// codegen_switch.c
+// Dispatches on the IR_SWITCH `v` whose value is in `reg`, sign extended to
+// 32 bits if it's narrower. `next` is the block placed after.
+void codegen_switch(struct codegen *g, uint32_t v, int reg, uint32_t next);
+
+// codegen_data.c
+// Readies `worker` to generate functions of the compile `g` began, on
+// another thread: it takes a copy of the symbols `g` named, the code, data
+// and symbols it makes are its own until codegen_join.
+void codegen_fork(struct codegen *worker, struct codegen *g);
+// Appends what `worker` generated to the object of `g`, laid out and
+// named as if `g` generated it after what it has. Workers joined in the
+// order of their functions make the same object as a single codegen.
+void codegen_join(struct codegen *g, struct codegen *worker);
+// Records that `symbol` was defined, aligned to `align`, see
+// codegen::pieces.
+void codegen_add_piece(struct codegen *g, uint32_t symbol, uint32_t align);
+// Returns the symbol of the function or variable declared by `decl`, a
+// static local is defined on first use.
+uint32_t codegen_symbol(struct codegen *g, uint32_t decl);
+// True if `symbol` is defined by this object.
+bool codegen_defined(struct codegen *g, uint32_t symbol);
+// Returns the symbol of the characters of the NODE_STRING `n`.
+uint32_t codegen_string(struct codegen *g, uint32_t n);
+
+// codegen_pool.c
+// Returns the symbol of the literal of the `length` bytes at `bytes`, the
+// terminator included: the same one for the same bytes.
+uint32_t codegen_literal(struct codegen *g, const void *bytes,
+                         uint32_t length);
+// Lays out the literals and defines their symbols.
+void codegen_layout_literals(struct codegen *g);
+
+#endif  // PEACHCODEGEN_H
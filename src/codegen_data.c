@@ -0,0 +1,535 @@
+#include <elf.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../helpers/intern.h"
+#include "ast.h"
+#include "codegen.h"
+#include "lexer.h"
+#include "parser.h"
+#include "resolver.h"
+#include "types.h"
+
+// File scope declarations of the same name are one symbol, local if any of
+// them is static. Variables are defined by the declaration with an
+// initializer, or else by the first tentative one in .bss. Declarations of
+// functions and extern variables only name a symbol, it stays undefined
+// unless the file defines it.
+
+static void codegen_error(struct codegen *g, uint32_t token, const char *msg,
+                          ...) {
+    if (g->quiet) compiler_fail(g->compiler);
+    struct token *tok = parser_token(g->parser, token);
+    va_list args;
+    printf("[ERROR]: ");
+    va_start(args, msg);
+    vprintf(msg, args);
+    va_end(args);
+    printf("\nSemantic error at line: %d, col: %d at file: %s\n",
+           tok->pos.line, tok->pos.col, g->compiler->pos.filename);
+    compiler_fail(g->compiler);
+}
+
+static struct node *codegen_node(struct codegen *g, uint32_t n) {
+    return ast_node(&g->parser->ast, n);
+}
+
+static struct type *codegen_type(struct codegen *g, uint32_t type) {
+    return types_get(g->types, type);
+}
+
+static const char *codegen_name(struct codegen *g, uint32_t decl) {
+    return parser_token(g->parser, codegen_node(g, decl)->token)->sval;
+}
+
+// Symbol of the file scope name of `decl`, made on first use.
+static uint32_t codegen_global(struct codegen *g, uint32_t decl) {
+    const char *name = codegen_name(g, decl);
+    uint32_t id =
+        interner_find(g->compiler->resolver->names, name, strlen(name));
+    uint32_t symbol = ir_map_get(&g->names, id);
+    if (symbol) {
+        symbol--;
+    } else {
+        symbol = object_symbol(&g->object, name, OBJECT_GLOBAL, OBJECT_NOTYPE);
+        ir_map_set(&g->names, id, symbol + 1);
+    }
+    ir_map_set(&g->symbols, decl, symbol + 1);
+    return symbol;
+}
+
+bool codegen_defined(struct codegen *g, uint32_t symbol) {
+    return g->object.symbols[symbol].section != 0;
+}
+
+uint32_t codegen_string(struct codegen *g, uint32_t n) {
+    uint32_t symbol = ir_map_get(&g->strings, n);
+    if (symbol) return symbol - 1;
+    struct node *node = codegen_node(g, n);
+    uint32_t length = types_string_length(g->types, n);
+    uint8_t *bytes = calloc(length, 1);
+    // adjacent literals are concatenated, the terminator is already 0.
+    uint8_t *at = bytes;
+    for (uint32_t i = 0; i < node->b; i++) {
+        struct token *tok = parser_token(g->parser, node->token + i);
+        memcpy(at, tok->sval, tok->slen);
+        at += tok->slen;
+    }
+    symbol = codegen_literal(g, bytes, length);
+    free(bytes);
+    ir_map_set(&g->strings, n, symbol + 1);
+    return symbol;
+}
+
+static void codegen_write(struct codegen *g, int section, uint32_t offset,
+                          int64_t value, uint32_t size) {
+    uint8_t *at = object_data(&g->object, section, offset);
+    for (uint32_t i = 0; i < size; i++) at[i] = (uint64_t)value >> (i * 8);
+}
+
+static bool codegen_address(struct codegen *g, uint32_t n, uint32_t *symbol,
+                            int64_t *addend, uint32_t *pointee);
+
+// Size `pointee` scales pointer arithmetic by.
+static uint32_t codegen_scale(struct codegen *g, uint32_t pointee) {
+    struct type *t = codegen_type(g, pointee);
+    return t->kind == TYPE_FUNCTION || !t->size ? 1 : t->size;
+}
+
+// Finds the symbol and addend of the object designated by the lvalue `n`
+// and its type. Returns false if its address isn't a constant.
+static bool codegen_object(struct codegen *g, uint32_t n, uint32_t *symbol,
+                           int64_t *addend, uint32_t *type) {
+    struct node *node = codegen_node(g, n);
+    switch (node->kind) {
+    case NODE_IDENTIFIER: {
+        struct node *decl = codegen_node(g, node->a);
+        // locals other than static ones have no constant address.
+        if (decl->kind == NODE_PARAM) return false;
+        if (decl->kind == NODE_VAR &&
+            !(decl->flags & (NODE_FLAG_STATIC | NODE_FLAG_EXTERN)) &&
+            !ir_map_get(&g->symbols, node->a))
+            return false;
+        *symbol = codegen_symbol(g, node->a);
+        *addend = 0;
+        *type = types_type_of(g->types, node->a);
+        return true;
+    }
+    case NODE_INDEX: {
+        int64_t index;
+        if (!types_constant(g->types, node->b, &index) ||
+            !codegen_address(g, node->a, symbol, addend, type))
+            return false;
+        *addend += index * codegen_scale(g, *type);
+        return true;
+    }
+    case NODE_MEMBER: {
+        bool found = node->op == OPERATOR_ARROW
+                         ? codegen_address(g, node->a, symbol, addend, type)
+                         : codegen_object(g, node->a, symbol, addend, type);
+        if (!found || codegen_type(g, *type)->kind != TYPE_STRUCT) return false;
+        struct type_member *m = types_member(g->types, *type, node->token);
+        if (!m) return false;
+        *addend += m->offset;
+        *type = m->type;
+        return true;
+    }
+    case NODE_UNARY:
+        if (node->op != OPERATOR_STAR) return false;
+        return codegen_address(g, node->a, symbol, addend, type);
+    }
+    return false;
+}
+
+// Finds the symbol and addend of the address constant `n` and the type it
+// points to. Returns false if `n` isn't one.
+static bool codegen_address(struct codegen *g, uint32_t n, uint32_t *symbol,
+                            int64_t *addend, uint32_t *pointee) {
+    struct node *node = codegen_node(g, n);
+    switch (node->kind) {
+    case NODE_STRING:
+        *symbol = codegen_string(g, n);
+        *addend = 0;
+        *pointee = TYPE_ID_CHAR;
+        return true;
+    case NODE_UNARY:
+        if (node->op != OPERATOR_AMPERSAND) break;
+        return codegen_object(g, node->a, symbol, addend, pointee);
+    case NODE_CAST: {
+        uint32_t to = types_type_of(g->types, node->a);
+        if (codegen_type(g, to)->kind != TYPE_POINTER ||
+            !codegen_address(g, node->b, symbol, addend, pointee))
+            return false;
+        *pointee = codegen_type(g, to)->base;
+        return true;
+    }
+    case NODE_BINARY: {
+        if (node->op != OPERATOR_PLUS && node->op != OPERATOR_MINUS)
+            return false;
+        uint32_t pointer = node->a, count = node->b;
+        int64_t value;
+        if (node->op == OPERATOR_PLUS && types_constant(g->types, pointer, &value))
+            pointer = node->b, count = node->a;
+        if (!types_constant(g->types, count, &value) ||
+            !codegen_address(g, pointer, symbol, addend, pointee))
+            return false;
+        *addend += (node->op == OPERATOR_PLUS ? value : -value) *
+                   codegen_scale(g, *pointee);
+        return true;
+    }
+    }
+    // arrays and functions decay to their address.
+    uint32_t type;
+    if (!codegen_object(g, n, symbol, addend, &type)) return false;
+    struct type *t = codegen_type(g, type);
+    if (t->kind != TYPE_ARRAY && t->kind != TYPE_FUNCTION) return false;
+    *pointee = t->kind == TYPE_ARRAY ? t->base : type;
+    return true;
+}
+
+// Writes the constant initializer `n` of an object of `type` at `offset` of
+// `section`, which is zeroed.
+static void codegen_init(struct codegen *g, int section, uint32_t offset,
+                         uint32_t type, uint32_t n) {
+    struct node *node = codegen_node(g, n);
+    struct type *t = codegen_type(g, type);
+    uint32_t count = 0;
+    uint32_t *items = NULL;
+    if (node->kind == NODE_INIT_LIST)
+        items = ast_list(&g->parser->ast, node->a, &count);
+
+    if (t->kind == TYPE_ARRAY) {
+        bool incomplete = t->flags & TYPE_FLAG_INCOMPLETE;
+        uint32_t element = t->base;
+        uint32_t element_size = codegen_type(g, element)->size;
+        if (node->kind == NODE_STRING && element_size == 1 &&
+            codegen_type(g, element)->kind == TYPE_INTEGER) {
+            // the terminating NULL character is dropped if it doesn't fit,
+            // an array without a size was given the string's.
+            uint32_t length = types_string_length(g->types, n);
+            uint32_t size = incomplete ? length : t->size;
+            if (length - 1 > size)
+                codegen_error(g, node->token, "Initializer string is too long");
+            if (length > size) length = size;
+            uint8_t *at = object_data(&g->object, section, offset);
+            for (uint32_t i = 0, done = 0; i < node->b && done < length; i++) {
+                struct token *tok = parser_token(g->parser, node->token + i);
+                uint32_t len = tok->slen;
+                if (len > length - done) len = length - done;
+                memcpy(at + done, tok->sval, len);
+                done += len;
+            }
+            return;
+        }
+        if (node->kind != NODE_INIT_LIST) {
+            codegen_error(g, node->token, "Array initializer must be a list");
+            return;
+        }
+        if (!incomplete && count > t->count)
+            codegen_error(g, node->token, "Too many initializers");
+        for (uint32_t i = 0; i < count; i++)
+            codegen_init(g, section, offset + i * element_size, element,
+                         items[i]);
+        return;
+    }
+
+    if (t->kind == TYPE_STRUCT) {
+        if (node->kind != NODE_INIT_LIST) {
+            codegen_error(g, node->token,
+                          "Initializer element is not a constant");
+            return;
+        }
+        // a union is initialized through its first member.
+        uint32_t members = t->flags & TYPE_FLAG_UNION && t->count ? 1 : t->count;
+        if (count > members)
+            codegen_error(g, node->token, "Too many initializers");
+        for (uint32_t i = 0; i < count; i++) {
+            struct type_member *m = &g->types->members[t->first + i];
+            codegen_init(g, section, offset + m->offset, m->type, items[i]);
+        }
+        return;
+    }
+
+    if (node->kind == NODE_INIT_LIST) {
+        if (count > 1) codegen_error(g, node->token, "Too many initializers");
+        if (count) codegen_init(g, section, offset, type, items[0]);
+        return;
+    }
+    if (!types_is_scalar(g->types, type)) {
+        codegen_error(g, node->token,
+                      t->kind == TYPE_FLOATING
+                          ? "Floating point types are not supported"
+                          : "Initializer element is not a constant");
+        return;
+    }
+    int64_t value;
+    if (types_constant(g->types, n, &value)) {
+        codegen_write(g, section, offset, value, t->size);
+        return;
+    }
+    uint32_t symbol, pointee;
+    int64_t addend;
+    if (t->size != 8 || !codegen_address(g, n, &symbol, &addend, &pointee)) {
+        codegen_error(g, node->token, "Initializer element is not a constant");
+        return;
+    }
+    object_reloc(&g->object, section, offset, symbol, R_X86_64_64, addend);
+}
+
+// Size of the variable `decl` of `type`, an array left without a size takes
+// it from its initializer.
+static uint32_t codegen_size(struct codegen *g, uint32_t decl, uint32_t type) {
+    struct node *node = codegen_node(g, decl);
+    struct type *t = codegen_type(g, type);
+    if (t->kind == TYPE_ARRAY && t->flags & TYPE_FLAG_INCOMPLETE && node->b) {
+        struct node *init = codegen_node(g, node->b);
+        uint32_t element = codegen_type(g, t->base)->size;
+        if (init->kind == NODE_STRING)
+            return types_string_length(g->types, node->b) * element;
+        if (init->kind == NODE_INIT_LIST)
+            return g->parser->ast.extra[init->a] * element;
+    }
+    if (t->flags & TYPE_FLAG_INCOMPLETE || t->kind == TYPE_VOID)
+        codegen_error(g, node->token, "Variable '%s' has an incomplete type",
+                      codegen_name(g, decl));
+    return t->size;
+}
+
+// Defines `symbol` as the storage of the variable `decl`, in .data if it has
+// an initializer and in .bss otherwise.
+static void codegen_define(struct codegen *g, uint32_t symbol, uint32_t decl) {
+    struct node *node = codegen_node(g, decl);
+    uint32_t type = types_type_of(g->types, decl);
+    uint32_t size = codegen_size(g, decl, type);
+    uint32_t align = codegen_type(g, type)->align;
+    int section = node->b ? OBJECT_DATA : OBJECT_BSS;
+    uint32_t offset =
+        object_append(&g->object, section, NULL, size, align ? align : 1);
+    // the symbol is defined before the initializer, which may refer to it.
+    object_define(&g->object, symbol, section, offset, size);
+    codegen_add_piece(g, symbol, align ? align : 1);
+    g->object.symbols[symbol].type = OBJECT_OBJECT;
+    if (node->b) codegen_init(g, section, offset, type, node->b);
+}
+
+uint32_t codegen_symbol(struct codegen *g, uint32_t decl) {
+    uint32_t symbol = ir_map_get(&g->symbols, decl);
+    if (symbol) return symbol - 1;
+    struct node *node = codegen_node(g, decl);
+    struct type *t = codegen_type(g, types_type_of(g->types, decl));
+    if (!(node->flags & NODE_FLAG_STATIC) || t->kind == TYPE_FUNCTION)
+        // extern locals and local declarations of functions.
+        return codegen_global(g, decl);
+
+    char name[256];
+    snprintf(name, sizeof(name), "%s.%u", codegen_name(g, decl),
+             g->static_count++);
+    symbol = object_symbol(&g->object, name, OBJECT_LOCAL, OBJECT_OBJECT);
+    ir_map_set(&g->symbols, decl, symbol + 1);
+    codegen_define(g, symbol, decl);
+    return symbol;
+}
+
+// Calls `visit` on every file scope NODE_VAR and NODE_FUNCTION in source
+// order.
+static void codegen_each_global(struct codegen *g,
+                                void (*visit)(struct codegen *, uint32_t)) {
+    struct ast *ast = &g->parser->ast;
+    uint32_t count;
+    uint32_t *items = ast_list(ast, ast_node(ast, ast->root)->a, &count);
+    for (uint32_t i = 0; i < count; i++) {
+        struct node *item = ast_node(ast, items[i]);
+        if (item->kind == NODE_FUNCTION) {
+            visit(g, items[i]);
+            continue;
+        }
+        if (item->kind != NODE_DECLARATION) continue;
+        uint32_t var_count;
+        uint32_t *vars = ast_list(ast, item->a, &var_count);
+        for (uint32_t v = 0; v < var_count; v++) visit(g, vars[v]);
+    }
+}
+
+static void codegen_name_global(struct codegen *g, uint32_t decl) {
+    struct node *node = codegen_node(g, decl);
+    uint32_t symbol = codegen_global(g, decl);
+    struct object_symbol *s = &g->object.symbols[symbol];
+    if (node->flags & NODE_FLAG_STATIC) s->bind = OBJECT_LOCAL;
+    if (node->kind == NODE_FUNCTION) {
+        // placed once the function is generated.
+        s->type = OBJECT_FUNC;
+        s->section = OBJECT_TEXT;
+    }
+}
+
+static void codegen_define_initialized(struct codegen *g, uint32_t decl) {
+    struct node *node = codegen_node(g, decl);
+    if (node->kind != NODE_VAR || !node->b) return;
+    uint32_t symbol = codegen_symbol(g, decl);
+    if (codegen_defined(g, symbol))
+        codegen_error(g, node->token, "Redefinition of '%s'",
+                      codegen_name(g, decl));
+    codegen_define(g, symbol, decl);
+}
+
+static void codegen_define_tentative(struct codegen *g, uint32_t decl) {
+    struct node *node = codegen_node(g, decl);
+    if (node->kind != NODE_VAR || node->flags & NODE_FLAG_EXTERN) return;
+    if (codegen_type(g, types_type_of(g->types, decl))->kind == TYPE_FUNCTION)
+        return;
+    uint32_t symbol = codegen_symbol(g, decl);
+    if (!codegen_defined(g, symbol)) codegen_define(g, symbol, decl);
+}
+
+void codegen_begin(struct codegen *g) {
+    object_reset(&g->object, g->compiler->cfile.abs_path);
+    ir_map_clear(&g->names);
+    ir_map_clear(&g->symbols);
+    ir_map_clear(&g->strings);
+    g->literal_count = 0;
+    buffer_clear(&g->literal_bytes);
+    ir_map_clear(&g->literal_hashes);
+    g->static_count = 0;
+    g->piece_count = 0;
+    g->forked_symbols = 0;
+
+    codegen_each_global(g, codegen_name_global);
+    codegen_each_global(g, codegen_define_initialized);
+    codegen_each_global(g, codegen_define_tentative);
+}
+
+void codegen_add_piece(struct codegen *g, uint32_t symbol, uint32_t align) {
+    if (g->piece_count == g->piece_capacity) {
+        g->piece_capacity = g->piece_capacity ? g->piece_capacity * 2 : 64;
+        g->pieces = realloc(g->pieces,
+                            g->piece_capacity * sizeof(struct codegen_piece));
+    }
+    g->pieces[g->piece_count++] = (struct codegen_piece){symbol, align};
+}
+
+void codegen_fork(struct codegen *worker, struct codegen *g) {
+    object_reset_from(&worker->object, &g->object);
+    ir_map_copy(&worker->names, &g->names);
+    ir_map_copy(&worker->symbols, &g->symbols);
+    // the strings of a function are only used by it, their contents are
+    // pooled with those of the file scope.
+    ir_map_clear(&worker->strings);
+    if (worker->literal_capacity < g->literal_count) {
+        worker->literal_capacity = g->literal_capacity;
+        worker->literals =
+            realloc(worker->literals,
+                    worker->literal_capacity * sizeof(struct codegen_literal));
+    }
+    // no literal yet, and no array to copy from.
+    if (g->literal_count)
+        memcpy(worker->literals, g->literals,
+               g->literal_count * sizeof(struct codegen_literal));
+    worker->literal_count = g->literal_count;
+    buffer_clear(&worker->literal_bytes);
+    buffer_write_bytes(&worker->literal_bytes, buffer_ptr(&g->literal_bytes),
+                       buffer_len(&g->literal_bytes));
+    ir_map_copy(&worker->literal_hashes, &g->literal_hashes);
+    worker->static_count = 0;
+    worker->piece_count = 0;
+    worker->forked_symbols = g->object.symbol_count;
+}
+
+// Symbol of `g` for the symbol `symbol` the worker made: literals are
+// pooled again, static locals are numbered again, globals are those `g` or
+// an earlier worker named.
+static uint32_t codegen_join_symbol(struct codegen *g, struct codegen *worker,
+                                    uint32_t symbol) {
+    struct object_symbol *s = &worker->object.symbols[symbol];
+    const char *name = object_symbol_name(&worker->object, symbol);
+    if (s->section == OBJECT_STRINGS || s->section == OBJECT_RODATA) {
+        struct codegen_literal *literal = &worker->literals[s->value];
+        return codegen_literal(
+            g, (uint8_t *)buffer_ptr(&worker->literal_bytes) + literal->start,
+            literal->length);
+    }
+    if (s->bind == OBJECT_LOCAL) {
+        char renamed[256];
+        snprintf(renamed, sizeof(renamed), "%.*s.%u",
+                 (int)(strrchr(name, '.') - name), name, g->static_count++);
+        return object_symbol(&g->object, renamed, OBJECT_LOCAL, s->type);
+    }
+    uint32_t id =
+        interner_find(g->compiler->resolver->names, name, strlen(name));
+    uint32_t global = ir_map_get(&g->names, id);
+    if (global) return global - 1;
+    global = object_symbol(&g->object, name, OBJECT_GLOBAL, OBJECT_NOTYPE);
+    ir_map_set(&g->names, id, global + 1);
+    return global;
+}
+
+void codegen_join(struct codegen *g, struct codegen *worker) {
+    struct object *from = &worker->object;
+    struct object *to = &g->object;
+    // the functions are aligned in .text, it's appended whole. The strings
+    // are only laid out by codegen_end.
+    uint32_t bases[OBJECT_SECTION_COUNT] = {0};
+    struct object_section *text = &from->sections[OBJECT_TEXT];
+    bases[OBJECT_TEXT] = object_append(to, OBJECT_TEXT, buffer_ptr(&text->data),
+                                       text->size, text->align);
+
+    uint32_t *symbols = malloc(from->symbol_count * sizeof(uint32_t));
+    for (uint32_t i = 0; i < worker->forked_symbols; i++) symbols[i] = i;
+    for (uint32_t i = worker->forked_symbols; i < from->symbol_count; i++)
+        symbols[i] = codegen_join_symbol(g, worker, i);
+
+    // static locals are laid out one at a time, in the order they were
+    // defined. `moved` is the offset of each piece in `g`, `data` lists the
+    // pieces of .data by offset, for its relocations.
+    uint32_t *moved = malloc((worker->piece_count + 1) * sizeof(uint32_t));
+    uint32_t *data = malloc((worker->piece_count + 1) * sizeof(uint32_t));
+    uint32_t data_count = 0;
+    for (uint32_t p = 0; p < worker->piece_count; p++) {
+        struct codegen_piece *piece = &worker->pieces[p];
+        struct object_symbol *s = &from->symbols[piece->symbol];
+        if (s->section == OBJECT_TEXT) {
+            moved[p] = bases[OBJECT_TEXT] + s->value;
+        } else {
+            const void *bytes = s->section == OBJECT_BSS
+                                    ? NULL
+                                    : object_data(from, s->section, s->value);
+            moved[p] = object_append(to, s->section, bytes, s->size,
+                                     piece->align);
+        }
+        if (s->section == OBJECT_DATA) data[data_count++] = p;
+        object_define(to, symbols[piece->symbol], s->section, moved[p],
+                      s->size);
+    }
+
+    for (int i = OBJECT_TEXT; i < OBJECT_SECTION_COUNT; i++) {
+        struct object_section *s = &from->sections[i];
+        for (uint32_t r = 0; r < s->reloc_count; r++) {
+            struct object_reloc *reloc = &s->relocs[r];
+            uint64_t offset = bases[i] + reloc->offset;
+            if (i == OBJECT_DATA) {
+                // the last piece starting at or before the offset.
+                uint32_t low = 0, high = data_count;
+                while (high - low > 1) {
+                    uint32_t middle = (low + high) / 2;
+                    uint32_t symbol = worker->pieces[data[middle]].symbol;
+                    if (from->symbols[symbol].value <= reloc->offset)
+                        low = middle;
+                    else
+                        high = middle;
+                }
+                uint32_t symbol = worker->pieces[data[low]].symbol;
+                offset = moved[data[low]] + reloc->offset -
+                         from->symbols[symbol].value;
+            }
+            int64_t addend = reloc->addend;
+            if (reloc->symbol == from->section_symbols[OBJECT_TEXT])
+                addend += bases[OBJECT_TEXT];
+            object_reloc(to, i, offset, symbols[reloc->symbol], reloc->type,
+                         addend);
+        }
+    }
+    free(data);
+    free(moved);
+    free(symbols);
+}
@@ -0,0 +1,132 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "codegen.h"
+
+// Pools the string literals of the object. Each content is kept once,
+// looked up by its hash, and gets a local symbol the code and the data
+// refer to it by. A literal is only placed once every function is
+// generated: by then every string is known, and one which ends another
+// shares the other's tail, "world" in "hello world".
+//
+// Literals go to .rodata.str1.1, where the linker merges them with the
+// same ones of other objects. Those with a 0 before their terminator would
+// be cut there by the linker, they go to .rodata.
+//
+// Until codegen_layout_literals the symbol of a literal is in the section
+// it's going to and its value is the index of the literal, which is how
+// codegen_join finds the contents of a worker's literals.
+
+// 64-bit FNV-1a.
+static uint64_t codegen_literal_hash(const uint8_t *bytes, uint32_t length) {
+    uint64_t hash = 14695981039346656037ull;
+    for (uint32_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static const uint8_t *codegen_literal_data(struct codegen *g,
+                                           struct codegen_literal *literal) {
+    return (const uint8_t *)buffer_ptr(&g->literal_bytes) + literal->start;
+}
+
+uint32_t codegen_literal(struct codegen *g, const void *bytes,
+                         uint32_t length) {
+    uint64_t hash = codegen_literal_hash(bytes, length);
+    for (uint32_t l = ir_map_get(&g->literal_hashes, hash); l;
+         l = g->literals[l - 1].next) {
+        struct codegen_literal *literal = &g->literals[l - 1];
+        if (literal->length == length &&
+            !memcmp(codegen_literal_data(g, literal), bytes, length))
+            return literal->symbol;
+    }
+
+    if (g->literal_count == g->literal_capacity) {
+        g->literal_capacity = g->literal_capacity ? g->literal_capacity * 2 : 64;
+        g->literals = realloc(g->literals, g->literal_capacity *
+                                               sizeof(struct codegen_literal));
+    }
+    uint32_t index = g->literal_count++;
+    char name[32];
+    snprintf(name, sizeof(name), ".LC%u", index);
+    uint32_t symbol =
+        object_symbol(&g->object, name, OBJECT_LOCAL, OBJECT_OBJECT);
+    bool strings = !memchr(bytes, 0, length - 1);
+    object_define(&g->object, symbol, strings ? OBJECT_STRINGS : OBJECT_RODATA,
+                  index, length);
+    g->literals[index] = (struct codegen_literal){
+        .start = buffer_len(&g->literal_bytes),
+        .length = length,
+        .symbol = symbol,
+        .next = ir_map_get(&g->literal_hashes, hash),
+    };
+    buffer_write_bytes(&g->literal_bytes, bytes, length);
+    ir_map_set(&g->literal_hashes, hash, index + 1);
+    return symbol;
+}
+
+// A literal being laid out, by the end of its bytes.
+struct codegen_tail {
+    const uint8_t *end;
+    uint32_t length;
+    uint32_t literal;
+};
+
+// Orders the literals by their bytes read backwards, a literal before
+// those it ends. The literals a literal ends then follow it.
+static int codegen_tail_compare(const void *a, const void *b) {
+    const struct codegen_tail *x = a, *y = b;
+    uint32_t length = x->length < y->length ? x->length : y->length;
+    for (uint32_t i = 1; i <= length; i++) {
+        uint8_t p = *(x->end - i), q = *(y->end - i);
+        if (p != q) return p < q ? -1 : 1;
+    }
+    return (x->length < y->length) - (x->length > y->length);
+}
+
+// Places the literals of `section`, each one in the last placed if it ends
+// it.
+static void codegen_layout_section(struct codegen *g, int section,
+                                   struct codegen_tail *tails) {
+    struct object *object = &g->object;
+    uint32_t count = 0;
+    for (uint32_t l = 0; l < g->literal_count; l++) {
+        struct codegen_literal *literal = &g->literals[l];
+        if (object->symbols[literal->symbol].section != section) continue;
+        tails[count++] = (struct codegen_tail){
+            .end = codegen_literal_data(g, literal) + literal->length,
+            .length = literal->length,
+            .literal = l,
+        };
+    }
+    qsort(tails, count, sizeof(struct codegen_tail), codegen_tail_compare);
+
+    struct codegen_tail *last = NULL;
+    uint32_t last_offset = 0;
+    for (uint32_t t = 0; t < count; t++) {
+        struct codegen_tail *tail = &tails[t];
+        uint32_t offset;
+        if (last && tail->length <= last->length &&
+            !memcmp(last->end - tail->length, tail->end - tail->length,
+                    tail->length)) {
+            offset = last_offset + last->length - tail->length;
+        } else {
+            offset = object_append(object, section, tail->end - tail->length,
+                                   tail->length, 1);
+            last = tail;
+            last_offset = offset;
+        }
+        object->symbols[g->literals[tail->literal].symbol].value = offset;
+    }
+}
+
+void codegen_layout_literals(struct codegen *g) {
+    struct codegen_tail *tails =
+        malloc((g->literal_count + 1) * sizeof(struct codegen_tail));
+    codegen_layout_section(g, OBJECT_STRINGS, tails);
+    codegen_layout_section(g, OBJECT_RODATA, tails);
+    free(tails);
+}
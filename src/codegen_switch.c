@@ -0,0 +1,283 @@
+#include <stdlib.h>
+
+#include "codegen.h"
+
+// Lowers IR_SWITCH. The cases are sorted by value and split into clusters,
+// each dispatched the cheapest way the run of values it holds allows, as in
+// "Improving Switch Lowering for The LLVM Compiler System" (Korobeynikov):
+// - cases spanning at most 64 values and going to a few blocks are a bit
+//   test per block on a mask of their values, cleared when the value is
+//   out of them rather than branched around,
+// - a run of cases dense enough is a jump table, 32-bit offsets from the
+//   table placed in .text right after the indirect jump, which need no
+//   relocation,
+// - any other case is compared on its own.
+// The clusters are found in a single greedy pass, and searched with a
+// balanced binary tree of comparisons, those left at a leaf tested in
+// order. The branches of the tree are taken about half the time whatever
+// the value, a predictor can't learn them when the values are random. The
+// compares of a leaf are rarely taken, so leaves are large and trees
+// shallow: bench/switch.sh times them.
+//
+// Values are compared signed at 32 bits, or 64 for IR_I64 switches. rax, rcx
+// and rdx are scratch, the register of the value is left alone.
+
+// codegen_cluster::kind
+enum {
+    CODEGEN_CLUSTER_CASE,
+    CODEGEN_CLUSTER_TABLE,
+    CODEGEN_CLUSTER_BITS,
+};
+
+enum {
+    // least cases of a jump table, and of every 10 values it spans.
+    CODEGEN_TABLE_CASES = 4,
+    CODEGEN_TABLE_DENSITY = 4,
+    // most values a jump table spans.
+    CODEGEN_TABLE_SPAN = 1 << 16,
+    // least cases of a bit test, and most blocks it goes to.
+    CODEGEN_BITS_CASES = 3,
+    CODEGEN_BITS_BLOCKS = 3,
+    // most clusters tested in order at a leaf of the search, with random
+    // values 16 is as fast as a chain of compares over 64 sparse cases.
+    CODEGEN_LEAF_CLUSTERS = 16,
+};
+
+static struct x86_inst *codegen_switch_emit(struct codegen *g, int op, int size,
+                                            struct x86_operand dst,
+                                            struct x86_operand src) {
+    return x86_emit(&g->x86, op, size, dst, src);
+}
+
+static void codegen_switch_jcc(struct codegen *g, int cond, uint32_t label) {
+    codegen_switch_emit(g, X86_JCC, 8, x86_label(label), (struct x86_operand){0})
+        ->cond = cond;
+}
+
+static void codegen_switch_jump(struct codegen *g, uint32_t label) {
+    codegen_switch_emit(g, X86_JMP, 8, x86_label(label), (struct x86_operand){0});
+}
+
+// `op` of `reg` and the constant `value`, through rcx if it doesn't fit in
+// an immediate.
+static void codegen_switch_op(struct codegen *g, int op, int size, int reg,
+                              int64_t value) {
+    struct x86_operand src = x86_imm(value);
+    if (value < INT32_MIN || value > INT32_MAX) {
+        codegen_switch_emit(g, X86_MOV, 8, x86_reg(X86_RCX), src);
+        src = x86_reg(X86_RCX);
+    }
+    codegen_switch_emit(g, op, size, x86_reg(reg), src);
+}
+
+static int codegen_switch_compare(const void *a, const void *b) {
+    int64_t x = ((const struct codegen_case *)a)->value;
+    int64_t y = ((const struct codegen_case *)b)->value;
+    return (x > y) - (x < y);
+}
+
+// The block reached from `block` past the empty blocks which only jump on,
+// those of case labels sharing a statement, so that their cases count as
+// going to one block. A block with phis is left alone, the moves of the
+// edge into it are made by the block jumping to it.
+static uint32_t codegen_switch_target(struct ir_function *fn, uint32_t block) {
+    for (uint32_t hops = 0; hops < fn->block_count; hops++) {
+        struct ir_block *b = &fn->blocks[block];
+        if (b->first != b->body || b->end != b->body + 1) break;
+        struct ir_inst *jump = ir_inst(fn, b->body);
+        if (jump->op != IR_JUMP) break;
+        struct ir_block *target = &fn->blocks[jump->a];
+        if (target->first != target->body) break;
+        block = jump->a;
+    }
+    return block;
+}
+
+// Amount of values from the case `first` to the case `last`, at most 2^64.
+static uint64_t codegen_switch_span(struct codegen *g, uint32_t first,
+                                    uint32_t last) {
+    return (uint64_t)g->cases[last].value - (uint64_t)g->cases[first].value;
+}
+
+// Splits the sorted cases into clusters and returns their amount.
+static uint32_t codegen_switch_clusters(struct codegen *g, uint32_t count) {
+    struct codegen_case *cases = g->cases;
+    uint32_t cluster_count = 0;
+    for (uint32_t first = 0; first < count;) {
+        // the longest run of cases dense enough for a table.
+        uint32_t table = first + 1;
+        for (; table < count; table++) {
+            uint64_t span = codegen_switch_span(g, first, table);
+            if (span >= CODEGEN_TABLE_SPAN ||
+                (uint64_t)(table + 1 - first) * 10 <
+                    (span + 1) * CODEGEN_TABLE_DENSITY)
+                break;
+        }
+        // and of cases within 64 values going to few blocks.
+        uint32_t blocks[CODEGEN_BITS_BLOCKS] = {cases[first].block};
+        uint32_t block_count = 1;
+        uint32_t bits = first + 1;
+        for (; bits < count && codegen_switch_span(g, first, bits) < 64; bits++) {
+            uint32_t b = 0;
+            while (b < block_count && blocks[b] != cases[bits].block) b++;
+            if (b == CODEGEN_BITS_BLOCKS) break;
+            if (b == block_count) blocks[block_count++] = cases[bits].block;
+        }
+
+        struct codegen_cluster *cluster = &g->clusters[cluster_count++];
+        cluster->first = first;
+        if (bits - first >= CODEGEN_BITS_CASES && bits >= table) {
+            cluster->kind = CODEGEN_CLUSTER_BITS;
+            cluster->end = bits;
+        } else if (table - first >= CODEGEN_TABLE_CASES) {
+            cluster->kind = CODEGEN_CLUSTER_TABLE;
+            cluster->end = table;
+        } else {
+            cluster->kind = CODEGEN_CLUSTER_CASE;
+            cluster->end = first + 1;
+        }
+        first = cluster->end;
+    }
+    return cluster_count;
+}
+
+// Leaves the value less the lowest of `cluster` in rax, or jumps to `skip`
+// if it's out of the values the cluster spans.
+static void codegen_switch_index(struct codegen *g, int reg, int size,
+                                 struct codegen_cluster *cluster,
+                                 uint32_t skip) {
+    int64_t low = g->cases[cluster->first].value;
+    // a 32-bit move clears the upper half, the index is unsigned.
+    codegen_switch_emit(g, X86_MOV, size, x86_reg(X86_RAX), x86_reg(reg));
+    if (low) codegen_switch_op(g, X86_SUB, size, X86_RAX, low);
+    codegen_switch_emit(g, X86_CMP, size, x86_reg(X86_RAX),
+                        x86_imm(codegen_switch_span(g, cluster->first,
+                                                    cluster->end - 1)));
+    codegen_switch_jcc(g, X86_CC_A, skip);
+}
+
+static void codegen_switch_table(struct codegen *g, int reg, int size,
+                                 struct codegen_cluster *cluster,
+                                 uint32_t default_block) {
+    uint32_t skip = x86_new_label(&g->x86);
+    uint32_t table = x86_new_label(&g->x86);
+    codegen_switch_index(g, reg, size, cluster, skip);
+    codegen_switch_emit(g, X86_LEA, 8, x86_reg(X86_RCX), x86_label(table));
+    struct x86_operand entry = x86_mem(X86_RCX, 0);
+    entry.index = X86_RAX;
+    entry.scale = 4;
+    codegen_switch_emit(g, X86_MOVSX, 8, x86_reg(X86_RAX), entry)->src_size = 4;
+    codegen_switch_emit(g, X86_ADD, 8, x86_reg(X86_RAX), x86_reg(X86_RCX));
+    codegen_switch_emit(g, X86_JMP, 8, x86_reg(X86_RAX), (struct x86_operand){0});
+
+    codegen_switch_emit(g, X86_LABEL, 0, x86_label(table), (struct x86_operand){0});
+    uint64_t span = codegen_switch_span(g, cluster->first, cluster->end - 1);
+    uint32_t c = cluster->first;
+    for (uint64_t i = 0; i <= span; i++) {
+        uint32_t block = default_block;
+        if (c < cluster->end && codegen_switch_span(g, cluster->first, c) == i)
+            block = g->cases[c++].block;
+        codegen_switch_emit(g, X86_CASE, 4, x86_label(block), x86_label(table));
+    }
+    codegen_switch_emit(g, X86_LABEL, 0, x86_label(skip), (struct x86_operand){0});
+}
+
+// Jumps to the block of the value if it's one of the cases of `cluster`,
+// falls through otherwise. Rather than jumping around the masks when the
+// value is out of the cluster, they are cleared then: the only branches
+// left are those taken for a case, which random values rarely are, as in a
+// chain of compares.
+static void codegen_switch_bits(struct codegen *g, int reg, int size,
+                                struct codegen_cluster *cluster) {
+    int64_t low = g->cases[cluster->first].value;
+    codegen_switch_emit(g, X86_MOV, size, x86_reg(X86_RAX), x86_reg(reg));
+    if (low) codegen_switch_op(g, X86_SUB, size, X86_RAX, low);
+    // rcx is all ones if the value is within the cluster, 0 otherwise.
+    codegen_switch_emit(g, X86_XOR, 4, x86_reg(X86_RCX), x86_reg(X86_RCX));
+    codegen_switch_emit(g, X86_CMP, size, x86_reg(X86_RAX),
+                        x86_imm(codegen_switch_span(g, cluster->first,
+                                                    cluster->end - 1)));
+    codegen_switch_emit(g, X86_SETCC, 1, x86_reg(X86_RCX), (struct x86_operand){0})
+        ->cond = X86_CC_BE;
+    codegen_switch_emit(g, X86_NEG, 8, x86_reg(X86_RCX), (struct x86_operand){0});
+    // a mask of the values of each block, in the order of their first case.
+    for (uint32_t c = cluster->first; c < cluster->end; c++) {
+        uint32_t block = g->cases[c].block;
+        bool seen = false;
+        for (uint32_t d = cluster->first; d < c; d++)
+            seen |= g->cases[d].block == block;
+        if (seen) continue;
+        uint64_t mask = 0;
+        for (uint32_t d = c; d < cluster->end; d++)
+            if (g->cases[d].block == block)
+                mask |= 1ull << codegen_switch_span(g, cluster->first, d);
+        codegen_switch_emit(g, X86_MOV, 8, x86_reg(X86_RDX), x86_imm(mask));
+        codegen_switch_emit(g, X86_AND, 8, x86_reg(X86_RDX), x86_reg(X86_RCX));
+        codegen_switch_emit(g, X86_BT, 8, x86_reg(X86_RDX), x86_reg(X86_RAX));
+        codegen_switch_jcc(g, X86_CC_B, block);
+    }
+}
+
+// Dispatches on the clusters [first, end), the value isn't in any other.
+// `last` tells if nothing follows the code, which may then fall through to
+// the default block when it's `next`.
+static void codegen_switch_tree(struct codegen *g, int reg, int size,
+                                uint32_t first, uint32_t end,
+                                uint32_t default_block, uint32_t next,
+                                bool last) {
+    if (end - first > CODEGEN_LEAF_CLUSTERS) {
+        uint32_t middle = first + (end - first) / 2;
+        uint32_t right = x86_new_label(&g->x86);
+        codegen_switch_op(g, X86_CMP, size, reg,
+                          g->cases[g->clusters[middle].first].value);
+        codegen_switch_jcc(g, X86_CC_GE, right);
+        codegen_switch_tree(g, reg, size, first, middle, default_block, next,
+                            false);
+        codegen_switch_emit(g, X86_LABEL, 0, x86_label(right),
+                            (struct x86_operand){0});
+        codegen_switch_tree(g, reg, size, middle, end, default_block, next,
+                            last);
+        return;
+    }
+    for (uint32_t i = first; i < end; i++) {
+        struct codegen_cluster *cluster = &g->clusters[i];
+        switch (cluster->kind) {
+        case CODEGEN_CLUSTER_CASE:
+            codegen_switch_op(g, X86_CMP, size, reg,
+                              g->cases[cluster->first].value);
+            codegen_switch_jcc(g, X86_CC_E, g->cases[cluster->first].block);
+            break;
+        case CODEGEN_CLUSTER_TABLE:
+            codegen_switch_table(g, reg, size, cluster, default_block);
+            break;
+        case CODEGEN_CLUSTER_BITS:
+            codegen_switch_bits(g, reg, size, cluster);
+            break;
+        }
+    }
+    if (!last || default_block != next) codegen_switch_jump(g, default_block);
+}
+
+void codegen_switch(struct codegen *g, uint32_t v, int reg, uint32_t next) {
+    struct ir_function *fn = g->fn;
+    struct ir_inst *inst = ir_inst(fn, v);
+    uint32_t *extra = &fn->extra[inst->b];
+    uint32_t count = extra[0];
+    int size = inst->type == IR_I64 ? 8 : 4;
+    if (count > g->case_capacity) {
+        g->case_capacity = count * 2;
+        g->cases = realloc(g->cases, g->case_capacity * sizeof(struct codegen_case));
+        g->clusters = realloc(g->clusters, g->case_capacity *
+                                               sizeof(struct codegen_cluster));
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t *bits = &extra[2 + count + i * 2];
+        int64_t value = (int64_t)((uint64_t)bits[0] | (uint64_t)bits[1] << 32);
+        g->cases[i] = (struct codegen_case){
+            .value = size == 8 ? value : (int32_t)value,
+            .block = codegen_switch_target(fn, extra[2 + i])};
+    }
+    qsort(g->cases, count, sizeof(struct codegen_case), codegen_switch_compare);
+    uint32_t cluster_count = codegen_switch_clusters(g, count);
+    codegen_switch_tree(g, reg, size, 0, cluster_count, extra[1], next, true);
+}
@@ -1,60 +1,214 @@
 #include "compiler.h"
+#include "backend.h"
+#include "bodies.h"
+#include "codegen.h"
 #include "lexer.h"
+#include "lower.h"
+#include "opt.h"
+#include "output.h"
+#include "parser.h"
+#include "resolver.h"
+#include "types.h"
 
 #include <stdarg.h>
 #include <stdlib.h>
 
+static void compiler_vwarning(struct compiler *compiler, const char *msg,
+                              va_list args) {
+    vfprintf(stderr, msg, args);
+
+    fprintf(stderr, "on line %i, col %i in file %s\n", compiler->pos.line,
+            compiler->pos.col, compiler->cfile.abs_path);
+}
+
 void compiler_warning(struct compiler *compiler, const char *msg, ...) {
     va_list args;
     va_start(args, msg);
-    vfprintf(stderr, msg, args);
+    compiler_vwarning(compiler, msg, args);
     va_end(args);
+}
 
-    fprintf(stderr, "on line %i, col %i in file %s\n", compiler->pos.line,
-            compiler->pos.col, compiler->cfile.abs_path);
+// set by compiler_catch_errors, per thread.
+static _Thread_local jmp_buf *compiler_thread_jmp;
+
+void compiler_catch_errors(jmp_buf *jmp) {
+    compiler_thread_jmp = jmp;
+}
+
+void compiler_fail(struct compiler *compiler) {
+    if (compiler_thread_jmp) longjmp(*compiler_thread_jmp, 1);
+    if (compiler->recovering) longjmp(compiler->error_jmp, 1);
+
+    if (compiler->ofile) output_abort(compiler->ofile);
+    exit(-1);
 }
 
 void compiler_error(struct compiler *compiler, const char *msg, ...) {
     va_list args;
     va_start(args, msg);
-    compiler_warning(compiler, msg, args);
+    compiler_vwarning(compiler, msg, args);
     va_end(args);
-    exit(-1);
+    compiler_fail(compiler);
+}
+
+// Reads the whole file at `path` into a heap allocation, returns NULL if the
+// file can't be read.
+static char *compiler_read_file(const char *path, size_t *len) {
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) return NULL;
+
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    if (size < 0) {
+        fclose(fp);
+        return NULL;
+    }
+
+    // never hand out a zero sized allocation for an empty file.
+    char *data = malloc(size + 1);
+    *len = fread(data, 1, size, fp);
+    fclose(fp);
+    return data;
+}
+
+static void compiler_set_input(struct compiler *c, const char *src,
+                               size_t len, const char *filename) {
+    c->pos.line = 1;
+    c->pos.col = 1;
+    c->pos.filename = filename;
+    c->cfile.abs_path = filename;
+    c->cfile.data = src;
+    c->cfile.len = len;
 }
 
 struct compiler *compiler_create(const char *infile, const char *out_file,
                                  int flags) {
     struct compiler *c = calloc(1, sizeof(struct compiler));
     c->flags = flags;
-    c->pos.line = 1;
-    c->pos.col = 1;
-    c->pos.filename = infile;
-    c->cfile.abs_path = infile;
 
-    c->cfile.fp = fopen(infile, "r");
-    if (c->cfile.fp == NULL) {
+    size_t len = 0;
+    char *data = compiler_read_file(infile, &len);
+    if (data == NULL) {
 		printf("Error opening input file\n");
         exit(EXIT_FAILURE);
     }
+    compiler_set_input(c, data, len, infile);
+    c->cfile.owned = true;
 
-    c->ofile = fopen(out_file, "w");
+    if (out_file == NULL) return c;
+    c->ofile = output_open(out_file);
     if (c->ofile == NULL) {
 		compiler_error(c, "Error opening output file\n");
-        fclose(c->cfile.fp);  // Close the input file before exiting
         exit(EXIT_FAILURE);
     }
 
     return c;
 }
 
+struct compiler *compiler_create_from_memory(const char *src, size_t len,
+                                             const char *virtual_filename,
+                                             struct buffer *out, int flags) {
+    struct compiler *c = calloc(1, sizeof(struct compiler));
+    c->flags = flags;
+    compiler_reset_from_memory(c, src, len, virtual_filename, out);
+    return c;
+}
+
+void compiler_reset_from_memory(struct compiler *c, const char *src,
+                                size_t len, const char *virtual_filename,
+                                struct buffer *out) {
+    if (c->cfile.owned) free((char *)c->cfile.data);
+    c->cfile.owned = false;
+    compiler_set_input(c, src, len, virtual_filename);
+
+    if (c->ofile) output_abort(c->ofile);
+    c->ofile = output_open_memory(out);
+}
+
+void compiler_free(struct compiler *c) {
+    if (c->backend) backend_free(c->backend);
+    if (c->codegen) codegen_free(c->codegen);
+    if (c->opt) opt_free(c->opt);
+    if (c->lower) lower_free(c->lower);
+    if (c->types) types_free(c->types);
+    if (c->bodies) bodies_free(c->bodies);
+    if (c->resolver) resolver_free(c->resolver);
+    if (c->parser) parser_free(c->parser);
+    if (c->lexer) lexer_free(c->lexer);
+    if (c->ofile) output_abort(c->ofile);
+    if (c->cfile.owned) free((char *)c->cfile.data);
+    free(c);
+}
+
+static void compiler_lex_and_parse(struct compiler *c) {
+	if (!(c->flags & COMPILER_FLAG_PIPELINED)) {
+		if (lexer_lex(c->lexer) != LEXICAL_ANALYSIS_ALL_OK)
+			compiler_fail(c);
+		if (parser_parse(c->parser) != PARSE_ALL_OK)
+			compiler_fail(c);
+		return;
+	}
+
+	lexer_lex_start(c->lexer);
+	int parsed = parser_parse_stream(c->parser);
+	if (lexer_lex_join(c->lexer) != LEXICAL_ANALYSIS_ALL_OK)
+		compiler_fail(c);
+	// reported like a serial compile would, by parsing the complete tokens
+	// again.
+	if (parsed != PARSE_ALL_OK && parser_parse(c->parser) != PARSE_ALL_OK)
+		compiler_fail(c);
+}
+
+// Types the tree, lowers its functions and generates their code into the
+// object written to the output, if there is one.
+static void compiler_lower(struct compiler *c) {
+	types_reset(c->types);
+	types_build(c->types);
+	codegen_begin(c->codegen);
+	if (backend_generate_all(c->backend) != BACKEND_ALL_OK)
+		compiler_fail(c);
+	codegen_end(c->codegen);
+	if (c->ofile) codegen_finish(c->codegen, c->ofile);
+}
+
 int compile_file(struct compiler *c) {
+	if (!c->lexer) c->lexer = lexer_create(c);
+	if (!c->parser) c->parser = parser_create(c);
+	if (!c->resolver) c->resolver = resolver_create(c);
+	if (!c->bodies) c->bodies = bodies_create(c);
+	if (!c->types) c->types = types_create(c);
+	if (!c->lower) c->lower = lower_create(c);
+	if (!c->opt && (c->flags & COMPILER_FLAG_OPTIMIZE)) c->opt = opt_create();
+	if (!c->codegen) c->codegen = codegen_create(c);
+	if (!c->backend) c->backend = backend_create(c);
 
-	struct lexer *l = lexer_create(c);
-	if (!l)
+	if (setjmp(c->error_jmp)) {
+		// a compiler or lexical error was reported.
+		c->recovering = false;
+		if (c->ofile) output_abort(c->ofile);
+		c->ofile = NULL;
 		return COMPILER_FAILED_WITH_ERRORS;
+	}
+	c->recovering = true;
+
+	compiler_lex_and_parse(c);
+	if (resolver_resolve(c->resolver) != RESOLVE_ALL_OK)
+		compiler_fail(c);
+	if (!(c->flags & COMPILER_FLAG_LAZY_BODIES) &&
+	    bodies_parse_all(c->bodies) != BODIES_ALL_OK)
+		compiler_fail(c);
+	if (!(c->flags & COMPILER_FLAG_LAZY_BODIES)) compiler_lower(c);
+
+	c->recovering = false;
+	if (!c->ofile) return COMPILER_FILE_COMPILED_OK;
 
-	if (lexer_lex(l) != LEXICAL_ANALYSIS_ALL_OK)
+	int res = output_commit(c->ofile);
+	c->ofile = NULL;
+	if (res != 0) {
+		perror("Error writing output file");
 		return COMPILER_FAILED_WITH_ERRORS;
+	}
 
     return COMPILER_FILE_COMPILED_OK;
 }
@@ -1,6 +1,9 @@
 #ifndef PEACHCOMPILER_H
 #define PEACHCOMPILER_H
 
+#include <setjmp.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdio.h>
 struct pos {
     int line;
@@ -10,26 +13,117 @@ struct pos {
 
 enum { COMPILER_FILE_COMPILED_OK, COMPILER_FAILED_WITH_ERRORS };
 
+// Flags of compiler::flags.
+enum {
+    // Lex with the tooling profile: the source as written is also kept, its
+    // tokens in lexer::raw_tokens and the comments, newlines and whitespace
+    // between them in lexer::trivia, so it can be reproduced. Without it
+    // trivia are dropped. The compile reads the preprocessed tokens with
+    // either profile.
+    COMPILER_FLAG_LEX_TOOLING = 0b00000001,
+    // Leave function bodies unparsed, tools parse the ones they look into
+    // with bodies_parse_function.
+    COMPILER_FLAG_LAZY_BODIES = 0b00000010,
+    // Lex on a thread of its own while the parser takes the tokens as they
+    // come, the result is the same as lexing first.
+    COMPILER_FLAG_PIPELINED = 0b00000100,
+    // Print the IR of every function on stdout once it's lowered.
+    COMPILER_FLAG_DUMP_IR = 0b00001000,
+    // Print the machine code of every function on stdout in assembly syntax
+    // once it's generated.
+    COMPILER_FLAG_DUMP_ASM = 0b00010000,
+    // Optimize the IR of every function before its code is generated, and
+    // the machine code after, see opt.h and x86_peephole.
+    COMPILER_FLAG_OPTIMIZE = 0b00100000,
+};
+
+struct buffer;
+
 struct compiler {
     // Instructs details of file compilation
     int flags;
 
+    // Most threads the parallel phases of a compile may use, 0 for one per
+    // online CPU.
+    int threads;
+
     // Tracks lexer position
     struct pos pos;
 
-    // input file
+    // input file, the whole source is held in memory while lexing.
     struct compile_process_input_file {
-        FILE *fp;
+        const char *data;
+        size_t len;
         const char *abs_path;
+        // true if `data` was read from disk and is freed by the compiler.
+        bool owned;
     } cfile;
 
-    // output file.
-    FILE *ofile;
+    // output file, only replaces the destination once the compile succeeded.
+    // NULL if the object is only kept in memory, in codegen.
+    struct output *ofile;
+
+    // lexer reused by every compile of this compiler, holds the tokens of the
+    // last compile.
+    struct lexer *lexer;
+    // parser reused by every compile of this compiler, holds the tree of the
+    // last compile.
+    struct parser *parser;
+    // binds the names of the parsed tree to their declarations.
+    struct resolver *resolver;
+    // parses and resolves the function bodies the parser skipped.
+    struct bodies *bodies;
+    // types of the parsed tree, built once the bodies are parsed.
+    struct types *types;
+    // lowers each function to SSA form, see ir.h.
+    struct lower *lower;
+    // optimizes the functions lowered with COMPILER_FLAG_OPTIMIZE.
+    struct opt *opt;
+    // generates the object file written to `ofile`.
+    struct codegen *codegen;
+    // runs the three passes above on the functions, in parallel if they're
+    // worth it.
+    struct backend *backend;
+
+    // compiler and lexical errors unwind to compile_file instead of exiting
+    // the process while `recovering` is set.
+    jmp_buf error_jmp;
+    bool recovering;
 };
 
+// Creates a compiler of the file `infile` writing to `out_file`, or only
+// keeping the object in memory if `out_file` is NULL, see jit.h.
 struct compiler *compiler_create(const char *infile, const char *out_file,
                                  int flags);
 
+// Creates a compiler which never touches the file system. The `len` bytes at
+// `src` are compiled as if they were read from `virtual_filename` and the
+// output is appended to `out`.
+// `src` must stay valid for as long as the tokens of the compile are used.
+struct compiler *compiler_create_from_memory(const char *src, size_t len,
+                                             const char *virtual_filename,
+                                             struct buffer *out, int flags);
+
+// Rearms a compiler for another in-memory compile. The lexer and its token
+// storage are kept and reused, only the contents are reset.
+void compiler_reset_from_memory(struct compiler *c, const char *src,
+                                size_t len, const char *virtual_filename,
+                                struct buffer *out);
+
+void compiler_free(struct compiler *c);
+
 int compile_file(struct compiler *c);
 
+// Print a diagnostic followed by the current position to stderr.
+void compiler_warning(struct compiler *compiler, const char *msg, ...);
+// Print a diagnostic and fail the compile, unwinding to compile_file or
+// exiting the process outside of it.
+void compiler_error(struct compiler *compiler, const char *msg, ...);
+// Fail the compile after the diagnostic has already been reported.
+void compiler_fail(struct compiler *compiler);
+// Makes compile failures on the calling thread unwind to `jmp` instead, NULL
+// restores the default. Worker threads can't unwind to compile_file, it runs
+// on another thread.
+void compiler_catch_errors(jmp_buf *jmp);
+
 #endif  // PEACHCOMPILER_H
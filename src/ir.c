@@ -0,0 +1,898 @@
+#include "ir.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Where an instruction keeps its operands, see ir_operand.
+enum {
+    // `a` and `b` are immediates.
+    IR_FORM_IMMEDIATE,
+    // `a` is a value, 0 if it's optional and left out.
+    IR_FORM_UNARY,
+    // `a` and `b` are values.
+    IR_FORM_BINARY,
+    // `a` is a value and `b` a list of values.
+    IR_FORM_CALL,
+    // `a` is a list of values.
+    IR_FORM_PHI,
+    // `a` is a block.
+    IR_FORM_JUMP,
+    // `a` is a value and `b` an extra index of blocks.
+    IR_FORM_BRANCH,
+};
+
+static const struct {
+    const char *name;
+    uint8_t form;
+} ir_ops[IR_OP_COUNT] = {
+    [IR_NONE] = {"none", IR_FORM_IMMEDIATE},
+    [IR_CONST] = {"const", IR_FORM_IMMEDIATE},
+    [IR_PARAM] = {"param", IR_FORM_IMMEDIATE},
+    [IR_UNDEF] = {"undef", IR_FORM_IMMEDIATE},
+    [IR_SLOT] = {"slot", IR_FORM_IMMEDIATE},
+    [IR_GLOBAL] = {"global", IR_FORM_IMMEDIATE},
+    [IR_STRING] = {"string", IR_FORM_IMMEDIATE},
+    [IR_COPY] = {"copy", IR_FORM_UNARY},
+    [IR_NEG] = {"neg", IR_FORM_UNARY},
+    [IR_NOT] = {"not", IR_FORM_UNARY},
+    [IR_SEXT] = {"sext", IR_FORM_UNARY},
+    [IR_ZEXT] = {"zext", IR_FORM_UNARY},
+    [IR_TRUNC] = {"trunc", IR_FORM_UNARY},
+    [IR_LOAD] = {"load", IR_FORM_UNARY},
+    [IR_ADD] = {"add", IR_FORM_BINARY},
+    [IR_SUB] = {"sub", IR_FORM_BINARY},
+    [IR_MUL] = {"mul", IR_FORM_BINARY},
+    [IR_SDIV] = {"sdiv", IR_FORM_BINARY},
+    [IR_UDIV] = {"udiv", IR_FORM_BINARY},
+    [IR_SREM] = {"srem", IR_FORM_BINARY},
+    [IR_UREM] = {"urem", IR_FORM_BINARY},
+    [IR_AND] = {"and", IR_FORM_BINARY},
+    [IR_OR] = {"or", IR_FORM_BINARY},
+    [IR_XOR] = {"xor", IR_FORM_BINARY},
+    [IR_SHL] = {"shl", IR_FORM_BINARY},
+    [IR_SHR] = {"shr", IR_FORM_BINARY},
+    [IR_SAR] = {"sar", IR_FORM_BINARY},
+    [IR_EQ] = {"eq", IR_FORM_BINARY},
+    [IR_NE] = {"ne", IR_FORM_BINARY},
+    [IR_LT] = {"lt", IR_FORM_BINARY},
+    [IR_LE] = {"le", IR_FORM_BINARY},
+    [IR_GT] = {"gt", IR_FORM_BINARY},
+    [IR_GE] = {"ge", IR_FORM_BINARY},
+    [IR_ULT] = {"ult", IR_FORM_BINARY},
+    [IR_ULE] = {"ule", IR_FORM_BINARY},
+    [IR_UGT] = {"ugt", IR_FORM_BINARY},
+    [IR_UGE] = {"uge", IR_FORM_BINARY},
+    [IR_STORE] = {"store", IR_FORM_BINARY},
+    [IR_CALL] = {"call", IR_FORM_CALL},
+    [IR_PHI] = {"phi", IR_FORM_PHI},
+    [IR_JUMP] = {"jump", IR_FORM_JUMP},
+    [IR_BRANCH] = {"branch", IR_FORM_BRANCH},
+    [IR_SWITCH] = {"switch", IR_FORM_BRANCH},
+    [IR_RET] = {"ret", IR_FORM_UNARY},
+};
+
+static const char *ir_type_names[] = {"void", "i8", "i16", "i32", "i64"};
+
+const char *ir_op_name(int op) {
+    return ir_ops[op].name;
+}
+
+// Grows the array at `*items` of `*capacity` elements of `size` bytes to
+// hold at least `needed` of them.
+static void *ir_reserve(void *items, uint32_t *capacity, uint32_t needed,
+                        size_t size) {
+    if (needed <= *capacity) return items;
+    uint32_t grown = *capacity ? *capacity : 64;
+    while (grown < needed) grown *= 2;
+    *capacity = grown;
+    return realloc(items, (size_t)grown * size);
+}
+
+// Operands of the instruction `v` of the array `insts`, whose lists are in
+// `extra`. Shared by the built functions and the builder.
+static uint32_t ir_count_operands(const struct ir_inst *insts,
+                                  const uint32_t *extra, uint32_t v) {
+    const struct ir_inst *inst = &insts[v];
+    switch (ir_ops[inst->op].form) {
+    case IR_FORM_UNARY:
+        return inst->a ? 1 : 0;
+    case IR_FORM_BINARY:
+        return 2;
+    case IR_FORM_CALL:
+        return 1 + extra[inst->b];
+    case IR_FORM_PHI:
+        return inst->a ? extra[inst->a] : 0;
+    case IR_FORM_BRANCH:
+        return 1;
+    }
+    return 0;
+}
+
+static uint32_t *ir_operand_at(struct ir_inst *insts, uint32_t *extra,
+                               uint32_t v, uint32_t i) {
+    struct ir_inst *inst = &insts[v];
+    switch (ir_ops[inst->op].form) {
+    case IR_FORM_CALL:
+        return i ? &extra[inst->b + i] : &inst->a;
+    case IR_FORM_PHI:
+        return &extra[inst->a + 1 + i];
+    }
+    return i ? &inst->b : &inst->a;
+}
+
+// Block operands of the terminator `v`, written to `count`.
+static uint32_t *ir_targets_at(struct ir_inst *insts, uint32_t *extra,
+                               uint32_t v, uint32_t *count) {
+    struct ir_inst *inst = &insts[v];
+    switch (inst->op) {
+    case IR_JUMP:
+        *count = 1;
+        return &inst->a;
+    case IR_BRANCH:
+        *count = 2;
+        return &extra[inst->b];
+    case IR_SWITCH:
+        *count = extra[inst->b] + 1;
+        return &extra[inst->b + 1];
+    }
+    *count = 0;
+    return NULL;
+}
+
+uint32_t ir_operand_count(struct ir_function *fn, uint32_t v) {
+    return ir_count_operands(fn->insts, fn->extra, v);
+}
+
+uint32_t *ir_operand(struct ir_function *fn, uint32_t v, uint32_t i) {
+    return ir_operand_at(fn->insts, fn->extra, v, i);
+}
+
+uint32_t *ir_successors(struct ir_function *fn, uint32_t block,
+                        uint32_t *count) {
+    struct ir_block *bb = &fn->blocks[block];
+    return ir_targets_at(fn->insts, fn->extra, bb->end - 1, count);
+}
+
+static void ir_build_uses(struct ir_function *fn) {
+    uint32_t *first = fn->use_first =
+        ir_reserve(fn->use_first, &fn->use_first_capacity, fn->count + 1,
+                   sizeof(uint32_t));
+    memset(first, 0, (fn->count + 1) * sizeof(uint32_t));
+
+    uint32_t total = 0;
+    for (uint32_t v = 1; v < fn->count; v++) {
+        uint32_t count = ir_operand_count(fn, v);
+        for (uint32_t i = 0; i < count; i++) first[*ir_operand(fn, v, i)]++;
+        total += count;
+    }
+    // counts to the index of each value's first use.
+    uint32_t sum = 0;
+    for (uint32_t v = 0; v <= fn->count; v++) {
+        uint32_t count = first[v];
+        first[v] = sum;
+        sum += count;
+    }
+
+    // filling moves first[v] to the first use of v + 1, it's shifted back
+    // after.
+    fn->uses = ir_reserve(fn->uses, &fn->use_capacity, total + 1,
+                          sizeof(uint32_t));
+    for (uint32_t v = 1; v < fn->count; v++) {
+        uint32_t count = ir_operand_count(fn, v);
+        for (uint32_t i = 0; i < count; i++)
+            fn->uses[first[*ir_operand(fn, v, i)]++] = v;
+    }
+    for (uint32_t v = fn->count; v > 0; v--) first[v] = first[v - 1];
+    first[0] = 0;
+    fn->uses_valid = true;
+}
+
+uint32_t *ir_uses(struct ir_function *fn, uint32_t v, uint32_t *count) {
+    if (!fn->uses_valid) ir_build_uses(fn);
+    *count = fn->use_first[v + 1] - fn->use_first[v];
+    return &fn->uses[fn->use_first[v]];
+}
+
+void ir_print(struct ir_function *fn, FILE *out) {
+    fprintf(out, "function %s\n", fn->name);
+    for (uint32_t block = 0; block < fn->block_count; block++) {
+        struct ir_block *bb = &fn->blocks[block];
+        uint32_t count;
+        uint32_t *preds = ir_list(fn, bb->preds, &count);
+        fprintf(out, "b%u:", block);
+        if (count) fprintf(out, " ; preds");
+        for (uint32_t i = 0; i < count; i++) fprintf(out, " b%u", preds[i]);
+        fprintf(out, "\n");
+
+        for (uint32_t v = bb->first; v < bb->end; v++) {
+            struct ir_inst *inst = ir_inst(fn, v);
+            fprintf(out, "  ");
+            if (!ir_is_terminator(inst->op) && inst->op != IR_STORE &&
+                (inst->type != IR_VOID || inst->op != IR_CALL))
+                fprintf(out, "v%u = ", v);
+            fprintf(out, "%s", ir_op_name(inst->op));
+            if (inst->type != IR_VOID)
+                fprintf(out, " %s", ir_type_names[inst->type]);
+
+            switch (inst->op) {
+            case IR_CONST:
+                fprintf(out, " %lld",
+                        (long long)((uint64_t)inst->a | (uint64_t)inst->b << 32));
+                break;
+            case IR_PARAM:
+            case IR_GLOBAL:
+            case IR_STRING:
+                fprintf(out, " %u", inst->a);
+                break;
+            case IR_SLOT:
+                fprintf(out, " %u, %u", inst->a, inst->b);
+                break;
+            default: {
+                uint32_t operands = ir_operand_count(fn, v);
+                for (uint32_t i = 0; i < operands; i++)
+                    fprintf(out, "%s v%u", i ? "," : "", *ir_operand(fn, v, i));
+                break;
+            }
+            }
+
+            uint32_t target_count;
+            uint32_t *targets =
+                ir_targets_at(fn->insts, fn->extra, v, &target_count);
+            if (inst->op == IR_SWITCH) {
+                uint32_t *values = targets + target_count;
+                fprintf(out, ", default b%u", targets[0]);
+                for (uint32_t i = 1; i < target_count; i++)
+                    fprintf(out, ", %lld: b%u",
+                            (long long)((uint64_t)values[2 * i - 2] |
+                                        (uint64_t)values[2 * i - 1] << 32),
+                            targets[i]);
+            } else {
+                for (uint32_t i = 0; i < target_count; i++)
+                    fprintf(out, "%s b%u",
+                            i || inst->op == IR_BRANCH ? "," : "", targets[i]);
+            }
+            fprintf(out, "\n");
+        }
+    }
+}
+
+void ir_function_init(struct ir_function *fn) {
+    memset(fn, 0, sizeof(*fn));
+    ir_function_reset(fn);
+}
+
+void ir_function_free(struct ir_function *fn) {
+    free(fn->insts);
+    free(fn->blocks);
+    free(fn->extra);
+    free(fn->use_first);
+    free(fn->uses);
+    memset(fn, 0, sizeof(*fn));
+}
+
+void ir_function_reset(struct ir_function *fn) {
+    fn->node = 0;
+    fn->name = NULL;
+    fn->count = 1;
+    fn->insts = ir_reserve(fn->insts, &fn->capacity, 1, sizeof(struct ir_inst));
+    fn->insts[0] = (struct ir_inst){.op = IR_NONE};
+    fn->block_count = 0;
+    // extra[0] is the empty list.
+    fn->extra_count = 1;
+    fn->extra = ir_reserve(fn->extra, &fn->extra_capacity, 1, sizeof(uint32_t));
+    fn->extra[0] = 0;
+    fn->uses_valid = false;
+}
+
+void ir_map_init(struct ir_map *map) {
+    memset(map, 0, sizeof(*map));
+    map->generation = 1;
+}
+
+void ir_map_free(struct ir_map *map) {
+    free(map->entries);
+    memset(map, 0, sizeof(*map));
+}
+
+void ir_map_clear(struct ir_map *map) {
+    map->count = 0;
+    if (++map->generation == 0) {
+        memset(map->entries, 0, map->capacity * sizeof(struct ir_map_entry));
+        map->generation = 1;
+    }
+}
+
+void ir_map_copy(struct ir_map *map, struct ir_map *from) {
+    // the same capacity keeps every entry in its slot.
+    if (map->capacity != from->capacity) {
+        free(map->entries);
+        map->entries = malloc(from->capacity * sizeof(struct ir_map_entry));
+        map->capacity = from->capacity;
+    }
+    if (from->capacity)
+        memcpy(map->entries, from->entries,
+               from->capacity * sizeof(struct ir_map_entry));
+    map->count = from->count;
+    map->generation = from->generation;
+}
+
+static uint32_t ir_map_slot(struct ir_map *map, uint64_t key) {
+    uint32_t mask = map->capacity - 1;
+    uint32_t slot = (uint32_t)((key * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+    while (map->entries[slot].generation == map->generation &&
+           map->entries[slot].key != key)
+        slot = (slot + 1) & mask;
+    return slot;
+}
+
+uint32_t ir_map_get(struct ir_map *map, uint64_t key) {
+    if (!map->count) return 0;
+    struct ir_map_entry *entry = &map->entries[ir_map_slot(map, key)];
+    return entry->generation == map->generation ? entry->value : 0;
+}
+
+void ir_map_set(struct ir_map *map, uint64_t key, uint32_t value) {
+    if ((map->count + 1) * 2 > map->capacity) {
+        struct ir_map_entry *old = map->entries;
+        uint32_t old_capacity = map->capacity;
+        uint32_t old_generation = map->generation;
+        map->capacity = map->capacity ? map->capacity * 2 : 256;
+        map->entries = calloc(map->capacity, sizeof(struct ir_map_entry));
+        map->generation = 1;
+        for (uint32_t i = 0; i < old_capacity; i++) {
+            if (old[i].generation != old_generation) continue;
+            struct ir_map_entry *entry = &map->entries[ir_map_slot(map, old[i].key)];
+            *entry = old[i];
+            entry->generation = 1;
+        }
+        free(old);
+    }
+    struct ir_map_entry *entry = &map->entries[ir_map_slot(map, key)];
+    if (entry->generation != map->generation) map->count++;
+    *entry = (struct ir_map_entry){
+        .key = key, .value = value, .generation = map->generation};
+}
+
+// Builder.
+
+static uint32_t ir_add(struct ir_builder *b, int op, int type, uint32_t a,
+                       uint32_t operand_b) {
+    if (b->count == b->capacity) {
+        b->capacity = b->capacity ? b->capacity * 2 : 256;
+        b->insts = realloc(b->insts, b->capacity * sizeof(struct ir_inst));
+        b->next = realloc(b->next, b->capacity * sizeof(uint32_t));
+        b->alias = realloc(b->alias, b->capacity * sizeof(uint32_t));
+    }
+    b->insts[b->count] =
+        (struct ir_inst){.op = op, .type = type, .a = a, .b = operand_b};
+    b->next[b->count] = 0;
+    b->alias[b->count] = 0;
+    return b->count++;
+}
+
+static uint32_t ir_add_extra(struct ir_builder *b, uint32_t n) {
+    b->extra = ir_reserve(b->extra, &b->extra_capacity, b->extra_count + n,
+                          sizeof(uint32_t));
+    uint32_t at = b->extra_count;
+    b->extra_count += n;
+    return at;
+}
+
+// Appends `v` to the chain from `*first` to `*last`.
+static void ir_chain(struct ir_builder *b, uint32_t *first, uint32_t *last,
+                     uint32_t v) {
+    if (*last)
+        b->next[*last] = v;
+    else
+        *first = v;
+    *last = v;
+}
+
+static uint32_t ir_undef(struct ir_builder *b, int type) {
+    if (!b->undef[type]) {
+        b->undef[type] = ir_add(b, IR_UNDEF, type, 0, 0);
+        ir_chain(b, &b->entry_first, &b->entry_last, b->undef[type]);
+    }
+    return b->undef[type];
+}
+
+// Returns the value replacing `v` once trivial phis are removed.
+static uint32_t ir_find(struct ir_builder *b, uint32_t v) {
+    uint32_t root = v;
+    while (b->alias[root]) root = b->alias[root];
+    while (b->alias[v] && b->alias[v] != root) {
+        uint32_t next = b->alias[v];
+        b->alias[v] = root;
+        v = next;
+    }
+    return root;
+}
+
+static uint64_t ir_def_key(uint32_t var, uint32_t block) {
+    return (uint64_t)var << 32 | block;
+}
+
+static uint32_t ir_phi(struct ir_builder *b, uint32_t block, int type) {
+    uint32_t phi = ir_add(b, IR_PHI, type, 0, 0);
+    struct ir_build_block *bb = &b->blocks[block];
+    ir_chain(b, &bb->phi_first, &bb->phi_last, phi);
+    return phi;
+}
+
+// Removes `phi` if all its operands are the same value or the phi itself,
+// and returns what stands for it.
+static uint32_t ir_try_trivial(struct ir_builder *b, uint32_t phi) {
+    uint32_t same = 0;
+    uint32_t list = b->insts[phi].a;
+    uint32_t count = b->extra[list];
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t op = ir_find(b, b->extra[list + 1 + i]);
+        if (op == same || op == phi) continue;
+        if (same) return phi;
+        same = op;
+    }
+    // unreachable, or reads before any write.
+    if (!same) same = ir_undef(b, b->insts[phi].type);
+    b->alias[phi] = same;
+    return same;
+}
+
+static uint32_t ir_read(struct ir_builder *b, uint32_t var, uint32_t block,
+                        int type);
+
+static uint32_t ir_phi_operands(struct ir_builder *b, uint32_t var,
+                                uint32_t phi, uint32_t block) {
+    uint32_t count = b->blocks[block].pred_count;
+    uint32_t list = ir_add_extra(b, count + 1);
+    b->extra[list] = count;
+
+    uint32_t i = 0;
+    for (uint32_t e = b->blocks[block].pred_first; e; e = b->edges[e].next) {
+        uint32_t value = ir_read(b, var, b->edges[e].from, b->insts[phi].type);
+        b->extra[list + 1 + i++] = value;
+    }
+    b->insts[phi].a = list;
+    b->insts[phi].b = 0;
+    return ir_try_trivial(b, phi);
+}
+
+static uint32_t ir_read(struct ir_builder *b, uint32_t var, uint32_t block,
+                        int type) {
+    uint32_t v = ir_map_get(&b->defs, ir_def_key(var, block));
+    if (v) return ir_find(b, v);
+
+    // blocks with a single predecessor have no phis, the value comes from
+    // further up. A cycle of them can only be unreachable.
+    uint32_t at = block;
+    uint32_t steps = 0;
+    while (b->blocks[at].sealed && b->blocks[at].pred_count == 1 &&
+           steps++ < b->block_count) {
+        at = b->edges[b->blocks[at].pred_first].from;
+        v = ir_map_get(&b->defs, ir_def_key(var, at));
+        if (v) {
+            v = ir_find(b, v);
+            break;
+        }
+    }
+
+    if (!v && !b->blocks[at].sealed) {
+        // completed by ir_seal_block.
+        v = ir_phi(b, at, type);
+        b->insts[v].b = var;
+    } else if (!v && b->blocks[at].pred_count > 1) {
+        v = ir_phi(b, at, type);
+        // reads of the variable in loops leading back here find the phi.
+        ir_map_set(&b->defs, ir_def_key(var, at), v);
+        v = ir_phi_operands(b, var, v, at);
+    } else if (!v) {
+        v = ir_undef(b, type);
+    }
+    ir_map_set(&b->defs, ir_def_key(var, at), v);
+    if (at != block) ir_map_set(&b->defs, ir_def_key(var, block), v);
+    return v;
+}
+
+void ir_write_var(struct ir_builder *b, uint32_t var, uint32_t value) {
+    ir_map_set(&b->defs, ir_def_key(var, b->current), value);
+}
+
+uint32_t ir_read_var(struct ir_builder *b, uint32_t var, int type) {
+    return ir_read(b, var, b->current, type);
+}
+
+uint32_t ir_new_block(struct ir_builder *b) {
+    b->blocks = ir_reserve(b->blocks, &b->block_capacity, b->block_count + 1,
+                           sizeof(struct ir_build_block));
+    b->blocks[b->block_count] = (struct ir_build_block){0};
+    return b->block_count++;
+}
+
+void ir_set_block(struct ir_builder *b, uint32_t block) {
+    b->current = block;
+}
+
+void ir_seal_block(struct ir_builder *b, uint32_t block) {
+    if (b->blocks[block].sealed) return;
+    // phis made by the reads below are complete already.
+    for (uint32_t phi = b->blocks[block].phi_first; phi; phi = b->next[phi]) {
+        if (!b->insts[phi].a && !b->alias[phi])
+            ir_phi_operands(b, b->insts[phi].b, phi, block);
+    }
+    b->blocks[block].sealed = true;
+}
+
+bool ir_terminated(struct ir_builder *b) {
+    return b->blocks[b->current].terminated;
+}
+
+uint32_t ir_emit(struct ir_builder *b, int op, int type, uint32_t a,
+                 uint32_t operand_b) {
+    if (b->blocks[b->current].terminated) {
+        b->current = ir_new_block(b);
+        b->blocks[b->current].sealed = true;
+    }
+    uint32_t v = ir_add(b, op, type, a, operand_b);
+    struct ir_build_block *bb = &b->blocks[b->current];
+    ir_chain(b, &bb->first, &bb->last, v);
+    return v;
+}
+
+uint32_t ir_emit_const(struct ir_builder *b, int type, int64_t value) {
+    return ir_emit(b, IR_CONST, type, (uint32_t)value,
+                   (uint32_t)((uint64_t)value >> 32));
+}
+
+uint32_t ir_emit_call(struct ir_builder *b, int type, uint32_t callee,
+                      const uint32_t *args, uint32_t count, int flags) {
+    uint32_t list = ir_add_extra(b, count + 1);
+    b->extra[list] = count;
+    memcpy(&b->extra[list + 1], args, count * sizeof(uint32_t));
+    uint32_t v = ir_emit(b, IR_CALL, type, callee, list);
+    b->insts[v].flags = flags;
+    return v;
+}
+
+uint32_t ir_emit_entry(struct ir_builder *b, int op, int type, uint32_t a,
+                       uint32_t operand_b) {
+    uint32_t v = ir_add(b, op, type, a, operand_b);
+    ir_chain(b, &b->entry_first, &b->entry_last, v);
+    return v;
+}
+
+static void ir_add_edge(struct ir_builder *b, uint32_t from, uint32_t to) {
+    b->edges = ir_reserve(b->edges, &b->edge_capacity, b->edge_count + 1,
+                          sizeof(struct ir_edge));
+    uint32_t e = b->edge_count++;
+    b->edges[e] = (struct ir_edge){.from = from};
+    struct ir_build_block *bb = &b->blocks[to];
+    if (bb->pred_last)
+        b->edges[bb->pred_last].next = e;
+    else
+        bb->pred_first = e;
+    bb->pred_last = e;
+    bb->pred_count++;
+}
+
+static void ir_terminate(struct ir_builder *b, int op, int type, uint32_t a,
+                         uint32_t operand_b) {
+    ir_emit(b, op, type, a, operand_b);
+    b->blocks[b->current].terminated = true;
+}
+
+void ir_jump(struct ir_builder *b, uint32_t target) {
+    ir_terminate(b, IR_JUMP, IR_VOID, target, 0);
+    ir_add_edge(b, b->current, target);
+}
+
+void ir_branch(struct ir_builder *b, uint32_t cond, uint32_t then_block,
+               uint32_t else_block) {
+    uint32_t targets = ir_add_extra(b, 2);
+    b->extra[targets] = then_block;
+    b->extra[targets + 1] = else_block;
+    ir_terminate(b, IR_BRANCH, b->insts[cond].type, cond, targets);
+    ir_add_edge(b, b->current, then_block);
+    ir_add_edge(b, b->current, else_block);
+}
+
+void ir_return(struct ir_builder *b, int type, uint32_t value) {
+    ir_terminate(b, IR_RET, type, value, 0);
+}
+
+void ir_switch(struct ir_builder *b, int type, uint32_t value,
+               uint32_t default_block, const int64_t *values,
+               const uint32_t *blocks, uint32_t count) {
+    uint32_t table = ir_add_extra(b, 2 + count * 3);
+    b->extra[table] = count;
+    b->extra[table + 1] = default_block;
+    for (uint32_t i = 0; i < count; i++) {
+        b->extra[table + 2 + i] = blocks[i];
+        b->extra[table + 2 + count + 2 * i] = (uint32_t)values[i];
+        b->extra[table + 3 + count + 2 * i] = (uint32_t)((uint64_t)values[i] >> 32);
+    }
+    ir_terminate(b, IR_SWITCH, type, value, table);
+    ir_add_edge(b, b->current, default_block);
+    for (uint32_t i = 0; i < count; i++) ir_add_edge(b, b->current, blocks[i]);
+}
+
+void ir_builder_begin(struct ir_builder *b, struct ir_function *fn) {
+    ir_function_reset(fn);
+    b->fn = fn;
+    b->count = 0;
+    ir_add(b, IR_NONE, IR_VOID, 0, 0);
+    b->block_count = 0;
+    b->edge_count = 0;
+    b->edges = ir_reserve(b->edges, &b->edge_capacity, 1, sizeof(struct ir_edge));
+    // edge 0 ends the chains.
+    b->edge_count = 1;
+    b->extra_count = 0;
+    // list 0 is empty.
+    uint32_t empty = ir_add_extra(b, 1);
+    b->extra[empty] = 0;
+    b->entry_first = 0;
+    b->entry_last = 0;
+    memset(b->undef, 0, sizeof(b->undef));
+    ir_map_clear(&b->defs);
+
+    b->current = ir_new_block(b);
+    b->blocks[b->current].sealed = true;
+}
+
+// Marks the blocks reachable from the entry with a nonzero
+// ir_build_block::index, the others with 0.
+static void ir_mark_reachable(struct ir_builder *b) {
+    for (uint32_t i = 0; i < b->block_count; i++) b->blocks[i].index = 0;
+    b->scratch = ir_reserve(b->scratch, &b->scratch_capacity, b->block_count,
+                            sizeof(uint32_t));
+    uint32_t top = 0;
+    b->scratch[top++] = 0;
+    b->blocks[0].index = 1;
+    while (top) {
+        uint32_t block = b->scratch[--top];
+        uint32_t count;
+        uint32_t *targets =
+            ir_targets_at(b->insts, b->extra, b->blocks[block].last, &count);
+        for (uint32_t i = 0; i < count; i++) {
+            if (b->blocks[targets[i]].index) continue;
+            b->blocks[targets[i]].index = 1;
+            b->scratch[top++] = targets[i];
+        }
+    }
+}
+
+// Drops the operands of the phis of a reachable block which come from
+// unreachable predecessors.
+static void ir_filter_phis(struct ir_builder *b, uint32_t block) {
+    struct ir_build_block *bb = &b->blocks[block];
+    for (uint32_t phi = bb->phi_first; phi; phi = b->next[phi]) {
+        if (b->alias[phi]) continue;
+        uint32_t list = b->insts[phi].a;
+        uint32_t kept = 0;
+        uint32_t i = 0;
+        for (uint32_t e = bb->pred_first; e; e = b->edges[e].next, i++) {
+            if (b->blocks[b->edges[e].from].index)
+                b->extra[list + 1 + kept++] = b->extra[list + 1 + i];
+        }
+        b->extra[list] = kept;
+    }
+}
+
+// Replaces the phis left trivial once unreachable operands are gone, a
+// removal may make the phis using it trivial in turn.
+static void ir_remove_trivial(struct ir_builder *b) {
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (uint32_t block = 0; block < b->block_count; block++) {
+            if (!b->blocks[block].index) continue;
+            for (uint32_t phi = b->blocks[block].phi_first; phi;
+                 phi = b->next[phi]) {
+                if (!b->alias[phi] && ir_try_trivial(b, phi) != phi)
+                    changed = true;
+            }
+        }
+    }
+}
+
+// Writes the values kept to builder::order in layout order: the entry
+// values first, then each reachable block's phis and other instructions.
+// Blocks are numbered in the same pass, ir_build_block::index becomes the
+// block's index in the function plus one. Returns the amount of values.
+static uint32_t ir_layout(struct ir_builder *b) {
+    b->order = ir_reserve(b->order, &b->order_capacity, b->count,
+                          sizeof(uint32_t));
+    uint32_t n = 0;
+    uint32_t index = 0;
+    for (uint32_t block = 0; block < b->block_count; block++) {
+        struct ir_build_block *bb = &b->blocks[block];
+        if (!bb->index) continue;
+        bb->index = ++index;
+        if (block == 0)
+            for (uint32_t v = b->entry_first; v; v = b->next[v]) b->order[n++] = v;
+        for (uint32_t v = bb->phi_first; v; v = b->next[v])
+            if (!b->alias[v]) b->order[n++] = v;
+        for (uint32_t v = bb->first; v; v = b->next[v]) b->order[n++] = v;
+    }
+    return n;
+}
+
+// Points the operands of kept values at values which were dropped to an
+// undefined value instead. They can only be reached from phis removed
+// after unreachable operands were dropped. Returns true if an IR_UNDEF was
+// added to the entry block.
+static bool ir_undefine_dropped(struct ir_builder *b, uint32_t n) {
+    uint32_t *kept = b->scratch = ir_reserve(b->scratch, &b->scratch_capacity,
+                                             b->count, sizeof(uint32_t));
+    memset(kept, 0, b->count * sizeof(uint32_t));
+    for (uint32_t i = 0; i < n; i++) kept[b->order[i]] = 1;
+
+    bool added = false;
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t v = b->order[i];
+        uint32_t count = ir_count_operands(b->insts, b->extra, v);
+        for (uint32_t j = 0; j < count; j++) {
+            uint32_t *op = ir_operand_at(b->insts, b->extra, v, j);
+            if (!*op) continue;
+            *op = ir_find(b, *op);
+            if (*op < b->count && kept[*op]) continue;
+            int type = b->insts[*op].type;
+            added |= !b->undef[type];
+            *op = ir_undef(b, type);
+        }
+    }
+    return added;
+}
+
+static uint32_t ir_out_extra(struct ir_function *fn, uint32_t n) {
+    fn->extra = ir_reserve(fn->extra, &fn->extra_capacity, fn->extra_count + n,
+                           sizeof(uint32_t));
+    uint32_t at = fn->extra_count;
+    fn->extra_count += n;
+    return at;
+}
+
+// Copies the list of values at `list` of the builder's extra to the
+// function, renumbered.
+static uint32_t ir_out_values(struct ir_builder *b, uint32_t list) {
+    struct ir_function *fn = b->fn;
+    uint32_t count = b->extra[list];
+    uint32_t out = ir_out_extra(fn, count + 1);
+    fn->extra[out] = count;
+    for (uint32_t i = 0; i < count; i++)
+        fn->extra[out + 1 + i] = b->scratch[b->extra[list + 1 + i]];
+    return out;
+}
+
+static uint32_t ir_out_block(struct ir_builder *b, uint32_t block) {
+    return b->blocks[block].index - 1;
+}
+
+static struct ir_inst ir_out_inst(struct ir_builder *b, uint32_t v) {
+    struct ir_function *fn = b->fn;
+    const uint32_t *renumber = b->scratch;
+    struct ir_inst inst = b->insts[v];
+    switch (ir_ops[inst.op].form) {
+    case IR_FORM_UNARY:
+        inst.a = renumber[inst.a];
+        break;
+    case IR_FORM_BINARY:
+        inst.a = renumber[inst.a];
+        inst.b = renumber[inst.b];
+        break;
+    case IR_FORM_CALL:
+        inst.a = renumber[inst.a];
+        inst.b = ir_out_values(b, inst.b);
+        break;
+    case IR_FORM_PHI:
+        inst.a = ir_out_values(b, inst.a);
+        break;
+    case IR_FORM_JUMP:
+        inst.a = ir_out_block(b, inst.a);
+        break;
+    case IR_FORM_BRANCH: {
+        inst.a = renumber[inst.a];
+        uint32_t cases = inst.op == IR_SWITCH ? b->extra[inst.b] : 0;
+        uint32_t size = inst.op == IR_SWITCH ? 2 + 3 * cases : 2;
+        uint32_t out = ir_out_extra(fn, size);
+        // the targets of a branch, or the count and the targets of a switch
+        // followed by its values.
+        uint32_t first = inst.op == IR_SWITCH;
+        uint32_t end = inst.op == IR_SWITCH ? cases + 2 : 2;
+        for (uint32_t i = 0; i < size; i++) {
+            uint32_t item = b->extra[inst.b + i];
+            fn->extra[out + i] =
+                i >= first && i < end ? ir_out_block(b, item) : item;
+        }
+        inst.b = out;
+        break;
+    }
+    }
+    return inst;
+}
+
+void ir_builder_finish(struct ir_builder *b) {
+    struct ir_function *fn = b->fn;
+    for (uint32_t i = 0; i < b->block_count; i++) {
+        ir_seal_block(b, i);
+        // only unreachable blocks end without a terminator.
+        if (!b->blocks[i].terminated) {
+            b->current = i;
+            ir_return(b, IR_VOID, 0);
+        }
+    }
+
+    ir_mark_reachable(b);
+    for (uint32_t i = 0; i < b->block_count; i++)
+        if (b->blocks[i].index) ir_filter_phis(b, i);
+    ir_remove_trivial(b);
+
+    uint32_t n = ir_layout(b);
+    if (ir_undefine_dropped(b, n)) {
+        for (uint32_t i = 0; i < b->block_count; i++)
+            b->blocks[i].index = b->blocks[i].index != 0;
+        n = ir_layout(b);
+    }
+
+    // new number of each value kept.
+    uint32_t *renumber = b->scratch = ir_reserve(
+        b->scratch, &b->scratch_capacity, b->count, sizeof(uint32_t));
+    renumber[0] = 0;
+    for (uint32_t i = 0; i < n; i++) renumber[b->order[i]] = i + 1;
+
+    fn->count = n + 1;
+    fn->insts = ir_reserve(fn->insts, &fn->capacity, fn->count,
+                           sizeof(struct ir_inst));
+    fn->block_count = 0;
+    for (uint32_t i = 0; i < b->block_count; i++)
+        if (b->blocks[i].index) fn->block_count++;
+    fn->blocks = ir_reserve(fn->blocks, &fn->block_capacity, fn->block_count,
+                            sizeof(struct ir_block));
+
+    uint32_t at = 1;
+    for (uint32_t block = 0; block < b->block_count; block++) {
+        struct ir_build_block *bb = &b->blocks[block];
+        if (!bb->index) continue;
+        struct ir_block *out = &fn->blocks[bb->index - 1];
+
+        // the predecessors which can be reached, in the order of the phi
+        // operands.
+        out->preds = ir_out_extra(fn, 1);
+        for (uint32_t e = bb->pred_first; e; e = b->edges[e].next) {
+            uint32_t from = b->edges[e].from;
+            if (!b->blocks[from].index) continue;
+            uint32_t pred = ir_out_extra(fn, 1);
+            fn->extra[pred] = ir_out_block(b, from);
+        }
+        fn->extra[out->preds] = fn->extra_count - out->preds - 1;
+
+        out->first = at;
+        if (block == 0)
+            for (uint32_t v = b->entry_first; v; v = b->next[v])
+                fn->insts[at++] = ir_out_inst(b, v);
+        for (uint32_t v = bb->phi_first; v; v = b->next[v])
+            if (!b->alias[v]) fn->insts[at++] = ir_out_inst(b, v);
+        out->body = at;
+        for (uint32_t v = bb->first; v; v = b->next[v])
+            fn->insts[at++] = ir_out_inst(b, v);
+        out->end = at;
+    }
+    fn->uses_valid = false;
+}
+
+struct ir_builder *ir_builder_create(void) {
+    struct ir_builder *b = calloc(1, sizeof(struct ir_builder));
+    ir_map_init(&b->defs);
+    return b;
+}
+
+void ir_builder_free(struct ir_builder *b) {
+    free(b->insts);
+    free(b->next);
+    free(b->alias);
+    free(b->blocks);
+    free(b->edges);
+    free(b->extra);
+    free(b->scratch);
+    free(b->order);
+    ir_map_free(&b->defs);
+    free(b);
+}
@@ -0,0 +1,345 @@
+#ifndef PEACHIR_H
+#define PEACHIR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// SSA form of one function, laid out for passes that stream over it.
+//
+// Instructions live in a single array and are the values they define: a
+// value id is the index of its instruction, operands are 32-bit value ids.
+// Instruction 0 is reserved, an operand of 0 means "none". Blocks are index
+// ranges of the array in layout order, each starting with its phis and
+// ending with its terminator. Operands that don't fit in ir_inst::a and
+// ir_inst::b, call arguments, phi operands and branch targets, are lists in
+// ir_function::extra holding their count followed by the items, like the
+// lists of the AST. Who uses a value is only known once ir_uses builds the
+// use lists, passes that don't need them never pay for them.
+//
+// An ir_function holds one function at a time: it's reset before the next
+// one is built into it and its arrays are reused, the memory a compile needs
+// for its IR is that of its largest function.
+
+// Types of the values, the width of the integer they hold. Values of fewer
+// than 64 bits leave the upper bits of their register undefined.
+enum {
+    IR_VOID,
+    IR_I8,
+    IR_I16,
+    IR_I32,
+    IR_I64,
+};
+
+// Opcodes, see ir_inst. Unless told otherwise operands and result have the
+// instruction's type.
+enum {
+    IR_NONE,
+
+    // `a` | `b` << 32 is the value.
+    IR_CONST,
+    // parameter number `a`, in the entry block.
+    IR_PARAM,
+    // any value, read of a variable before it's written.
+    IR_UNDEF,
+    // address of a stack slot of `a` bytes aligned to `b`, in the entry
+    // block.
+    IR_SLOT,
+    // address of the function or variable declared by the AST node `a`.
+    IR_GLOBAL,
+    // address of the NODE_STRING `a`.
+    IR_STRING,
+
+    // `a`.
+    IR_COPY,
+    IR_NEG,
+    IR_NOT,
+    // `a` sign or zero extended, or truncated, to the instruction's type.
+    IR_SEXT,
+    IR_ZEXT,
+    IR_TRUNC,
+    // loads the value at address `a`.
+    IR_LOAD,
+
+    IR_ADD,
+    IR_SUB,
+    IR_MUL,
+    IR_SDIV,
+    IR_UDIV,
+    IR_SREM,
+    IR_UREM,
+    IR_AND,
+    IR_OR,
+    IR_XOR,
+    IR_SHL,
+    IR_SHR,
+    IR_SAR,
+    // comparisons of `a` and `b` of the instruction's type, the result is an
+    // IR_I32 of 0 or 1.
+    IR_EQ,
+    IR_NE,
+    IR_LT,
+    IR_LE,
+    IR_GT,
+    IR_GE,
+    IR_ULT,
+    IR_ULE,
+    IR_UGT,
+    IR_UGE,
+    // stores `b` of the instruction's type at address `a`.
+    IR_STORE,
+
+    // calls the address `a` with the argument list `b`. The instruction's
+    // type is that of the result, IR_VOID if there is none.
+    IR_CALL,
+    // one operand per predecessor of the block in the order of
+    // ir_block::preds, `a` is the list.
+    IR_PHI,
+
+    // Terminators.
+    // jumps to block `a`.
+    IR_JUMP,
+    // jumps to extra[b] if `a`, of the instruction's type, isn't 0, to
+    // extra[b + 1] otherwise.
+    IR_BRANCH,
+    // multiway jump on `a`. extra[b] is the amount of cases, extra[b + 1] the
+    // default block, followed by the block of each case and then by the
+    // value of each case as its low and high 32 bits.
+    IR_SWITCH,
+    // returns `a`, 0 if there is no value.
+    IR_RET,
+
+    IR_OP_COUNT
+};
+
+// ir_inst::flags
+enum {
+    // IR_CALL of a variadic function.
+    IR_FLAG_VARIADIC = 0b0001,
+    // comparison only used by the IR_BRANCH right after it, which jumps on
+    // the flags it sets instead of its value.
+    IR_FLAG_FUSED = 0b0010,
+};
+
+struct ir_inst {
+    uint8_t op;
+    uint8_t type;
+    uint16_t flags;
+    uint32_t a;
+    uint32_t b;
+};
+
+_Static_assert(sizeof(struct ir_inst) == 12, "IR instructions must stay 12 bytes");
+
+struct ir_block {
+    // instructions [first, end), phis are [first, body).
+    uint32_t first;
+    uint32_t body;
+    uint32_t end;
+    // list of the predecessor blocks, a block reached by several edges of
+    // the same terminator is listed once per edge.
+    uint32_t preds;
+};
+
+struct ir_function {
+    // AST node of the function and its name.
+    uint32_t node;
+    const char *name;
+
+    struct ir_inst *insts;
+    uint32_t count;
+    uint32_t capacity;
+
+    // block 0 is the entry, no jump leads to it.
+    struct ir_block *blocks;
+    uint32_t block_count;
+    uint32_t block_capacity;
+
+    uint32_t *extra;
+    uint32_t extra_count;
+    uint32_t extra_capacity;
+
+    // instructions using each value, see ir_uses.
+    uint32_t *use_first;
+    uint32_t *uses;
+    uint32_t use_capacity;
+    uint32_t use_first_capacity;
+    bool uses_valid;
+};
+
+void ir_function_init(struct ir_function *fn);
+void ir_function_free(struct ir_function *fn);
+// Drops the function's IR, the storage is kept for the next function.
+void ir_function_reset(struct ir_function *fn);
+
+static inline struct ir_inst *ir_inst(struct ir_function *fn, uint32_t v) {
+    return &fn->insts[v];
+}
+
+// Returns the items of the list at `list` and writes their amount to `count`.
+static inline uint32_t *ir_list(struct ir_function *fn, uint32_t list,
+                                uint32_t *count) {
+    *count = fn->extra[list];
+    return &fn->extra[list + 1];
+}
+
+static inline bool ir_is_terminator(int op) {
+    return op >= IR_JUMP;
+}
+
+const char *ir_op_name(int op);
+
+// Amount of value operands of `v`, and where the i-th of them is stored so
+// passes can replace it. Block and immediate operands aren't counted.
+uint32_t ir_operand_count(struct ir_function *fn, uint32_t v);
+uint32_t *ir_operand(struct ir_function *fn, uint32_t v, uint32_t i);
+
+// Returns the successors of `block` and writes their amount to `count`.
+uint32_t *ir_successors(struct ir_function *fn, uint32_t block,
+                        uint32_t *count);
+
+// Returns the instructions using `v`, once per use, and writes their amount
+// to `count`. The use lists of the whole function are built by the first
+// call, passes changing operands must clear ir_function::uses_valid.
+uint32_t *ir_uses(struct ir_function *fn, uint32_t v, uint32_t *count);
+
+// Prints the function in a readable form, for debugging.
+void ir_print(struct ir_function *fn, FILE *out);
+
+// Maps 64-bit keys to 32-bit values. Clearing it is O(1), entries of an
+// older generation count as empty.
+struct ir_map {
+    struct ir_map_entry {
+        uint64_t key;
+        uint32_t value;
+        uint32_t generation;
+    } *entries;
+    // power of two.
+    uint32_t capacity;
+    uint32_t count;
+    uint32_t generation;
+};
+
+void ir_map_init(struct ir_map *map);
+void ir_map_free(struct ir_map *map);
+void ir_map_clear(struct ir_map *map);
+// Makes `map` hold the entries of `from`.
+void ir_map_copy(struct ir_map *map, struct ir_map *from);
+// Returns the value of `key`, 0 if it has none.
+uint32_t ir_map_get(struct ir_map *map, uint64_t key);
+void ir_map_set(struct ir_map *map, uint64_t key, uint32_t value);
+
+// Builds an ir_function in SSA form while the source is walked once, as in
+// "Simple and Efficient Construction of Static Single Assignment Form"
+// (Braun et al.): variables are read and written by id and the builder
+// places the phis. A block is sealed once all its predecessors are known,
+// reads in a block that isn't sealed yet get a phi completed when it is.
+//
+// Instructions are chained per block while building, blocks may be filled in
+// any order. ir_builder_finish lays them out in the function, drops the
+// blocks which can't be reached and the phis which turned out to be
+// trivial, and renumbers the values.
+struct ir_builder {
+    struct ir_function *fn;
+
+    // instructions in the order they were made, values index them until
+    // the function is laid out.
+    struct ir_inst *insts;
+    // next instruction of the same block.
+    uint32_t *next;
+    // value replacing a trivial phi, 0 for the others.
+    uint32_t *alias;
+    uint32_t count;
+    uint32_t capacity;
+
+    struct ir_build_block {
+        // chains of the phis and the other instructions.
+        uint32_t first;
+        uint32_t last;
+        uint32_t phi_first;
+        uint32_t phi_last;
+        // chain of the edges leading to the block in builder::edges.
+        uint32_t pred_first;
+        uint32_t pred_last;
+        uint32_t pred_count;
+        bool sealed;
+        bool terminated;
+        // scratch of ir_builder_finish.
+        uint32_t index;
+    } *blocks;
+    uint32_t block_count;
+    uint32_t block_capacity;
+
+    struct ir_edge {
+        uint32_t from;
+        uint32_t next;
+    } *edges;
+    uint32_t edge_count;
+    uint32_t edge_capacity;
+
+    uint32_t *extra;
+    uint32_t extra_count;
+    uint32_t extra_capacity;
+
+    // parameters, slots and undefined values, laid out first in the entry
+    // block.
+    uint32_t entry_first;
+    uint32_t entry_last;
+    // IR_UNDEF of each type, made on first use.
+    uint32_t undef[IR_I64 + 1];
+
+    // block instructions are added to.
+    uint32_t current;
+
+    // value of each (variable, block) written or read so far.
+    struct ir_map defs;
+
+    // scratch of ir_builder_finish.
+    uint32_t *scratch;
+    uint32_t scratch_capacity;
+    uint32_t *order;
+    uint32_t order_capacity;
+};
+
+struct ir_builder *ir_builder_create(void);
+void ir_builder_free(struct ir_builder *b);
+
+// Starts building into `fn`, which is reset. The entry block is made, sealed
+// and current.
+void ir_builder_begin(struct ir_builder *b, struct ir_function *fn);
+// Lays out the function built, see ir_builder. Blocks left unsealed are
+// sealed first.
+void ir_builder_finish(struct ir_builder *b);
+
+uint32_t ir_new_block(struct ir_builder *b);
+// Makes `block` current, it must not be terminated.
+void ir_set_block(struct ir_builder *b, uint32_t block);
+void ir_seal_block(struct ir_builder *b, uint32_t block);
+// True once the current block has its terminator.
+bool ir_terminated(struct ir_builder *b);
+
+// Appends an instruction to the current block and returns its value. Code
+// following a terminator goes to a new block nothing jumps to.
+uint32_t ir_emit(struct ir_builder *b, int op, int type, uint32_t a,
+                 uint32_t operand_b);
+uint32_t ir_emit_const(struct ir_builder *b, int type, int64_t value);
+uint32_t ir_emit_call(struct ir_builder *b, int type, uint32_t callee,
+                      const uint32_t *args, uint32_t count, int flags);
+// Adds an IR_PARAM or IR_SLOT to the entry block.
+uint32_t ir_emit_entry(struct ir_builder *b, int op, int type, uint32_t a,
+                       uint32_t operand_b);
+
+// Terminators of the current block.
+void ir_jump(struct ir_builder *b, uint32_t target);
+void ir_branch(struct ir_builder *b, uint32_t cond, uint32_t then_block,
+               uint32_t else_block);
+void ir_return(struct ir_builder *b, int type, uint32_t value);
+void ir_switch(struct ir_builder *b, int type, uint32_t value,
+               uint32_t default_block, const int64_t *values,
+               const uint32_t *blocks, uint32_t count);
+
+// Variables are named by any id other than 0 and hold values of one type.
+void ir_write_var(struct ir_builder *b, uint32_t var, uint32_t value);
+uint32_t ir_read_var(struct ir_builder *b, uint32_t var, int type);
+
+#endif  // PEACHIR_H
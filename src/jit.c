@@ -0,0 +1,211 @@
+#include "jit.h"
+
+#include <dlfcn.h>
+#include <elf.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Bytes of each stub, a `jmp [rip + entry]` padded.
+#define JIT_STUB_SIZE 8
+
+extern char **environ;
+
+// Functions of libc the shared library doesn't export, every program links
+// them statically from libc_nonshared.a. Those of this process are used.
+static const struct {
+    const char *name;
+    void *address;
+} jit_nonshared[] = {
+    {"atexit", (void *)atexit},
+    {"at_quick_exit", (void *)at_quick_exit},
+    {"pthread_atfork", (void *)pthread_atfork},
+};
+
+static size_t jit_align(size_t offset, size_t align) {
+    return (offset + align - 1) & ~(align - 1);
+}
+
+// Address of `symbol`, looked up in the process the first time if the
+// object doesn't define it. Returns false after reporting if there is none.
+static bool jit_resolve(struct jit *jit, uint32_t symbol) {
+    if (jit->addresses[symbol]) return true;
+    const char *name = object_symbol_name(jit->object, symbol);
+    for (size_t i = 0; i < sizeof(jit_nonshared) / sizeof(*jit_nonshared); i++)
+        if (!strcmp(jit_nonshared[i].name, name))
+            jit->addresses[symbol] = jit_nonshared[i].address;
+    if (!jit->addresses[symbol])
+        jit->addresses[symbol] = dlsym(RTLD_DEFAULT, name);
+    if (!jit->addresses[symbol]) {
+        fprintf(stderr, "Undefined symbol '%s'\n", name);
+        return false;
+    }
+    jit->got[symbol] = jit->addresses[symbol];
+    return true;
+}
+
+static bool jit_relocate(struct jit *jit, int section,
+                         struct object_reloc *reloc) {
+    uint8_t *place = jit->sections[section] + reloc->offset;
+    uint32_t symbol = reloc->symbol;
+    if (!jit_resolve(jit, symbol)) return false;
+    uint8_t *target = jit->addresses[symbol];
+    switch (reloc->type) {
+    case R_X86_64_64: {
+        uint64_t value = (uint64_t)(target + reloc->addend);
+        memcpy(place, &value, 8);
+        return true;
+    }
+    case R_X86_64_PLT32:
+        // calls out of the object go through the stub.
+        if (!jit->object->symbols[symbol].section)
+            target = jit->stubs + symbol * JIT_STUB_SIZE;
+        break;
+    case R_X86_64_GOTPCREL:
+    case R_X86_64_GOTPCRELX:
+    case R_X86_64_REX_GOTPCRELX:
+        target = (uint8_t *)&jit->got[symbol];
+        break;
+    case R_X86_64_PC32:
+        break;
+    default:
+        fprintf(stderr, "Unsupported relocation %u against '%s'\n",
+                reloc->type, object_symbol_name(jit->object, symbol));
+        return false;
+    }
+    int64_t value = target + reloc->addend - place;
+    if (value != (int32_t)value) {
+        fprintf(stderr, "Relocation against '%s' out of reach\n",
+                object_symbol_name(jit->object, symbol));
+        return false;
+    }
+    int32_t disp = value;
+    memcpy(place, &disp, 4);
+    return true;
+}
+
+struct jit *jit_load(struct object *object) {
+    struct jit *jit = calloc(1, sizeof(struct jit));
+    jit->object = object;
+    uint32_t count = object->symbol_count;
+    jit->addresses = calloc(count, sizeof(uint8_t *));
+    struct object_section *sections = object->sections;
+
+    // the code and the stubs, the read-only data and the GOT, then the
+    // writable data, each run on pages of its own.
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t offsets[OBJECT_SECTION_COUNT];
+    offsets[OBJECT_TEXT] = 0;
+    size_t stubs = jit_align(sections[OBJECT_TEXT].size, 16);
+    size_t code_size = stubs + count * JIT_STUB_SIZE;
+    offsets[OBJECT_RODATA] = jit_align(code_size, page);
+    offsets[OBJECT_STRINGS] =
+        offsets[OBJECT_RODATA] + sections[OBJECT_RODATA].size;
+    size_t got =
+        jit_align(offsets[OBJECT_STRINGS] + sections[OBJECT_STRINGS].size, 8);
+    size_t read_only_end = got + count * sizeof(uint8_t *);
+    offsets[OBJECT_DATA] = jit_align(read_only_end, page);
+    offsets[OBJECT_BSS] =
+        jit_align(offsets[OBJECT_DATA] + sections[OBJECT_DATA].size,
+                  sections[OBJECT_BSS].align);
+    jit->size =
+        jit_align(offsets[OBJECT_BSS] + sections[OBJECT_BSS].size, page);
+
+    void *memory = mmap(NULL, jit->size, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        perror("Error mapping the program");
+        jit_free(jit);
+        return NULL;
+    }
+    jit->memory = memory;
+    jit->stubs = jit->memory + stubs;
+    jit->got = (uint8_t **)(jit->memory + got);
+
+    // .bss is left to the zeros of the mapping.
+    for (int i = 1; i < OBJECT_SECTION_COUNT; i++) {
+        jit->sections[i] = jit->memory + offsets[i];
+        if (sections[i].type != SHT_NOBITS)
+            memcpy(jit->sections[i], buffer_ptr(&sections[i].data),
+                   buffer_len(&sections[i].data));
+    }
+    for (uint32_t i = 1; i < count; i++) {
+        struct object_symbol *s = &object->symbols[i];
+        if (!s->section) continue;
+        jit->addresses[i] = jit->sections[s->section] + s->value;
+        jit->got[i] = jit->addresses[i];
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        // jmp [rip + disp32] to the GOT entry.
+        uint8_t *stub = jit->stubs + i * JIT_STUB_SIZE;
+        int32_t disp = (int32_t)((uint8_t *)&jit->got[i] - (stub + 6));
+        stub[0] = 0xff;
+        stub[1] = 0x25;
+        memcpy(stub + 2, &disp, 4);
+        stub[6] = stub[7] = 0xcc;
+    }
+
+    for (int i = 1; i < OBJECT_SECTION_COUNT; i++)
+        for (uint32_t r = 0; r < sections[i].reloc_count; r++)
+            if (!jit_relocate(jit, i, &sections[i].relocs[r])) {
+                jit_free(jit);
+                return NULL;
+            }
+
+    if (mprotect(jit->memory, offsets[OBJECT_RODATA], PROT_READ | PROT_EXEC) ||
+        mprotect(jit->sections[OBJECT_RODATA],
+                 offsets[OBJECT_DATA] - offsets[OBJECT_RODATA], PROT_READ)) {
+        perror("Error protecting the program");
+        jit_free(jit);
+        return NULL;
+    }
+    return jit;
+}
+
+void jit_free(struct jit *jit) {
+    if (jit->memory) munmap(jit->memory, jit->size);
+    free(jit->addresses);
+    free(jit);
+}
+
+void *jit_symbol(struct jit *jit, const char *name) {
+    struct object *object = jit->object;
+    for (uint32_t i = 1; i < object->symbol_count; i++) {
+        struct object_symbol *s = &object->symbols[i];
+        if (s->section && s->type != OBJECT_SECTION &&
+            !strcmp(object_symbol_name(object, i), name))
+            return jit->addresses[i];
+    }
+    return NULL;
+}
+
+int jit_run(struct jit *jit, int argc, char **argv, bool isolated) {
+    int (*entry)(int, char **, char **) = jit_symbol(jit, "main");
+    if (!entry) {
+        fprintf(stderr, "No main function to run\n");
+        return -1;
+    }
+    if (!isolated) return entry(argc, argv, environ);
+
+    // the child would write what's buffered again.
+    fflush(NULL);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("Error forking the program");
+        return -1;
+    }
+    if (pid == 0) exit(entry(argc, argv, environ));
+    int status;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno == EINTR) continue;
+        perror("Error waiting for the program");
+        return -1;
+    }
+    if (WIFSIGNALED(status)) return 128 + WTERMSIG(status);
+    return WEXITSTATUS(status);
+}
@@ -0,0 +1,53 @@
+#ifndef PEACHJIT_H
+#define PEACHJIT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "object.h"
+
+// Runs the object of a compile straight from memory, without writing it,
+// assembling or linking: what the system linker and loader do for the
+// object is done here in a single pass over its relocations.
+//
+// The sections are laid out in one mapping, in three runs of pages: the
+// code, then the read-only data, then the writable data and .bss. The
+// symbols the object doesn't define are looked up in the process with
+// dlsym, libc and whatever else the process was linked with. Each gets a
+// GOT entry and a stub jumping through it, both next to the code: a shared
+// library may be mapped further away than a 32-bit displacement reaches. The
+// mapping is writable while it's relocated and never executable at the same
+// time, the code is made executable and the read-only data read-only once
+// everything is patched.
+struct jit {
+    uint8_t *memory;
+    size_t size;
+    // address of each section of the object.
+    uint8_t *sections[OBJECT_SECTION_COUNT];
+    // symbols of the object, and their address once defined or resolved.
+    struct object *object;
+    uint8_t **addresses;
+    // GOT entry and stub of each symbol by index, the stubs are only used
+    // for the undefined ones.
+    uint8_t **got;
+    uint8_t *stubs;
+};
+
+// Loads `object`, which must stay alive as long as the jit. Returns NULL
+// after reporting on stderr if a symbol it uses can't be resolved, a
+// relocation doesn't reach or the memory can't be mapped.
+struct jit *jit_load(struct object *object);
+void jit_free(struct jit *jit);
+
+// Address of the symbol `name` the object defines, NULL if it defines none.
+void *jit_symbol(struct jit *jit, const char *name);
+
+// Calls main of the object with `argc` and `argv`, in a child process if
+// `isolated` is set, and returns its exit status: what main returns or
+// passes to exit, 128 plus the signal which killed the child. In the
+// process itself an exit of the program exits the process. Returns -1
+// after reporting on stderr if there is no main or no child can be forked.
+int jit_run(struct jit *jit, int argc, char **argv, bool isolated);
+
+#endif  // PEACHJIT_H
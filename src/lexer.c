@@ -3,39 +3,65 @@
 #include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
-#include "../helpers/buffer.h"
+#include "../helpers/segvector.h"
+#include "../helpers/utf8.h"
 #include "../helpers/vector.h"
 #include "lexer_token.h"
+#include "preprocessor.h"
+#include "token_stream.h"
 
-void lex_error(struct lexer *lex, enum lex_errors e) {
-    printf("[ERROR]: ");
+static const char *lex_error_message(enum lex_errors e) {
     switch (e) {
         case LEXICAL_ANALYSIS_INPUT_ERROR:
-            printf("Lexical analysis input error\n");
-            break;
-        case LEXICAL_ANALYSIS_INVALID_JOINED_OPERATOR:
-            printf("Invalid joined operator\n");
-            break;
+            return "Lexical analysis input error";
         case LEXICAL_ANALYSIS_INVALID_EXPR_CLOSE:
-            printf(
-                "Invalid expression closure, did you close an expression that "
-                "was not opened?\n");
-            break;
+            return "Invalid expression closure, did you close an expression "
+                   "that was not opened?";
         case LEXICAL_ANALYSIS_MULTILINE_COMMENT_NOT_CLOSED:
-            printf("Multiline comment not closed\n");
-            break;
+            return "Multiline comment not closed";
         case LEXICAL_ANALYSIS_QUOTE_NOT_CLOSED:
-            printf("Quote not closed\n");
-            break;
+            return "Quote not closed";
+        case LEXICAL_ANALYSIS_INVALID_NUMBER:
+            return "Invalid numeric literal";
+        case LEXICAL_ANALYSIS_NUMBER_TOO_LARGE:
+            return "Integer literal is too large for any integer type";
+        case LEXICAL_ANALYSIS_STRING_NOT_CLOSED:
+            return "String not closed";
+        case LEXICAL_ANALYSIS_INVALID_ESCAPE:
+            return "Invalid escape sequence";
+        case LEXICAL_ANALYSIS_INVALID_UTF8:
+            return "Source is not valid UTF-8";
+        case LEXICAL_ANALYSIS_BRACKET_MISMATCH:
+            return "Bracket closes a different kind of bracket";
+        case LEXICAL_ANALYSIS_BRACKET_NOT_CLOSED:
+            return "Bracket not closed";
         default:
-            printf("Unknown error\n");
-            break;
+            return "Unknown error";
     }
+}
 
+void lex_error(struct lexer *lex, enum lex_errors e) {
+    printf("[ERROR]: %s\n", lex_error_message(e));
     printf("Lexical error at line: %d, col: %d at file: %s\n", lex->pos.line,
            lex->pos.col, lex->pos.filename);
-    exit(-1);
+    compiler_fail(lex->compiler);
+}
+
+// Reports LEXICAL_ANALYSIS_BRACKET_MISMATCH at `close`, with both brackets
+// and where the one it doesn't match was opened.
+static void lex_bracket_error(struct lexer *lex, struct token *open,
+                              struct token *close) {
+    printf("[ERROR]: %s, '%c' does not close '%c'\n",
+           lex_error_message(LEXICAL_ANALYSIS_BRACKET_MISMATCH), close->cval,
+           open->type == TOKEN_TYPE_SYMBOL ? open->cval
+                                           : *operator_spelling(open->op));
+    printf("Lexical error at line: %d, col: %d at file: %s\n",
+           close->pos.line, close->pos.col, lex->pos.filename);
+    printf("Opening bracket at line: %d, col: %d\n", open->pos.line,
+           open->pos.col);
+    compiler_fail(lex->compiler);
 }
 
 // LEXER Characters //
@@ -53,7 +79,10 @@ void lex_error(struct lexer *lex, enum lex_errors e) {
 
 #define WHITESPACE_CASE \
     case ' ':           \
-    case '\t'
+    case '\t':          \
+    case '\r':          \
+    case '\f':          \
+    case '\v'
 
 #define OPERATOR_OR_COMMENT_CASE \
     case '+':                    \
@@ -81,7 +110,6 @@ void lex_error(struct lexer *lex, enum lex_errors e) {
     case ':':       \
     case ';':       \
     case '#':       \
-    case '\\':      \
     case ')':       \
     case ']'
 
@@ -89,122 +117,324 @@ void lex_error(struct lexer *lex, enum lex_errors e) {
 
 #define NEWLINE_CASE case '\n'
 
-#define COMMENT_CASE case '/'
-
 #define QUOTE_CASE case '\''
 
-#define EOF_CASE case EOF
+#define EOF_CASE case LEXER_EOF
+
+#define SPLICE_CASE case '\\'
 
 #define DEFAULT_CASE default
 
 struct lexer *lexer_create(struct compiler *c) {
     struct lexer *l = calloc(1, sizeof(struct lexer));
     l->compiler = c;
+    l->token_vec = segvector_create(sizeof(struct token));
+    l->raw_tokens = segvector_create(sizeof(struct token));
+    l->bracket_stack = vector_create(sizeof(int));
+    l->trivia = vector_create(sizeof(struct trivia));
+    l->preprocessor = preprocessor_create(l);
     return l;
 };
 
-bool valid_identifier_char(char c) { return (isalpha(c) || c == '_'); }
+// Releases the tokens of a previous run, keeping the token storage.
+static void lexer_release_tokens(struct lexer *lexer) {
+    for (int i = 0; i < segvector_count(lexer->token_vec); i++)
+        token_release(segvector_at(lexer->token_vec, i));
+    segvector_clear(lexer->token_vec);
+    for (int i = 0; i < segvector_count(lexer->raw_tokens); i++)
+        token_release(segvector_at(lexer->raw_tokens, i));
+    segvector_clear(lexer->raw_tokens);
+}
+
+void lexer_free(struct lexer *lexer) {
+    lexer_release_tokens(lexer);
+    segvector_free(lexer->token_vec);
+    segvector_free(lexer->raw_tokens);
+    vector_free(lexer->bracket_stack);
+    vector_free(lexer->trivia);
+    preprocessor_free(lexer->preprocessor);
+    if (lexer->stream) token_stream_free(lexer->stream);
+    free(lexer);
+}
 
 // peeks at the next char in the stream the lexer is parsing.
 // the char will indicate what token to create and if it does not we exit
-// our program with an unrecognized character error.
+// our program with an unrecognized character error. Trivia are skipped until
+// a token or the end of the stream is found.
 struct token *lexer_read_next_token(struct lexer *lexer) {
-    struct token *tok = NULL;
-    signed char c = lexer_peek_char(lexer);
-    switch (c) {
-    NUMERIC_CASE:
-        tok = token_number_create(lexer);
-        break;
-    STRING_CASE:
-        tok = token_string_create(lexer);
-        break;
-    OPERATOR_OR_COMMENT_CASE: {
-        // handle '/' indicating a comment, not the division operator
-        if (c == '/') {
-            // discard the first '/' since we need to read the next char
-            lexer_next_char(lexer);
-            // peek at the next char, can be '/' and '*' if its a comment, any
-            // other value indicates its a division operator
-            char next_c = lexer_peek_char(lexer);
-            if (next_c == '/' || next_c == '*') {
-                tok = token_comment_create(lexer);
+    struct token *tok;
+    const char *start;
+    for (;;) {
+        start = lexer->cur;
+        int c = lexer_peek_char(lexer);
+        switch (c) {
+        NUMERIC_CASE:
+            tok = token_number_create(lexer);
+            break;
+        STRING_CASE:
+            tok = token_string_create(lexer);
+            break;
+        OPERATOR_OR_COMMENT_CASE: {
+            // '.' followed by a digit starts a floating literal such as '.5'
+            if (c == '.' && isdigit(lexer_peek_char_at(lexer, 1))) {
+                tok = token_number_create(lexer);
                 break;
             }
-            // its not a comment, but we moved the lexer one past the original
-            // '/' operator, we push it back onto the stream, since
-            // `token_operator_create` expects the lexer to ready to read the
-            // current operator.
-            lexer_push_char(lexer, '/');
+            // handle '/' indicating a comment, not the division operator
+            if (c == '/') {
+                int next_c = lexer_peek_char_at(lexer, 1);
+                if (next_c == '/' || next_c == '*') {
+                    trivia_comment_read(lexer);
+                    continue;
+                }
+            }
+            tok = token_operator_create(lexer);
+            break;
+        }
+        SYMBOL_CASE:
+            tok = token_symbol_create(lexer);
+            break;
+        NEWLINE_CASE:
+            trivia_newline_read(lexer);
+            continue;
+        WHITESPACE_CASE:
+            trivia_whitespace_read(lexer);
+            continue;
+        QUOTE_CASE:
+            tok = token_quote_create(lexer);
+            break;
+        EOF_CASE:
+            // parsing done...
+            return NULL;
+        SPLICE_CASE:
+            if (trivia_splice_read(lexer)) continue;
+            // a backslash on its own is no token.
+            // fall through
+        DEFAULT_CASE:
+            if (token_identifier_start(lexer)) {
+                tok = token_identifier_create(lexer);
+                break;
+            }
+
+            // we peeked at the char to find an unhandled token, so we need to
+            // increment the lexers col to get the accurate col unknown token
+            // is at
+            lexer->pos.col += 1;
+            lex_error(lexer, LEXICAL_ANALYSIS_INPUT_ERROR);
         }
-        tok = token_operator_create(lexer);
         break;
     }
-    SYMBOL_CASE:
-        tok = token_symbol_create(lexer);
-        break;
-    NEWLINE_CASE:
-        tok = token_newline_create(lexer);
-        break;
-    WHITESPACE_CASE: {
-        // last read token needs indication that white space was next
-        struct token *last_token = vector_back_or_null(lexer->token_vec);
-        last_token->whitespace = true;
-        // discard this token
-        lexer_next_char(lexer);
-        // recurse here so this function still returns the next token,
-        // if you return NULL here iteration would stop prematurely.
-        return lexer_read_next_token(lexer);
-    } break;
-    QUOTE_CASE:
-        tok = token_quote_create(lexer);
-        break;
-    EOF_CASE:
-        // parsing done...
-        return NULL;
-    DEFAULT_CASE:
-        if (valid_identifier_char(c))
-            return tok = token_identifier_create(lexer);
-
-        // we peeked at the char to find an unhandled token, so we need to
-        // increment the lexers col to get the accurate col unknown token
-        // is at
-        lexer->pos.col += 1;
-        lex_error(lexer, LEXICAL_ANALYSIS_INPUT_ERROR);
+
+    tok->spelling = start;
+    tok->spelling_len = lexer->cur - start;
+    if (lexer->line_start) {
+        tok->flags |= TOKEN_FLAG_AT_LINE_START;
+        lexer->line_start = false;
     }
+    if (lexer->whitespace_before) {
+        tok->flags |= TOKEN_FLAG_WHITESPACE_BEFORE;
+        lexer->whitespace_before = false;
+    }
+    lexer->header_name_next =
+        tok->type == TOKEN_TYPE_KEYWORD && strcmp(tok->sval, "include") == 0;
     return tok;
 }
 
-int lexer_lex(struct lexer *lexer) {
-    lexer->current_expression_count = 0;
-    lexer->parantheses_buffer = NULL;
+struct token *lexer_lex_spelling(struct lexer *lexer, const char *text,
+                                 size_t len, struct pos pos) {
+    struct lexer saved = *lexer;
+    lexer->cur = text;
+    lexer->end = text + len;
+    lexer->pos = pos;
+    lexer->line_start = false;
+    lexer->whitespace_before = false;
+    lexer->header_name_next = false;
+    // the text isn't part of the source as written.
+    lexer->recording = false;
+
+    struct token *tok = lexer_read_next_token(lexer);
+    // trivia within the text, '//' for example, don't make a token either.
+    if (tok && (lexer->cur != lexer->end ||
+                (tok->flags & TOKEN_FLAG_WHITESPACE_BEFORE))) {
+        token_release(tok);
+        free(tok);
+        tok = NULL;
+    }
+
+    lexer->cur = saved.cur;
+    lexer->end = saved.end;
+    lexer->pos = saved.pos;
+    lexer->line_start = saved.line_start;
+    lexer->whitespace_before = saved.whitespace_before;
+    lexer->header_name_next = saved.header_name_next;
+    lexer->recording = saved.recording;
+    return tok;
+}
+
+void lexer_advance_to(struct lexer *lexer, const char *p) {
+    const char *newline;
+    while ((newline = memchr(lexer->cur, '\n', p - lexer->cur))) {
+        lexer->pos.line += 1;
+        lexer->pos.col = 1;
+        lexer->cur = newline + 1;
+    }
+    lexer->pos.col += (int)(p - lexer->cur);
+    lexer->cur = p;
+}
+
+// Returns the character closing the bracket `tok` opens, 0 if `tok` is not an
+// opening bracket.
+static char lexer_opening_bracket(struct token *tok) {
+    if (tok->type == TOKEN_TYPE_OPERATOR) {
+        if (tok->op == OPERATOR_LEFT_PAREN) return ')';
+        if (tok->op == OPERATOR_LEFT_BRACKET) return ']';
+    } else if (tok->type == TOKEN_TYPE_SYMBOL && tok->cval == '{') {
+        return '}';
+    }
+    return 0;
+}
+
+static bool lexer_closing_bracket(struct token *tok) {
+    return tok->type == TOKEN_TYPE_SYMBOL &&
+           (tok->cval == ')' || tok->cval == ']' || tok->cval == '}');
+}
+
+// Pushes the block of lexer::token_vec holding the tokens just before `end`
+// to the stream.
+static void lexer_publish(struct lexer *lexer, int end) {
+    struct token_batch batch = {
+        .tokens = segvector_at(lexer->token_vec,
+                               (end - 1) & ~SEGVECTOR_BLOCK_MASK),
+        .end = end,
+    };
+    token_stream_push(lexer->stream, batch);
+}
+
+// Pushes `token` onto the token vector, linking brackets to their match.
+static void lexer_push_token(struct lexer *lexer, struct token *token) {
+    int index = segvector_count(lexer->token_vec);
+    token->bracket_match = -1;
+    if (token->flags & TOKEN_FLAG_WHITESPACE_BEFORE) {
+        struct token *last = segvector_back_or_null(lexer->token_vec);
+        if (last) last->whitespace = true;
+    }
+
+    if (lexer_opening_bracket(token)) {
+        vector_push(lexer->bracket_stack, &index);
+    } else if (lexer_closing_bracket(token)) {
+        int *open_index = vector_back_or_null(lexer->bracket_stack);
+        if (!open_index) {
+            lexer->pos = token->pos;
+            free(token);
+            lex_error(lexer, LEXICAL_ANALYSIS_INVALID_EXPR_CLOSE);
+        }
+
+        struct token *open = segvector_at(lexer->token_vec, *open_index);
+        if (lexer_opening_bracket(open) != token->cval) {
+            struct token close = *token;
+            free(token);
+            lex_bracket_error(lexer, open, &close);
+        }
+        // the opening bracket may already be in the parser's hands, see
+        // parser_bracket_match.
+        __atomic_store_n(&open->bracket_match, index, __ATOMIC_RELAXED);
+        token->bracket_match = *open_index;
+        vector_pop(lexer->bracket_stack);
+    }
+
+    segvector_push(lexer->token_vec, token);
+
+    // the block before is done once a token lands in the next one, the
+    // whitespace flag of its last token was set above.
+    if (lexer->streaming && index && !(index & SEGVECTOR_BLOCK_MASK))
+        lexer_publish(lexer, index);
+}
+
+// Moves the lexer to the start of the source.
+static void lexer_rewind(struct lexer *lexer) {
+    lexer->line_start = true;
+    lexer->whitespace_before = false;
+    lexer->header_name_next = false;
+    lexer->pos = lexer->compiler->pos;
     lexer->pos.filename = lexer->compiler->cfile.abs_path;
-    lexer->token_vec = vector_create(sizeof(struct token));
-    struct token *token = lexer_read_next_token(lexer);
-    while (token) {
-        vector_push(lexer->token_vec, token);
-        token = lexer_read_next_token(lexer);
+    lexer->cur = lexer->compiler->cfile.data;
+    lexer->end = lexer->cur + lexer->compiler->cfile.len;
+}
+
+int lexer_lex(struct lexer *lexer) {
+    lexer_release_tokens(lexer);
+    vector_clear(lexer->bracket_stack);
+    vector_clear(lexer->trivia);
+    preprocessor_reset(lexer->preprocessor);
+    lexer->recording = lexer->compiler->flags & COMPILER_FLAG_LEX_TOOLING;
+    lexer_rewind(lexer);
+
+    // the whole source is validated up front, from here on every non ASCII
+    // byte is known to be part of a well formed UTF-8 sequence.
+    size_t invalid;
+    if (!utf8_validate(lexer->cur, lexer->end - lexer->cur, &invalid)) {
+        lexer_advance_to(lexer, lexer->cur + invalid);
+        lex_error(lexer, LEXICAL_ANALYSIS_INVALID_UTF8);
     }
+
+    struct token *token;
+    while ((token = preprocessor_next_token(lexer->preprocessor))) {
+        // the token is copied into the token vector, the heap token is no
+        // longer needed.
+        lexer_push_token(lexer, token);
+        free(token);
+    }
+
+    // trailing trivia still count as whitespace after the last token.
+    struct token *last = segvector_back_or_null(lexer->token_vec);
+    if (last && lexer->whitespace_before) last->whitespace = true;
+
+    if (!vector_empty(lexer->bracket_stack)) {
+        // the outermost bracket left open is the most helpful to report.
+        struct token *open =
+            segvector_at(lexer->token_vec, *(int *)vector_at(lexer->bracket_stack, 0));
+        lexer->pos = open->pos;
+        lex_error(lexer, LEXICAL_ANALYSIS_BRACKET_NOT_CLOSED);
+    }
+
+    int count = segvector_count(lexer->token_vec);
+    if (lexer->streaming && count) lexer_publish(lexer, count);
     return LEXICAL_ANALYSIS_ALL_OK;
 };
 
-void lexer_new_expression(struct lexer *lexer) {
-    lexer->current_expression_count++;
-    if (lexer->current_expression_count == 1)
-        lexer->parantheses_buffer = buffer_create();
+static void *lexer_thread_main(void *arg) {
+    struct lexer *lexer = arg;
+    jmp_buf jmp;
+    if (setjmp(jmp)) {
+        // reported already, the parser only needs to know the tokens end.
+        compiler_catch_errors(NULL);
+        token_stream_close(lexer->stream, LEXICAL_ANALYSIS_INPUT_ERROR);
+        return NULL;
+    }
+    compiler_catch_errors(&jmp);
+    int result = lexer_lex(lexer);
+    compiler_catch_errors(NULL);
+    token_stream_close(lexer->stream, result);
+    return NULL;
 }
 
-bool lexer_in_expression(struct lexer *lexer) {
-    return lexer->current_expression_count > 0;
+void lexer_lex_start(struct lexer *lexer) {
+    if (!lexer->stream) lexer->stream = token_stream_create();
+    token_stream_reset(lexer->stream);
+    lexer->streaming = true;
+    pthread_create(&lexer->stream->thread, NULL, lexer_thread_main, lexer);
 }
 
-void lexer_finish_expression(struct lexer *lexer) {
-    lexer->current_expression_count--;
-    if (lexer->current_expression_count < 0)
-        lex_error(lexer, LEXICAL_ANALYSIS_INVALID_EXPR_CLOSE);
+int lexer_lex_join(struct lexer *lexer) {
+    pthread_join(lexer->stream->thread, NULL);
+    lexer->streaming = false;
+    return lexer->stream->result;
 }
 
-char lexer_next_char(struct lexer *lexer) {
-    char c = getc(lexer->compiler->cfile.fp);
+int lexer_next_char(struct lexer *lexer) {
+    if (lexer->cur == lexer->end) return LEXER_EOF;
+
+    unsigned char c = *lexer->cur++;
     lexer->pos.col += 1;
     if (c == '\n') {
         lexer->pos.line += 1;
@@ -212,11 +442,11 @@ char lexer_next_char(struct lexer *lexer) {
     }
     return c;
 };
-char lexer_peek_char(struct lexer *lexer) {
-    char c = getc(lexer->compiler->cfile.fp);
-    lexer_push_char(lexer, c);
-    return c;
+int lexer_peek_char(struct lexer *lexer) {
+    if (lexer->cur == lexer->end) return LEXER_EOF;
+    return (unsigned char)*lexer->cur;
 };
-void lexer_push_char(struct lexer *lexer, char c) {
-    ungetc(c, lexer->compiler->cfile.fp);
+int lexer_peek_char_at(struct lexer *lexer, int offset) {
+    if (lexer->end - lexer->cur <= offset) return LEXER_EOF;
+    return (unsigned char)lexer->cur[offset];
 };
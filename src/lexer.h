@@ -7,10 +7,16 @@
 
 enum lex_errors {
     LEXICAL_ANALYSIS_ALL_OK,
-    LEXICAL_ANALYSIS_INVALID_JOINED_OPERATOR,
 	LEXICAL_ANALYSIS_INVALID_EXPR_CLOSE,
 	LEXICAL_ANALYSIS_MULTILINE_COMMENT_NOT_CLOSED,
 	LEXICAL_ANALYSIS_QUOTE_NOT_CLOSED,
+	LEXICAL_ANALYSIS_INVALID_NUMBER,
+	LEXICAL_ANALYSIS_NUMBER_TOO_LARGE,
+	LEXICAL_ANALYSIS_STRING_NOT_CLOSED,
+	LEXICAL_ANALYSIS_INVALID_ESCAPE,
+	LEXICAL_ANALYSIS_INVALID_UTF8,
+	LEXICAL_ANALYSIS_BRACKET_MISMATCH,
+	LEXICAL_ANALYSIS_BRACKET_NOT_CLOSED,
     LEXICAL_ANALYSIS_INPUT_ERROR
 };
 
@@ -21,8 +27,109 @@ enum {
     TOKEN_TYPE_SYMBOL,
     TOKEN_TYPE_NUMBER,
     TOKEN_TYPE_STRING,
-    TOKEN_TYPE_COMMENT,
-    TOKEN_TYPE_NEWLINE,
+};
+
+enum {
+    // token::sval points into the source being lexed instead of memory owned
+    // by the token.
+    TOKEN_FLAG_BORROWED_SVAL = 0b00000001,
+    // the token is the first of its line, preprocessing directives are
+    // recognized by a '#' with this flag.
+    TOKEN_FLAG_AT_LINE_START = 0b00000010,
+    // whitespace, a comment or a newline precedes the token.
+    TOKEN_FLAG_WHITESPACE_BEFORE = 0b00000100,
+    // identifier the preprocessor must never expand, it named a macro while
+    // that macro was being expanded.
+    TOKEN_FLAG_NO_EXPAND = 0b00001000,
+};
+
+// Types of struct trivia.
+enum {
+    // run of spaces, tabs, carriage returns, form feeds and vertical tabs.
+    TRIVIA_WHITESPACE,
+    TRIVIA_NEWLINE,
+    // single line or multiline comment, including its delimiters.
+    TRIVIA_COMMENT,
+    // group of a conditional which isn't taken, up to the directive ending
+    // it. It's never tokenized.
+    TRIVIA_INACTIVE,
+    // backslash newline, the lines on either side of it are one line.
+    TRIVIA_SPLICE,
+};
+
+// Source text between tokens, recorded with COMPILER_FLAG_LEX_TOOLING.
+struct trivia {
+    int type;
+    // index of the token the trivia precedes in lexer::raw_tokens, the token
+    // count for trivia after the last token.
+    int token_index;
+    int line;
+    int col;
+    // span of the source, not NULL terminated.
+    const char *text;
+    size_t len;
+};
+
+// Types of TOKEN_TYPE_NUMBER tokens, stored in token::number_type.
+// Integer types keep their value in token::llnum, floating types in
+// token::dval.
+enum {
+    NUMBER_TYPE_INT,
+    NUMBER_TYPE_UNSIGNED_INT,
+    NUMBER_TYPE_LONG,
+    NUMBER_TYPE_UNSIGNED_LONG,
+    NUMBER_TYPE_LONG_LONG,
+    NUMBER_TYPE_UNSIGNED_LONG_LONG,
+    NUMBER_TYPE_FLOAT,
+    NUMBER_TYPE_DOUBLE,
+    // long double literals are held with double precision.
+    NUMBER_TYPE_LONG_DOUBLE,
+};
+
+// Operators of TOKEN_TYPE_OPERATOR tokens, stored in token::op.
+enum {
+    OPERATOR_NONE,
+    OPERATOR_PLUS,                // +
+    OPERATOR_MINUS,               // -
+    OPERATOR_STAR,                // *
+    OPERATOR_SLASH,               // /
+    OPERATOR_PERCENT,             // %
+    OPERATOR_LESS,                // <
+    OPERATOR_GREATER,             // >
+    OPERATOR_ASSIGN,              // =
+    OPERATOR_NOT,                 // !
+    OPERATOR_TILDE,               // ~
+    OPERATOR_AMPERSAND,           // &
+    OPERATOR_PIPE,                // |
+    OPERATOR_CARET,               // ^
+    OPERATOR_QUESTION,            // ?
+    OPERATOR_COMMA,               // ,
+    OPERATOR_DOT,                 // .
+    OPERATOR_LEFT_PAREN,          // (
+    OPERATOR_LEFT_BRACKET,        // [
+    OPERATOR_INCREMENT,           // ++
+    OPERATOR_DECREMENT,           // --
+    OPERATOR_ARROW,               // ->
+    OPERATOR_PLUS_ASSIGN,         // +=
+    OPERATOR_MINUS_ASSIGN,        // -=
+    OPERATOR_STAR_ASSIGN,         // *=
+    OPERATOR_SLASH_ASSIGN,        // /=
+    OPERATOR_PERCENT_ASSIGN,      // %=
+    OPERATOR_LESS_EQUAL,          // <=
+    OPERATOR_GREATER_EQUAL,       // >=
+    OPERATOR_EQUAL,               // ==
+    OPERATOR_NOT_EQUAL,           // !=
+    OPERATOR_LOGICAL_AND,         // &&
+    OPERATOR_LOGICAL_OR,          // ||
+    OPERATOR_SHIFT_LEFT,          // <<
+    OPERATOR_SHIFT_RIGHT,         // >>
+    OPERATOR_AMPERSAND_ASSIGN,    // &=
+    OPERATOR_PIPE_ASSIGN,         // |=
+    OPERATOR_CARET_ASSIGN,        // ^=
+    OPERATOR_SHIFT_LEFT_ASSIGN,   // <<=
+    OPERATOR_SHIFT_RIGHT_ASSIGN,  // >>=
+    OPERATOR_ELLIPSIS,            // ...
+    OPERATOR_COUNT
 };
 
 struct token {
@@ -32,60 +139,145 @@ struct token {
 
     union {
         char cval;
+        int op;
         const char *sval;
         unsigned int inum;
         unsigned long lnum;
         unsigned long long llnum;
+        double dval;
         void *any;
     };
 
+    // NUMBER_TYPE_* of a TOKEN_TYPE_NUMBER token.
+    int number_type;
+
+    // Length of sval for TOKEN_TYPE_STRING tokens. A borrowed string is not
+    // NULL terminated and a decoded one may contain NULL characters, so
+    // consumers must use this length instead of strlen.
+    size_t slen;
+
+    // Source text of the token, not NULL terminated. Points into the source
+    // or, for tokens made by the preprocessor, into preprocessor storage.
+    const char *spelling;
+    size_t spelling_len;
+
     // True if their is whitespace between next token.
     bool whitespace;
 
-    // Points to string between two brackets.
-    // e.g: (10+20+30)
-    //       ^ char *between_brackets points to first char within the brackets
-    // useful for debugging
-    const char *between_brackets;
+    // Index in lexer::token_vec of the matching bracket for '(', '[', '{'
+    // and their closing counterparts, -1 for any other token.
+    // e.g: f(a[1], b)
+    //       ^      ^ both refer to each other, a whole bracketed range can be
+    // skipped in one step.
+    int bracket_match;
 };
 
 struct lexer {
     struct pos pos;
-    struct vector *token_vec;
+    // Lexed tokens, element addresses are stable so a struct token* taken
+    // from this vector stays valid while more tokens are pushed.
+    struct segvector *token_vec;
     struct compiler *compiler;
 
-    int current_expression_count;
-    struct buffer *parantheses_buffer;
+    // source being lexed, `cur` points at the next character to read.
+    const char *cur;
+    const char *end;
+
+    // Indices of the opening brackets not closed yet, innermost last.
+    struct vector *bracket_stack;
+
+    // tokens of the source as written, directives and macro uses included,
+    // and the struct trivia between them in source order, see lexer_trivia.
+    // Only the tooling profile records them, the parser reads the
+    // preprocessed token_vec with either profile.
+    struct segvector *raw_tokens;
+    struct vector *trivia;
+    // true while tokens and trivia read from the source are recorded.
+    bool recording;
+    // true until the first token of the current line is read.
+    bool line_start;
+    // true if trivia were skipped since the last token was read.
+    bool whitespace_before;
+    // true right after the include keyword, a '<' starts a header name.
+    bool header_name_next;
+
+    // expands macros and runs directives between reading and pushing tokens
+    // to token_vec.
+    struct preprocessor *preprocessor;
+
+    // tokens are handed to the parser through it while lexing on a thread of
+    // its own, see lexer_lex_start. Kept for the next run.
+    struct token_stream *stream;
+    // true while lexer_lex runs on the stream's thread.
+    bool streaming;
 
     void *private;
 };
 
 struct lexer *lexer_create(struct compiler *c);
+void lexer_free(struct lexer *lexer);
 
 // Start lexing the file configured for the lexer's embedded compiler instance.
+// Tokens of a previous run are released first, their storage is reused.
 // Returns LEXICAL_ANALYSIS_ALL_OK if no errors were encountered.
-// Any errors will OS exit our compiler with details on stderr.
+// Any errors are reported on stderr and fail the compile, see compiler_fail.
 int lexer_lex(struct lexer *lexer);
 
-// Start a new expression.
-void lexer_new_expression(struct lexer *lexer);
-// Informs the caller if the lexer is currently in an expression.
-bool lexer_in_expression(struct lexer *lexer);
-// Finishes the current expression.
-void lexer_finish_expression(struct lexer *lexer);
+// Runs lexer_lex on a thread of its own. Every block of lexer::token_vec is
+// pushed to lexer::stream once it's complete, the parser consumes the tokens
+// while the rest of the source is lexed, see parser_parse_stream.
+// Errors are reported by the lexing thread.
+void lexer_lex_start(struct lexer *lexer);
+// Waits for the lexing thread, returns what lexer_lex returned or
+// LEXICAL_ANALYSIS_INPUT_ERROR if it failed. The stream must have been read
+// to its end, the lexer waits for the parser whenever the stream is full.
+int lexer_lex_join(struct lexer *lexer);
+
+// Reads the next token of the source, skipping trivia. Returns a heap token
+// owned by the caller or NULL at the end of the source. No preprocessing is
+// done.
+struct token *lexer_read_next_token(struct lexer *lexer);
+
+// Lexes the `len` characters at `text` as a single token as if they were found
+// at `pos`, the lexer's position is kept. Returns NULL if `text` isn't exactly
+// one token. Used to re-lex the result of token pasting, the token borrows
+// from `text` like it would from the source.
+struct token *lexer_lex_spelling(struct lexer *lexer, const char *text,
+                                 size_t len, struct pos pos);
+
+// Skips a conditional group which isn't taken, up to the line of the #elif,
+// #else or #endif ending it. Nested conditionals are skipped whole and
+// nothing is tokenized. Skipping starts at `first`, a token read at the start
+// of a line, or at the lexer's position if NULL. Returns false if the source
+// ends first.
+bool lexer_skip_group(struct lexer *lexer, const struct token *first);
+
+// Returned by the character functions below once the end of the stream is
+// reached. Characters are returned as unsigned char values, so LEXER_EOF never
+// collides with a byte of the source, UTF-8 bytes included.
+#define LEXER_EOF -1
 
 // Returns the next character of the file stream the lexer is currently parsing,
 // moving the lexer to the next character in the stream.
-char lexer_next_char(struct lexer *lexer);
+int lexer_next_char(struct lexer *lexer);
 // Returns the next character of the file stream the lexer is currently parsing,
 // without moving the lexer to the next character in the stream.
-char lexer_peek_char(struct lexer *lexer);
-// Pushes a character back onto the lexer's stream.
-// The character is only pushed to the in-memory stream and does not result int
-// any write to the file being lexed.
-void lexer_push_char(struct lexer *lexer, char c);
+int lexer_peek_char(struct lexer *lexer);
+// Returns the character `offset` characters past the next character, without
+// moving the lexer. Returns LEXER_EOF past the end of the stream.
+int lexer_peek_char_at(struct lexer *lexer, int offset);
+// Moves the lexer forward to `p`, which must be on or after the lexer's
+// position, keeping track of the lines passed.
+void lexer_advance_to(struct lexer *lexer, const char *p);
+
+// Returns the trivia preceding the token at `token_index` of
+// lexer::raw_tokens and writes their amount to `count`. The trivia after the
+// last token are found at the token count. Trivia are only recorded with
+// COMPILER_FLAG_LEX_TOOLING.
+struct trivia *lexer_trivia(struct lexer *lexer, int token_index, int *count);
 
-// Write an error to stderr for the given lexer error enum and exit the process.
+// Write an error to stderr for the given lexer error enum and fail the
+// compile.
 void lex_error(struct lexer *lex, enum lex_errors e);
 
 #endif  // PEACHLEXER_H
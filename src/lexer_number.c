@@ -0,0 +1,359 @@
+#include <ctype.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../helpers/buffer.h"
+#include "lexer.h"
+#include "lexer_token.h"
+
+// Numeric literals are scanned straight out of the in-memory source instead
+// of character by character, decimal digits are consumed eight at a time with
+// SWAR arithmetic.
+
+// Exact powers of ten representable by a double.
+static const double number_exact_powers_of_ten[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+#define NUMBER_MAX_EXACT_POWER_OF_TEN 22
+// Largest integer every smaller integer of is exactly representable by a
+// double.
+#define NUMBER_MAX_EXACT_MANTISSA (1ULL << 53)
+
+// True if all eight bytes of `chunk` are ASCII digits.
+static bool number_is_eight_digits(uint64_t chunk) {
+    return (((chunk & 0xF0F0F0F0F0F0F0F0ULL) |
+             (((chunk + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >>
+              4)) == 0x3333333333333333ULL);
+}
+
+// Converts eight ASCII digits, loaded little endian, to their value.
+// Neighbouring digits are combined into 2, then 4, then 8 digit values with
+// three multiplications instead of eight.
+static uint32_t number_parse_eight_digits(uint64_t chunk) {
+    const uint64_t mask = 0x000000FF000000FFULL;
+    const uint64_t mul1 = 0x000F424000000064ULL;  // 100 + (1000000 << 32)
+    const uint64_t mul2 = 0x0000271000000001ULL;  // 1 + (10000 << 32)
+    chunk -= 0x3030303030303030ULL;
+    chunk = (chunk * 10) + (chunk >> 8);
+    chunk = (((chunk & mask) * mul1) + (((chunk >> 16) & mask) * mul2)) >> 32;
+    return (uint32_t)chunk;
+}
+
+// Accumulates the decimal digits starting at `p` into `value`.
+// Sets `overflow` if the value no longer fits 64 bits and `digits` to the
+// amount of digits consumed. Returns the first non digit.
+static const char *number_scan_decimal(const char *p, const char *end,
+                                       uint64_t *value, int *digits,
+                                       bool *overflow) {
+    const char *start = p;
+    while (end - p >= 8) {
+        uint64_t chunk;
+        memcpy(&chunk, p, sizeof(chunk));
+        if (!number_is_eight_digits(chunk)) break;
+
+        uint64_t scaled;
+        if (__builtin_mul_overflow(*value, 100000000ULL, &scaled) ||
+            __builtin_add_overflow(scaled, number_parse_eight_digits(chunk),
+                                   value))
+            *overflow = true;
+        p += 8;
+    }
+
+    while (p < end && isdigit((unsigned char)*p)) {
+        uint64_t scaled;
+        if (__builtin_mul_overflow(*value, 10, &scaled) ||
+            __builtin_add_overflow(scaled, (uint64_t)(*p - '0'), value))
+            *overflow = true;
+        p++;
+    }
+
+    *digits += (int)(p - start);
+    return p;
+}
+
+static int number_digit_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return 16;
+}
+
+// Accumulates digits of a power of two `base` starting at `p`.
+// Returns the first character which isn't a digit of `base`.
+static const char *number_scan_power_of_two(const char *p, const char *end,
+                                            int base, int bits_per_digit,
+                                            uint64_t *value, bool *overflow) {
+    while (p < end) {
+        int digit = number_digit_value(*p);
+        if (digit >= base) break;
+        if (*value >> (64 - bits_per_digit)) *overflow = true;
+        *value = (*value << bits_per_digit) | digit;
+        p++;
+    }
+    return p;
+}
+
+// Skips an exponent such as 'e-10' or 'p+3', returns NULL if the exponent has
+// no digits. `exponent` receives its value, saturated so it can't overflow.
+static const char *number_scan_exponent(const char *p, const char *end,
+                                        int *exponent) {
+    // skip 'e' or 'p'
+    p++;
+    int sign = 1;
+    if (p < end && (*p == '+' || *p == '-')) {
+        if (*p == '-') sign = -1;
+        p++;
+    }
+
+    if (p == end || !isdigit((unsigned char)*p)) return NULL;
+
+    int value = 0;
+    while (p < end && isdigit((unsigned char)*p)) {
+        if (value < 100000) value = value * 10 + (*p - '0');
+        p++;
+    }
+    *exponent = sign * value;
+    return p;
+}
+
+// Moves the lexer to `p`, numeric literals never span lines.
+// The literal must not run into an identifier or another literal, e.g. '12abc'
+// or '1.2.3'.
+static void number_consume(struct lexer *l, const char *p) {
+    if (p < l->end && (isalnum((unsigned char)*p) || *p == '_' || *p == '.'))
+        lex_error(l, LEXICAL_ANALYSIS_INVALID_NUMBER);
+
+    l->pos.col += (int)(p - l->cur);
+    l->cur = p;
+}
+
+// Converts the floating literal spelled by [start, end) to a double.
+// The exactly representable case is handled with one multiplication or
+// division, which IEEE arithmetic rounds correctly, everything else goes
+// through strtod/strtof which round correctly as well.
+static double number_convert_floating(const char *start, const char *end,
+                                      bool is_float, bool exact,
+                                      uint64_t mantissa, int exponent) {
+    if (exact && !is_float && mantissa <= NUMBER_MAX_EXACT_MANTISSA &&
+        exponent >= -NUMBER_MAX_EXACT_POWER_OF_TEN &&
+        exponent <= NUMBER_MAX_EXACT_POWER_OF_TEN) {
+        double value = (double)mantissa;
+        if (exponent < 0)
+            return value / number_exact_powers_of_ten[-exponent];
+        return value * number_exact_powers_of_ten[exponent];
+    }
+
+    struct buffer buf;
+    buffer_init(&buf);
+    buffer_write_bytes(&buf, start, end - start);
+    buffer_write(&buf, '\0');
+    double value = is_float ? (double)strtof(buffer_ptr(&buf), NULL)
+                            : strtod(buffer_ptr(&buf), NULL);
+    buffer_release(&buf);
+    return value;
+}
+
+// Scans a floating literal whose integer part [start, p) has already been
+// consumed, `p` points at '.', or the exponent character.
+static const char *number_scan_floating(struct lexer *l, struct token *tok,
+                                        const char *start, const char *p,
+                                        bool hex, uint64_t mantissa,
+                                        bool overflow) {
+    const char *end = l->end;
+    int exponent = 0;
+    int fraction_digits = 0;
+
+    if (p < end && *p == '.') {
+        p++;
+        if (hex) {
+            while (p < end && number_digit_value(*p) < 16) p++;
+        } else {
+            p = number_scan_decimal(p, end, &mantissa, &fraction_digits,
+                                    &overflow);
+        }
+    }
+
+    // hex floating literals require an exponent, decimal ones may have one.
+    char exponent_char = hex ? 'p' : 'e';
+    if (p < end && tolower((unsigned char)*p) == exponent_char) {
+        p = number_scan_exponent(p, end, &exponent);
+        if (!p) lex_error(l, LEXICAL_ANALYSIS_INVALID_NUMBER);
+    } else if (hex) {
+        lex_error(l, LEXICAL_ANALYSIS_INVALID_NUMBER);
+    }
+    const char *spelling_end = p;
+
+    tok->number_type = NUMBER_TYPE_DOUBLE;
+    if (p < end && (*p == 'f' || *p == 'F')) {
+        tok->number_type = NUMBER_TYPE_FLOAT;
+        p++;
+    } else if (p < end && (*p == 'l' || *p == 'L')) {
+        tok->number_type = NUMBER_TYPE_LONG_DOUBLE;
+        p++;
+    }
+
+    bool exact = !hex && !overflow;
+    tok->dval = number_convert_floating(
+        start, spelling_end, tok->number_type == NUMBER_TYPE_FLOAT, exact,
+        mantissa, exponent - fraction_digits);
+    return p;
+}
+
+enum {
+    NUMBER_SUFFIX_NONE = 0,
+    NUMBER_SUFFIX_UNSIGNED = 1 << 0,
+    NUMBER_SUFFIX_LONG = 1 << 1,
+    NUMBER_SUFFIX_LONG_LONG = 1 << 2,
+};
+
+// Parses an integer suffix, returns NULL if the suffix is malformed.
+static const char *number_scan_integer_suffix(const char *p, const char *end,
+                                              int *suffix) {
+    *suffix = NUMBER_SUFFIX_NONE;
+    for (int parts = 0; parts < 2 && p < end; parts++) {
+        if ((*p == 'u' || *p == 'U') && !(*suffix & NUMBER_SUFFIX_UNSIGNED)) {
+            *suffix |= NUMBER_SUFFIX_UNSIGNED;
+            p++;
+        } else if ((*p == 'l' || *p == 'L') &&
+                   !(*suffix & (NUMBER_SUFFIX_LONG | NUMBER_SUFFIX_LONG_LONG))) {
+            // 'll' and 'LL' are allowed, 'lL' is not.
+            if (end - p >= 2 && p[1] == p[0]) {
+                *suffix |= NUMBER_SUFFIX_LONG_LONG;
+                p += 2;
+            } else {
+                *suffix |= NUMBER_SUFFIX_LONG;
+                p++;
+            }
+        } else {
+            break;
+        }
+    }
+    return p;
+}
+
+static bool number_fits(int number_type, uint64_t value) {
+    switch (number_type) {
+        case NUMBER_TYPE_INT:
+            return value <= INT_MAX;
+        case NUMBER_TYPE_UNSIGNED_INT:
+            return value <= UINT_MAX;
+        case NUMBER_TYPE_LONG:
+            return value <= LONG_MAX;
+        case NUMBER_TYPE_UNSIGNED_LONG:
+            return value <= ULONG_MAX;
+        case NUMBER_TYPE_LONG_LONG:
+            return value <= LLONG_MAX;
+        default:
+            return true;
+    }
+}
+
+// Picks the first type of the C11 6.4.4.1 candidate list for the suffix
+// which can represent `value`. Unsuffixed and 'l' decimal literals never
+// become unsigned. Returns -1 if no candidate fits.
+static int number_integer_type(uint64_t value, int suffix, bool decimal) {
+    // candidate lists terminated by -1, picked below by suffix and base.
+    static const int candidates[][7] = {
+        {NUMBER_TYPE_INT, NUMBER_TYPE_UNSIGNED_INT, NUMBER_TYPE_LONG,
+         NUMBER_TYPE_UNSIGNED_LONG, NUMBER_TYPE_LONG_LONG,
+         NUMBER_TYPE_UNSIGNED_LONG_LONG, -1},
+        {NUMBER_TYPE_INT, NUMBER_TYPE_LONG, NUMBER_TYPE_LONG_LONG, -1},
+        {NUMBER_TYPE_UNSIGNED_INT, NUMBER_TYPE_UNSIGNED_LONG,
+         NUMBER_TYPE_UNSIGNED_LONG_LONG, -1},
+        {NUMBER_TYPE_LONG, NUMBER_TYPE_UNSIGNED_LONG, NUMBER_TYPE_LONG_LONG,
+         NUMBER_TYPE_UNSIGNED_LONG_LONG, -1},
+        {NUMBER_TYPE_LONG, NUMBER_TYPE_LONG_LONG, -1},
+        {NUMBER_TYPE_UNSIGNED_LONG, NUMBER_TYPE_UNSIGNED_LONG_LONG, -1},
+        {NUMBER_TYPE_LONG_LONG, NUMBER_TYPE_UNSIGNED_LONG_LONG, -1},
+        {NUMBER_TYPE_LONG_LONG, -1},
+        {NUMBER_TYPE_UNSIGNED_LONG_LONG, -1},
+    };
+
+    const int *list;
+    bool is_unsigned = suffix & NUMBER_SUFFIX_UNSIGNED;
+    if (suffix & NUMBER_SUFFIX_LONG_LONG)
+        list = is_unsigned ? candidates[8] : candidates[decimal ? 7 : 6];
+    else if (suffix & NUMBER_SUFFIX_LONG)
+        list = is_unsigned ? candidates[5] : candidates[decimal ? 4 : 3];
+    else
+        list = is_unsigned ? candidates[2] : candidates[decimal ? 1 : 0];
+
+    for (; *list != -1; list++) {
+        if (number_fits(*list, value)) return *list;
+    }
+    return -1;
+}
+
+// Copies the scanned token to the heap, the token is only allocated once the
+// literal is known to be valid so a lexical error can't leak it.
+static struct token *number_token_finish(struct token *scanned) {
+    struct token *tok = malloc(sizeof(struct token));
+    *tok = *scanned;
+    return tok;
+}
+
+struct token *token_number_create(struct lexer *l) {
+    struct token scanned = {0};
+    struct token *tok = &scanned;
+    tok->type = TOKEN_TYPE_NUMBER;
+    tok->pos = l->pos;
+
+    const char *start = l->cur;
+    const char *end = l->end;
+    const char *p = start;
+    uint64_t value = 0;
+    bool overflow = false;
+    bool decimal = true;
+
+    if (end - p >= 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+        decimal = false;
+        const char *digits = p + 2;
+        p = number_scan_power_of_two(digits, end, 16, 4, &value, &overflow);
+        bool has_digits = p != digits;
+        if (p < end && (*p == '.' || *p == 'p' || *p == 'P')) {
+            p = number_scan_floating(l, tok, start, p, true, value, overflow);
+            number_consume(l, p);
+            return number_token_finish(tok);
+        }
+        if (!has_digits) lex_error(l, LEXICAL_ANALYSIS_INVALID_NUMBER);
+    } else if (end - p >= 2 && p[0] == '0' && (p[1] == 'b' || p[1] == 'B')) {
+        decimal = false;
+        const char *digits = p + 2;
+        p = number_scan_power_of_two(digits, end, 2, 1, &value, &overflow);
+        if (p == digits) lex_error(l, LEXICAL_ANALYSIS_INVALID_NUMBER);
+    } else {
+        // decimal digits are scanned even for a leading '0' since '0123.5' is
+        // a decimal floating literal, only once we know it isn't floating is
+        // it reparsed as octal.
+        int digits = 0;
+        p = number_scan_decimal(p, end, &value, &digits, &overflow);
+        if (p < end && (*p == '.' || *p == 'e' || *p == 'E')) {
+            p = number_scan_floating(l, tok, start, p, false, value, overflow);
+            number_consume(l, p);
+            return number_token_finish(tok);
+        }
+
+        if (start[0] == '0' && digits > 1) {
+            decimal = false;
+            value = 0;
+            overflow = false;
+            const char *octal = number_scan_power_of_two(start + 1, p, 8, 3,
+                                                         &value, &overflow);
+            if (octal != p) lex_error(l, LEXICAL_ANALYSIS_INVALID_NUMBER);
+        }
+    }
+
+    int suffix;
+    p = number_scan_integer_suffix(p, end, &suffix);
+    int number_type = number_integer_type(value, suffix, decimal);
+    if (overflow || number_type < 0)
+        lex_error(l, LEXICAL_ANALYSIS_NUMBER_TOO_LARGE);
+
+    number_consume(l, p);
+    tok->number_type = number_type;
+    tok->llnum = value;
+    return number_token_finish(tok);
+}
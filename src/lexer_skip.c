@@ -0,0 +1,168 @@
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "lexer.h"
+#include "lexer_token.h"
+
+// Groups of a conditional which aren't taken are skipped without being
+// tokenized. Only the start of each line is looked at for a '#', the rest of
+// the line is scanned for the few characters which could hide a newline or
+// a directive: quotes, comments and backslash newline continuations.
+
+static bool skip_is_blank(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v';
+}
+
+static bool skip_is_name_char(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+           (c >= '0' && c <= '9') || c == '_';
+}
+
+// Returns the first newline, quote, '/' or backslash in [p, end), or `end`.
+static const char *skip_find_special(const char *p, const char *end) {
+#ifdef __SSE2__
+    const __m128i newlines = _mm_set1_epi8('\n');
+    const __m128i quotes = _mm_set1_epi8('"');
+    const __m128i apostrophes = _mm_set1_epi8('\'');
+    const __m128i slashes = _mm_set1_epi8('/');
+    const __m128i backslashes = _mm_set1_epi8('\\');
+    while (end - p >= 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)p);
+        __m128i hits = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, newlines),
+                         _mm_cmpeq_epi8(chunk, quotes)),
+            _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, apostrophes),
+                                      _mm_cmpeq_epi8(chunk, slashes)),
+                         _mm_cmpeq_epi8(chunk, backslashes)));
+        int mask = _mm_movemask_epi8(hits);
+        if (mask) return p + __builtin_ctz(mask);
+        p += 16;
+    }
+#endif
+    while (p < end && *p != '\n' && *p != '"' && *p != '\'' && *p != '/' &&
+           *p != '\\')
+        p++;
+    return p;
+}
+
+// Returns the end of the multiline comment opened at `p`, or `end` if it's
+// never closed.
+static const char *skip_comment(const char *p, const char *end) {
+    for (p += 2; (p = memchr(p, '*', end - p)); p++)
+        if (p + 1 < end && p[1] == '/') return p + 2;
+    return end;
+}
+
+// Skips blanks, comments and backslash newlines without leaving the line, a
+// multiline comment may span lines but doesn't end the line it started on.
+static const char *skip_blanks(const char *p, const char *end) {
+    for (;;) {
+        while (p < end && skip_is_blank(*p)) p++;
+        size_t splice = trivia_splice_length(p, end);
+        if (splice) {
+            p += splice;
+            continue;
+        }
+        if (end - p < 2 || p[0] != '/') return p;
+        if (p[1] == '*')
+            p = skip_comment(p, end);
+        else if (p[1] == '/') {
+            const char *newline = memchr(p, '\n', end - p);
+            return newline ? newline : end;
+        } else
+            return p;
+    }
+}
+
+// Returns the end of the character or string literal opened at `p`. A literal
+// left open in an inactive group ends with its line.
+static const char *skip_literal(const char *p, const char *end) {
+    char delim = *p++;
+    while (p < end && *p != delim && *p != '\n') {
+        if (*p == '\\' && p + 1 < end) p++;
+        p++;
+    }
+    return p < end && *p == delim ? p + 1 : p;
+}
+
+// Returns the start of the line after the one `p` is on, or `end`.
+static const char *skip_line(const char *p, const char *end) {
+    for (;;) {
+        p = skip_find_special(p, end);
+        if (p == end) return end;
+
+        switch (*p) {
+        case '\n':
+            return p + 1;
+        case '"':
+        case '\'':
+            p = skip_literal(p, end);
+            break;
+        case '/':
+            if (p + 1 < end && p[1] == '/') {
+                const char *newline = memchr(p, '\n', end - p);
+                return newline ? newline + 1 : end;
+            }
+            p = p + 1 < end && p[1] == '*' ? skip_comment(p, end) : p + 1;
+            break;
+        default: {
+            // a backslash newline continues the line.
+            size_t splice = trivia_splice_length(p, end);
+            p += splice ? splice : 1;
+            break;
+        }
+        }
+    }
+}
+
+// Returns true if the `len` characters at `name` are `directive`.
+static bool skip_directive_is(const char *name, size_t len,
+                              const char *directive) {
+    return strlen(directive) == len && memcmp(name, directive, len) == 0;
+}
+
+bool lexer_skip_group(struct lexer *lexer, const struct token *first) {
+    if (first) {
+        lexer->cur = first->spelling;
+        lexer->pos = first->pos;
+    }
+    struct pos start_pos = lexer->pos;
+    const char *start = lexer->cur;
+
+    const char *end = lexer->end;
+    const char *line = lexer->cur;
+    int depth = 0;
+    while (line < end) {
+        const char *p = skip_blanks(line, end);
+        if (p < end && *p == '#') {
+            const char *name = skip_blanks(p + 1, end);
+            const char *name_end = name;
+            while (name_end < end && skip_is_name_char(*name_end)) name_end++;
+            size_t len = name_end - name;
+
+            if (skip_directive_is(name, len, "if") ||
+                skip_directive_is(name, len, "ifdef") ||
+                skip_directive_is(name, len, "ifndef")) {
+                depth++;
+            } else if (skip_directive_is(name, len, "endif")) {
+                if (!depth) break;
+                depth--;
+            } else if (!depth && (skip_directive_is(name, len, "elif") ||
+                                  skip_directive_is(name, len, "else"))) {
+                break;
+            }
+            p = name_end;
+        }
+        line = skip_line(p, end);
+    }
+
+    // the directive is read as usual, from the start of its line.
+    lexer_advance_to(lexer, line);
+    trivia_inactive_record(lexer, first, start_pos, start);
+    lexer->line_start = true;
+    lexer->whitespace_before = true;
+    lexer->header_name_next = false;
+    return line < end;
+}
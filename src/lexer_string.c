@@ -0,0 +1,276 @@
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "../helpers/buffer.h"
+#include "lexer.h"
+#include "lexer_token.h"
+
+// String and character literals are scanned straight out of the in-memory
+// source. The scan jumps between the characters that need attention, the
+// closing delimiter, a backslash or a newline, 16 bytes at a time, everything
+// in between is either borrowed from the source as is or copied in bulk.
+
+// Value of the simple escape sequences, 0 for characters which don't form
+// one.
+static const char string_simple_escapes[256] = {
+    ['n'] = '\n', ['t'] = '\t', ['r'] = '\r', ['a'] = '\a',
+    ['b'] = '\b', ['f'] = '\f', ['v'] = '\v', ['\\'] = '\\',
+    ['\''] = '\'', ['"'] = '"', ['?'] = '?',
+};
+
+// Returns the first `delim`, backslash or newline in [p, end), or `end`.
+static const char *string_find_special(const char *p, const char *end,
+                                       char delim) {
+#ifdef __SSE2__
+    const __m128i delims = _mm_set1_epi8(delim);
+    const __m128i backslashes = _mm_set1_epi8('\\');
+    const __m128i newlines = _mm_set1_epi8('\n');
+    while (end - p >= 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)p);
+        __m128i hits = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, delims),
+                         _mm_cmpeq_epi8(chunk, backslashes)),
+            _mm_cmpeq_epi8(chunk, newlines));
+        int mask = _mm_movemask_epi8(hits);
+        if (mask) return p + __builtin_ctz(mask);
+        p += 16;
+    }
+#endif
+    while (p < end && *p != delim && *p != '\\' && *p != '\n') p++;
+    return p;
+}
+
+// Tracks the position of a literal while it's scanned, a literal only spans
+// lines through backslash newline continuations.
+struct string_scan {
+    struct lexer *lexer;
+    const char *end;
+    int line;
+    // first character of the current line, NULL while still on the line the
+    // literal started on.
+    const char *line_start;
+};
+
+// Moves the lexer to `p`, the end of the literal.
+static void string_scan_finish(struct string_scan *scan, const char *p) {
+    struct lexer *l = scan->lexer;
+    if (scan->line_start) {
+        l->pos.line = scan->line;
+        l->pos.col = (int)(p - scan->line_start) + 1;
+    } else {
+        l->pos.col += (int)(p - l->cur);
+    }
+    l->cur = p;
+}
+
+// Reports `e` at `p`.
+static void string_error(struct string_scan *scan, const char *p,
+                         enum lex_errors e) {
+    string_scan_finish(scan, p);
+    lex_error(scan->lexer, e);
+}
+
+static int string_hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Appends `code_point` to `buf` encoded as UTF-8.
+static void string_write_utf8(struct buffer *buf, unsigned int code_point) {
+    if (code_point < 0x80) {
+        buffer_write(buf, code_point);
+    } else if (code_point < 0x800) {
+        buffer_write(buf, 0xC0 | (code_point >> 6));
+        buffer_write(buf, 0x80 | (code_point & 0x3F));
+    } else if (code_point < 0x10000) {
+        buffer_write(buf, 0xE0 | (code_point >> 12));
+        buffer_write(buf, 0x80 | ((code_point >> 6) & 0x3F));
+        buffer_write(buf, 0x80 | (code_point & 0x3F));
+    } else {
+        buffer_write(buf, 0xF0 | (code_point >> 18));
+        buffer_write(buf, 0x80 | ((code_point >> 12) & 0x3F));
+        buffer_write(buf, 0x80 | ((code_point >> 6) & 0x3F));
+        buffer_write(buf, 0x80 | (code_point & 0x3F));
+    }
+}
+
+// Decodes the escape sequence whose backslash is at `p` and appends its value
+// to `buf`. A backslash followed by a newline is a line continuation and
+// appends nothing. Returns the first character after the sequence.
+static const char *string_decode_escape(struct string_scan *scan,
+                                        const char *p, struct buffer *buf) {
+    const char *end = scan->end;
+    const char *backslash = p++;
+    if (p == end) string_error(scan, backslash, LEXICAL_ANALYSIS_INVALID_ESCAPE);
+
+    unsigned char c = *p;
+    if (string_simple_escapes[c]) {
+        buffer_write(buf, string_simple_escapes[c]);
+        return p + 1;
+    }
+
+    if (c == '\n') {
+        scan->line++;
+        scan->line_start = p + 1;
+        return p + 1;
+    }
+
+    if (c >= '0' && c <= '7') {
+        unsigned int value = 0;
+        for (int i = 0; i < 3 && p < end && *p >= '0' && *p <= '7'; i++, p++)
+            value = value * 8 + (*p - '0');
+        if (value > 0xFF)
+            string_error(scan, backslash, LEXICAL_ANALYSIS_INVALID_ESCAPE);
+        buffer_write(buf, (char)value);
+        return p;
+    }
+
+    if (c == 'x') {
+        p++;
+        const char *digits = p;
+        unsigned int value = 0;
+        for (; p < end && string_hex_value(*p) >= 0; p++) {
+            value = value * 16 + string_hex_value(*p);
+            if (value > 0xFF)
+                string_error(scan, backslash, LEXICAL_ANALYSIS_INVALID_ESCAPE);
+        }
+        if (p == digits)
+            string_error(scan, backslash, LEXICAL_ANALYSIS_INVALID_ESCAPE);
+        buffer_write(buf, (char)value);
+        return p;
+    }
+
+    if (c == 'u' || c == 'U') {
+        // universal character names are stored UTF-8 encoded.
+        int digits = c == 'u' ? 4 : 8;
+        p++;
+        if (end - p < digits)
+            string_error(scan, backslash, LEXICAL_ANALYSIS_INVALID_ESCAPE);
+
+        unsigned int code_point = 0;
+        for (int i = 0; i < digits; i++, p++) {
+            int digit = string_hex_value(*p);
+            if (digit < 0)
+                string_error(scan, backslash, LEXICAL_ANALYSIS_INVALID_ESCAPE);
+            code_point = code_point * 16 + digit;
+        }
+        if (code_point > 0x10FFFF ||
+            (code_point >= 0xD800 && code_point <= 0xDFFF))
+            string_error(scan, backslash, LEXICAL_ANALYSIS_INVALID_ESCAPE);
+        string_write_utf8(buf, code_point);
+        return p;
+    }
+
+    string_error(scan, backslash, LEXICAL_ANALYSIS_INVALID_ESCAPE);
+    return p;
+}
+
+struct token *token_string_create(struct lexer *l) {
+    struct pos pos = l->pos;
+    struct string_scan scan = {
+        .lexer = l, .end = l->end, .line = l->pos.line, .line_start = NULL};
+
+    // pop-off initial delimiter, '<' is closed by '>' in '#include <x.h>'
+    const char *p = l->cur;
+    char delim = *p++;
+    if (delim == '<') delim = '>';
+    // escape sequences have no meaning in header names.
+    bool decode = delim == '"';
+
+    const char *start = p;
+    // only allocated once the first escape sequence is found, up to then the
+    // string is a span of the source.
+    struct buffer decoded;
+    bool owned = false;
+
+    for (;;) {
+        const char *hit = string_find_special(p, scan.end, delim);
+        if (hit == scan.end || *hit == '\n') {
+            if (owned) buffer_release(&decoded);
+            string_error(&scan, hit, LEXICAL_ANALYSIS_STRING_NOT_CLOSED);
+        }
+
+        if (*hit == delim) {
+            if (owned) buffer_write_bytes(&decoded, p, hit - p);
+            p = hit;
+            break;
+        }
+
+        if (!decode) {
+            p = hit + 1;
+            continue;
+        }
+
+        if (!owned) {
+            buffer_init(&decoded);
+            owned = true;
+            p = start;
+        }
+        buffer_write_bytes(&decoded, p, hit - p);
+        p = string_decode_escape(&scan, hit, &decoded);
+    }
+
+    struct token *tok = calloc(1, sizeof(struct token));
+    tok->type = TOKEN_TYPE_STRING;
+    tok->pos = pos;
+    if (owned) {
+        tok->slen = buffer_len(&decoded);
+        tok->sval = buffer_strdup(&decoded);
+        buffer_release(&decoded);
+    } else {
+        tok->slen = p - start;
+        tok->sval = start;
+        tok->flags |= TOKEN_FLAG_BORROWED_SVAL;
+    }
+
+    // pop off final delimiter, or else the lexer would think another string
+    // exists
+    string_scan_finish(&scan, p + 1);
+    return tok;
+}
+
+struct token *token_quote_create(struct lexer *l) {
+    struct pos pos = l->pos;
+    struct string_scan scan = {
+        .lexer = l, .end = l->end, .line = l->pos.line, .line_start = NULL};
+
+    // discard first quote, we don't need it...
+    const char *p = l->cur + 1;
+    if (p == scan.end || *p == '\'' || *p == '\n')
+        string_error(&scan, p, LEXICAL_ANALYSIS_QUOTE_NOT_CLOSED);
+
+    char c;
+    if (*p == '\\') {
+        struct buffer decoded;
+        buffer_init(&decoded);
+        p = string_decode_escape(&scan, p, &decoded);
+        size_t len = buffer_len(&decoded);
+        c = len ? *(char *)buffer_ptr(&decoded) : 0;
+        buffer_release(&decoded);
+        // a continuation or a multi byte universal character name doesn't
+        // make a single character.
+        if (len != 1) string_error(&scan, p, LEXICAL_ANALYSIS_INVALID_ESCAPE);
+    } else {
+        c = *p++;
+    }
+
+    // discard the paired quote
+    if (p == scan.end || *p != '\'')
+        string_error(&scan, p, LEXICAL_ANALYSIS_QUOTE_NOT_CLOSED);
+    string_scan_finish(&scan, p + 1);
+
+    // a character constant has type int in C.
+    struct token *tok = calloc(1, sizeof(struct token));
+    tok->type = TOKEN_TYPE_NUMBER;
+    tok->number_type = NUMBER_TYPE_INT;
+    tok->pos = pos;
+    tok->llnum = c;
+
+    return tok;
+}
@@ -5,7 +5,8 @@
 #include <string.h>
 
 #include "../helpers/buffer.h"
-#include "../helpers/vector.h"
+#include "../helpers/segvector.h"
+#include "../helpers/utf8.h"
 #include "lexer.h"
 
 bool is_keyword(char *str) {
@@ -17,144 +18,229 @@ bool is_keyword(char *str) {
     return false;
 }
 
-struct token *token_number_create(struct lexer *l) {
-    struct token *tok = calloc(1, sizeof(struct token));
-    tok->pos = l->pos;
-
-    struct buffer *buf = buffer_create();
-    for (char c = lexer_peek_char(l); (c >= '0' && c <= '9');
-         c = lexer_peek_char(l)) {
-        buffer_write(buf, lexer_next_char(l));
+void token_release(struct token *tok) {
+    switch (tok->type) {
+        case TOKEN_TYPE_IDENTIFIER:
+        case TOKEN_TYPE_KEYWORD:
+        case TOKEN_TYPE_STRING:
+            if (!(tok->flags & TOKEN_FLAG_BORROWED_SVAL))
+                free((char *)tok->sval);
+            break;
     }
-
-    tok->type = TOKEN_TYPE_NUMBER;
-    tok->llnum = atoll(buffer_ptr(buf));
-    buffer_free(buf);
-    return tok;
 }
 
-struct token *token_string_create(struct lexer *l) {
-    struct token *tok = calloc(1, sizeof(struct token));
-    tok->type = TOKEN_TYPE_STRING;
-    tok->pos = l->pos;
-
-    struct buffer *buf = buffer_create();
-
-    // pop-off initial delimiter
-    char delim = lexer_next_char(l);
-
-    char c = lexer_peek_char(l);
-    while (c != delim && (signed char)c != EOF) {
-        if (c == '\\') {
-            // TODO: handle escapes
-        }
-
-        buffer_write(buf, lexer_next_char(l));
-        c = lexer_peek_char(l);
+// Operator characters are mapped to a small class index so the operator
+// tables stay tiny, class 0 means the character is not an operator.
+enum {
+    OPERATOR_CLASS_NONE,
+    OPERATOR_CLASS_PLUS,
+    OPERATOR_CLASS_MINUS,
+    OPERATOR_CLASS_STAR,
+    OPERATOR_CLASS_SLASH,
+    OPERATOR_CLASS_PERCENT,
+    OPERATOR_CLASS_LESS,
+    OPERATOR_CLASS_GREATER,
+    OPERATOR_CLASS_EQUAL,
+    OPERATOR_CLASS_NOT,
+    OPERATOR_CLASS_TILDE,
+    OPERATOR_CLASS_AMPERSAND,
+    OPERATOR_CLASS_PIPE,
+    OPERATOR_CLASS_CARET,
+    OPERATOR_CLASS_QUESTION,
+    OPERATOR_CLASS_COMMA,
+    OPERATOR_CLASS_DOT,
+    OPERATOR_CLASS_LEFT_PAREN,
+    OPERATOR_CLASS_LEFT_BRACKET,
+    OPERATOR_CLASS_COUNT
+};
+
+static const unsigned char operator_class[256] = {
+    ['+'] = OPERATOR_CLASS_PLUS,       ['-'] = OPERATOR_CLASS_MINUS,
+    ['*'] = OPERATOR_CLASS_STAR,       ['/'] = OPERATOR_CLASS_SLASH,
+    ['%'] = OPERATOR_CLASS_PERCENT,    ['<'] = OPERATOR_CLASS_LESS,
+    ['>'] = OPERATOR_CLASS_GREATER,    ['='] = OPERATOR_CLASS_EQUAL,
+    ['!'] = OPERATOR_CLASS_NOT,        ['~'] = OPERATOR_CLASS_TILDE,
+    ['&'] = OPERATOR_CLASS_AMPERSAND,  ['|'] = OPERATOR_CLASS_PIPE,
+    ['^'] = OPERATOR_CLASS_CARET,      ['?'] = OPERATOR_CLASS_QUESTION,
+    [','] = OPERATOR_CLASS_COMMA,      ['.'] = OPERATOR_CLASS_DOT,
+    ['('] = OPERATOR_CLASS_LEFT_PAREN, ['['] = OPERATOR_CLASS_LEFT_BRACKET,
+};
+
+// Operator made of a single character of the given class.
+static const unsigned char operator_single[OPERATOR_CLASS_COUNT] = {
+    [OPERATOR_CLASS_PLUS] = OPERATOR_PLUS,
+    [OPERATOR_CLASS_MINUS] = OPERATOR_MINUS,
+    [OPERATOR_CLASS_STAR] = OPERATOR_STAR,
+    [OPERATOR_CLASS_SLASH] = OPERATOR_SLASH,
+    [OPERATOR_CLASS_PERCENT] = OPERATOR_PERCENT,
+    [OPERATOR_CLASS_LESS] = OPERATOR_LESS,
+    [OPERATOR_CLASS_GREATER] = OPERATOR_GREATER,
+    [OPERATOR_CLASS_EQUAL] = OPERATOR_ASSIGN,
+    [OPERATOR_CLASS_NOT] = OPERATOR_NOT,
+    [OPERATOR_CLASS_TILDE] = OPERATOR_TILDE,
+    [OPERATOR_CLASS_AMPERSAND] = OPERATOR_AMPERSAND,
+    [OPERATOR_CLASS_PIPE] = OPERATOR_PIPE,
+    [OPERATOR_CLASS_CARET] = OPERATOR_CARET,
+    [OPERATOR_CLASS_QUESTION] = OPERATOR_QUESTION,
+    [OPERATOR_CLASS_COMMA] = OPERATOR_COMMA,
+    [OPERATOR_CLASS_DOT] = OPERATOR_DOT,
+    [OPERATOR_CLASS_LEFT_PAREN] = OPERATOR_LEFT_PAREN,
+    [OPERATOR_CLASS_LEFT_BRACKET] = OPERATOR_LEFT_BRACKET,
+};
+
+// ".." is not an operator on its own but is the prefix of "...", it only
+// appears in operator_pair so the recognizer knows to look at a third
+// character.
+#define OPERATOR_DOT_DOT_PREFIX OPERATOR_COUNT
+
+// Operator made of two characters, indexed by the class of the first and
+// second character. OPERATOR_NONE means the pair isn't an operator and only
+// the first character is consumed.
+static const unsigned char
+    operator_pair[OPERATOR_CLASS_COUNT][OPERATOR_CLASS_COUNT] = {
+        [OPERATOR_CLASS_PLUS][OPERATOR_CLASS_PLUS] = OPERATOR_INCREMENT,
+        [OPERATOR_CLASS_PLUS][OPERATOR_CLASS_EQUAL] = OPERATOR_PLUS_ASSIGN,
+        [OPERATOR_CLASS_MINUS][OPERATOR_CLASS_MINUS] = OPERATOR_DECREMENT,
+        [OPERATOR_CLASS_MINUS][OPERATOR_CLASS_GREATER] = OPERATOR_ARROW,
+        [OPERATOR_CLASS_MINUS][OPERATOR_CLASS_EQUAL] = OPERATOR_MINUS_ASSIGN,
+        [OPERATOR_CLASS_STAR][OPERATOR_CLASS_EQUAL] = OPERATOR_STAR_ASSIGN,
+        [OPERATOR_CLASS_SLASH][OPERATOR_CLASS_EQUAL] = OPERATOR_SLASH_ASSIGN,
+        [OPERATOR_CLASS_PERCENT][OPERATOR_CLASS_EQUAL] =
+            OPERATOR_PERCENT_ASSIGN,
+        [OPERATOR_CLASS_LESS][OPERATOR_CLASS_EQUAL] = OPERATOR_LESS_EQUAL,
+        [OPERATOR_CLASS_LESS][OPERATOR_CLASS_LESS] = OPERATOR_SHIFT_LEFT,
+        [OPERATOR_CLASS_GREATER][OPERATOR_CLASS_EQUAL] = OPERATOR_GREATER_EQUAL,
+        [OPERATOR_CLASS_GREATER][OPERATOR_CLASS_GREATER] = OPERATOR_SHIFT_RIGHT,
+        [OPERATOR_CLASS_EQUAL][OPERATOR_CLASS_EQUAL] = OPERATOR_EQUAL,
+        [OPERATOR_CLASS_NOT][OPERATOR_CLASS_EQUAL] = OPERATOR_NOT_EQUAL,
+        [OPERATOR_CLASS_AMPERSAND][OPERATOR_CLASS_AMPERSAND] =
+            OPERATOR_LOGICAL_AND,
+        [OPERATOR_CLASS_AMPERSAND][OPERATOR_CLASS_EQUAL] =
+            OPERATOR_AMPERSAND_ASSIGN,
+        [OPERATOR_CLASS_PIPE][OPERATOR_CLASS_PIPE] = OPERATOR_LOGICAL_OR,
+        [OPERATOR_CLASS_PIPE][OPERATOR_CLASS_EQUAL] = OPERATOR_PIPE_ASSIGN,
+        [OPERATOR_CLASS_CARET][OPERATOR_CLASS_EQUAL] = OPERATOR_CARET_ASSIGN,
+        [OPERATOR_CLASS_DOT][OPERATOR_CLASS_DOT] = OPERATOR_DOT_DOT_PREFIX,
+};
+
+static const char *operator_spellings[OPERATOR_COUNT] = {
+    [OPERATOR_NONE] = "",
+    [OPERATOR_PLUS] = "+",
+    [OPERATOR_MINUS] = "-",
+    [OPERATOR_STAR] = "*",
+    [OPERATOR_SLASH] = "/",
+    [OPERATOR_PERCENT] = "%",
+    [OPERATOR_LESS] = "<",
+    [OPERATOR_GREATER] = ">",
+    [OPERATOR_ASSIGN] = "=",
+    [OPERATOR_NOT] = "!",
+    [OPERATOR_TILDE] = "~",
+    [OPERATOR_AMPERSAND] = "&",
+    [OPERATOR_PIPE] = "|",
+    [OPERATOR_CARET] = "^",
+    [OPERATOR_QUESTION] = "?",
+    [OPERATOR_COMMA] = ",",
+    [OPERATOR_DOT] = ".",
+    [OPERATOR_LEFT_PAREN] = "(",
+    [OPERATOR_LEFT_BRACKET] = "[",
+    [OPERATOR_INCREMENT] = "++",
+    [OPERATOR_DECREMENT] = "--",
+    [OPERATOR_ARROW] = "->",
+    [OPERATOR_PLUS_ASSIGN] = "+=",
+    [OPERATOR_MINUS_ASSIGN] = "-=",
+    [OPERATOR_STAR_ASSIGN] = "*=",
+    [OPERATOR_SLASH_ASSIGN] = "/=",
+    [OPERATOR_PERCENT_ASSIGN] = "%=",
+    [OPERATOR_LESS_EQUAL] = "<=",
+    [OPERATOR_GREATER_EQUAL] = ">=",
+    [OPERATOR_EQUAL] = "==",
+    [OPERATOR_NOT_EQUAL] = "!=",
+    [OPERATOR_LOGICAL_AND] = "&&",
+    [OPERATOR_LOGICAL_OR] = "||",
+    [OPERATOR_SHIFT_LEFT] = "<<",
+    [OPERATOR_SHIFT_RIGHT] = ">>",
+    [OPERATOR_AMPERSAND_ASSIGN] = "&=",
+    [OPERATOR_PIPE_ASSIGN] = "|=",
+    [OPERATOR_CARET_ASSIGN] = "^=",
+    [OPERATOR_SHIFT_LEFT_ASSIGN] = "<<=",
+    [OPERATOR_SHIFT_RIGHT_ASSIGN] = ">>=",
+    [OPERATOR_ELLIPSIS] = "...",
+};
+
+const char *operator_spelling(int op) { return operator_spellings[op]; }
+
+// Recognizes the longest operator at the lexer's position without consuming
+// anything, writes its length to `len`.
+// The first character must be an operator character.
+static int operator_recognize(struct lexer *l, int *len) {
+    int first = operator_class[(unsigned char)lexer_peek_char(l)];
+    int second = operator_class[(unsigned char)lexer_peek_char_at(l, 1)];
+
+    int op = operator_pair[first][second];
+    switch (op) {
+        case OPERATOR_NONE:
+            *len = 1;
+            return operator_single[first];
+        case OPERATOR_SHIFT_LEFT:
+        case OPERATOR_SHIFT_RIGHT:
+            if (lexer_peek_char_at(l, 2) == '=') {
+                *len = 3;
+                return op == OPERATOR_SHIFT_LEFT ? OPERATOR_SHIFT_LEFT_ASSIGN
+                                                 : OPERATOR_SHIFT_RIGHT_ASSIGN;
+            }
+            break;
+        case OPERATOR_DOT_DOT_PREFIX:
+            if (lexer_peek_char_at(l, 2) == '.') {
+                *len = 3;
+                return OPERATOR_ELLIPSIS;
+            }
+            // ".." is two "." operators, take the first one.
+            *len = 1;
+            return OPERATOR_DOT;
     }
 
-    // write null char
-    buffer_write(buf, '\0');
-
-    // pop off final delimiter, or else the lexer would think another string
-    // exists
-    lexer_next_char(l);
-
-    char *str_buff = calloc(buf->len, sizeof(char));
-    memcpy(str_buff, buffer_ptr(buf), buf->len);
-    tok->sval = str_buff;
-
-    buffer_free(buf);
-
-    return tok;
-}
-
-// Determine if `op` is an operator which supports being joined with another
-// operator.
-bool operator_is_joinable(char op) {
-    return op == '+' || op == '-' || op == '>' || op == '<' || op == '|' ||
-           op == '&' || op == '*' || op == '/' || op == '=';
-}
-
-#define VALID_JOINED_OPS_LEN 12
-
-// Vector containing valid joined operators.
-char operator_joined[VALID_JOINED_OPS_LEN][2] = {
-    {'*', '='}, {'/', '='}, {'+', '+'}, {'-', '-'}, {'>', '='}, {'<', '='},
-    {'|', '|'}, {'&', '&'}, {'+', '='}, {'-', '='}, {'>', '>'}, {'<', '<'}};
-
-// Ensures the two byte string `joined_op` is a valid joined operator from
-// vector `operator_joined`
-void operator_validate_joined_op(struct lexer *l, char *joined_op) {
-    for (int i = 0; i < VALID_JOINED_OPS_LEN; i++) {
-        if (memcmp(operator_joined[i], joined_op, 2) == 0) return;
-    }
-    lex_error(l, LEXICAL_ANALYSIS_INVALID_JOINED_OPERATOR);
+    *len = 2;
+    return op;
 }
 
 // Checks if 'op' is the '<' operator and if so determines if its being used
 // in an include statement, if it is a String token with the contained included
 // file is returned.
-struct token *token_operator_is_include(struct lexer *l, char op) {
+struct token *token_operator_is_include(struct lexer *l, int op) {
     if (op != '<') return NULL;
 
     // we need to see if the lexer has an INCLUDE keyword token on its stack
     // if it does we need to return a string token with the file name
-    struct token *tok = vector_back_or_null(l->token_vec);
-    if (!tok) return NULL;
-
-    if (tok->type == TOKEN_TYPE_KEYWORD && strcmp(tok->sval, "include") == 0) {
-        return token_string_create(l);
-    };
+    if (l->header_name_next) return token_string_create(l);
 
     return NULL;
 }
 
 struct token *token_operator_create(struct lexer *l) {
-    struct token *tok = calloc(1, sizeof(struct token));
     struct token *include = NULL;
-    struct buffer *buf = buffer_create();
 
     // peek first to see if we actually need to make a string token for '<'
     // operator usage in '#include <x.h>'
-    char op = lexer_peek_char(l);
-    if ((include = token_operator_is_include(l, op))) return include;
+    int c = lexer_peek_char(l);
+    if ((include = token_operator_is_include(l, c))) return include;
 
     // either operator was not '<' or '<' was not being used in an include so
     // continue on parsing the operator...
-    op = lexer_next_char(l);
-    buffer_write(buf, op);
-
-    if (operator_is_joinable(op)) {
-        if (operator_is_joinable(lexer_peek_char(l))) {
-            op = lexer_next_char(l);
-            buffer_write(buf, op);
-            operator_validate_joined_op(l, buffer_ptr(buf));
-        }
-    }
-
-    // Open parens means new expression, so instruct the lexer to create a new
-    // expr.
-    if (op == '(') lexer_new_expression(l);
-
-    buffer_write(buf, '\0');
-
-    char *token_str = calloc(buf->len, sizeof(char));
-    strcpy(token_str, buffer_ptr(buf));
+    int len;
+    int op = operator_recognize(l, &len);
+    for (int i = 0; i < len; i++) lexer_next_char(l);
 
+    struct token *tok = calloc(1, sizeof(struct token));
     tok->type = TOKEN_TYPE_OPERATOR;
-    tok->sval = token_str;
+    tok->op = op;
     tok->pos = l->pos;
 
-    buffer_free(buf);
-
     return tok;
 }
 
 struct token *token_symbol_create(struct lexer *l) {
     struct token *tok = calloc(1, sizeof(struct token));
     char c = lexer_next_char(l);
-    if (c == ')') lexer_finish_expression(l);
 
     tok->type = TOKEN_TYPE_SYMBOL;
     tok->cval = c;
@@ -162,123 +248,113 @@ struct token *token_symbol_create(struct lexer *l) {
     return tok;
 }
 
-struct token *token_identifier_create(struct lexer *l) {
-    struct token *tok = calloc(1, sizeof(struct token));
-    struct buffer *buf = buffer_create();
-
-    unsigned char c = lexer_peek_char(l);
-    while (isalnum(c) || c == '_') {
-        c = lexer_next_char(l);
-        buffer_write(buf, c);
-        c = lexer_peek_char(l);
-    }
-
-    // add null byte
-    buffer_write(buf, '\0');
-
-    char *token_str = calloc(buf->len, sizeof(char));
-    strcpy(token_str, buffer_ptr(buf));
-
-    if (is_keyword(buffer_ptr(buf))) {
-        tok->type = TOKEN_TYPE_KEYWORD;
-    } else {
-        tok->type = TOKEN_TYPE_IDENTIFIER;
+// Code points allowed in identifiers besides ASCII letters, digits and '_',
+// C11 Annex D.1. Sorted inclusive ranges, searched with a binary search.
+static const uint32_t identifier_ranges[][2] = {
+    {0x00A8, 0x00A8},   {0x00AA, 0x00AA},   {0x00AD, 0x00AD},
+    {0x00AF, 0x00AF},   {0x00B2, 0x00B5},   {0x00B7, 0x00BA},
+    {0x00BC, 0x00BE},   {0x00C0, 0x00D6},   {0x00D8, 0x00F6},
+    {0x00F8, 0x00FF},   {0x0100, 0x167F},   {0x1681, 0x180D},
+    {0x180F, 0x1FFF},   {0x200B, 0x200D},   {0x202A, 0x202E},
+    {0x203F, 0x2040},   {0x2054, 0x2054},   {0x2060, 0x206F},
+    {0x2070, 0x218F},   {0x2460, 0x24FF},   {0x2776, 0x2793},
+    {0x2C00, 0x2DFF},   {0x2E80, 0x2FFF},   {0x3004, 0x3007},
+    {0x3021, 0x302F},   {0x3031, 0x303F},   {0x3040, 0xD7FF},
+    {0xF900, 0xFD3D},   {0xFD40, 0xFDCF},   {0xFDF0, 0xFE44},
+    {0xFE47, 0xFFFD},   {0x10000, 0x1FFFD}, {0x20000, 0x2FFFD},
+    {0x30000, 0x3FFFD}, {0x40000, 0x4FFFD}, {0x50000, 0x5FFFD},
+    {0x60000, 0x6FFFD}, {0x70000, 0x7FFFD}, {0x80000, 0x8FFFD},
+    {0x90000, 0x9FFFD}, {0xA0000, 0xAFFFD}, {0xB0000, 0xBFFFD},
+    {0xC0000, 0xCFFFD}, {0xD0000, 0xDFFFD}, {0xE0000, 0xEFFFD},
+};
+
+// Combining characters, C11 Annex D.2, an identifier can't start with them.
+// Every range lies within identifier_ranges.
+static const uint32_t identifier_continue_ranges[][2] = {
+    {0x0300, 0x036F},
+    {0x1DC0, 0x1DFF},
+    {0x20D0, 0x20FF},
+    {0xFE20, 0xFE2F},
+};
+
+#define IDENTIFIER_RANGE_COUNT(ranges) (sizeof(ranges) / sizeof(ranges[0]))
+
+static bool identifier_in_ranges(const uint32_t (*ranges)[2], int count,
+                                 uint32_t code_point) {
+    int lo = 0, hi = count - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (code_point < ranges[mid][0])
+            hi = mid - 1;
+        else if (code_point > ranges[mid][1])
+            lo = mid + 1;
+        else
+            return true;
     }
-    tok->sval = token_str;
-    tok->pos = l->pos;
-
-    buffer_free(buf);
-    return tok;
+    return false;
 }
 
-struct token *token_newline_create(struct lexer *l) {
-    lexer_next_char(l);
-    struct token *tok = calloc(1, sizeof(struct token));
-    tok->type = TOKEN_TYPE_NEWLINE;
-    tok->pos = l->pos;
-    return tok;
+// Returns true if the non ASCII `code_point` may appear in an identifier,
+// `first` if it would be the first character of the identifier.
+static bool identifier_code_point(uint32_t code_point, bool first) {
+    if (!identifier_in_ranges(identifier_ranges,
+                              IDENTIFIER_RANGE_COUNT(identifier_ranges),
+                              code_point))
+        return false;
+    return !first ||
+           !identifier_in_ranges(
+               identifier_continue_ranges,
+               IDENTIFIER_RANGE_COUNT(identifier_continue_ranges), code_point);
 }
 
-struct token *token_comment_create(struct lexer *l) {
-    // determine if we are a single line or a multiline comment
-    char comment = lexer_next_char(l);
-    struct buffer *buf = buffer_create();
-
-    switch (comment) {
-        case '/':
-            comment = lexer_next_char(l);
-            while (comment != '\n' && (signed char)comment != EOF) {
-                buffer_write(buf, comment);
-                comment = lexer_next_char(l);
-            }
-            break;
-        case '*':
-            comment = lexer_next_char(l);
-            while (comment != '*') {
-                if ((signed char)comment == EOF)
-                    lex_error(l, LEXICAL_ANALYSIS_MULTILINE_COMMENT_NOT_CLOSED);
-
-                char next_c = lexer_peek_char(l);
-                if (next_c == '/') {
-                    // discard end of comment
-                    lexer_next_char(l);
-                    break;
-                }
-
-                buffer_write(buf, comment);
-                comment = lexer_next_char(l);
-            }
-            break;
-        default:
-            lex_error(l, LEXICAL_ANALYSIS_INPUT_ERROR);
-    }
-
-    // add nul char
-    buffer_write(buf, '\0');
-
-    struct token *tok = calloc(1, sizeof(struct token));
-    tok->type = TOKEN_TYPE_COMMENT;
-    tok->sval = buffer_ptr(buf);
-    tok->pos = l->pos;
+// Returns the length of the identifier character at `p` or 0 if there is
+// none. The source is valid UTF-8, see lexer_lex.
+static int identifier_char_length(const char *p, const char *end, bool first) {
+    unsigned char c = *p;
+    if (c < 0x80) return (isalpha(c) || c == '_' || (!first && isdigit(c)));
 
-    buffer_free(buf);
-    return tok;
+    int len;
+    uint32_t code_point = utf8_decode(p, end, &len);
+    return identifier_code_point(code_point, first) ? len : 0;
 }
 
-struct token *token_quote_create(struct lexer *l) {
-    // discard first quote, we don't need it...
-    lexer_next_char(l);
-
-    char c = lexer_next_char(l);
+bool token_identifier_start(struct lexer *l) {
+    return l->cur < l->end && identifier_char_length(l->cur, l->end, true);
+}
 
-    // handle escapes
-    if (c == '\\') {
-        char escaped = lexer_next_char(l);
-        switch (escaped) {
-            case 'n':
-                c = '\n';
-                break;
-            case '\\':
-                c = '\\';
-                break;
-            case '\'':
-                c = '\'';
-                break;
-            case '\t':
-                c = '\t';
-                break;
+struct token *token_identifier_create(struct lexer *l) {
+    struct token *tok = calloc(1, sizeof(struct token));
+    struct buffer buf;
+    buffer_init(&buf);
+
+    const char *start = l->cur;
+    const char *p = start;
+    int len;
+    while (p < l->end) {
+        // ASCII identifier characters don't need any decoding.
+        unsigned char c = *p;
+        if (c < 0x80 && (isalnum(c) || c == '_')) {
+            p++;
+            continue;
         }
+        if (!(len = identifier_char_length(p, l->end, p == start))) break;
+        p += len;
     }
+    buffer_write_bytes(&buf, start, p - start);
+    // identifiers never span lines, columns count bytes like everywhere else.
+    l->pos.col += (int)(p - start);
+    l->cur = p;
 
-    // discard the paired quote
-    if (lexer_next_char(l) != '\'') {
-        lex_error(l, LEXICAL_ANALYSIS_QUOTE_NOT_CLOSED);
-    }
+    char *token_str = buffer_strdup(&buf);
 
-    struct token *tok = calloc(1, sizeof(struct token));
-    tok->type = TOKEN_TYPE_NUMBER;
+    if (is_keyword(token_str)) {
+        tok->type = TOKEN_TYPE_KEYWORD;
+    } else {
+        tok->type = TOKEN_TYPE_IDENTIFIER;
+    }
+    tok->sval = token_str;
     tok->pos = l->pos;
-    tok->cval = c;
 
+    buffer_release(&buf);
     return tok;
 }
@@ -37,16 +37,27 @@ static char *keywords[] = {"unsigned",
                            "restrict",
                            NULL};
 
-// Creates a new token of type TOKEN_TYPE_NUMBER
+// Frees the memory owned by `tok`, the token itself is not freed.
+void token_release(struct token *tok);
+
+// Creates a new token of type TOKEN_TYPE_NUMBER from a decimal, octal, hex or
+// binary integer literal or a decimal or hex floating literal, including
+// suffixes. The type of the literal is stored in token::number_type.
 // Lexer MUST be set to the first character of the numeric token.
 struct token *token_number_create(struct lexer *l);
 
 // Creates a new token of type TOKEN_TYPE_STRING
 // Lexer MUST be set to the first character delimiter of the string and will
-// read until EOF or the delimeter is found.
+// read until the delimeter is found, running into the end of the line or file
+// is an error. Escape sequences are decoded, strings without any borrow their
+// characters from the source, see TOKEN_FLAG_BORROWED_SVAL and token::slen.
 struct token *token_string_create(struct lexer *l);
 
-// Creates a new token of type TOKEN_TYPE_IDENTIFIER
+// Returns the source spelling of an OPERATOR_* value.
+const char *operator_spelling(int op);
+
+// Creates a new token of type TOKEN_TYPE_OPERATOR, the longest operator at
+// the lexer's position is consumed and stored in token::op.
 // Lexer MUST be set to the first character of the operator.
 // If the '<' operator is encountered a check to see if it the `include` keyword
 // preceeds it and if it does a TOKEN_TYPE_STRING token representing the
@@ -61,24 +72,52 @@ struct token *token_symbol_create(struct lexer *l);
 // Lexer MUST be set to the first character of the keyword.
 struct token *token_keyword_create(struct lexer *l);
 
+// Returns true if the lexer is set to a character that can start an
+// identifier: an ASCII letter, '_' or a UTF-8 encoded C11 Annex D character.
+bool token_identifier_start(struct lexer *l);
+
 // Creates a new token of type TOKEN_TYPE_IDENTIFIER
 // Lexer MUST be set to the first character of the identifier.
 // If the identifier is determined to be a keyword a TOKEN_TYPE_KEYWORD token
 // is returned.
 struct token *token_identifier_create(struct lexer *l);
 
-// Creates a new token of type TOKEN_TYPE_NEWLINE
+// Skips a run of whitespace other than newlines, recording it as trivia.
+// Lexer MUST be set to the first whitespace character.
+void trivia_whitespace_read(struct lexer *l);
+
+// Skips a newline, recording it as trivia. The next token starts a line.
 // Lexer MUST be set to the newline character.
-struct token *token_newline_create(struct lexer *l);
+void trivia_newline_read(struct lexer *l);
+
+// Returns the length of the backslash newline at `p`, a backslash, maybe a
+// carriage return and a newline, or 0 if there's none.
+size_t trivia_splice_length(const char *p, const char *end);
+
+// Skips a backslash newline, recording it as trivia, and returns true, or
+// returns false if the backslash isn't followed by a newline. The next token
+// doesn't start a line and isn't separated by whitespace.
+// Lexer MUST be set to the backslash.
+bool trivia_splice_read(struct lexer *l);
+
+// Skips a single line, '//', or multiline, '/*', comment, recording it as
+// trivia. The newline ending a single line comment is not part of it.
+// Lexer MUST be set to the first '/' of the comment.
+void trivia_comment_read(struct lexer *l);
+
+// Records `tok`, just read from the source, in lexer::raw_tokens with the
+// tooling profile. Its sval must be borrowed.
+void trivia_token_record(struct lexer *l, const struct token *tok);
 
-// Creates a new token of type TOKEN_TYPE_COMMENT.
-// Lexer MUST be set to the SECOND character of the comment string, '/' or '*'
-// in the single line, '//', or the multiline, '/*' comment declaration,
-// respectively.
-struct token *token_comment_create(struct lexer *l);
+// Records the source from `start` at `pos` up to the lexer's position as a
+// group which isn't taken, skipped by lexer_skip_group. `first` is the token
+// the group starts with if it was read already, it's no longer a token of its
+// own.
+void trivia_inactive_record(struct lexer *l, const struct token *first,
+                            struct pos pos, const char *start);
 
 // Creates a new token of type TOKEN_TYPE_NUMBER representing the character
-// within a quote pair.
+// within a quote pair, escape sequences are decoded.
 // Lexer MUST be set to the first quote character.
 struct token *token_quote_create(struct lexer*l);
 
@@ -0,0 +1,133 @@
+#include <string.h>
+
+#include "../helpers/segvector.h"
+#include "../helpers/vector.h"
+#include "lexer.h"
+#include "lexer_token.h"
+
+// Comments, newlines and whitespace never become tokens. The compile profile
+// only skips over them, the tooling profile, COMPILER_FLAG_LEX_TOOLING,
+// records each of them in lexer::trivia as a span of the source, as well as
+// the groups of conditionals which aren't taken, and keeps the tokens as read
+// from the source in lexer::raw_tokens.
+
+// Marks the next token as preceded by whitespace, a comment or a newline
+// separates tokens just like a space.
+static void trivia_mark_whitespace(struct lexer *l) {
+    l->whitespace_before = true;
+}
+
+// Records the trivia from `start` up to the lexer's position.
+static void trivia_record(struct lexer *l, int type, struct pos pos,
+                          const char *start) {
+    if (!l->recording) return;
+
+    struct trivia trivia = {
+        .type = type,
+        .token_index = segvector_count(l->raw_tokens),
+        .line = pos.line,
+        .col = pos.col,
+        .text = start,
+        .len = l->cur - start,
+    };
+    vector_push(l->trivia, &trivia);
+}
+
+void trivia_whitespace_read(struct lexer *l) {
+    struct pos pos = l->pos;
+    const char *start = l->cur;
+    const char *p = start;
+    while (p < l->end && (*p == ' ' || *p == '\t' || *p == '\r' ||
+                          *p == '\f' || *p == '\v'))
+        p++;
+    l->pos.col += (int)(p - start);
+    l->cur = p;
+
+    trivia_mark_whitespace(l);
+    trivia_record(l, TRIVIA_WHITESPACE, pos, start);
+}
+
+void trivia_newline_read(struct lexer *l) {
+    struct pos pos = l->pos;
+    const char *start = l->cur;
+    lexer_next_char(l);
+
+    trivia_mark_whitespace(l);
+    l->line_start = true;
+    trivia_record(l, TRIVIA_NEWLINE, pos, start);
+}
+
+size_t trivia_splice_length(const char *p, const char *end) {
+    const char *q = p + 1;
+    if (p == end || *p != '\\') return 0;
+    if (q < end && *q == '\r') q++;
+    return q < end && *q == '\n' ? q + 1 - p : 0;
+}
+
+bool trivia_splice_read(struct lexer *l) {
+    struct pos pos = l->pos;
+    const char *start = l->cur;
+    size_t len = trivia_splice_length(start, l->end);
+    if (!len) return false;
+    lexer_advance_to(l, start + len);
+
+    trivia_record(l, TRIVIA_SPLICE, pos, start);
+    return true;
+}
+
+void trivia_comment_read(struct lexer *l) {
+    struct pos pos = l->pos;
+    const char *start = l->cur;
+    const char *end = NULL;
+
+    if (start[1] == '/') {
+        // the newline ending the comment is trivia of its own.
+        end = memchr(start + 2, '\n', l->end - start - 2);
+        if (!end) end = l->end;
+    } else {
+        for (const char *p = start + 2; (p = memchr(p, '*', l->end - p)); p++) {
+            if (p + 1 < l->end && p[1] == '/') {
+                end = p + 2;
+                break;
+            }
+        }
+        if (!end) lex_error(l, LEXICAL_ANALYSIS_MULTILINE_COMMENT_NOT_CLOSED);
+    }
+    lexer_advance_to(l, end);
+
+    trivia_mark_whitespace(l);
+    trivia_record(l, TRIVIA_COMMENT, pos, start);
+}
+
+void trivia_token_record(struct lexer *l, const struct token *tok) {
+    if (l->recording) segvector_push(l->raw_tokens, (void *)tok);
+}
+
+void trivia_inactive_record(struct lexer *l, const struct token *first,
+                            struct pos pos, const char *start) {
+    if (!l->recording) return;
+    struct token *last = segvector_back_or_null(l->raw_tokens);
+    if (first && last && last->spelling == first->spelling)
+        segvector_pop(l->raw_tokens);
+    if (l->cur != start) trivia_record(l, TRIVIA_INACTIVE, pos, start);
+}
+
+struct trivia *lexer_trivia(struct lexer *lexer, int token_index, int *count) {
+    struct trivia *trivia = vector_data_ptr(lexer->trivia);
+    int total = vector_count(lexer->trivia);
+
+    // trivia are recorded in source order, so sorted by token index.
+    int lo = 0, hi = total;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (trivia[mid].token_index < token_index)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    int first = lo;
+    while (lo < total && trivia[lo].token_index == token_index) lo++;
+    *count = lo - first;
+    return trivia + first;
+}
@@ -0,0 +1,1335 @@
+#include "lower.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ast.h"
+#include "lexer.h"
+#include "lexer_token.h"
+#include "parser.h"
+#include "types.h"
+
+// Functions are lowered in one walk of their body. Expressions yield the
+// value they compute, lvalues the variable or address they designate, and
+// statements branch between blocks made as the walk goes, sealing each block
+// once the last jump to it is known.
+
+// How lower::locals holds a local, any other value is its IR_SLOT.
+enum {
+    // SSA variable named by its declaring node.
+    LOWER_LOCAL_SSA = UINT32_MAX - 1,
+    // its address is taken, it gets a slot once declared. Set before the body
+    // is lowered by lower_scan.
+    LOWER_LOCAL_ADDRESSED = UINT32_MAX,
+};
+
+// Objects larger than this are cleared by a loop rather than store by store.
+#define LOWER_UNROLL_BYTES 128
+
+// Value of an expression and its type. Arrays and functions decay to
+// pointers, structs are held by address.
+struct lower_value {
+    uint32_t value;
+    uint32_t type;
+};
+
+// Object designated by an lvalue: the SSA variable `var` or the memory at
+// `address`.
+struct lower_place {
+    uint32_t var;
+    uint32_t address;
+    uint32_t type;
+};
+
+static struct lower_value lower_expr(struct lower *l, uint32_t n);
+static void lower_statement(struct lower *l, uint32_t n);
+
+static void lower_error(struct lower *l, uint32_t token, const char *msg, ...) {
+    if (l->quiet) compiler_fail(l->compiler);
+    struct token *tok = parser_token(l->parser, token);
+    va_list args;
+    printf("[ERROR]: ");
+    va_start(args, msg);
+    vprintf(msg, args);
+    va_end(args);
+    printf("\nSemantic error at line: %d, col: %d at file: %s\n",
+           tok->pos.line, tok->pos.col, l->compiler->pos.filename);
+    compiler_fail(l->compiler);
+}
+
+static struct node *lower_node(struct lower *l, uint32_t n) {
+    return ast_node(&l->parser->ast, n);
+}
+
+static uint32_t *lower_list(struct lower *l, uint32_t list, uint32_t *count) {
+    return ast_list(&l->parser->ast, list, count);
+}
+
+static struct type *lower_type(struct lower *l, uint32_t type) {
+    return types_get(l->types, type);
+}
+
+// IR type holding values of the C `type`, structs are addresses.
+static int lower_ir_type(struct lower *l, uint32_t type) {
+    struct type *t = lower_type(l, type);
+    if (t->kind == TYPE_VOID) return IR_VOID;
+    if (t->kind != TYPE_INTEGER) return IR_I64;
+    switch (t->size) {
+    case 1:
+        return IR_I8;
+    case 2:
+        return IR_I16;
+    case 4:
+        return IR_I32;
+    }
+    return IR_I64;
+}
+
+static uint32_t lower_emit(struct lower *l, int op, int type, uint32_t a,
+                           uint32_t b) {
+    return ir_emit(l->builder, op, type, a, b);
+}
+
+static uint32_t lower_const(struct lower *l, int type, int64_t value) {
+    return ir_emit_const(l->builder, type, value);
+}
+
+// Address `offset` bytes past `address`.
+static uint32_t lower_offset(struct lower *l, uint32_t address,
+                             uint32_t offset) {
+    if (!offset) return address;
+    return lower_emit(l, IR_ADD, IR_I64, address,
+                      lower_const(l, IR_I64, offset));
+}
+
+// Jumps to `target` unless the current block already ended, by a return or
+// a jump.
+static void lower_jump(struct lower *l, uint32_t target) {
+    if (!ir_terminated(l->builder)) ir_jump(l->builder, target);
+}
+
+// Returns `v` converted to `to`.
+static uint32_t lower_convert(struct lower *l, struct lower_value v,
+                              uint32_t to, uint32_t token) {
+    struct type *from = lower_type(l, v.type);
+    struct type *t = lower_type(l, to);
+    if (t->kind == TYPE_VOID) return 0;
+    if (from->kind == TYPE_FLOATING || t->kind == TYPE_FLOATING) {
+        lower_error(l, token, "Floating point types are not supported");
+        return 0;
+    }
+    if (from->kind == TYPE_STRUCT || t->kind == TYPE_STRUCT) {
+        if (v.type != to) lower_error(l, token, "Incompatible struct types");
+        return v.value;
+    }
+    if (!types_is_scalar(l->types, v.type)) {
+        lower_error(l, token, "Void value used in an expression");
+        return 0;
+    }
+    int from_ir = lower_ir_type(l, v.type), to_ir = lower_ir_type(l, to);
+    if (from_ir == to_ir) return v.value;
+    if (to_ir < from_ir) return lower_emit(l, IR_TRUNC, to_ir, v.value, 0);
+    return lower_emit(l, from->flags & TYPE_FLAG_UNSIGNED ? IR_ZEXT : IR_SEXT,
+                      to_ir, v.value, 0);
+}
+
+// `v` after the integer promotions.
+static struct lower_value lower_promote(struct lower *l, struct lower_value v,
+                                        uint32_t token) {
+    uint32_t type = types_promote(l->types, v.type);
+    return (struct lower_value){lower_convert(l, v, type, token), type};
+}
+
+// Byte offset of `index` elements of `element`, as a long.
+static uint32_t lower_scale(struct lower *l, struct lower_value index,
+                            uint32_t element, uint32_t token) {
+    struct type *e = lower_type(l, element);
+    if (e->flags & TYPE_FLAG_INCOMPLETE || e->kind == TYPE_FUNCTION)
+        lower_error(l, token, "Arithmetic on a pointer to an incomplete type");
+    uint32_t offset = lower_convert(l, index, TYPE_ID_LONG, token);
+    if (e->size == 1) return offset;
+    return lower_emit(l, IR_MUL, IR_I64, offset,
+                      lower_const(l, IR_I64, e->size));
+}
+
+// Opcodes of the integer binary operators, signed then unsigned.
+static const uint8_t lower_binary_ops[OPERATOR_COUNT][2] = {
+    [OPERATOR_PLUS] = {IR_ADD, IR_ADD},
+    [OPERATOR_MINUS] = {IR_SUB, IR_SUB},
+    [OPERATOR_STAR] = {IR_MUL, IR_MUL},
+    [OPERATOR_SLASH] = {IR_SDIV, IR_UDIV},
+    [OPERATOR_PERCENT] = {IR_SREM, IR_UREM},
+    [OPERATOR_AMPERSAND] = {IR_AND, IR_AND},
+    [OPERATOR_PIPE] = {IR_OR, IR_OR},
+    [OPERATOR_CARET] = {IR_XOR, IR_XOR},
+    [OPERATOR_SHIFT_LEFT] = {IR_SHL, IR_SHL},
+    [OPERATOR_SHIFT_RIGHT] = {IR_SAR, IR_SHR},
+    [OPERATOR_LESS] = {IR_LT, IR_ULT},
+    [OPERATOR_GREATER] = {IR_GT, IR_UGT},
+    [OPERATOR_LESS_EQUAL] = {IR_LE, IR_ULE},
+    [OPERATOR_GREATER_EQUAL] = {IR_GE, IR_UGE},
+    [OPERATOR_EQUAL] = {IR_EQ, IR_EQ},
+    [OPERATOR_NOT_EQUAL] = {IR_NE, IR_NE},
+};
+
+// Operator applied by each compound assignment.
+static const uint8_t lower_compound_ops[OPERATOR_COUNT] = {
+    [OPERATOR_PLUS_ASSIGN] = OPERATOR_PLUS,
+    [OPERATOR_MINUS_ASSIGN] = OPERATOR_MINUS,
+    [OPERATOR_STAR_ASSIGN] = OPERATOR_STAR,
+    [OPERATOR_SLASH_ASSIGN] = OPERATOR_SLASH,
+    [OPERATOR_PERCENT_ASSIGN] = OPERATOR_PERCENT,
+    [OPERATOR_AMPERSAND_ASSIGN] = OPERATOR_AMPERSAND,
+    [OPERATOR_PIPE_ASSIGN] = OPERATOR_PIPE,
+    [OPERATOR_CARET_ASSIGN] = OPERATOR_CARET,
+    [OPERATOR_SHIFT_LEFT_ASSIGN] = OPERATOR_SHIFT_LEFT,
+    [OPERATOR_SHIFT_RIGHT_ASSIGN] = OPERATOR_SHIFT_RIGHT,
+};
+
+static bool lower_is_comparison(int op) {
+    return lower_binary_ops[op][0] >= IR_EQ && lower_binary_ops[op][0] <= IR_UGE;
+}
+
+static struct lower_value lower_invalid_operands(struct lower *l, int op,
+                                                 uint32_t token) {
+    lower_error(l, token, "Invalid operands to binary '%s'",
+                operator_spelling(op));
+    return (struct lower_value){0, TYPE_ID_INT};
+}
+
+// `lhs` op `rhs` for the arithmetic, bitwise, shift and comparison operators.
+static struct lower_value lower_arith(struct lower *l, int op,
+                                      struct lower_value lhs,
+                                      struct lower_value rhs, uint32_t token) {
+    struct type *lt = lower_type(l, lhs.type), *rt = lower_type(l, rhs.type);
+    if (lt->kind == TYPE_FLOATING || rt->kind == TYPE_FLOATING) {
+        lower_error(l, token, "Floating point types are not supported");
+        return lhs;
+    }
+    bool lp = lt->kind == TYPE_POINTER, rp = rt->kind == TYPE_POINTER;
+    if (!(lp || lt->kind == TYPE_INTEGER) || !(rp || rt->kind == TYPE_INTEGER))
+        return lower_invalid_operands(l, op, token);
+
+    if (lp || rp) {
+        if (lower_is_comparison(op)) {
+            // pointers compare as addresses, null constants are integers.
+            uint32_t a = lower_convert(l, lhs, TYPE_ID_UNSIGNED_LONG, token);
+            uint32_t b = lower_convert(l, rhs, TYPE_ID_UNSIGNED_LONG, token);
+            return (struct lower_value){
+                lower_emit(l, lower_binary_ops[op][1], IR_I64, a, b),
+                TYPE_ID_INT};
+        }
+        if (op == OPERATOR_PLUS && lp != rp) {
+            struct lower_value pointer = lp ? lhs : rhs, index = lp ? rhs : lhs;
+            uint32_t base = lower_type(l, pointer.type)->base;
+            uint32_t offset = lower_scale(l, index, base, token);
+            return (struct lower_value){
+                lower_emit(l, IR_ADD, IR_I64, pointer.value, offset),
+                pointer.type};
+        }
+        if (op == OPERATOR_MINUS && lp && !rp) {
+            uint32_t offset = lower_scale(l, rhs, lt->base, token);
+            return (struct lower_value){
+                lower_emit(l, IR_SUB, IR_I64, lhs.value, offset), lhs.type};
+        }
+        if (op == OPERATOR_MINUS && lp && rp) {
+            uint32_t size = lower_type(l, lt->base)->size;
+            uint32_t diff = lower_emit(l, IR_SUB, IR_I64, lhs.value, rhs.value);
+            if (size > 1)
+                diff = lower_emit(l, IR_SDIV, IR_I64, diff,
+                                  lower_const(l, IR_I64, size));
+            return (struct lower_value){diff, TYPE_ID_LONG};
+        }
+        return lower_invalid_operands(l, op, token);
+    }
+
+    if (!lower_binary_ops[op][0]) return lower_invalid_operands(l, op, token);
+    uint32_t type;
+    if (op == OPERATOR_SHIFT_LEFT || op == OPERATOR_SHIFT_RIGHT) {
+        // the promoted left operand alone gives the type.
+        type = types_promote(l->types, lhs.type);
+    } else {
+        type = types_common(l->types, types_promote(l->types, lhs.type),
+                            types_promote(l->types, rhs.type));
+    }
+    int ir_type = lower_ir_type(l, type);
+    uint32_t a = lower_convert(l, lhs, type, token);
+    uint32_t b = lower_convert(l, rhs, type, token);
+    int ir_op = lower_binary_ops[op][types_is_unsigned(l->types, type)];
+    uint32_t value = lower_emit(l, ir_op, ir_type, a, b);
+    return (struct lower_value){
+        value, lower_is_comparison(op) ? TYPE_ID_INT : type};
+}
+
+// The value of an object, see lower_value.
+static struct lower_value lower_load(struct lower *l, struct lower_place p,
+                                     uint32_t token) {
+    struct type *t = lower_type(l, p.type);
+    switch (t->kind) {
+    case TYPE_ARRAY:
+        return (struct lower_value){p.address, types_pointer(l->types, t->base)};
+    case TYPE_FUNCTION:
+        return (struct lower_value){p.address, types_pointer(l->types, p.type)};
+    case TYPE_STRUCT:
+        if (t->flags & TYPE_FLAG_INCOMPLETE)
+            lower_error(l, token, "Use of an incomplete struct");
+        return (struct lower_value){p.address, p.type};
+    case TYPE_VOID:
+        return (struct lower_value){0, TYPE_ID_VOID};
+    case TYPE_FLOATING:
+        lower_error(l, token, "Floating point types are not supported");
+        return (struct lower_value){0, TYPE_ID_VOID};
+    }
+    int ir_type = lower_ir_type(l, p.type);
+    if (p.var)
+        return (struct lower_value){ir_read_var(l->builder, p.var, ir_type),
+                                    p.type};
+    return (struct lower_value){lower_emit(l, IR_LOAD, ir_type, p.address, 0),
+                                p.type};
+}
+
+// Stores the scalar `value`, already of the place's type.
+static void lower_store(struct lower *l, struct lower_place p, uint32_t value) {
+    if (p.var)
+        ir_write_var(l->builder, p.var, value);
+    else
+        lower_emit(l, IR_STORE, lower_ir_type(l, p.type), p.address, value);
+}
+
+// Widest access of at most `size` bytes, returns its width.
+static uint32_t lower_chunk(uint32_t size, int *type) {
+    if (size >= 8) {
+        *type = IR_I64;
+        return 8;
+    }
+    if (size >= 4) {
+        *type = IR_I32;
+        return 4;
+    }
+    if (size >= 2) {
+        *type = IR_I16;
+        return 2;
+    }
+    *type = IR_I8;
+    return 1;
+}
+
+// Copies `size` bytes from `src` to `dst`, the objects don't overlap.
+static void lower_copy(struct lower *l, uint32_t dst, uint32_t src,
+                       uint32_t size) {
+    for (uint32_t offset = 0; offset < size;) {
+        int type;
+        uint32_t width = lower_chunk(size - offset, &type);
+        uint32_t value =
+            lower_emit(l, IR_LOAD, type, lower_offset(l, src, offset), 0);
+        lower_emit(l, IR_STORE, type, lower_offset(l, dst, offset), value);
+        offset += width;
+    }
+}
+
+// Clears `size` bytes at `address`. Large objects are cleared 8 bytes at a
+// time by a loop counting in the SSA variable `var`.
+static void lower_zero(struct lower *l, uint32_t address, uint32_t size,
+                       uint32_t var) {
+    struct ir_builder *b = l->builder;
+    uint32_t offset = 0;
+    if (size > LOWER_UNROLL_BYTES) {
+        offset = size & ~7u;
+        uint32_t end = lower_offset(l, address, offset);
+        uint32_t head = ir_new_block(b), exit = ir_new_block(b);
+        ir_write_var(b, var, address);
+        ir_jump(b, head);
+        ir_set_block(b, head);
+        uint32_t at = ir_read_var(b, var, IR_I64);
+        lower_emit(l, IR_STORE, IR_I64, at, lower_const(l, IR_I64, 0));
+        uint32_t next = lower_offset(l, at, 8);
+        ir_write_var(b, var, next);
+        ir_branch(b, lower_emit(l, IR_ULT, IR_I64, next, end), head, exit);
+        ir_seal_block(b, head);
+        ir_seal_block(b, exit);
+        ir_set_block(b, exit);
+    }
+    while (offset < size) {
+        int type;
+        uint32_t width = lower_chunk(size - offset, &type);
+        lower_emit(l, IR_STORE, type, lower_offset(l, address, offset),
+                   lower_const(l, type, 0));
+        offset += width;
+    }
+}
+
+// Where the lvalue `n` is.
+static struct lower_place lower_place(struct lower *l, uint32_t n) {
+    struct node *node = lower_node(l, n);
+    switch (node->kind) {
+    case NODE_IDENTIFIER: {
+        uint32_t decl = node->a;
+        uint32_t type = types_type_of(l->types, decl);
+        uint32_t local = ir_map_get(&l->locals, decl);
+        if (local == LOWER_LOCAL_SSA)
+            return (struct lower_place){.var = decl, .type = type};
+        if (local && local != LOWER_LOCAL_ADDRESSED)
+            return (struct lower_place){.address = local, .type = type};
+        return (struct lower_place){
+            .address = lower_emit(l, IR_GLOBAL, IR_I64, decl, 0), .type = type};
+    }
+    case NODE_UNARY:
+        if (node->op != OPERATOR_STAR) break;
+        struct lower_value pointer = lower_expr(l, node->a);
+        if (lower_type(l, pointer.type)->kind != TYPE_POINTER) {
+            lower_error(l, node->token, "Dereference of a non-pointer");
+            break;
+        }
+        return (struct lower_place){
+            .address = pointer.value,
+            .type = lower_type(l, pointer.type)->base};
+    case NODE_INDEX: {
+        struct lower_value base = lower_expr(l, node->a);
+        struct lower_value index = lower_expr(l, node->b);
+        if (lower_type(l, index.type)->kind == TYPE_POINTER) {
+            struct lower_value swap = base;
+            base = index;
+            index = swap;
+        }
+        if (lower_type(l, base.type)->kind != TYPE_POINTER ||
+            !types_is_integer(l->types, index.type)) {
+            lower_error(l, node->token, "Subscript of a non-array");
+            break;
+        }
+        uint32_t element = lower_type(l, base.type)->base;
+        uint32_t offset = lower_scale(l, index, element, node->token);
+        return (struct lower_place){
+            .address = lower_emit(l, IR_ADD, IR_I64, base.value, offset),
+            .type = element};
+    }
+    case NODE_MEMBER: {
+        struct lower_value base = lower_expr(l, node->a);
+        uint32_t type = base.type;
+        if (node->op == OPERATOR_ARROW) {
+            if (lower_type(l, type)->kind != TYPE_POINTER) {
+                lower_error(l, node->token, "'->' applied to a non-pointer");
+                break;
+            }
+            type = lower_type(l, type)->base;
+        }
+        struct type *t = lower_type(l, type);
+        if (t->kind != TYPE_STRUCT || t->flags & TYPE_FLAG_INCOMPLETE) {
+            lower_error(l, node->token, "Member access of a non-struct");
+            break;
+        }
+        struct type_member *m = types_member(l->types, type, node->token);
+        if (!m) {
+            lower_error(l, node->token, "No member named '%s'",
+                        parser_token(l->parser, node->token)->sval);
+            break;
+        }
+        return (struct lower_place){
+            .address = lower_offset(l, base.value, m->offset), .type = m->type};
+    }
+    default:
+        lower_error(l, node->token, "Expression is not assignable");
+    }
+    return (struct lower_place){.type = TYPE_ID_INT};
+}
+
+// Value of a condition, 1 if it holds and 0 otherwise.
+static struct lower_value lower_condition(struct lower *l, uint32_t n);
+
+// Jumps to `then_block` if the scalar `n` isn't 0 and to `else_block`
+// otherwise, && and || short-circuit.
+static void lower_branch(struct lower *l, uint32_t n, uint32_t then_block,
+                         uint32_t else_block) {
+    struct ir_builder *b = l->builder;
+    struct node *node = lower_node(l, n);
+    if (node->kind == NODE_BINARY && (node->op == OPERATOR_LOGICAL_AND ||
+                                      node->op == OPERATOR_LOGICAL_OR)) {
+        uint32_t next = ir_new_block(b);
+        if (node->op == OPERATOR_LOGICAL_AND)
+            lower_branch(l, node->a, next, else_block);
+        else
+            lower_branch(l, node->a, then_block, next);
+        ir_seal_block(b, next);
+        ir_set_block(b, next);
+        lower_branch(l, node->b, then_block, else_block);
+        return;
+    }
+    if (node->kind == NODE_UNARY && node->op == OPERATOR_NOT) {
+        lower_branch(l, node->a, else_block, then_block);
+        return;
+    }
+    struct lower_value v = lower_expr(l, n);
+    if (!types_is_scalar(l->types, v.type))
+        lower_error(l, node->token, "Condition must have a scalar type");
+    ir_branch(b, v.value, then_block, else_block);
+}
+
+static struct lower_value lower_condition(struct lower *l, uint32_t n) {
+    struct ir_builder *b = l->builder;
+    uint32_t then_block = ir_new_block(b), else_block = ir_new_block(b);
+    uint32_t join = ir_new_block(b);
+    lower_branch(l, n, then_block, else_block);
+    ir_seal_block(b, then_block);
+    ir_seal_block(b, else_block);
+    // the condition's node names the variable joining both values.
+    ir_set_block(b, then_block);
+    ir_write_var(b, n, lower_const(l, IR_I32, 1));
+    ir_jump(b, join);
+    ir_set_block(b, else_block);
+    ir_write_var(b, n, lower_const(l, IR_I32, 0));
+    ir_jump(b, join);
+    ir_seal_block(b, join);
+    ir_set_block(b, join);
+    return (struct lower_value){ir_read_var(b, n, IR_I32), TYPE_ID_INT};
+}
+
+// Type of the result of a ?: with operands of types `a` and `b`.
+static uint32_t lower_conditional_type(struct lower *l, uint32_t a, uint32_t b,
+                                       uint32_t token) {
+    struct type *ta = lower_type(l, a), *tb = lower_type(l, b);
+    if (ta->kind == TYPE_INTEGER && tb->kind == TYPE_INTEGER)
+        return types_common(l->types, types_promote(l->types, a),
+                            types_promote(l->types, b));
+    if (ta->kind == TYPE_VOID || tb->kind == TYPE_VOID) return TYPE_ID_VOID;
+    if (ta->kind == TYPE_STRUCT && a == b) return a;
+    if (ta->kind == TYPE_POINTER && tb->kind == TYPE_INTEGER) return a;
+    if (ta->kind == TYPE_INTEGER && tb->kind == TYPE_POINTER) return b;
+    if (ta->kind == TYPE_POINTER && tb->kind == TYPE_POINTER)
+        return ta->base == TYPE_ID_VOID ? b : a;
+    lower_error(l, token, "Incompatible operand types in a conditional");
+    return TYPE_ID_VOID;
+}
+
+static struct lower_value lower_conditional(struct lower *l, uint32_t n) {
+    struct ir_builder *b = l->builder;
+    struct node *node = lower_node(l, n);
+    uint32_t *branches = &l->parser->ast.extra[node->b];
+    uint32_t then_block = ir_new_block(b), else_block = ir_new_block(b);
+    uint32_t join = ir_new_block(b);
+    lower_branch(l, node->a, then_block, else_block);
+    ir_seal_block(b, then_block);
+    ir_seal_block(b, else_block);
+
+    // both operands are lowered before the type of the result is known,
+    // their conversions go at the end of their branch.
+    ir_set_block(b, then_block);
+    struct lower_value lhs = lower_expr(l, branches[0]);
+    uint32_t then_end = b->current;
+    ir_set_block(b, else_block);
+    struct lower_value rhs = lower_expr(l, branches[1]);
+    uint32_t else_end = b->current;
+
+    uint32_t type = lower_conditional_type(l, lhs.type, rhs.type, node->token);
+    bool has_value = type != TYPE_ID_VOID;
+    ir_set_block(b, then_end);
+    if (has_value) ir_write_var(b, n, lower_convert(l, lhs, type, node->token));
+    ir_jump(b, join);
+    ir_set_block(b, else_end);
+    if (has_value) ir_write_var(b, n, lower_convert(l, rhs, type, node->token));
+    ir_jump(b, join);
+    ir_seal_block(b, join);
+    ir_set_block(b, join);
+    if (!has_value) return (struct lower_value){0, TYPE_ID_VOID};
+    return (struct lower_value){ir_read_var(b, n, lower_ir_type(l, type)),
+                                type};
+}
+
+static struct lower_value lower_call(struct lower *l, uint32_t n) {
+    struct node *node = lower_node(l, n);
+    struct lower_value callee = lower_expr(l, node->a);
+    struct type *pointer = lower_type(l, callee.type);
+    if (pointer->kind != TYPE_POINTER ||
+        lower_type(l, pointer->base)->kind != TYPE_FUNCTION) {
+        lower_error(l, node->token, "Called object is not a function");
+        return (struct lower_value){0, TYPE_ID_INT};
+    }
+    struct type *fn = lower_type(l, pointer->base);
+    uint32_t result = fn->base;
+    int result_kind = lower_type(l, result)->kind;
+    if (result_kind == TYPE_STRUCT || result_kind == TYPE_FLOATING)
+        lower_error(l, node->token,
+                    "Calls returning structs or floating point values are not "
+                    "supported");
+
+    uint32_t count;
+    uint32_t *args = lower_list(l, node->b, &count);
+    bool variadic = fn->flags & TYPE_FLAG_VARIADIC;
+    // f() and f(void) both have no parameters, calls of either aren't
+    // checked beyond the parameters there are.
+    if (count < fn->count)
+        lower_error(l, node->token, "Too few arguments in a call");
+    if (count > fn->count && fn->count && !variadic)
+        lower_error(l, node->token, "Too many arguments in a call");
+
+    // nested calls stack their arguments above those of the enclosing call.
+    uint32_t top = l->arg_count;
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t arg = args[i];
+        struct lower_value v = lower_expr(l, arg);
+        if (!types_is_scalar(l->types, v.type))
+            lower_error(l, lower_node(l, arg)->token,
+                        "Passing structs or void by value is not supported");
+        uint32_t to = i < fn->count ? l->types->params[fn->first + i]
+                                    : types_promote(l->types, v.type);
+        uint32_t value = lower_convert(l, v, to, lower_node(l, arg)->token);
+        // callers extend char and short arguments to int, as the System V
+        // ABI is used in practice.
+        if (lower_ir_type(l, to) < IR_I32)
+            value = lower_convert(l, (struct lower_value){value, to},
+                                  types_promote(l->types, to),
+                                  lower_node(l, arg)->token);
+        if (l->arg_count == l->arg_capacity) {
+            l->arg_capacity = l->arg_capacity ? l->arg_capacity * 2 : 16;
+            l->args = realloc(l->args, l->arg_capacity * sizeof(uint32_t));
+        }
+        l->args[l->arg_count++] = value;
+    }
+    int flags = variadic || (!fn->count && count) ? IR_FLAG_VARIADIC : 0;
+    uint32_t call =
+        ir_emit_call(l->builder, lower_ir_type(l, result), callee.value,
+                     &l->args[top], count, flags);
+    l->arg_count = top;
+    return (struct lower_value){call, result};
+}
+
+// ++ and -- of `n`, yielding the new value if `prefix` and the old one
+// otherwise.
+static struct lower_value lower_increment(struct lower *l, uint32_t n,
+                                          bool prefix) {
+    struct node *node = lower_node(l, n);
+    int op = node->op == OPERATOR_INCREMENT ? OPERATOR_PLUS : OPERATOR_MINUS;
+    struct lower_place p = lower_place(l, node->a);
+    struct lower_value old = lower_load(l, p, node->token);
+    if (!types_is_scalar(l->types, p.type)) {
+        lower_error(l, node->token, "Invalid operand to '%s'",
+                    operator_spelling(node->op));
+        return old;
+    }
+    struct lower_value one = {lower_const(l, IR_I32, 1), TYPE_ID_INT};
+    struct lower_value sum = lower_arith(l, op, old, one, node->token);
+    uint32_t value = lower_convert(l, sum, p.type, node->token);
+    lower_store(l, p, value);
+    return prefix ? (struct lower_value){value, p.type} : old;
+}
+
+static struct lower_value lower_assign(struct lower *l, uint32_t n) {
+    struct node *node = lower_node(l, n);
+    struct lower_place p = lower_place(l, node->a);
+    struct type *t = lower_type(l, p.type);
+    if (t->kind == TYPE_ARRAY || t->kind == TYPE_FUNCTION) {
+        lower_error(l, node->token, "Assignment to an array or function");
+        return (struct lower_value){0, p.type};
+    }
+    if (node->op == OPERATOR_ASSIGN) {
+        struct lower_value v = lower_expr(l, node->b);
+        if (t->kind == TYPE_STRUCT) {
+            if (v.type != p.type)
+                lower_error(l, node->token, "Incompatible struct types");
+            lower_copy(l, p.address, v.value, t->size);
+            return (struct lower_value){p.address, p.type};
+        }
+        uint32_t value = lower_convert(l, v, p.type, node->token);
+        lower_store(l, p, value);
+        return (struct lower_value){value, p.type};
+    }
+    struct lower_value old = lower_load(l, p, node->token);
+    struct lower_value rhs = lower_expr(l, node->b);
+    struct lower_value result =
+        lower_arith(l, lower_compound_ops[node->op], old, rhs, node->token);
+    uint32_t value = lower_convert(l, result, p.type, node->token);
+    lower_store(l, p, value);
+    return (struct lower_value){value, p.type};
+}
+
+static bool lower_is_place(struct node *node) {
+    switch (node->kind) {
+    case NODE_IDENTIFIER:
+    case NODE_INDEX:
+    case NODE_MEMBER:
+        return true;
+    case NODE_UNARY:
+        return node->op == OPERATOR_STAR;
+    }
+    return false;
+}
+
+// Type of the operand of sizeof, `n` isn't evaluated: its code goes to a
+// block nothing jumps to.
+static uint32_t lower_type_of(struct lower *l, uint32_t n) {
+    struct ir_builder *b = l->builder;
+    uint32_t current = b->current;
+    uint32_t dead = ir_new_block(b);
+    ir_seal_block(b, dead);
+    ir_set_block(b, dead);
+    uint32_t type = lower_is_place(lower_node(l, n)) ? lower_place(l, n).type
+                                                     : lower_expr(l, n).type;
+    ir_set_block(b, current);
+    return type;
+}
+
+static struct lower_value lower_sizeof(struct lower *l, uint32_t n) {
+    struct node *node = lower_node(l, n);
+    int64_t size;
+    if (!types_constant(l->types, n, &size)) {
+        uint32_t type = node->kind == NODE_SIZEOF_TYPE
+                            ? types_type_of(l->types, node->a)
+                            : lower_type_of(l, node->a);
+        struct type *t = lower_type(l, type);
+        if (t->flags & TYPE_FLAG_INCOMPLETE || t->kind == TYPE_FUNCTION ||
+            t->kind == TYPE_VOID)
+            lower_error(l, node->token, "sizeof applied to an incomplete type");
+        size = t->size;
+    }
+    return (struct lower_value){lower_const(l, IR_I64, size),
+                                TYPE_ID_UNSIGNED_LONG};
+}
+
+static struct lower_value lower_unary(struct lower *l, uint32_t n) {
+    struct node *node = lower_node(l, n);
+    switch (node->op) {
+    case OPERATOR_STAR:
+        return lower_load(l, lower_place(l, n), node->token);
+    case OPERATOR_AMPERSAND: {
+        struct node *operand = lower_node(l, node->a);
+        if (!lower_is_place(operand)) {
+            lower_error(l, node->token, "Cannot take the address of an rvalue");
+            break;
+        }
+        // lower_scan gave every local whose address is taken a slot.
+        struct lower_place p = lower_place(l, node->a);
+        return (struct lower_value){p.address,
+                                    types_pointer(l->types, p.type)};
+    }
+    case OPERATOR_INCREMENT:
+    case OPERATOR_DECREMENT:
+        return lower_increment(l, n, true);
+    case OPERATOR_NOT: {
+        struct lower_value v = lower_expr(l, node->a);
+        if (!types_is_scalar(l->types, v.type)) break;
+        int type = lower_ir_type(l, v.type);
+        return (struct lower_value){
+            lower_emit(l, IR_EQ, type, v.value, lower_const(l, type, 0)),
+            TYPE_ID_INT};
+    }
+    case OPERATOR_PLUS:
+    case OPERATOR_MINUS:
+    case OPERATOR_TILDE: {
+        struct lower_value v = lower_expr(l, node->a);
+        if (!types_is_integer(l->types, v.type)) break;
+        v = lower_promote(l, v, node->token);
+        if (node->op == OPERATOR_PLUS) return v;
+        int op = node->op == OPERATOR_MINUS ? IR_NEG : IR_NOT;
+        return (struct lower_value){
+            lower_emit(l, op, lower_ir_type(l, v.type), v.value, 0), v.type};
+    }
+    }
+    lower_error(l, node->token, "Invalid operand to unary '%s'",
+                operator_spelling(node->op));
+    return (struct lower_value){0, TYPE_ID_INT};
+}
+
+static struct lower_value lower_binary(struct lower *l, uint32_t n) {
+    struct node *node = lower_node(l, n);
+    switch (node->op) {
+    case OPERATOR_ASSIGN:
+        return lower_assign(l, n);
+    case OPERATOR_COMMA:
+        lower_expr(l, node->a);
+        return lower_expr(l, node->b);
+    case OPERATOR_LOGICAL_AND:
+    case OPERATOR_LOGICAL_OR:
+        return lower_condition(l, n);
+    }
+    if (lower_compound_ops[node->op]) return lower_assign(l, n);
+    struct lower_value lhs = lower_expr(l, node->a);
+    struct lower_value rhs = lower_expr(l, node->b);
+    return lower_arith(l, node->op, lhs, rhs, node->token);
+}
+
+static struct lower_value lower_expr(struct lower *l, uint32_t n) {
+    struct node *node = lower_node(l, n);
+    switch (node->kind) {
+    case NODE_NUMBER: {
+        struct token *tok = parser_token(l->parser, node->token);
+        uint32_t type = types_number(tok->number_type);
+        if (!types_is_integer(l->types, type)) break;
+        return (struct lower_value){
+            lower_const(l, lower_ir_type(l, type), (int64_t)tok->llnum), type};
+    }
+    case NODE_STRING:
+        return (struct lower_value){
+            lower_emit(l, IR_STRING, IR_I64, n, 0),
+            types_pointer(l->types, TYPE_ID_CHAR)};
+    case NODE_IDENTIFIER:
+    case NODE_INDEX:
+    case NODE_MEMBER:
+        return lower_load(l, lower_place(l, n), node->token);
+    case NODE_UNARY:
+        return lower_unary(l, n);
+    case NODE_POSTFIX:
+        return lower_increment(l, n, false);
+    case NODE_BINARY:
+        return lower_binary(l, n);
+    case NODE_CONDITIONAL:
+        return lower_conditional(l, n);
+    case NODE_CALL:
+        return lower_call(l, n);
+    case NODE_CAST: {
+        uint32_t type = types_type_of(l->types, node->a);
+        struct lower_value v = lower_expr(l, node->b);
+        if (type == TYPE_ID_VOID) return (struct lower_value){0, TYPE_ID_VOID};
+        if (!types_is_scalar(l->types, type)) {
+            lower_error(l, node->token, "Cast to a non-scalar type");
+            break;
+        }
+        return (struct lower_value){lower_convert(l, v, type, node->token),
+                                    type};
+    }
+    case NODE_SIZEOF_EXPR:
+    case NODE_SIZEOF_TYPE:
+        return lower_sizeof(l, n);
+    }
+    lower_error(l, node->token, "Unsupported expression");
+    return (struct lower_value){0, TYPE_ID_INT};
+}
+
+// Stores the initializer `n` of an object of `type` at `address`, which is
+// cleared already if it's an aggregate.
+static void lower_init(struct lower *l, uint32_t address, uint32_t type,
+                       uint32_t n) {
+    struct node *node = lower_node(l, n);
+    struct type *t = lower_type(l, type);
+    uint32_t count = 0;
+    uint32_t *items = NULL;
+    if (node->kind == NODE_INIT_LIST) items = lower_list(l, node->a, &count);
+
+    if (t->kind == TYPE_ARRAY) {
+        struct type *element = lower_type(l, t->base);
+        if (node->kind == NODE_STRING && element->kind == TYPE_INTEGER &&
+            element->size == 1) {
+            // the terminating NULL character is dropped if it doesn't fit.
+            uint32_t length = types_string_length(l->types, n);
+            if (length - 1 > t->size)
+                lower_error(l, node->token, "Initializer string is too long");
+            if (length > t->size) length = t->size;
+            lower_copy(l, address, lower_emit(l, IR_STRING, IR_I64, n, 0),
+                       length);
+            return;
+        }
+        if (node->kind != NODE_INIT_LIST) {
+            lower_error(l, node->token, "Array initializer must be a list");
+            return;
+        }
+        if (count > t->count)
+            lower_error(l, node->token, "Too many initializers");
+        for (uint32_t i = 0; i < count; i++)
+            lower_init(l, lower_offset(l, address, i * element->size), t->base,
+                       items[i]);
+        return;
+    }
+
+    if (t->kind == TYPE_STRUCT) {
+        if (node->kind != NODE_INIT_LIST) {
+            struct lower_value v = lower_expr(l, n);
+            if (v.type != type)
+                lower_error(l, node->token, "Incompatible struct types");
+            lower_copy(l, address, v.value, t->size);
+            return;
+        }
+        // a union is initialized through its first member.
+        uint32_t members = t->flags & TYPE_FLAG_UNION && t->count ? 1 : t->count;
+        if (count > members)
+            lower_error(l, node->token, "Too many initializers");
+        for (uint32_t i = 0; i < count; i++) {
+            struct type_member *m = &l->types->members[t->first + i];
+            lower_init(l, lower_offset(l, address, m->offset), m->type,
+                       items[i]);
+        }
+        return;
+    }
+
+    if (node->kind == NODE_INIT_LIST) {
+        if (count > 1) lower_error(l, node->token, "Too many initializers");
+        if (count) lower_init(l, address, type, items[0]);
+        return;
+    }
+    struct lower_value v = lower_expr(l, n);
+    lower_emit(l, IR_STORE, lower_ir_type(l, type), address,
+               lower_convert(l, v, type, node->token));
+}
+
+// Gives the local `var` of `type` its SSA variable or slot.
+static struct lower_place lower_declare(struct lower *l, uint32_t var,
+                                        uint32_t type) {
+    if (ir_map_get(&l->locals, var) != LOWER_LOCAL_ADDRESSED &&
+        types_is_scalar(l->types, type)) {
+        ir_map_set(&l->locals, var, LOWER_LOCAL_SSA);
+        return (struct lower_place){.var = var, .type = type};
+    }
+    struct type *t = lower_type(l, type);
+    uint32_t slot = ir_emit_entry(l->builder, IR_SLOT, IR_I64,
+                                  t->size ? t->size : 1, t->align);
+    ir_map_set(&l->locals, var, slot);
+    return (struct lower_place){.address = slot, .type = type};
+}
+
+static void lower_declaration(struct lower *l, uint32_t n) {
+    uint32_t count;
+    uint32_t *vars = lower_list(l, lower_node(l, n)->a, &count);
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t var = vars[i];
+        struct node *node = lower_node(l, var);
+        uint32_t type = types_type_of(l->types, var);
+        struct type *t = lower_type(l, type);
+        // static and extern locals and function declarations are globals.
+        if (node->flags & (NODE_FLAG_STATIC | NODE_FLAG_EXTERN) ||
+            t->kind == TYPE_FUNCTION)
+            continue;
+        if (t->flags & TYPE_FLAG_INCOMPLETE || t->kind == TYPE_VOID)
+            lower_error(l, node->token, "Variable '%s' has an incomplete type",
+                        parser_token(l->parser, node->token)->sval);
+        if (t->kind == TYPE_FLOATING)
+            lower_error(l, node->token, "Floating point types are not supported");
+
+        struct lower_place p = lower_declare(l, var, type);
+        if (!node->b) continue;
+        struct node *init = lower_node(l, node->b);
+        if (p.var) {
+            uint32_t init_count = 0;
+            uint32_t value = node->b;
+            if (init->kind == NODE_INIT_LIST) {
+                uint32_t *items = lower_list(l, init->a, &init_count);
+                if (init_count > 1)
+                    lower_error(l, init->token, "Too many initializers");
+                value = init_count ? items[0] : 0;
+            }
+            if (value)
+                lower_store(l, p, lower_convert(l, lower_expr(l, value), type,
+                                                init->token));
+            else
+                lower_store(l, p, lower_const(l, lower_ir_type(l, type), 0));
+            continue;
+        }
+        // members and elements left out of the initializer are 0.
+        if (init->kind == NODE_INIT_LIST || init->kind == NODE_STRING)
+            lower_zero(l, p.address, t->size, var);
+        lower_init(l, p.address, type, node->b);
+    }
+}
+
+// Block of the NODE_LABEL `label`, made on first use.
+static uint32_t lower_label(struct lower *l, uint32_t label) {
+    uint32_t block = ir_map_get(&l->labels, label);
+    if (block) return block - 1;
+    block = ir_new_block(l->builder);
+    ir_map_set(&l->labels, label, block + 1);
+    return block;
+}
+
+static int lower_compare_cases(const void *a, const void *b) {
+    const struct lower_case *ca = a, *cb = b;
+    if (ca->value != cb->value) return ca->value < cb->value ? -1 : 1;
+    return ca->token < cb->token ? -1 : ca->token > cb->token;
+}
+
+static void lower_switch(struct lower *l, uint32_t n) {
+    struct ir_builder *b = l->builder;
+    struct node *node = lower_node(l, n);
+    struct lower_value v = lower_expr(l, node->a);
+    if (!types_is_integer(l->types, v.type))
+        lower_error(l, node->token, "Switch quantity is not an integer");
+    v = lower_promote(l, v, node->token);
+
+    // the body is lowered first, the cases are known when the switch is
+    // added at the end of the block computing the value.
+    uint32_t dispatch = b->current;
+    uint32_t exit = ir_new_block(b);
+    uint32_t break_block = l->break_block, first = l->switch_first;
+    uint32_t default_block = l->switch_default, type = l->switch_type;
+    l->break_block = exit;
+    l->switch_first = l->case_count;
+    l->switch_default = 0;
+    l->switch_type = v.type;
+
+    uint32_t body = ir_new_block(b);
+    ir_seal_block(b, body);
+    ir_set_block(b, body);
+    lower_statement(l, node->b);
+    lower_jump(l, exit);
+
+    struct lower_case *cases = &l->cases[l->switch_first];
+    uint32_t count = l->case_count - l->switch_first;
+    qsort(cases, count, sizeof(struct lower_case), lower_compare_cases);
+    for (uint32_t i = 1; i < count; i++)
+        if (cases[i].value == cases[i - 1].value)
+            lower_error(l, cases[i].token, "Duplicate case value");
+    int64_t *values = malloc(count * sizeof(int64_t) + 1);
+    uint32_t *blocks = malloc(count * sizeof(uint32_t) + 1);
+    for (uint32_t i = 0; i < count; i++) {
+        values[i] = cases[i].value;
+        blocks[i] = cases[i].block;
+    }
+    uint32_t fallback = l->switch_default ? l->switch_default - 1 : exit;
+    ir_set_block(b, dispatch);
+    ir_switch(b, lower_ir_type(l, v.type), v.value, fallback, values, blocks,
+              count);
+    for (uint32_t i = 0; i < count; i++) ir_seal_block(b, blocks[i]);
+    if (l->switch_default) ir_seal_block(b, l->switch_default - 1);
+    ir_seal_block(b, exit);
+    ir_set_block(b, exit);
+    free(values);
+    free(blocks);
+
+    l->case_count = l->switch_first;
+    l->break_block = break_block;
+    l->switch_first = first;
+    l->switch_default = default_block;
+    l->switch_type = type;
+}
+
+// Starts the block of a case or default label, reached from the switch and
+// by falling through.
+static uint32_t lower_case_block(struct lower *l) {
+    uint32_t block = ir_new_block(l->builder);
+    lower_jump(l, block);
+    ir_set_block(l->builder, block);
+    return block;
+}
+
+static void lower_case(struct lower *l, uint32_t n) {
+    struct node *node = lower_node(l, n);
+    if (!l->switch_type) {
+        lower_error(l, node->token, "'case' outside of a switch");
+        return;
+    }
+    int64_t value;
+    if (!types_constant(l->types, node->a, &value))
+        lower_error(l, node->token, "Case value is not an integer constant");
+    if (l->case_count == l->case_capacity) {
+        l->case_capacity = l->case_capacity ? l->case_capacity * 2 : 16;
+        l->cases = realloc(l->cases, l->case_capacity * sizeof(struct lower_case));
+    }
+    l->cases[l->case_count++] = (struct lower_case){
+        .value = types_truncate(l->types, l->switch_type, value),
+        .block = lower_case_block(l),
+        .token = node->token,
+    };
+    lower_statement(l, node->b);
+}
+
+static void lower_if(struct lower *l, struct node *node) {
+    struct ir_builder *b = l->builder;
+    uint32_t *branches = &l->parser->ast.extra[node->b];
+    uint32_t then_block = ir_new_block(b), join = ir_new_block(b);
+    uint32_t else_block = branches[1] ? ir_new_block(b) : join;
+    lower_branch(l, node->a, then_block, else_block);
+    ir_seal_block(b, then_block);
+    ir_set_block(b, then_block);
+    lower_statement(l, branches[0]);
+    lower_jump(l, join);
+    if (branches[1]) {
+        ir_seal_block(b, else_block);
+        ir_set_block(b, else_block);
+        lower_statement(l, branches[1]);
+        lower_jump(l, join);
+    }
+    ir_seal_block(b, join);
+    ir_set_block(b, join);
+}
+
+// Lowers a loop body with break and continue leading to `exit` and `next`.
+static void lower_loop_body(struct lower *l, uint32_t n, uint32_t exit,
+                            uint32_t next) {
+    uint32_t break_block = l->break_block, continue_block = l->continue_block;
+    l->break_block = exit;
+    l->continue_block = next;
+    lower_statement(l, n);
+    lower_jump(l, next);
+    l->break_block = break_block;
+    l->continue_block = continue_block;
+}
+
+static void lower_while(struct lower *l, struct node *node) {
+    struct ir_builder *b = l->builder;
+    uint32_t head = ir_new_block(b), body = ir_new_block(b);
+    uint32_t exit = ir_new_block(b);
+    lower_jump(l, head);
+    ir_set_block(b, head);
+    lower_branch(l, node->a, body, exit);
+    ir_seal_block(b, body);
+    ir_set_block(b, body);
+    lower_loop_body(l, node->b, exit, head);
+    ir_seal_block(b, head);
+    ir_seal_block(b, exit);
+    ir_set_block(b, exit);
+}
+
+static void lower_do(struct lower *l, struct node *node) {
+    struct ir_builder *b = l->builder;
+    uint32_t body = ir_new_block(b), cond = ir_new_block(b);
+    uint32_t exit = ir_new_block(b);
+    lower_jump(l, body);
+    ir_set_block(b, body);
+    lower_loop_body(l, node->a, exit, cond);
+    ir_seal_block(b, cond);
+    ir_set_block(b, cond);
+    lower_branch(l, node->b, body, exit);
+    ir_seal_block(b, body);
+    ir_seal_block(b, exit);
+    ir_set_block(b, exit);
+}
+
+static void lower_for(struct lower *l, struct node *node) {
+    struct ir_builder *b = l->builder;
+    uint32_t *clauses = &l->parser->ast.extra[node->a];
+    if (clauses[0] && lower_node(l, clauses[0])->kind == NODE_DECLARATION)
+        lower_declaration(l, clauses[0]);
+    else if (clauses[0])
+        lower_expr(l, clauses[0]);
+
+    uint32_t head = ir_new_block(b), body = ir_new_block(b);
+    uint32_t step = ir_new_block(b), exit = ir_new_block(b);
+    lower_jump(l, head);
+    ir_set_block(b, head);
+    if (clauses[1])
+        lower_branch(l, clauses[1], body, exit);
+    else
+        ir_jump(b, body);
+    ir_seal_block(b, body);
+    ir_set_block(b, body);
+    lower_loop_body(l, node->b, exit, step);
+    ir_seal_block(b, step);
+    ir_set_block(b, step);
+    if (clauses[2]) lower_expr(l, clauses[2]);
+    lower_jump(l, head);
+    ir_seal_block(b, head);
+    ir_seal_block(b, exit);
+    ir_set_block(b, exit);
+}
+
+static void lower_return(struct lower *l, struct node *node) {
+    struct ir_builder *b = l->builder;
+    if (l->return_type == TYPE_ID_VOID) {
+        if (node->a && lower_expr(l, node->a).type != TYPE_ID_VOID)
+            lower_error(l, node->token, "Void function returns a value");
+        ir_return(b, IR_VOID, 0);
+        return;
+    }
+    int type = lower_ir_type(l, l->return_type);
+    if (!node->a) {
+        ir_return(b, type, 0);
+        return;
+    }
+    struct lower_value v = lower_expr(l, node->a);
+    ir_return(b, type, lower_convert(l, v, l->return_type, node->token));
+}
+
+static void lower_statement(struct lower *l, uint32_t n) {
+    if (!n) return;
+    struct node *node = lower_node(l, n);
+    switch (node->kind) {
+    case NODE_COMPOUND: {
+        uint32_t count;
+        uint32_t *items = lower_list(l, node->a, &count);
+        for (uint32_t i = 0; i < count; i++) lower_statement(l, items[i]);
+        break;
+    }
+    case NODE_DECLARATION:
+        lower_declaration(l, n);
+        break;
+    case NODE_EXPRESSION_STMT:
+        lower_expr(l, node->a);
+        break;
+    case NODE_EMPTY:
+        break;
+    case NODE_IF:
+        lower_if(l, node);
+        break;
+    case NODE_WHILE:
+        lower_while(l, node);
+        break;
+    case NODE_DO:
+        lower_do(l, node);
+        break;
+    case NODE_FOR:
+        lower_for(l, node);
+        break;
+    case NODE_SWITCH:
+        lower_switch(l, n);
+        break;
+    case NODE_CASE:
+        lower_case(l, n);
+        break;
+    case NODE_DEFAULT:
+        if (!l->switch_type) {
+            lower_error(l, node->token, "'default' outside of a switch");
+            break;
+        }
+        if (l->switch_default)
+            lower_error(l, node->token, "Multiple default labels in one switch");
+        l->switch_default = lower_case_block(l) + 1;
+        lower_statement(l, node->b);
+        break;
+    case NODE_LABEL: {
+        uint32_t block = lower_label(l, n);
+        lower_jump(l, block);
+        ir_set_block(l->builder, block);
+        lower_statement(l, node->a);
+        break;
+    }
+    case NODE_GOTO:
+        lower_jump(l, lower_label(l, node->a));
+        break;
+    case NODE_RETURN:
+        lower_return(l, node);
+        break;
+    case NODE_BREAK:
+        if (!l->break_block)
+            lower_error(l, node->token, "'break' outside of a loop or switch");
+        else
+            lower_jump(l, l->break_block);
+        break;
+    case NODE_CONTINUE:
+        if (!l->continue_block)
+            lower_error(l, node->token, "'continue' outside of a loop");
+        else
+            lower_jump(l, l->continue_block);
+        break;
+    default:
+        lower_error(l, node->token, "Unsupported statement");
+    }
+}
+
+// Marks the locals of `n` whose address is taken, they can't be SSA
+// variables.
+static void lower_scan(struct lower *l, uint32_t n) {
+    if (!n) return;
+    struct node *node = lower_node(l, n);
+    uint32_t count, *items;
+    switch (node->kind) {
+    case NODE_UNARY:
+        if (node->op == OPERATOR_AMPERSAND &&
+            lower_node(l, node->a)->kind == NODE_IDENTIFIER)
+            ir_map_set(&l->locals, lower_node(l, node->a)->a,
+                       LOWER_LOCAL_ADDRESSED);
+        lower_scan(l, node->a);
+        break;
+    case NODE_BINARY:
+    case NODE_INDEX:
+    case NODE_WHILE:
+    case NODE_DO:
+    case NODE_SWITCH:
+    case NODE_CASE:
+        lower_scan(l, node->a);
+        lower_scan(l, node->b);
+        break;
+    case NODE_POSTFIX:
+    case NODE_MEMBER:
+    case NODE_SIZEOF_EXPR:
+    case NODE_EXPRESSION_STMT:
+    case NODE_LABEL:
+    case NODE_RETURN:
+        lower_scan(l, node->a);
+        break;
+    case NODE_CAST:
+    case NODE_DEFAULT:
+    case NODE_VAR:
+        lower_scan(l, node->b);
+        break;
+    case NODE_CONDITIONAL:
+    case NODE_IF:
+        lower_scan(l, node->a);
+        lower_scan(l, l->parser->ast.extra[node->b]);
+        lower_scan(l, l->parser->ast.extra[node->b + 1]);
+        break;
+    case NODE_FOR:
+        for (int i = 0; i < 3; i++)
+            lower_scan(l, l->parser->ast.extra[node->a + i]);
+        lower_scan(l, node->b);
+        break;
+    case NODE_CALL:
+        lower_scan(l, node->a);
+        items = lower_list(l, node->b, &count);
+        for (uint32_t i = 0; i < count; i++) lower_scan(l, items[i]);
+        break;
+    case NODE_INIT_LIST:
+    case NODE_COMPOUND:
+    case NODE_DECLARATION:
+        items = lower_list(l, node->a, &count);
+        for (uint32_t i = 0; i < count; i++) lower_scan(l, items[i]);
+        break;
+    }
+}
+
+struct ir_function *lower_function(struct lower *l, uint32_t function) {
+    struct ir_builder *b = l->builder;
+    struct node *node = lower_node(l, function);
+    struct type *type = lower_type(l, types_type_of(l->types, function));
+    l->function = function;
+    l->return_type = type->base;
+    int return_kind = lower_type(l, type->base)->kind;
+    if (return_kind == TYPE_STRUCT || return_kind == TYPE_FLOATING)
+        lower_error(l, node->token,
+                    "Returning structs or floating point values is not "
+                    "supported");
+
+    ir_map_clear(&l->locals);
+    ir_map_clear(&l->labels);
+    l->break_block = l->continue_block = 0;
+    l->case_count = l->switch_first = l->switch_default = l->switch_type = 0;
+    l->arg_count = 0;
+    ir_builder_begin(b, &l->fn);
+    l->fn.node = function;
+    l->fn.name = parser_token(l->parser, node->token)->sval;
+
+    lower_scan(l, node->b);
+    uint32_t count;
+    uint32_t *params = lower_list(l, lower_node(l, node->a)->b, &count);
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t param = params[i];
+        uint32_t param_type = types_type_of(l->types, param);
+        if (!types_is_scalar(l->types, param_type)) {
+            lower_error(l, lower_node(l, param)->token,
+                        "Passing structs or floating point values is not "
+                        "supported");
+            continue;
+        }
+        uint32_t value = ir_emit_entry(b, IR_PARAM,
+                                       lower_ir_type(l, param_type), i, 0);
+        lower_store(l, lower_declare(l, param, param_type), value);
+    }
+
+    lower_statement(l, node->b);
+    if (!ir_terminated(b)) {
+        // falling off the end of main returns 0.
+        int result = lower_ir_type(l, l->return_type);
+        bool main = !strcmp(l->fn.name, "main") && result == IR_I32;
+        ir_return(b, result, main ? lower_const(l, IR_I32, 0) : 0);
+    }
+    ir_builder_finish(b);
+    return &l->fn;
+}
+
+struct lower *lower_create(struct compiler *c) {
+    struct lower *l = calloc(1, sizeof(struct lower));
+    l->compiler = c;
+    l->parser = c->parser;
+    l->types = c->types;
+    l->builder = ir_builder_create();
+    ir_function_init(&l->fn);
+    ir_map_init(&l->locals);
+    ir_map_init(&l->labels);
+    return l;
+}
+
+void lower_free(struct lower *l) {
+    if (!l) return;
+    ir_builder_free(l->builder);
+    ir_function_free(&l->fn);
+    ir_map_free(&l->locals);
+    ir_map_free(&l->labels);
+    free(l->cases);
+    free(l->args);
+    free(l);
+}
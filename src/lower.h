@@ -0,0 +1,75 @@
+#ifndef PEACHLOWER_H
+#define PEACHLOWER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "compiler.h"
+#include "ir.h"
+
+// A case label of the switch statements being lowered.
+struct lower_case {
+    int64_t value;
+    uint32_t block;
+    // token of the label, reported if its value was used before.
+    uint32_t token;
+};
+
+// Lowers the resolved, typed body of one function at a time to SSA form.
+//
+// Scalar locals whose address is never taken are SSA variables, every read
+// and write goes through the ir_builder which places the phis. Arrays,
+// structs and locals whose address is taken live in stack slots and are
+// loaded and stored.
+struct lower {
+    struct compiler *compiler;
+    struct parser *parser;
+    struct types *types;
+
+    struct ir_builder *builder;
+    // function last lowered, reused by the next one.
+    struct ir_function fn;
+
+    // NODE_FUNCTION being lowered and its return type.
+    uint32_t function;
+    uint32_t return_type;
+
+    // how each local of the function is held: LOWER_LOCAL_SSA or its
+    // IR_SLOT, by declaring node. Missing names are globals.
+    struct ir_map locals;
+    // block of each NODE_LABEL plus one.
+    struct ir_map labels;
+
+    // where break and continue jump to, 0 outside of loops and switches.
+    uint32_t break_block;
+    uint32_t continue_block;
+
+    // cases of the switches being lowered, innermost last. The innermost
+    // switch's cases start at `switch_first`.
+    struct lower_case *cases;
+    uint32_t case_count;
+    uint32_t case_capacity;
+    uint32_t switch_first;
+    // default block of the innermost switch plus one, 0 if it has none yet.
+    uint32_t switch_default;
+    // type of the innermost switch's value, 0 outside of switches.
+    uint32_t switch_type;
+
+    // arguments of the calls being lowered, innermost last.
+    uint32_t *args;
+    uint32_t arg_count;
+    uint32_t arg_capacity;
+
+    // errors fail the compile without being printed, see parser::quiet.
+    bool quiet;
+};
+
+struct lower *lower_create(struct compiler *c);
+void lower_free(struct lower *lower);
+
+// Lowers the body of the NODE_FUNCTION `function` into lower::fn, which is
+// returned. Whatever the previous call built is dropped. Errors are reported
+// on stdout and fail the compile, see compiler_fail.
+struct ir_function *lower_function(struct lower *lower, uint32_t function);
+
+#endif  // PEACHLOWER_H
@@ -1,25 +1,90 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
+#include "codegen.h"
 #include "compiler.h"
+#include "jit.h"
+
+static void usage(const char *program) {
+    printf("Usage: %s [-o <object>] [-j <threads>] [-O0|-O1] [--pipelined] "
+           "[--dump-ir] [--dump-asm] [<file.c>]\n"
+           "       %s --run [--fork] [-j <threads>] [-O0|-O1] [--pipelined] "
+           "<file.c> [<argument>...]\n",
+           program, program);
+}
 
 int main(int argc, char *argv[]) {
-    // if (argc < 2) {
-    // 	printf("Usage: %s <filename>\n", argv[0]);
-    // 	return 1;
-    // }
-    //
-    // const char *filename = argv[1];
-    // const char *out_filename = "out.txt";
-    // int flags = 0;
+    // without arguments test.c is compiled to out.txt.
+    const char *filename = "test.c";
+    const char *out_filename = "out.txt";
+    int flags = 0;
+    int threads = 0;
+    // with --run the object is run from memory instead, the arguments after
+    // the file are passed to its main, in a child process with --fork.
+    bool run = false;
+    bool isolated = false;
+    int program_argc = 0;
+    char **program_argv = NULL;
 
-    struct compiler *c = compiler_create("test.c", "out.txt", 0);
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (!strcmp(arg, "-o") && i + 1 < argc) {
+            out_filename = argv[++i];
+        } else if (!strcmp(arg, "-j") && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (!strcmp(arg, "-O0")) {
+            flags &= ~COMPILER_FLAG_OPTIMIZE;
+        } else if (!strcmp(arg, "-O1")) {
+            flags |= COMPILER_FLAG_OPTIMIZE;
+        } else if (!strcmp(arg, "--pipelined")) {
+            // lex on a thread of its own while the file scope is parsed.
+            flags |= COMPILER_FLAG_PIPELINED;
+        } else if (!strcmp(arg, "--dump-ir")) {
+            flags |= COMPILER_FLAG_DUMP_IR;
+        } else if (!strcmp(arg, "--dump-asm")) {
+            flags |= COMPILER_FLAG_DUMP_ASM;
+        } else if (!strcmp(arg, "--run")) {
+            run = true;
+        } else if (!strcmp(arg, "--fork")) {
+            isolated = true;
+        } else if (arg[0] == '-') {
+            usage(argv[0]);
+            return 1;
+        } else {
+            filename = arg;
+            if (run) {
+                program_argc = argc - i;
+                program_argv = &argv[i];
+                break;
+            }
+        }
+    }
+    if (run && !program_argv) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    struct compiler *c =
+        compiler_create(filename, run ? NULL : out_filename, flags);
     if (!c) {
         printf("Failed to create compiler\n");
         return 1;
     }
+    c->threads = threads;
 
     if (compile_file(c) != COMPILER_FILE_COMPILED_OK) {
         printf("Failed to compile file\n");
         return 1;
     }
+    if (run) {
+        struct jit *jit = jit_load(&c->codegen->object);
+        int status = -1;
+        if (jit) status = jit_run(jit, program_argc, program_argv, isolated);
+        // the program stays mapped, the handlers it gave atexit run after
+        // main returns.
+        compiler_free(c);
+        return status < 0 ? 1 : status;
+    }
+    compiler_free(c);
 }
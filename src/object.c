@@ -0,0 +1,373 @@
+#include "object.h"
+
+#include <elf.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "output.h"
+
+// Sections object_write adds after the code and data sections: one
+// relocation section per section with relocations, then these.
+enum {
+    OBJECT_SYMTAB,
+    OBJECT_STRTAB,
+    OBJECT_SHSTRTAB,
+    OBJECT_NOTE_STACK,
+    OBJECT_TRAILING_COUNT
+};
+
+static const struct {
+    const char *name;
+    uint32_t type;
+    uint64_t flags;
+    uint32_t align;
+    uint8_t fill;
+    uint32_t entsize;
+} object_sections[OBJECT_SECTION_COUNT] = {
+    [OBJECT_TEXT] = {".text", SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, 16, 0x90},
+    [OBJECT_DATA] = {".data", SHT_PROGBITS, SHF_ALLOC | SHF_WRITE, 8, 0},
+    [OBJECT_BSS] = {".bss", SHT_NOBITS, SHF_ALLOC | SHF_WRITE, 8, 0},
+    [OBJECT_RODATA] = {".rodata", SHT_PROGBITS, SHF_ALLOC, 8, 0},
+    [OBJECT_STRINGS] = {".rodata.str1.1", SHT_PROGBITS,
+                        SHF_ALLOC | SHF_MERGE | SHF_STRINGS, 1, 0, 1},
+};
+
+void object_init(struct object *object) {
+    memset(object, 0, sizeof(*object));
+    for (int i = 1; i < OBJECT_SECTION_COUNT; i++) {
+        struct object_section *s = &object->sections[i];
+        s->name = object_sections[i].name;
+        s->type = object_sections[i].type;
+        s->flags = object_sections[i].flags;
+        s->fill = object_sections[i].fill;
+        s->entsize = object_sections[i].entsize;
+        buffer_init(&s->data);
+    }
+    buffer_init(&object->strtab);
+}
+
+void object_free(struct object *object) {
+    for (int i = 1; i < OBJECT_SECTION_COUNT; i++) {
+        buffer_release(&object->sections[i].data);
+        free(object->sections[i].relocs);
+    }
+    buffer_release(&object->strtab);
+    free(object->symbols);
+}
+
+static uint32_t object_add_symbol(struct object *object,
+                                  struct object_symbol symbol) {
+    if (object->symbol_count == object->symbol_capacity) {
+        object->symbol_capacity =
+            object->symbol_capacity ? object->symbol_capacity * 2 : 64;
+        object->symbols = realloc(
+            object->symbols, object->symbol_capacity * sizeof(struct object_symbol));
+    }
+    object->symbols[object->symbol_count] = symbol;
+    return object->symbol_count++;
+}
+
+static uint32_t object_add_name(struct object *object, const char *name) {
+    uint32_t offset = buffer_len(&object->strtab);
+    buffer_write_bytes(&object->strtab, name, strlen(name) + 1);
+    return offset;
+}
+
+void object_reset(struct object *object, const char *filename) {
+    for (int i = 1; i < OBJECT_SECTION_COUNT; i++) {
+        struct object_section *s = &object->sections[i];
+        buffer_clear(&s->data);
+        s->size = 0;
+        s->align = 1;
+        s->reloc_count = 0;
+    }
+    buffer_clear(&object->strtab);
+    buffer_write(&object->strtab, 0);
+    object->symbol_count = 0;
+    object_add_symbol(object, (struct object_symbol){0});
+
+    // the file symbol comes first, then the sections' own.
+    object_add_symbol(object, (struct object_symbol){
+        .name = object_add_name(object, filename), .type = OBJECT_FILE});
+    for (int i = 1; i < OBJECT_SECTION_COUNT; i++)
+        object->section_symbols[i] = object_add_symbol(
+            object, (struct object_symbol){.type = OBJECT_SECTION, .section = i});
+}
+
+void object_reset_from(struct object *object, struct object *from) {
+    for (int i = 1; i < OBJECT_SECTION_COUNT; i++) {
+        struct object_section *s = &object->sections[i];
+        buffer_clear(&s->data);
+        s->size = 0;
+        s->align = 1;
+        s->reloc_count = 0;
+    }
+    buffer_clear(&object->strtab);
+    buffer_write_bytes(&object->strtab, buffer_ptr(&from->strtab),
+                       buffer_len(&from->strtab));
+    if (from->symbol_count > object->symbol_capacity) {
+        object->symbol_capacity = from->symbol_count * 2;
+        object->symbols = realloc(
+            object->symbols, object->symbol_capacity * sizeof(struct object_symbol));
+    }
+    memcpy(object->symbols, from->symbols,
+           from->symbol_count * sizeof(struct object_symbol));
+    object->symbol_count = from->symbol_count;
+    memcpy(object->section_symbols, from->section_symbols,
+           sizeof(object->section_symbols));
+}
+
+uint32_t object_symbol(struct object *object, const char *name, int bind,
+                       int type) {
+    return object_add_symbol(
+        object, (struct object_symbol){.name = object_add_name(object, name),
+                                       .bind = bind,
+                                       .type = type});
+}
+
+void object_define(struct object *object, uint32_t symbol, int section,
+                   uint64_t value, uint64_t size) {
+    struct object_symbol *s = &object->symbols[symbol];
+    s->section = section;
+    s->value = value;
+    s->size = size;
+}
+
+const char *object_symbol_name(struct object *object, uint32_t symbol) {
+    struct object_symbol *s = &object->symbols[symbol];
+    if (s->type == OBJECT_SECTION) return object->sections[s->section].name;
+    return (const char *)buffer_ptr(&object->strtab) + s->name;
+}
+
+uint32_t object_align(struct object *object, int section, uint32_t align) {
+    struct object_section *s = &object->sections[section];
+    if (align > s->align) s->align = align;
+    uint64_t aligned = (s->size + align - 1) & ~(uint64_t)(align - 1);
+    if (s->type != SHT_NOBITS)
+        while (buffer_len(&s->data) < aligned) buffer_write(&s->data, s->fill);
+    s->size = aligned;
+    return aligned;
+}
+
+uint32_t object_append(struct object *object, int section, const void *data,
+                       uint32_t len, uint32_t align) {
+    struct object_section *s = &object->sections[section];
+    uint32_t offset = object_align(object, section, align);
+    if (s->type != SHT_NOBITS) {
+        buffer_reserve(&s->data, len);
+        if (data)
+            memcpy((char *)buffer_ptr(&s->data) + offset, data, len);
+        else
+            memset((char *)buffer_ptr(&s->data) + offset, 0, len);
+        s->data.len += len;
+    }
+    s->size += len;
+    return offset;
+}
+
+uint8_t *object_data(struct object *object, int section, uint32_t offset) {
+    return (uint8_t *)buffer_ptr(&object->sections[section].data) + offset;
+}
+
+void object_reloc(struct object *object, int section, uint64_t offset,
+                  uint32_t symbol, uint32_t type, int64_t addend) {
+    struct object_section *s = &object->sections[section];
+    if (s->reloc_count == s->reloc_capacity) {
+        s->reloc_capacity = s->reloc_capacity ? s->reloc_capacity * 2 : 64;
+        s->relocs =
+            realloc(s->relocs, s->reloc_capacity * sizeof(struct object_reloc));
+    }
+    s->relocs[s->reloc_count++] = (struct object_reloc){
+        .offset = offset, .symbol = symbol, .type = type, .addend = addend};
+}
+
+// Streams the file while keeping track of its size, to pad up to the
+// offsets laid out beforehand.
+struct object_writer {
+    struct output *out;
+    uint64_t offset;
+};
+
+static void object_emit(struct object_writer *w, const void *data,
+                        uint64_t len) {
+    output_write(w->out, data, len);
+    w->offset += len;
+}
+
+static void object_pad(struct object_writer *w, uint64_t offset) {
+    static const char zeros[16];
+    while (w->offset < offset) {
+        uint64_t len = offset - w->offset;
+        object_emit(w, zeros, len < sizeof(zeros) ? len : sizeof(zeros));
+    }
+}
+
+static uint32_t object_section_name(struct buffer *names, const char *prefix,
+                                    const char *name) {
+    uint32_t offset = buffer_len(names);
+    buffer_write_bytes(names, prefix, strlen(prefix));
+    buffer_write_bytes(names, name, strlen(name) + 1);
+    return offset;
+}
+
+static Elf64_Sym object_elf_symbol(struct object_symbol *s) {
+    static const uint8_t types[] = {
+        [OBJECT_NOTYPE] = STT_NOTYPE, [OBJECT_OBJECT] = STT_OBJECT,
+        [OBJECT_FUNC] = STT_FUNC,     [OBJECT_SECTION] = STT_SECTION,
+        [OBJECT_FILE] = STT_FILE,
+    };
+    int bind = s->bind == OBJECT_GLOBAL ? STB_GLOBAL : STB_LOCAL;
+    return (Elf64_Sym){
+        .st_name = s->name,
+        .st_info = ELF64_ST_INFO(bind, types[s->type]),
+        .st_shndx = s->type == OBJECT_FILE ? SHN_ABS : s->section,
+        .st_value = s->value,
+        .st_size = s->size,
+    };
+}
+
+void object_write(struct object *object, struct output *out) {
+    // ELF wants the local symbols first, `order` maps the symbols to their
+    // index in the file.
+    uint32_t count = object->symbol_count;
+    uint32_t *order = malloc(count * sizeof(uint32_t));
+    uint32_t index = 0, locals = 0;
+    for (int bind = OBJECT_LOCAL; bind <= OBJECT_GLOBAL; bind++) {
+        if (bind == OBJECT_GLOBAL) locals = index;
+        for (uint32_t i = 0; i < count; i++)
+            if (object->symbols[i].bind == bind) order[i] = index++;
+    }
+
+    // the code and data sections, one relocation section for each of them
+    // with relocations, then the trailing sections.
+    uint32_t relas[OBJECT_SECTION_COUNT];
+    uint32_t section_count = OBJECT_SECTION_COUNT;
+    for (int i = 1; i < OBJECT_SECTION_COUNT; i++)
+        relas[i] = object->sections[i].reloc_count ? section_count++ : 0;
+    uint32_t trailing = section_count;
+    section_count += OBJECT_TRAILING_COUNT;
+    Elf64_Shdr *headers = calloc(section_count, sizeof(Elf64_Shdr));
+    struct buffer names;
+    buffer_init(&names);
+    buffer_write(&names, 0);
+
+    // lays out the file, every section at the next offset aligned for it.
+    uint64_t offset = sizeof(Elf64_Ehdr);
+    for (int i = 1; i < OBJECT_SECTION_COUNT; i++) {
+        struct object_section *s = &object->sections[i];
+        Elf64_Shdr *h = &headers[i];
+        h->sh_name = object_section_name(&names, "", s->name);
+        h->sh_type = s->type;
+        h->sh_flags = s->flags;
+        h->sh_addralign = s->align;
+        h->sh_entsize = s->entsize;
+        h->sh_size = s->size;
+        h->sh_offset = offset = (offset + s->align - 1) & ~(uint64_t)(s->align - 1);
+        if (s->type != SHT_NOBITS) offset += s->size;
+        if (!relas[i]) continue;
+        Elf64_Shdr *rela = &headers[relas[i]];
+        rela->sh_name = object_section_name(&names, ".rela", s->name);
+        rela->sh_type = SHT_RELA;
+        rela->sh_flags = SHF_INFO_LINK;
+        rela->sh_addralign = 8;
+        rela->sh_entsize = sizeof(Elf64_Rela);
+        rela->sh_link = trailing + OBJECT_SYMTAB;
+        rela->sh_info = i;
+        rela->sh_size = s->reloc_count * sizeof(Elf64_Rela);
+    }
+    for (int i = 1; i < OBJECT_SECTION_COUNT; i++) {
+        if (!relas[i]) continue;
+        Elf64_Shdr *rela = &headers[relas[i]];
+        rela->sh_offset = offset = (offset + 7) & ~7ull;
+        offset += rela->sh_size;
+    }
+
+    Elf64_Shdr *symtab = &headers[trailing + OBJECT_SYMTAB];
+    symtab->sh_name = object_section_name(&names, "", ".symtab");
+    symtab->sh_type = SHT_SYMTAB;
+    symtab->sh_addralign = 8;
+    symtab->sh_entsize = sizeof(Elf64_Sym);
+    symtab->sh_link = trailing + OBJECT_STRTAB;
+    symtab->sh_info = locals;
+    symtab->sh_size = count * sizeof(Elf64_Sym);
+    symtab->sh_offset = offset = (offset + 7) & ~7ull;
+    offset += symtab->sh_size;
+
+    Elf64_Shdr *strtab = &headers[trailing + OBJECT_STRTAB];
+    strtab->sh_name = object_section_name(&names, "", ".strtab");
+    strtab->sh_type = SHT_STRTAB;
+    strtab->sh_addralign = 1;
+    strtab->sh_size = buffer_len(&object->strtab);
+    strtab->sh_offset = offset;
+    offset += strtab->sh_size;
+
+    // marks the stack as not executable for the linker.
+    Elf64_Shdr *note = &headers[trailing + OBJECT_NOTE_STACK];
+    note->sh_name = object_section_name(&names, "", ".note.GNU-stack");
+    note->sh_type = SHT_PROGBITS;
+    note->sh_addralign = 1;
+    note->sh_offset = offset;
+
+    Elf64_Shdr *shstrtab = &headers[trailing + OBJECT_SHSTRTAB];
+    shstrtab->sh_name = object_section_name(&names, "", ".shstrtab");
+    shstrtab->sh_type = SHT_STRTAB;
+    shstrtab->sh_addralign = 1;
+    shstrtab->sh_size = buffer_len(&names);
+    shstrtab->sh_offset = offset;
+    offset += shstrtab->sh_size;
+    uint64_t shoff = (offset + 7) & ~7ull;
+
+    Elf64_Ehdr ehdr = {
+        .e_type = ET_REL,
+        .e_machine = EM_X86_64,
+        .e_version = EV_CURRENT,
+        .e_shoff = shoff,
+        .e_ehsize = sizeof(Elf64_Ehdr),
+        .e_shentsize = sizeof(Elf64_Shdr),
+        .e_shnum = section_count,
+        .e_shstrndx = trailing + OBJECT_SHSTRTAB,
+    };
+    memcpy(ehdr.e_ident, ELFMAG, SELFMAG);
+    ehdr.e_ident[EI_CLASS] = ELFCLASS64;
+    ehdr.e_ident[EI_DATA] = ELFDATA2LSB;
+    ehdr.e_ident[EI_VERSION] = EV_CURRENT;
+    ehdr.e_ident[EI_OSABI] = ELFOSABI_SYSV;
+
+    // then streams it in the same order.
+    struct object_writer w = {.out = out};
+    object_emit(&w, &ehdr, sizeof(ehdr));
+    for (int i = 1; i < OBJECT_SECTION_COUNT; i++) {
+        struct object_section *s = &object->sections[i];
+        if (s->type == SHT_NOBITS) continue;
+        object_pad(&w, headers[i].sh_offset);
+        object_emit(&w, buffer_ptr(&s->data), buffer_len(&s->data));
+    }
+    for (int i = 1; i < OBJECT_SECTION_COUNT; i++) {
+        struct object_section *s = &object->sections[i];
+        if (!relas[i]) continue;
+        object_pad(&w, headers[relas[i]].sh_offset);
+        for (uint32_t r = 0; r < s->reloc_count; r++) {
+            struct object_reloc *reloc = &s->relocs[r];
+            Elf64_Rela entry = {
+                .r_offset = reloc->offset,
+                .r_info = ELF64_R_INFO(order[reloc->symbol], reloc->type),
+                .r_addend = reloc->addend,
+            };
+            object_emit(&w, &entry, sizeof(entry));
+        }
+    }
+    object_pad(&w, symtab->sh_offset);
+    Elf64_Sym *symbols = calloc(count, sizeof(Elf64_Sym));
+    for (uint32_t i = 1; i < count; i++)
+        symbols[order[i]] = object_elf_symbol(&object->symbols[i]);
+    object_emit(&w, symbols, count * sizeof(Elf64_Sym));
+    object_emit(&w, buffer_ptr(&object->strtab), buffer_len(&object->strtab));
+    object_emit(&w, buffer_ptr(&names), buffer_len(&names));
+    object_pad(&w, shoff);
+    object_emit(&w, headers, section_count * sizeof(Elf64_Shdr));
+
+    free(symbols);
+    buffer_release(&names);
+    free(headers);
+    free(order);
+}
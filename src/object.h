@@ -0,0 +1,123 @@
+#ifndef PEACHOBJECT_H
+#define PEACHOBJECT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../helpers/buffer.h"
+
+struct output;
+
+// Relocatable ELF64 object file for x86-64, as the system linker takes it.
+// Code and data are appended to the sections as they're generated, symbols
+// and relocations refer to them by offset. object_write lays everything out
+// and streams the file to an output once the compile is done.
+
+// Sections holding code and data, the others are made by object_write.
+enum {
+    OBJECT_TEXT = 1,
+    OBJECT_DATA,
+    OBJECT_BSS,
+    OBJECT_RODATA,
+    // strings the linker may merge with the same strings of other objects.
+    OBJECT_STRINGS,
+    OBJECT_SECTION_COUNT
+};
+
+// object_symbol::bind
+enum {
+    OBJECT_LOCAL,
+    OBJECT_GLOBAL,
+};
+
+// object_symbol::type
+enum {
+    OBJECT_NOTYPE,
+    OBJECT_OBJECT,
+    OBJECT_FUNC,
+    OBJECT_SECTION,
+    OBJECT_FILE,
+};
+
+struct object_symbol {
+    // offset of the name in object::strtab, 0 for none.
+    uint32_t name;
+    uint8_t bind;
+    uint8_t type;
+    // OBJECT_TEXT and so on, 0 while the symbol is undefined.
+    uint16_t section;
+    uint64_t value;
+    uint64_t size;
+};
+
+struct object_reloc {
+    uint64_t offset;
+    uint32_t symbol;
+    // R_X86_64_* type.
+    uint32_t type;
+    int64_t addend;
+};
+
+struct object_section {
+    const char *name;
+    uint32_t type;
+    uint64_t flags;
+    uint32_t align;
+    // size of the entries of a section of them, 0 for the others.
+    uint32_t entsize;
+    // contents, a NOBITS section only has a size.
+    struct buffer data;
+    uint64_t size;
+    // byte padding up to an alignment.
+    uint8_t fill;
+
+    struct object_reloc *relocs;
+    uint32_t reloc_count;
+    uint32_t reloc_capacity;
+};
+
+struct object {
+    struct object_section sections[OBJECT_SECTION_COUNT];
+
+    // symbol 0 is the null symbol.
+    struct object_symbol *symbols;
+    uint32_t symbol_count;
+    uint32_t symbol_capacity;
+    // symbol of each section, for relocations against section offsets.
+    uint32_t section_symbols[OBJECT_SECTION_COUNT];
+
+    // names of the symbols, starting with an empty one.
+    struct buffer strtab;
+};
+
+void object_init(struct object *object);
+void object_free(struct object *object);
+// Drops the contents and symbols, the storage is kept for the next compile.
+void object_reset(struct object *object, const char *filename);
+// Drops the contents and takes a copy of the symbols of `from` instead.
+void object_reset_from(struct object *object, struct object *from);
+
+// Adds an undefined symbol named `name` and returns its index.
+uint32_t object_symbol(struct object *object, const char *name, int bind,
+                       int type);
+// Defines `symbol` at `value` in `section`.
+void object_define(struct object *object, uint32_t symbol, int section,
+                   uint64_t value, uint64_t size);
+const char *object_symbol_name(struct object *object, uint32_t symbol);
+
+// Pads `section` to `align` and returns its size.
+uint32_t object_align(struct object *object, int section, uint32_t align);
+// Appends `len` bytes, zeros if `data` is NULL, aligned to `align` and
+// returns their offset. Only the size grows for the NOBITS section.
+uint32_t object_append(struct object *object, int section, const void *data,
+                       uint32_t len, uint32_t align);
+// Returns the contents of `section` from `offset` on, to patch them.
+uint8_t *object_data(struct object *object, int section, uint32_t offset);
+
+void object_reloc(struct object *object, int section, uint64_t offset,
+                  uint32_t symbol, uint32_t type, int64_t addend);
+
+// Writes the object file to `out`.
+void object_write(struct object *object, struct output *out);
+
+#endif  // PEACHOBJECT_H
@@ -0,0 +1,741 @@
+#include "opt.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Lattice of a value, see opt::states. Values only go down it.
+enum {
+    OPT_UNKNOWN,
+    OPT_CONSTANT,
+    OPT_VARYING,
+};
+
+// Successors the terminator of a block may take, see opt::feasible.
+enum {
+    OPT_NONE,
+    // opt::taken only.
+    OPT_ONE,
+    OPT_ALL,
+};
+
+struct opt *opt_create(void) {
+    struct opt *o = calloc(1, sizeof(struct opt));
+    ir_function_init(&o->out);
+    return o;
+}
+
+void opt_free(struct opt *o) {
+    if (!o) return;
+    free(o->states);
+    free(o->constants);
+    free(o->alias);
+    free(o->live);
+    free(o->renumber);
+    free(o->block_of);
+    free(o->work);
+    free(o->reached);
+    free(o->feasible);
+    free(o->taken);
+    free(o->block_renumber);
+    free(o->stamps);
+    free(o->block_work);
+    free(o->kept);
+    ir_function_free(&o->out);
+    free(o);
+}
+
+// Grows the array at `items` of `*capacity` elements of `size` bytes to hold
+// at least `needed` of them.
+static void *opt_reserve(void *items, uint32_t *capacity, uint32_t needed,
+                         size_t size) {
+    if (needed <= *capacity) return items;
+    uint32_t grown = *capacity ? *capacity : 64;
+    while (grown < needed) grown *= 2;
+    *capacity = grown;
+    return realloc(items, (size_t)grown * size);
+}
+
+static void opt_reserve_scratch(struct opt *o, struct ir_function *fn) {
+    if (fn->count + 1 > o->value_capacity) {
+        uint32_t n = o->value_capacity = (fn->count + 1) * 2;
+        o->states = realloc(o->states, n);
+        o->constants = realloc(o->constants, n * sizeof(int64_t));
+        o->alias = realloc(o->alias, n * sizeof(uint32_t));
+        o->live = realloc(o->live, n);
+        o->renumber = realloc(o->renumber, n * sizeof(uint32_t));
+        o->block_of = realloc(o->block_of, n * sizeof(uint32_t));
+        // a value is pushed each time it goes down the lattice.
+        o->work = realloc(o->work, 2 * n * sizeof(uint32_t));
+    }
+    if (fn->block_count + 1 > o->block_capacity) {
+        uint32_t n = o->block_capacity = (fn->block_count + 1) * 2;
+        o->reached = realloc(o->reached, n);
+        o->feasible = realloc(o->feasible, n);
+        o->taken = realloc(o->taken, n * sizeof(uint32_t));
+        o->block_renumber = realloc(o->block_renumber, n * sizeof(uint32_t));
+        o->stamps = realloc(o->stamps, n * sizeof(uint32_t));
+        o->block_work = realloc(o->block_work, n * sizeof(uint32_t));
+    }
+    o->kept = opt_reserve(o->kept, &o->kept_capacity, fn->extra_count + 1, 1);
+}
+
+// `value` as a value of the IR `type`, the bits past its width are copies
+// of its sign.
+static int64_t opt_normalize(int type, int64_t value) {
+    switch (type) {
+    case IR_I8:
+        return (int8_t)value;
+    case IR_I16:
+        return (int16_t)value;
+    case IR_I32:
+        return (int32_t)value;
+    }
+    return value;
+}
+
+static uint64_t opt_unsigned(int type, int64_t value) {
+    switch (type) {
+    case IR_I8:
+        return (uint8_t)value;
+    case IR_I16:
+        return (uint16_t)value;
+    case IR_I32:
+        return (uint32_t)value;
+    }
+    return value;
+}
+
+static bool opt_is_compare(int op) {
+    return op >= IR_EQ && op <= IR_UGE;
+}
+
+// Type of the value `inst` defines, comparisons define an IR_I32.
+static int opt_result_type(struct ir_inst *inst) {
+    return opt_is_compare(inst->op) ? IR_I32 : inst->type;
+}
+
+static int64_t opt_constant(struct ir_inst *inst) {
+    return opt_normalize(inst->type,
+                         (int64_t)((uint64_t)inst->a | (uint64_t)inst->b << 32));
+}
+
+// Folds the binary operation `op` of `type` on the constants `a` and `b`.
+// Divisions by zero and those which overflow are left to trap at run time.
+static bool opt_fold(int op, int type, int64_t a, int64_t b, int64_t *result) {
+    uint64_t ua = opt_unsigned(type, a), ub = opt_unsigned(type, b);
+    // counts are masked as the code generator's shifts do.
+    unsigned count = b & (type == IR_I64 ? 63 : 31);
+    int64_t r;
+    switch (op) {
+    case IR_ADD:
+        r = (uint64_t)a + (uint64_t)b;
+        break;
+    case IR_SUB:
+        r = (uint64_t)a - (uint64_t)b;
+        break;
+    case IR_MUL:
+        r = (uint64_t)a * (uint64_t)b;
+        break;
+    case IR_SDIV:
+    case IR_SREM:
+        if (b == 0 || (b == -1 && ((type == IR_I32 && a == INT32_MIN) ||
+                                   (type == IR_I64 && a == INT64_MIN))))
+            return false;
+        r = op == IR_SDIV ? a / b : a % b;
+        break;
+    case IR_UDIV:
+    case IR_UREM:
+        if (ub == 0) return false;
+        r = op == IR_UDIV ? ua / ub : ua % ub;
+        break;
+    case IR_AND:
+        r = a & b;
+        break;
+    case IR_OR:
+        r = a | b;
+        break;
+    case IR_XOR:
+        r = a ^ b;
+        break;
+    case IR_SHL:
+        r = (uint64_t)a << count;
+        break;
+    case IR_SHR:
+        r = ua >> count;
+        break;
+    case IR_SAR:
+        r = a >> count;
+        break;
+    case IR_EQ:
+        *result = a == b;
+        return true;
+    case IR_NE:
+        *result = a != b;
+        return true;
+    case IR_LT:
+        *result = a < b;
+        return true;
+    case IR_LE:
+        *result = a <= b;
+        return true;
+    case IR_GT:
+        *result = a > b;
+        return true;
+    case IR_GE:
+        *result = a >= b;
+        return true;
+    case IR_ULT:
+        *result = ua < ub;
+        return true;
+    case IR_ULE:
+        *result = ua <= ub;
+        return true;
+    case IR_UGT:
+        *result = ua > ub;
+        return true;
+    case IR_UGE:
+        *result = ua >= ub;
+        return true;
+    default:
+        return false;
+    }
+    *result = opt_normalize(type, r);
+    return true;
+}
+
+// Folds the unary operation `inst` on the constant `a` of the type `from`.
+static int64_t opt_fold_unary(struct ir_inst *inst, int from, int64_t a) {
+    int64_t r = a;
+    switch (inst->op) {
+    case IR_NEG:
+        r = -(uint64_t)a;
+        break;
+    case IR_NOT:
+        r = ~a;
+        break;
+    case IR_ZEXT:
+        r = opt_unsigned(from, a);
+        break;
+    }
+    return opt_normalize(inst->type, r);
+}
+
+// Lowers the lattice of `v` to `state`, a constant meeting another one
+// varies.
+static void opt_set(struct opt *o, uint32_t v, int state, int64_t value) {
+    uint8_t old = o->states[v];
+    if (old == OPT_CONSTANT && state == OPT_CONSTANT &&
+        value != o->constants[v])
+        state = OPT_VARYING;
+    if (state <= old) return;
+    o->states[v] = state;
+    o->constants[v] = value;
+    o->work[o->work_count++] = v;
+}
+
+// True if the terminator of `from` may jump to `to`.
+static bool opt_edge(struct opt *o, uint32_t from, uint32_t to) {
+    return o->feasible[from] == OPT_ALL ||
+           (o->feasible[from] == OPT_ONE && o->taken[from] == to);
+}
+
+static void opt_visit_phi(struct opt *o, uint32_t v) {
+    struct ir_function *fn = o->fn;
+    uint32_t block = o->block_of[v];
+    uint32_t count;
+    uint32_t *preds = ir_list(fn, fn->blocks[block].preds, &count);
+    uint32_t *operands = ir_list(fn, ir_inst(fn, v)->a, &count);
+    int state = OPT_UNKNOWN;
+    int64_t value = 0;
+    for (uint32_t i = 0; i < count && state != OPT_VARYING; i++) {
+        if (!opt_edge(o, preds[i], block)) continue;
+        uint32_t operand = operands[i];
+        uint8_t operand_state = o->states[operand];
+        if (operand_state == OPT_UNKNOWN) continue;
+        if (operand_state == OPT_VARYING ||
+            (state == OPT_CONSTANT && o->constants[operand] != value)) {
+            state = OPT_VARYING;
+        } else {
+            state = OPT_CONSTANT;
+            value = o->constants[operand];
+        }
+    }
+    opt_set(o, v, state, value);
+}
+
+// Marks `block` reached. A new edge to a block reached before may change
+// its phis, they're evaluated again.
+static void opt_reach(struct opt *o, uint32_t block) {
+    if (!o->reached[block]) {
+        o->reached[block] = 1;
+        o->block_work[o->block_work_count++] = block;
+        return;
+    }
+    struct ir_block *bb = &o->fn->blocks[block];
+    for (uint32_t phi = bb->first; phi < bb->body; phi++) opt_visit_phi(o, phi);
+}
+
+static void opt_feasible(struct opt *o, uint32_t block, int feasible,
+                         uint32_t taken) {
+    if (o->feasible[block] >= feasible) return;
+    o->feasible[block] = feasible;
+    o->taken[block] = taken;
+    if (feasible == OPT_ONE) {
+        opt_reach(o, taken);
+        return;
+    }
+    uint32_t count;
+    uint32_t *succs = ir_successors(o->fn, block, &count);
+    for (uint32_t i = 0; i < count; i++) opt_reach(o, succs[i]);
+}
+
+static void opt_visit_terminator(struct opt *o, uint32_t v) {
+    struct ir_function *fn = o->fn;
+    struct ir_inst *inst = ir_inst(fn, v);
+    uint32_t block = o->block_of[v];
+    if (inst->op == IR_RET) return;
+    if (inst->op == IR_JUMP) {
+        opt_feasible(o, block, OPT_ALL, 0);
+        return;
+    }
+    uint8_t state = o->states[inst->a];
+    if (state == OPT_UNKNOWN) return;
+    if (state == OPT_VARYING) {
+        opt_feasible(o, block, OPT_ALL, 0);
+        return;
+    }
+    int64_t value = o->constants[inst->a];
+    if (inst->op == IR_BRANCH) {
+        opt_feasible(o, block, OPT_ONE, fn->extra[inst->b + (value == 0)]);
+        return;
+    }
+    uint32_t *extra = &fn->extra[inst->b];
+    uint32_t cases = extra[0];
+    uint32_t target = extra[1];
+    for (uint32_t i = 0; i < cases; i++) {
+        uint32_t *bits = &extra[2 + cases + i * 2];
+        int64_t c = (int64_t)((uint64_t)bits[0] | (uint64_t)bits[1] << 32);
+        if (opt_normalize(inst->type, c) == value) {
+            target = extra[2 + i];
+            break;
+        }
+    }
+    opt_feasible(o, block, OPT_ONE, target);
+}
+
+static bool opt_is(struct opt *o, uint32_t v, int64_t value) {
+    return o->states[v] == OPT_CONSTANT && o->constants[v] == value;
+}
+
+static void opt_visit(struct opt *o, uint32_t v) {
+    struct ir_function *fn = o->fn;
+    struct ir_inst *inst = ir_inst(fn, v);
+    switch (inst->op) {
+    case IR_CONST:
+        opt_set(o, v, OPT_CONSTANT, opt_constant(inst));
+        return;
+    case IR_COPY:
+    case IR_NEG:
+    case IR_NOT:
+    case IR_SEXT:
+    case IR_ZEXT:
+    case IR_TRUNC: {
+        uint8_t state = o->states[inst->a];
+        int64_t value = 0;
+        if (state == OPT_CONSTANT)
+            value = opt_fold_unary(inst, ir_inst(fn, inst->a)->type,
+                                   o->constants[inst->a]);
+        opt_set(o, v, state, value);
+        return;
+    }
+    case IR_PHI:
+        opt_visit_phi(o, v);
+        return;
+    }
+    if (ir_is_terminator(inst->op)) {
+        opt_visit_terminator(o, v);
+        return;
+    }
+    if (inst->op < IR_ADD || inst->op > IR_UGE) {
+        // parameters, undefined values, addresses, loads and calls.
+        opt_set(o, v, OPT_VARYING, 0);
+        return;
+    }
+
+    uint8_t a = o->states[inst->a], b = o->states[inst->b];
+    int64_t ca = o->constants[inst->a], cb = o->constants[inst->b];
+    // a zero, or all ones, decides some operations alone.
+    if ((inst->op == IR_MUL || inst->op == IR_AND) &&
+        (opt_is(o, inst->a, 0) || opt_is(o, inst->b, 0))) {
+        opt_set(o, v, OPT_CONSTANT, 0);
+        return;
+    }
+    if (inst->op == IR_OR &&
+        (opt_is(o, inst->a, -1) || opt_is(o, inst->b, -1))) {
+        opt_set(o, v, OPT_CONSTANT, -1);
+        return;
+    }
+    if (a == OPT_VARYING || b == OPT_VARYING) {
+        opt_set(o, v, OPT_VARYING, 0);
+        return;
+    }
+    if (a == OPT_UNKNOWN || b == OPT_UNKNOWN) return;
+    int64_t result;
+    if (opt_fold(inst->op, inst->type, ca, cb, &result))
+        opt_set(o, v, OPT_CONSTANT, result);
+    else
+        opt_set(o, v, OPT_VARYING, 0);
+}
+
+// Runs the propagation from the entry block until nothing changes: blocks
+// reached are evaluated whole, values which changed have their uses in
+// blocks reached evaluated again.
+static void opt_propagate(struct opt *o) {
+    struct ir_function *fn = o->fn;
+    opt_reach(o, 0);
+    while (o->block_work_count || o->work_count) {
+        if (o->block_work_count) {
+            struct ir_block *bb = &fn->blocks[o->block_work[--o->block_work_count]];
+            for (uint32_t v = bb->first; v < bb->end; v++) opt_visit(o, v);
+            continue;
+        }
+        uint32_t v = o->work[--o->work_count];
+        uint32_t count;
+        uint32_t *uses = ir_uses(fn, v, &count);
+        for (uint32_t i = 0; i < count; i++)
+            if (o->reached[o->block_of[uses[i]]]) opt_visit(o, uses[i]);
+    }
+}
+
+// Returns the value replacing `v`, compressing the chain of replacements.
+static uint32_t opt_resolve(struct opt *o, uint32_t v) {
+    uint32_t root = v;
+    while (o->alias[root]) root = o->alias[root];
+    while (o->alias[v]) {
+        uint32_t next = o->alias[v];
+        o->alias[v] = root;
+        v = next;
+    }
+    return root;
+}
+
+// Returns the single value other than itself the phi `v` takes over the
+// edges which may be taken, 0 if there are several.
+static uint32_t opt_trivial_phi(struct opt *o, uint32_t v) {
+    struct ir_function *fn = o->fn;
+    uint32_t block = o->block_of[v];
+    uint32_t count;
+    uint32_t *preds = ir_list(fn, fn->blocks[block].preds, &count);
+    uint32_t *operands = ir_list(fn, ir_inst(fn, v)->a, &count);
+    uint32_t same = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (!opt_edge(o, preds[i], block)) continue;
+        uint32_t operand = opt_resolve(o, operands[i]);
+        if (operand == v || operand == same) continue;
+        if (same) return 0;
+        same = operand;
+    }
+    return same;
+}
+
+// Returns the value `v` merely forwards, 0 if it computes one.
+static uint32_t opt_forwarded(struct opt *o, uint32_t v) {
+    struct ir_inst *inst = ir_inst(o->fn, v);
+    switch (inst->op) {
+    case IR_COPY:
+        return inst->a;
+    case IR_PHI:
+        return opt_trivial_phi(o, v);
+    case IR_ADD:
+    case IR_OR:
+    case IR_XOR:
+        if (opt_is(o, inst->a, 0)) return inst->b;
+        return opt_is(o, inst->b, 0) ? inst->a : 0;
+    case IR_SUB:
+    case IR_SHL:
+    case IR_SHR:
+    case IR_SAR:
+        return opt_is(o, inst->b, 0) ? inst->a : 0;
+    case IR_MUL:
+        if (opt_is(o, inst->a, 1)) return inst->b;
+        return opt_is(o, inst->b, 1) ? inst->a : 0;
+    case IR_SDIV:
+    case IR_UDIV:
+        return opt_is(o, inst->b, 1) ? inst->a : 0;
+    case IR_AND:
+        if (opt_is(o, inst->a, -1)) return inst->b;
+        return opt_is(o, inst->b, -1) ? inst->a : 0;
+    }
+    return 0;
+}
+
+// Turns the branches which may only take one edge into jumps.
+static void opt_rewrite_terminator(struct opt *o, uint32_t block, uint32_t v) {
+    struct ir_function *fn = o->fn;
+    struct ir_inst *inst = ir_inst(fn, v);
+    if (inst->op == IR_BRANCH && fn->extra[inst->b] == fn->extra[inst->b + 1]) {
+        o->feasible[block] = OPT_ONE;
+        o->taken[block] = fn->extra[inst->b];
+    }
+    if (inst->op == IR_JUMP || inst->op == IR_RET ||
+        o->feasible[block] != OPT_ONE)
+        return;
+    *inst = (struct ir_inst){.op = IR_JUMP, .type = IR_VOID,
+                             .a = o->taken[block]};
+}
+
+static void opt_rewrite(struct opt *o) {
+    struct ir_function *fn = o->fn;
+    for (uint32_t b = 0; b < fn->block_count; b++) {
+        if (!o->reached[b]) continue;
+        struct ir_block *bb = &fn->blocks[b];
+        for (uint32_t v = bb->first; v < bb->end; v++) {
+            struct ir_inst *inst = ir_inst(fn, v);
+            if (ir_is_terminator(inst->op)) {
+                opt_rewrite_terminator(o, b, v);
+            } else if (o->states[v] == OPT_CONSTANT && inst->op != IR_CONST) {
+                int64_t value = o->constants[v];
+                int type = opt_result_type(inst);
+                *inst = (struct ir_inst){
+                    .op = IR_CONST, .type = type, .a = (uint32_t)value,
+                    .b = (uint32_t)((uint64_t)value >> 32)};
+            } else {
+                o->alias[v] = opt_forwarded(o, v);
+            }
+        }
+    }
+}
+
+// Marks the predecessor edges kept in opt::kept: those which may be taken,
+// and only the first of a terminator turned into a jump.
+static void opt_keep_edges(struct opt *o) {
+    struct ir_function *fn = o->fn;
+    memset(o->stamps, 0, fn->block_count * sizeof(uint32_t));
+    for (uint32_t b = 0; b < fn->block_count; b++) {
+        if (!o->reached[b]) continue;
+        uint32_t list = fn->blocks[b].preds;
+        uint32_t count;
+        uint32_t *preds = ir_list(fn, list, &count);
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t pred = preds[i];
+            bool keep = opt_edge(o, pred, b);
+            if (keep && o->feasible[pred] == OPT_ONE) {
+                keep = o->stamps[pred] != b + 1;
+                o->stamps[pred] = b + 1;
+            }
+            o->kept[list + 1 + i] = keep;
+        }
+    }
+}
+
+static void opt_mark(struct opt *o, uint32_t v) {
+    v = opt_resolve(o, v);
+    if (!v || o->live[v]) return;
+    o->live[v] = 1;
+    o->work[o->work_count++] = v;
+}
+
+// Marks live the values stores, calls and terminators of the blocks
+// reached depend on, the others are dead.
+static void opt_mark_live(struct opt *o) {
+    struct ir_function *fn = o->fn;
+    memset(o->live, 0, fn->count);
+    o->work_count = 0;
+    for (uint32_t b = 0; b < fn->block_count; b++) {
+        if (!o->reached[b]) continue;
+        struct ir_block *bb = &fn->blocks[b];
+        for (uint32_t v = bb->body; v < bb->end; v++) {
+            int op = ir_inst(fn, v)->op;
+            if (op == IR_STORE || op == IR_CALL || ir_is_terminator(op))
+                opt_mark(o, v);
+        }
+    }
+    while (o->work_count) {
+        uint32_t v = o->work[--o->work_count];
+        struct ir_inst *inst = ir_inst(fn, v);
+        if (inst->op != IR_PHI) {
+            uint32_t count = ir_operand_count(fn, v);
+            for (uint32_t i = 0; i < count; i++)
+                opt_mark(o, *ir_operand(fn, v, i));
+            continue;
+        }
+        uint32_t list = fn->blocks[o->block_of[v]].preds;
+        uint32_t count;
+        uint32_t *operands = ir_list(fn, inst->a, &count);
+        for (uint32_t i = 0; i < count; i++)
+            if (o->kept[list + 1 + i]) opt_mark(o, operands[i]);
+    }
+}
+
+static uint32_t opt_out_extra(struct opt *o, uint32_t n) {
+    struct ir_function *out = &o->out;
+    out->extra = opt_reserve(out->extra, &out->extra_capacity,
+                             out->extra_count + n, sizeof(uint32_t));
+    uint32_t at = out->extra_count;
+    out->extra_count += n;
+    return at;
+}
+
+// Copies the list at `list` of the function optimized to the one laid out,
+// leaving out the i-th item if `kept` isn't NULL and kept[i] is clear.
+static uint32_t opt_out_list(struct opt *o, uint32_t list, const uint8_t *kept) {
+    uint32_t count;
+    uint32_t *items = ir_list(o->fn, list, &count);
+    uint32_t out = opt_out_extra(o, count + 1);
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < count; i++)
+        if (!kept || kept[i]) o->out.extra[out + 1 + n++] = items[i];
+    o->out.extra[out] = n;
+    o->out.extra_count = out + 1 + n;
+    return out;
+}
+
+// Copies the live value `v` to the function laid out, renumbered.
+static void opt_out_inst(struct opt *o, uint32_t v) {
+    struct ir_function *fn = o->fn, *out = &o->out;
+    uint32_t n = o->renumber[v];
+    struct ir_inst inst = *ir_inst(fn, v);
+    switch (inst.op) {
+    case IR_CALL:
+        inst.b = opt_out_list(o, inst.b, NULL);
+        break;
+    case IR_PHI:
+        inst.a = opt_out_list(o, inst.a,
+                              o->kept + fn->blocks[o->block_of[v]].preds + 1);
+        break;
+    case IR_JUMP:
+        inst.a = o->block_renumber[inst.a];
+        break;
+    case IR_BRANCH:
+    case IR_SWITCH: {
+        // the targets of a branch, or the count and the targets of a switch
+        // followed by its values.
+        uint32_t cases = inst.op == IR_SWITCH ? fn->extra[inst.b] : 0;
+        uint32_t size = inst.op == IR_SWITCH ? 2 + 3 * cases : 2;
+        uint32_t first = inst.op == IR_SWITCH;
+        uint32_t end = inst.op == IR_SWITCH ? cases + 2 : 2;
+        uint32_t at = opt_out_extra(o, size);
+        for (uint32_t i = 0; i < size; i++) {
+            uint32_t item = fn->extra[inst.b + i];
+            out->extra[at + i] =
+                i >= first && i < end ? o->block_renumber[item] : item;
+        }
+        inst.b = at;
+        break;
+    }
+    }
+    out->insts[n] = inst;
+    uint32_t count = ir_operand_count(out, n);
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t *operand = ir_operand(out, n, i);
+        if (*operand) *operand = o->renumber[opt_resolve(o, *operand)];
+    }
+}
+
+// Lays out the live values of the blocks reached into opt::out and swaps
+// the arrays of the result with those of the function. Phis turned constant
+// go first in their block's body, like the entry block's parameters and
+// slots.
+static void opt_layout(struct opt *o) {
+    struct ir_function *fn = o->fn, *out = &o->out;
+    uint32_t count = 1, block_count = 0;
+    for (uint32_t b = 0; b < fn->block_count; b++) {
+        if (!o->reached[b]) continue;
+        struct ir_block *bb = &fn->blocks[b];
+        o->block_renumber[b] = block_count++;
+        for (uint32_t v = bb->first; v < bb->body; v++)
+            if (o->live[v] && ir_inst(fn, v)->op == IR_PHI) o->renumber[v] = count++;
+        for (uint32_t v = bb->first; v < bb->body; v++)
+            if (o->live[v] && ir_inst(fn, v)->op != IR_PHI) o->renumber[v] = count++;
+        for (uint32_t v = bb->body; v < bb->end; v++)
+            if (o->live[v]) o->renumber[v] = count++;
+    }
+
+    out->count = count;
+    out->insts = opt_reserve(out->insts, &out->capacity, count,
+                             sizeof(struct ir_inst));
+    out->insts[0] = fn->insts[0];
+    out->block_count = block_count;
+    out->blocks = opt_reserve(out->blocks, &out->block_capacity, block_count,
+                              sizeof(struct ir_block));
+    // list 0 is empty.
+    out->extra_count = 0;
+    out->extra[opt_out_extra(o, 1)] = 0;
+    uint32_t at = 1;
+    for (uint32_t b = 0; b < fn->block_count; b++) {
+        if (!o->reached[b]) continue;
+        struct ir_block *bb = &fn->blocks[b];
+        struct ir_block *block = &out->blocks[o->block_renumber[b]];
+        block->preds = opt_out_list(o, bb->preds, o->kept + bb->preds + 1);
+        uint32_t preds;
+        uint32_t *items = ir_list(out, block->preds, &preds);
+        for (uint32_t i = 0; i < preds; i++)
+            items[i] = o->block_renumber[items[i]];
+
+        block->first = at;
+        for (uint32_t v = bb->first; v < bb->body; v++)
+            if (o->live[v] && ir_inst(fn, v)->op == IR_PHI) opt_out_inst(o, v), at++;
+        block->body = at;
+        for (uint32_t v = bb->first; v < bb->body; v++)
+            if (o->live[v] && ir_inst(fn, v)->op != IR_PHI) opt_out_inst(o, v), at++;
+        for (uint32_t v = bb->body; v < bb->end; v++)
+            if (o->live[v]) opt_out_inst(o, v), at++;
+        block->end = at;
+    }
+
+    struct ir_function swapped = *fn;
+    fn->insts = out->insts;
+    fn->capacity = out->capacity;
+    fn->count = out->count;
+    fn->blocks = out->blocks;
+    fn->block_capacity = out->block_capacity;
+    fn->block_count = out->block_count;
+    fn->extra = out->extra;
+    fn->extra_capacity = out->extra_capacity;
+    fn->extra_count = out->extra_count;
+    fn->uses_valid = false;
+    out->insts = swapped.insts;
+    out->capacity = swapped.capacity;
+    out->blocks = swapped.blocks;
+    out->block_capacity = swapped.block_capacity;
+    out->extra = swapped.extra;
+    out->extra_capacity = swapped.extra_capacity;
+}
+
+// Marks the comparisons only used by the branch right after them.
+static void opt_fuse(struct opt *o) {
+    struct ir_function *fn = o->fn;
+    for (uint32_t b = 0; b < fn->block_count; b++) {
+        struct ir_block *bb = &fn->blocks[b];
+        uint32_t last = bb->end - 1;
+        struct ir_inst *branch = ir_inst(fn, last);
+        if (branch->op != IR_BRANCH || last == bb->body || branch->a != last - 1)
+            continue;
+        struct ir_inst *compare = ir_inst(fn, last - 1);
+        uint32_t count;
+        ir_uses(fn, last - 1, &count);
+        if (opt_is_compare(compare->op) && count == 1)
+            compare->flags |= IR_FLAG_FUSED;
+    }
+}
+
+void opt_function(struct opt *o, struct ir_function *fn) {
+    o->fn = fn;
+    opt_reserve_scratch(o, fn);
+    memset(o->states, OPT_UNKNOWN, fn->count);
+    memset(o->alias, 0, fn->count * sizeof(uint32_t));
+    memset(o->reached, 0, fn->block_count);
+    memset(o->feasible, OPT_NONE, fn->block_count);
+    o->work_count = 0;
+    o->block_work_count = 0;
+    for (uint32_t b = 0; b < fn->block_count; b++)
+        for (uint32_t v = fn->blocks[b].first; v < fn->blocks[b].end; v++)
+            o->block_of[v] = b;
+
+    opt_propagate(o);
+    opt_rewrite(o);
+    opt_keep_edges(o);
+    opt_mark_live(o);
+    opt_layout(o);
+    opt_fuse(o);
+}
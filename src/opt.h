@@ -0,0 +1,68 @@
+#ifndef PEACHOPT_H
+#define PEACHOPT_H
+
+#include <stdint.h>
+
+#include "ir.h"
+
+// Optimizes one function in SSA form at a time, the -O1 pipeline.
+//
+// Constants are propagated and folded by sparse conditional constant
+// propagation, "Constant Propagation with Conditional Branches" (Wegman and
+// Zadeck): a value is unknown, a constant or varying, and only the edges a
+// branch can take with what's known lead to blocks that are evaluated.
+// Values go down the lattice at most twice and blocks are reached once, so
+// the analysis is linear in the size of the function.
+//
+// The function is then rewritten: values found constant become IR_CONST,
+// branches on a constant jump, copies, trivial phis and operations with an
+// identity operand are replaced by the value they forward. Values nothing
+// with an effect depends on are dropped with the blocks never reached, and
+// the function is laid out again in a single pass. Each step is linear.
+//
+// A comparison only used by the branch right after it is marked
+// IR_FLAG_FUSED last, see ir.h.
+struct opt {
+    struct ir_function *fn;
+
+    // by value: lattice, value replacing it, whether it's kept, and its new
+    // number.
+    uint8_t *states;
+    int64_t *constants;
+    uint32_t *alias;
+    uint8_t *live;
+    uint32_t *renumber;
+    uint32_t *block_of;
+    // values whose lattice changed, and those found live, left to visit.
+    uint32_t *work;
+    uint32_t work_count;
+    uint32_t value_capacity;
+
+    // by block: reached, the successors its terminator may take, the one
+    // it takes if it's a single one, and the new number.
+    uint8_t *reached;
+    uint8_t *feasible;
+    uint32_t *taken;
+    uint32_t *block_renumber;
+    uint32_t *stamps;
+    uint32_t *block_work;
+    uint32_t block_work_count;
+    uint32_t block_capacity;
+
+    // by item of ir_function::extra: whether the predecessor edge it lists
+    // is kept.
+    uint8_t *kept;
+    uint32_t kept_capacity;
+
+    // the function laid out again, its arrays are swapped with those of
+    // the function optimized.
+    struct ir_function out;
+};
+
+struct opt *opt_create(void);
+void opt_free(struct opt *o);
+
+// Optimizes `fn` in place.
+void opt_function(struct opt *o, struct ir_function *fn);
+
+#endif  // PEACHOPT_H
@@ -0,0 +1,348 @@
+#include "output.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "../helpers/buffer.h"
+
+// Max amount of chunks flushed by a single writev.
+#define OUTPUT_WRITEV_BATCH OUTPUT_MAX_CHUNKS
+
+static void output_ring_push(struct output_ring *ring,
+                             struct output_chunk *chunk) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    ring->chunks[head % OUTPUT_RING_SIZE] = chunk;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+// Callers only pop after a sem_wait on the semaphore counting the ring, so
+// the ring is never empty here.
+static struct output_chunk *output_ring_pop(struct output_ring *ring) {
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    // pairs with the release store of head in output_ring_push.
+    atomic_load_explicit(&ring->head, memory_order_acquire);
+    struct output_chunk *chunk = ring->chunks[tail % OUTPUT_RING_SIZE];
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    return chunk;
+}
+
+// Writes every iovec completely, retrying on short writes.
+static int output_writev_all(int fd, struct iovec *iov, int count) {
+    while (count > 0) {
+        ssize_t written = writev(fd, iov, count);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return errno;
+        }
+
+        while (count > 0 && (size_t)written >= iov->iov_len) {
+            written -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (char *)iov->iov_base + written;
+            iov->iov_len -= written;
+        }
+    }
+    return 0;
+}
+
+// Flushes the batch and hands its chunks back to the emitter.
+static void output_flush_batch(struct output *out,
+                               struct output_chunk **batch, int count) {
+    struct iovec iov[OUTPUT_WRITEV_BATCH];
+    for (int i = 0; i < count; i++) {
+        iov[i].iov_base = batch[i]->data;
+        iov[i].iov_len = batch[i]->len;
+    }
+
+    // after a failed write the remaining chunks are dropped, the output is
+    // going to be discarded anyway.
+    if (atomic_load_explicit(&out->error, memory_order_relaxed) == 0) {
+        int err = output_writev_all(out->fd, iov, count);
+        if (err) atomic_store_explicit(&out->error, err, memory_order_relaxed);
+    }
+
+    for (int i = 0; i < count; i++) {
+        batch[i]->len = 0;
+        output_ring_push(&out->free, batch[i]);
+        sem_post(&out->free_count);
+    }
+}
+
+static void *output_writer_main(void *arg) {
+    struct output *out = arg;
+    struct output_chunk *batch[OUTPUT_WRITEV_BATCH];
+
+    for (;;) {
+        while (sem_wait(&out->queued_count) != 0) {
+        }
+
+        // gather whatever else is already queued so a burst of chunks goes
+        // out with a single writev.
+        int count = 0;
+        struct output_chunk *chunk = output_ring_pop(&out->queued);
+        while (chunk) {
+            batch[count++] = chunk;
+            if (count == OUTPUT_WRITEV_BATCH ||
+                sem_trywait(&out->queued_count) != 0)
+                break;
+            chunk = output_ring_pop(&out->queued);
+        }
+
+        if (count) output_flush_batch(out, batch, count);
+
+        // a NULL chunk is queued last by output_stop_writer.
+        if (!chunk) return NULL;
+    }
+}
+
+// Builds "<dir>/.<name>.XXXXXX" for `path` so the rename on commit stays
+// within one file system.
+static char *output_tmp_template(const char *path) {
+    const char *slash = strrchr(path, '/');
+    size_t dir_len = slash ? (size_t)(slash - path) + 1 : 0;
+    const char *name = path + dir_len;
+
+    struct buffer buf;
+    buffer_init(&buf);
+    buffer_write_bytes(&buf, path, dir_len);
+    buffer_printf(&buf, ".%s.XXXXXX", name);
+    char *tmp = buffer_strdup(&buf);
+    buffer_release(&buf);
+    return tmp;
+}
+
+// Follows the symbolic links `path` goes through to the file they point to,
+// which may not exist yet. Returns NULL with errno set on a loop.
+static char *output_resolve(const char *path) {
+    char *resolved = strdup(path);
+    for (int hops = 0; hops < 40; hops++) {
+        struct stat st;
+        if (lstat(resolved, &st) != 0 || !S_ISLNK(st.st_mode)) return resolved;
+
+        char target[PATH_MAX];
+        ssize_t len = readlink(resolved, target, sizeof(target) - 1);
+        if (len < 0) return resolved;
+        target[len] = 0;
+
+        // a relative target is relative to the directory of the link.
+        struct buffer buf;
+        buffer_init(&buf);
+        const char *slash = strrchr(resolved, '/');
+        if (target[0] != '/' && slash)
+            buffer_write_bytes(&buf, resolved, slash - resolved + 1);
+        buffer_write_bytes(&buf, target, len);
+        free(resolved);
+        resolved = buffer_strdup(&buf);
+        buffer_release(&buf);
+    }
+    free(resolved);
+    errno = ELOOP;
+    return NULL;
+}
+
+// Opens the destination itself, for files rename can't replace.
+static int output_open_in_place(struct output *out) {
+    out->fd = open(out->path, O_WRONLY | O_TRUNC | O_CLOEXEC);
+    return out->fd;
+}
+
+// Creates the temporary file with the permissions of the destination, or
+// those fopen would give a new file.
+static int output_open_tmp(struct output *out, const struct stat *existing) {
+    out->tmp_path = output_tmp_template(out->path);
+    out->fd = mkstemp(out->tmp_path);
+    if (out->fd < 0) return -1;
+
+    mode_t mode;
+    if (existing) {
+        mode = existing->st_mode & 07777;
+    } else {
+        mode_t mask = umask(0);
+        umask(mask);
+        mode = 0666 & ~mask;
+    }
+    fchmod(out->fd, mode);
+    return out->fd;
+}
+
+struct output *output_open(const char *path) {
+    struct output *out = calloc(1, sizeof(struct output));
+    out->path = output_resolve(path);
+
+    struct stat st;
+    bool exists = out->path && stat(out->path, &st) == 0;
+    int fd = -1;
+    if (out->path)
+        fd = exists && !S_ISREG(st.st_mode)
+                 ? output_open_in_place(out)
+                 : output_open_tmp(out, exists ? &st : NULL);
+    if (fd < 0) {
+        int err = errno;
+        free(out->tmp_path);
+        free(out->path);
+        free(out);
+        errno = err;
+        return NULL;
+    }
+
+    sem_init(&out->queued_count, 0, 0);
+    sem_init(&out->free_count, 0, OUTPUT_MAX_CHUNKS);
+    for (int i = 0; i < OUTPUT_MAX_CHUNKS; i++) {
+        struct output_chunk *chunk = &out->chunk_storage[i];
+        chunk->data = aligned_alloc(OUTPUT_CHUNK_ALIGNMENT, OUTPUT_CHUNK_SIZE);
+        output_ring_push(&out->free, chunk);
+    }
+
+    pthread_create(&out->writer, NULL, output_writer_main, out);
+    return out;
+}
+
+struct output *output_open_memory(struct buffer *buf) {
+    struct output *out = calloc(1, sizeof(struct output));
+    out->fd = -1;
+    out->memory = buf;
+    out->memory_start = buffer_len(buf);
+    return out;
+}
+
+static void output_queue_current(struct output *out) {
+    output_ring_push(&out->queued, out->current);
+    sem_post(&out->queued_count);
+    out->current = NULL;
+}
+
+// Makes sure there is a chunk with free space to write to, blocks while every
+// chunk is queued for the writer thread.
+static struct output_chunk *output_current(struct output *out) {
+    if (out->current && out->current->len == OUTPUT_CHUNK_SIZE)
+        output_queue_current(out);
+
+    if (!out->current) {
+        while (sem_wait(&out->free_count) != 0) {
+        }
+        out->current = output_ring_pop(&out->free);
+    }
+    return out->current;
+}
+
+void output_write(struct output *out, const void *data, size_t len) {
+    if (out->memory) {
+        buffer_write_bytes(out->memory, data, len);
+        return;
+    }
+
+    const char *bytes = data;
+    while (len) {
+        struct output_chunk *chunk = output_current(out);
+        size_t space = OUTPUT_CHUNK_SIZE - chunk->len;
+        size_t amount = len < space ? len : space;
+        memcpy(chunk->data + chunk->len, bytes, amount);
+        chunk->len += amount;
+        bytes += amount;
+        len -= amount;
+    }
+}
+
+void output_printf(struct output *out, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    if (out->memory) {
+        buffer_vprintf(out->memory, fmt, args);
+        va_end(args);
+        return;
+    }
+
+    va_list retry;
+    va_copy(retry, args);
+
+    // format straight into the chunk, only text crossing a chunk boundary
+    // takes the detour through a buffer.
+    struct output_chunk *chunk = output_current(out);
+    size_t space = OUTPUT_CHUNK_SIZE - chunk->len;
+    int len = vsnprintf(chunk->data + chunk->len, space, fmt, args);
+    if (len >= 0 && (size_t)len < space) {
+        chunk->len += len;
+    } else if (len > 0) {
+        struct buffer buf;
+        buffer_init(&buf);
+        buffer_reserve(&buf, len + 1);
+        vsnprintf(buffer_ptr(&buf), len + 1, fmt, retry);
+        output_write(out, buffer_ptr(&buf), len);
+        buffer_release(&buf);
+    }
+
+    va_end(retry);
+    va_end(args);
+}
+
+static void output_stop_writer(struct output *out) {
+    if (out->current && out->current->len)
+        output_queue_current(out);
+
+    output_ring_push(&out->queued, NULL);
+    sem_post(&out->queued_count);
+    pthread_join(out->writer, NULL);
+}
+
+static void output_free(struct output *out) {
+    if (out->memory) {
+        free(out);
+        return;
+    }
+
+    for (int i = 0; i < OUTPUT_MAX_CHUNKS; i++)
+        free(out->chunk_storage[i].data);
+    sem_destroy(&out->queued_count);
+    sem_destroy(&out->free_count);
+    free(out->tmp_path);
+    free(out->path);
+    free(out);
+}
+
+int output_commit(struct output *out) {
+    if (out->memory) {
+        output_free(out);
+        return 0;
+    }
+
+    output_stop_writer(out);
+
+    int err = atomic_load(&out->error);
+    if (close(out->fd) != 0 && !err) err = errno;
+    if (!err && out->tmp_path && rename(out->tmp_path, out->path) != 0)
+        err = errno;
+
+    if (err) {
+        if (out->tmp_path) unlink(out->tmp_path);
+        output_free(out);
+        errno = err;
+        return -1;
+    }
+
+    output_free(out);
+    return 0;
+}
+
+void output_abort(struct output *out) {
+    if (out->memory) {
+        out->memory->len = out->memory_start;
+        output_free(out);
+        return;
+    }
+
+    output_stop_writer(out);
+    close(out->fd);
+    if (out->tmp_path) unlink(out->tmp_path);
+    output_free(out);
+}
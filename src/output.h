@@ -0,0 +1,101 @@
+#ifndef PEACHOUTPUT_H
+#define PEACHOUTPUT_H
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Size and alignment of the chunks the emitter fills.
+#define OUTPUT_CHUNK_SIZE (64 * 1024)
+#define OUTPUT_CHUNK_ALIGNMENT 4096
+// Amount of chunks that exist per output. Once all of them are queued for the
+// writer thread the emitter blocks until one has been written, which bounds
+// the memory an output can hold on to.
+#define OUTPUT_MAX_CHUNKS 16
+// Capacity of an output_ring, large enough for every chunk plus the NULL
+// chunk which tells the writer thread to stop.
+#define OUTPUT_RING_SIZE 32
+
+struct output_chunk {
+    char *data;
+    size_t len;
+};
+
+// Single producer, single consumer ring of chunk pointers. It can hold every
+// chunk of an output so a push never finds it full.
+struct output_ring {
+    struct output_chunk *chunks[OUTPUT_RING_SIZE];
+    _Atomic size_t head;
+    _Atomic size_t tail;
+};
+
+// Compiler output file, or a caller supplied buffer for in-memory compiles.
+// The emitter fills aligned chunks which are handed to a background writer
+// thread that flushes them with writev, so code generation never waits on
+// disk I/O unless OUTPUT_MAX_CHUNKS chunks are already queued.
+// Everything is written to a temporary file next to the destination which is
+// renamed over it by output_commit, the destination never holds a partial
+// output. The destination is the file a symbolic link points to, and keeps
+// its permissions. A destination which exists and isn't a regular file, a
+// FIFO or /dev/null, can't be replaced and is written in place instead.
+struct output {
+    // destination path, symbolic links resolved, and the temporary file
+    // written until commit, NULL when writing in place.
+    char *path;
+    char *tmp_path;
+    int fd;
+
+    // chunk currently filled by the emitter.
+    struct output_chunk *current;
+
+    // chunks queued for the writer thread, and written chunks handed back to
+    // the emitter.
+    struct output_ring queued;
+    struct output_ring free;
+    // counts chunks in `queued`, the writer thread sleeps on it.
+    sem_t queued_count;
+    // counts chunks in `free`, the emitter sleeps on it when all chunks are
+    // queued.
+    sem_t free_count;
+
+    pthread_t writer;
+    // errno of the first failed write, 0 if none failed.
+    atomic_int error;
+
+    struct output_chunk chunk_storage[OUTPUT_MAX_CHUNKS];
+
+    // set for outputs created with output_open_memory, everything is appended
+    // to it directly and no writer thread exists.
+    struct buffer *memory;
+    // length of `memory` when the output was opened, restored on abort.
+    size_t memory_start;
+};
+
+// Creates a temporary file in the directory of `path` and starts the writer
+// thread. Returns NULL with errno set if the temporary file can't be created
+// or the destination opened.
+struct output *output_open(const char *path);
+
+// Creates an output appending to `buf`, output_abort truncates `buf` back to
+// the length it had when opened.
+struct output *output_open_memory(struct buffer *buf);
+
+// Appends `len` bytes to the output.
+void output_write(struct output *out, const void *data, size_t len);
+
+// Appends the formatted string to the output, no terminator is written.
+void output_printf(struct output *out, const char *fmt, ...);
+
+// Flushes everything written, stops the writer thread and atomically replaces
+// the destination with the output. Frees `out`.
+// Returns 0 on success, otherwise -1 with errno set and the destination left
+// untouched, unless it's written in place.
+int output_commit(struct output *out);
+
+// Stops the writer thread and deletes the temporary file, the destination is
+// left untouched unless it's written in place. Frees `out`.
+void output_abort(struct output *out);
+
+#endif  // PEACHOUTPUT_H
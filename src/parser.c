@@ -0,0 +1,1041 @@
+#include "parser.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../helpers/segvector.h"
+#include "lexer.h"
+#include "lexer_token.h"
+#include "token_stream.h"
+
+// Recursive descent over lexer::token_vec, binary operators are parsed by
+// precedence climbing. Every node goes to the parser's ast arena, lists are
+// gathered on parser::scratch and stored once complete.
+
+// Keywords the parser dispatches on, see parser_keyword.
+enum {
+    KEYWORD_NONE,
+    KEYWORD_BREAK,
+    KEYWORD_CASE,
+    KEYWORD_CHAR,
+    KEYWORD_CONST,
+    KEYWORD_CONTINUE,
+    KEYWORD_DEFAULT,
+    KEYWORD_DO,
+    KEYWORD_DOUBLE,
+    KEYWORD_ELSE,
+    KEYWORD_EXTERN,
+    KEYWORD_FLOAT,
+    KEYWORD_FOR,
+    KEYWORD_GOTO,
+    KEYWORD_IF,
+    KEYWORD_INT,
+    KEYWORD_LONG,
+    KEYWORD_RESTRICT,
+    KEYWORD_RETURN,
+    KEYWORD_SHORT,
+    KEYWORD_SIGNED,
+    KEYWORD_SIZEOF,
+    KEYWORD_STATIC,
+    KEYWORD_STRUCT,
+    KEYWORD_SWITCH,
+    KEYWORD_TYPEDEF,
+    KEYWORD_UNION,
+    KEYWORD_UNSIGNED,
+    KEYWORD_VOID,
+    KEYWORD_WHILE,
+};
+
+// Sorted by name for parser_keyword.
+static const struct {
+    const char *name;
+    int keyword;
+} parser_keywords[] = {
+    {"break", KEYWORD_BREAK},       {"case", KEYWORD_CASE},
+    {"char", KEYWORD_CHAR},         {"const", KEYWORD_CONST},
+    {"continue", KEYWORD_CONTINUE}, {"default", KEYWORD_DEFAULT},
+    {"do", KEYWORD_DO},             {"double", KEYWORD_DOUBLE},
+    {"else", KEYWORD_ELSE},         {"extern", KEYWORD_EXTERN},
+    {"float", KEYWORD_FLOAT},       {"for", KEYWORD_FOR},
+    {"goto", KEYWORD_GOTO},         {"if", KEYWORD_IF},
+    {"int", KEYWORD_INT},           {"long", KEYWORD_LONG},
+    {"restrict", KEYWORD_RESTRICT}, {"return", KEYWORD_RETURN},
+    {"short", KEYWORD_SHORT},       {"signed", KEYWORD_SIGNED},
+    {"sizeof", KEYWORD_SIZEOF},     {"static", KEYWORD_STATIC},
+    {"struct", KEYWORD_STRUCT},     {"switch", KEYWORD_SWITCH},
+    {"typedef", KEYWORD_TYPEDEF},   {"union", KEYWORD_UNION},
+    {"unsigned", KEYWORD_UNSIGNED}, {"void", KEYWORD_VOID},
+    {"while", KEYWORD_WHILE},
+};
+
+// Precedence of the binary operators, higher binds tighter. Assignments,
+// '?' and ',' are parsed on their own.
+static const uint8_t parser_binary_precedence[OPERATOR_COUNT] = {
+    [OPERATOR_STAR] = 10,        [OPERATOR_SLASH] = 10,
+    [OPERATOR_PERCENT] = 10,     [OPERATOR_PLUS] = 9,
+    [OPERATOR_MINUS] = 9,        [OPERATOR_SHIFT_LEFT] = 8,
+    [OPERATOR_SHIFT_RIGHT] = 8,  [OPERATOR_LESS] = 7,
+    [OPERATOR_GREATER] = 7,      [OPERATOR_LESS_EQUAL] = 7,
+    [OPERATOR_GREATER_EQUAL] = 7, [OPERATOR_EQUAL] = 6,
+    [OPERATOR_NOT_EQUAL] = 6,    [OPERATOR_AMPERSAND] = 5,
+    [OPERATOR_CARET] = 4,        [OPERATOR_PIPE] = 3,
+    [OPERATOR_LOGICAL_AND] = 2,  [OPERATOR_LOGICAL_OR] = 1,
+};
+
+// How a declarator may name what it declares.
+enum {
+    // a declaration, the name is required.
+    DECLARATOR_NAMED,
+    // a parameter, the name may be left out.
+    DECLARATOR_OPTIONAL,
+    // a type name of a cast or sizeof, there is no name.
+    DECLARATOR_ABSTRACT,
+};
+
+// Stands for the tokens past the end, its type matches no token.
+static const struct token parser_eof = {.type = -1};
+
+static void parser_error(struct parser *p, const struct token *tok,
+                         const char *msg, ...) {
+    // the end of the source is reported at the last token.
+    if (tok == &parser_eof && p->token_count)
+        tok = parser_token(p, p->token_count - 1);
+
+    if (p->quiet) compiler_fail(p->compiler);
+
+    va_list args;
+    printf("[ERROR]: ");
+    va_start(args, msg);
+    vprintf(msg, args);
+    va_end(args);
+    printf("\nParse error at line: %d, col: %d at file: %s\n", tok->pos.line,
+           tok->pos.col, p->compiler->pos.filename);
+    compiler_fail(p->compiler);
+}
+
+struct token *parser_token(struct parser *parser, uint32_t index) {
+    // the lexer may be growing the block directory of the token vector, the
+    // blocks handed over so far are indexed by the parser itself.
+    if (parser->stream)
+        return &parser->blocks[index >> SEGVECTOR_BLOCK_SHIFT]
+                              [index & SEGVECTOR_BLOCK_MASK];
+    return segvector_at(parser->lexer->token_vec, index);
+}
+
+// Takes the next batch of tokens from the lexer, returns false once every
+// token was taken.
+static bool parser_pull(struct parser *p) {
+    struct token_batch batch;
+    if (!p->stream || !token_stream_pop(p->stream, &batch)) return false;
+
+    if (p->block_count == p->block_capacity) {
+        p->block_capacity = p->block_capacity ? p->block_capacity * 2 : 64;
+        p->blocks =
+            realloc(p->blocks, p->block_capacity * sizeof(struct token *));
+    }
+    p->blocks[p->block_count++] = batch.tokens;
+    p->token_count = batch.end;
+    return true;
+}
+
+static const struct token *parser_peek_at(struct parser *p, uint32_t offset) {
+    while (p->pos + offset >= p->token_count)
+        if (!parser_pull(p)) return &parser_eof;
+    return parser_token(p, p->pos + offset);
+}
+
+// Returns the index of the bracket matching `tok`. While streaming the
+// match is only known once the lexer reached it.
+static uint32_t parser_bracket_match(struct parser *p, const struct token *tok) {
+    int match;
+    while ((match = __atomic_load_n(&tok->bracket_match, __ATOMIC_RELAXED)) <
+               0 ||
+           (uint32_t)match >= p->token_count) {
+        // the lexer failed before reaching it and reported why.
+        if (!parser_pull(p)) compiler_fail(p->compiler);
+    }
+    return match;
+}
+
+static const struct token *parser_peek(struct parser *p) {
+    return parser_peek_at(p, 0);
+}
+
+static bool parser_is_symbol(const struct token *tok, char c) {
+    return tok->type == TOKEN_TYPE_SYMBOL && tok->cval == c;
+}
+
+static bool parser_is_operator(const struct token *tok, int op) {
+    return tok->type == TOKEN_TYPE_OPERATOR && tok->op == op;
+}
+
+static int parser_keyword(const struct token *tok) {
+    if (tok->type != TOKEN_TYPE_KEYWORD) return KEYWORD_NONE;
+
+    int lo = 0;
+    int hi = sizeof(parser_keywords) / sizeof(parser_keywords[0]);
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        int cmp = strcmp(tok->sval, parser_keywords[mid].name);
+        if (cmp == 0) return parser_keywords[mid].keyword;
+        if (cmp < 0)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    return KEYWORD_NONE;
+}
+
+// Consumes the next token if it's the symbol `c`.
+static bool parser_accept_symbol(struct parser *p, char c) {
+    if (!parser_is_symbol(parser_peek(p), c)) return false;
+    p->pos++;
+    return true;
+}
+
+static bool parser_accept_operator(struct parser *p, int op) {
+    if (!parser_is_operator(parser_peek(p), op)) return false;
+    p->pos++;
+    return true;
+}
+
+static bool parser_accept_keyword(struct parser *p, int keyword) {
+    if (parser_keyword(parser_peek(p)) != keyword) return false;
+    p->pos++;
+    return true;
+}
+
+// Consumes the symbol `c` or fails, returns its index.
+static uint32_t parser_expect_symbol(struct parser *p, char c) {
+    if (!parser_is_symbol(parser_peek(p), c))
+        parser_error(p, parser_peek(p), "Expected '%c'", c);
+    return p->pos++;
+}
+
+static uint32_t parser_expect_operator(struct parser *p, int op) {
+    if (!parser_is_operator(parser_peek(p), op))
+        parser_error(p, parser_peek(p), "Expected '%s'", operator_spelling(op));
+    return p->pos++;
+}
+
+static uint32_t parser_expect_identifier(struct parser *p) {
+    if (parser_peek(p)->type != TOKEN_TYPE_IDENTIFIER)
+        parser_error(p, parser_peek(p), "Expected an identifier");
+    return p->pos++;
+}
+
+static uint32_t parser_add(struct parser *p, int kind, int op, uint32_t token,
+                           uint32_t a, uint32_t b) {
+    return ast_add(&p->ast, kind, op, token, a, b);
+}
+
+static void parser_set_flags(struct parser *p, uint32_t node, int flags) {
+    ast_node(&p->ast, node)->flags |= flags;
+}
+
+static void parser_scratch_push(struct parser *p, uint32_t item) {
+    if (p->scratch_len == p->scratch_capacity) {
+        p->scratch_capacity = p->scratch_capacity ? p->scratch_capacity * 2 : 64;
+        p->scratch = realloc(p->scratch, p->scratch_capacity * sizeof(uint32_t));
+    }
+    p->scratch[p->scratch_len++] = item;
+}
+
+// Stores the items pushed since the scratch length was `top` as a list.
+static uint32_t parser_scratch_list(struct parser *p, uint32_t top) {
+    uint32_t list =
+        ast_add_list(&p->ast, p->scratch + top, p->scratch_len - top);
+    p->scratch_len = top;
+    return list;
+}
+
+static bool parser_is_type_start(const struct token *tok) {
+    switch (parser_keyword(tok)) {
+    case KEYWORD_CHAR:
+    case KEYWORD_CONST:
+    case KEYWORD_DOUBLE:
+    case KEYWORD_EXTERN:
+    case KEYWORD_FLOAT:
+    case KEYWORD_INT:
+    case KEYWORD_LONG:
+    case KEYWORD_RESTRICT:
+    case KEYWORD_SHORT:
+    case KEYWORD_SIGNED:
+    case KEYWORD_STATIC:
+    case KEYWORD_STRUCT:
+    case KEYWORD_TYPEDEF:
+    case KEYWORD_UNION:
+    case KEYWORD_UNSIGNED:
+    case KEYWORD_VOID:
+        return true;
+    }
+    return false;
+}
+
+static uint32_t parser_expression(struct parser *p);
+static uint32_t parser_assignment(struct parser *p);
+static uint32_t parser_conditional(struct parser *p);
+static uint32_t parser_cast(struct parser *p);
+static uint32_t parser_statement(struct parser *p);
+static uint32_t parser_compound(struct parser *p);
+static uint32_t parser_specifiers(struct parser *p, int *storage);
+static uint32_t parser_declarator(struct parser *p, uint32_t type,
+                                  uint32_t *name, int mode);
+
+static uint32_t parser_type_name(struct parser *p) {
+    uint32_t name;
+    return parser_declarator(p, parser_specifiers(p, NULL), &name,
+                             DECLARATOR_ABSTRACT);
+}
+
+// Returns true if a '(' at the next token starts a parenthesized type name.
+static bool parser_is_paren_type(struct parser *p) {
+    return parser_is_operator(parser_peek(p), OPERATOR_LEFT_PAREN) &&
+           parser_is_type_start(parser_peek_at(p, 1));
+}
+
+static uint32_t parser_primary(struct parser *p) {
+    const struct token *tok = parser_peek(p);
+    uint32_t start = p->pos;
+
+    switch (tok->type) {
+    case TOKEN_TYPE_IDENTIFIER:
+        p->pos++;
+        return parser_add(p, NODE_IDENTIFIER, 0, start, 0, 0);
+    case TOKEN_TYPE_NUMBER:
+        p->pos++;
+        return parser_add(p, NODE_NUMBER, 0, start, 0, 0);
+    case TOKEN_TYPE_STRING: {
+        // adjacent string literals are concatenated.
+        uint32_t count = 0;
+        while (parser_peek(p)->type == TOKEN_TYPE_STRING) {
+            p->pos++;
+            count++;
+        }
+        return parser_add(p, NODE_STRING, 0, start, 0, count);
+    }
+    }
+
+    if (parser_accept_operator(p, OPERATOR_LEFT_PAREN)) {
+        uint32_t expr = parser_expression(p);
+        parser_expect_symbol(p, ')');
+        return expr;
+    }
+    parser_error(p, tok, "Expected an expression");
+    return 0;
+}
+
+static uint32_t parser_postfix(struct parser *p) {
+    uint32_t expr = parser_primary(p);
+    for (;;) {
+        const struct token *tok = parser_peek(p);
+        uint32_t start = p->pos;
+        if (tok->type != TOKEN_TYPE_OPERATOR) return expr;
+
+        switch (tok->op) {
+        case OPERATOR_LEFT_BRACKET: {
+            p->pos++;
+            uint32_t index = parser_expression(p);
+            parser_expect_symbol(p, ']');
+            expr = parser_add(p, NODE_INDEX, 0, start, expr, index);
+            break;
+        }
+        case OPERATOR_LEFT_PAREN: {
+            p->pos++;
+            uint32_t top = p->scratch_len;
+            if (!parser_is_symbol(parser_peek(p), ')')) {
+                do {
+                    parser_scratch_push(p, parser_assignment(p));
+                } while (parser_accept_operator(p, OPERATOR_COMMA));
+            }
+            parser_expect_symbol(p, ')');
+            expr = parser_add(p, NODE_CALL, 0, start, expr,
+                              parser_scratch_list(p, top));
+            break;
+        }
+        case OPERATOR_DOT:
+        case OPERATOR_ARROW: {
+            p->pos++;
+            uint32_t name = parser_expect_identifier(p);
+            expr = parser_add(p, NODE_MEMBER, tok->op, name, expr, 0);
+            break;
+        }
+        case OPERATOR_INCREMENT:
+        case OPERATOR_DECREMENT:
+            p->pos++;
+            expr = parser_add(p, NODE_POSTFIX, tok->op, start, expr, 0);
+            break;
+        default:
+            return expr;
+        }
+    }
+}
+
+static uint32_t parser_unary(struct parser *p) {
+    const struct token *tok = parser_peek(p);
+    uint32_t start = p->pos;
+
+    if (tok->type == TOKEN_TYPE_OPERATOR) {
+        switch (tok->op) {
+        case OPERATOR_PLUS:
+        case OPERATOR_MINUS:
+        case OPERATOR_NOT:
+        case OPERATOR_TILDE:
+        case OPERATOR_STAR:
+        case OPERATOR_AMPERSAND:
+            p->pos++;
+            return parser_add(p, NODE_UNARY, tok->op, start, parser_cast(p), 0);
+        case OPERATOR_INCREMENT:
+        case OPERATOR_DECREMENT:
+            p->pos++;
+            return parser_add(p, NODE_UNARY, tok->op, start, parser_unary(p), 0);
+        }
+    }
+
+    if (parser_accept_keyword(p, KEYWORD_SIZEOF)) {
+        if (parser_is_paren_type(p)) {
+            p->pos++;
+            uint32_t type = parser_type_name(p);
+            parser_expect_symbol(p, ')');
+            return parser_add(p, NODE_SIZEOF_TYPE, 0, start, type, 0);
+        }
+        return parser_add(p, NODE_SIZEOF_EXPR, 0, start, parser_unary(p), 0);
+    }
+    return parser_postfix(p);
+}
+
+static uint32_t parser_cast(struct parser *p) {
+    if (!parser_is_paren_type(p)) return parser_unary(p);
+
+    uint32_t start = p->pos++;
+    uint32_t type = parser_type_name(p);
+    parser_expect_symbol(p, ')');
+    if (parser_is_symbol(parser_peek(p), '{'))
+        parser_error(p, parser_peek(p), "Compound literals are not supported");
+    return parser_add(p, NODE_CAST, 0, start, type, parser_cast(p));
+}
+
+// Parses binary operators binding at least as tight as `min_precedence`.
+static uint32_t parser_binary(struct parser *p, int min_precedence) {
+    uint32_t lhs = parser_cast(p);
+    for (;;) {
+        const struct token *tok = parser_peek(p);
+        if (tok->type != TOKEN_TYPE_OPERATOR) return lhs;
+        int precedence = parser_binary_precedence[tok->op];
+        if (!precedence || precedence < min_precedence) return lhs;
+
+        uint32_t op = p->pos++;
+        uint32_t rhs = parser_binary(p, precedence + 1);
+        lhs = parser_add(p, NODE_BINARY, tok->op, op, lhs, rhs);
+    }
+}
+
+static uint32_t parser_conditional(struct parser *p) {
+    uint32_t cond = parser_binary(p, 1);
+    if (!parser_is_operator(parser_peek(p), OPERATOR_QUESTION)) return cond;
+
+    uint32_t start = p->pos++;
+    uint32_t branches[2];
+    branches[0] = parser_expression(p);
+    parser_expect_symbol(p, ':');
+    branches[1] = parser_conditional(p);
+    return parser_add(p, NODE_CONDITIONAL, 0, start, cond,
+                      ast_add_extra(&p->ast, branches, 2));
+}
+
+static bool parser_is_assignment(const struct token *tok) {
+    if (tok->type != TOKEN_TYPE_OPERATOR) return false;
+    switch (tok->op) {
+    case OPERATOR_ASSIGN:
+    case OPERATOR_PLUS_ASSIGN:
+    case OPERATOR_MINUS_ASSIGN:
+    case OPERATOR_STAR_ASSIGN:
+    case OPERATOR_SLASH_ASSIGN:
+    case OPERATOR_PERCENT_ASSIGN:
+    case OPERATOR_AMPERSAND_ASSIGN:
+    case OPERATOR_PIPE_ASSIGN:
+    case OPERATOR_CARET_ASSIGN:
+    case OPERATOR_SHIFT_LEFT_ASSIGN:
+    case OPERATOR_SHIFT_RIGHT_ASSIGN:
+        return true;
+    }
+    return false;
+}
+
+static uint32_t parser_assignment(struct parser *p) {
+    uint32_t lhs = parser_conditional(p);
+    const struct token *tok = parser_peek(p);
+    if (!parser_is_assignment(tok)) return lhs;
+
+    // assignments group right to left.
+    uint32_t op = p->pos++;
+    return parser_add(p, NODE_BINARY, tok->op, op, lhs, parser_assignment(p));
+}
+
+static uint32_t parser_expression(struct parser *p) {
+    uint32_t lhs = parser_assignment(p);
+    while (parser_is_operator(parser_peek(p), OPERATOR_COMMA)) {
+        uint32_t op = p->pos++;
+        lhs = parser_add(p, NODE_BINARY, OPERATOR_COMMA, op, lhs,
+                         parser_assignment(p));
+    }
+    return lhs;
+}
+
+// Parses a struct or union specifier, the keyword is the next token.
+static uint32_t parser_struct(struct parser *p) {
+    uint32_t keyword = p->pos++;
+    int op = parser_keyword(parser_token(p, keyword)) == KEYWORD_STRUCT
+                 ? AST_TYPE_STRUCT
+                 : AST_TYPE_UNION;
+
+    uint32_t tag = keyword;
+    int flags = 0;
+    if (parser_peek(p)->type == TOKEN_TYPE_IDENTIFIER)
+        tag = p->pos++;
+    else
+        flags |= NODE_FLAG_UNNAMED;
+
+    uint32_t members = 0;
+    if (parser_accept_symbol(p, '{')) {
+        uint32_t top = p->scratch_len;
+        while (!parser_accept_symbol(p, '}')) {
+            uint32_t start = p->pos;
+            uint32_t base = parser_specifiers(p, NULL);
+            uint32_t member_top = p->scratch_len;
+            do {
+                uint32_t name;
+                uint32_t type =
+                    parser_declarator(p, base, &name, DECLARATOR_NAMED);
+                parser_scratch_push(p, parser_add(p, NODE_VAR, 0, name, type, 0));
+            } while (parser_accept_operator(p, OPERATOR_COMMA));
+            parser_expect_symbol(p, ';');
+            parser_scratch_push(p, parser_add(p, NODE_DECLARATION, 0, start,
+                                              parser_scratch_list(p, member_top),
+                                              base));
+        }
+        members = parser_scratch_list(p, top);
+    } else if (flags & NODE_FLAG_UNNAMED) {
+        parser_error(p, parser_peek(p), "Expected a tag or '{'");
+    }
+
+    uint32_t node = parser_add(p, NODE_TYPE_STRUCT, op, tag, members, 0);
+    parser_set_flags(p, node, flags);
+    return node;
+}
+
+// Parses declaration specifiers into a type node. Storage classes are written
+// to `storage` as NODE_FLAG_* values, they aren't allowed if it's NULL.
+static uint32_t parser_specifiers(struct parser *p, int *storage) {
+    uint32_t start = p->pos;
+    int flags = 0;
+    uint32_t record = 0;
+    // amount of each specifier seen, any order is valid.
+    int voids = 0, chars = 0, shorts = 0, ints = 0, longs = 0, floats = 0,
+        doubles = 0, signs = 0;
+
+    for (;;) {
+        const struct token *tok = parser_peek(p);
+        int keyword = parser_keyword(tok);
+        if (keyword == KEYWORD_STRUCT || keyword == KEYWORD_UNION) {
+            if (record) parser_error(p, tok, "Invalid combination of type specifiers");
+            record = parser_struct(p);
+            continue;
+        }
+
+        switch (keyword) {
+        case KEYWORD_STATIC:
+        case KEYWORD_EXTERN:
+            if (!storage)
+                parser_error(p, tok, "Storage class is not allowed here");
+            *storage |= keyword == KEYWORD_STATIC ? NODE_FLAG_STATIC
+                                                  : NODE_FLAG_EXTERN;
+            break;
+        case KEYWORD_TYPEDEF:
+            parser_error(p, tok, "typedef is not supported");
+            break;
+        case KEYWORD_CONST:
+            flags |= NODE_FLAG_CONST;
+            break;
+        case KEYWORD_RESTRICT:
+            break;
+        case KEYWORD_UNSIGNED:
+            flags |= NODE_FLAG_UNSIGNED;
+            signs++;
+            break;
+        case KEYWORD_SIGNED:
+            flags |= NODE_FLAG_SIGNED;
+            signs++;
+            break;
+        case KEYWORD_VOID:
+            voids++;
+            break;
+        case KEYWORD_CHAR:
+            chars++;
+            break;
+        case KEYWORD_SHORT:
+            shorts++;
+            break;
+        case KEYWORD_INT:
+            ints++;
+            break;
+        case KEYWORD_LONG:
+            longs++;
+            break;
+        case KEYWORD_FLOAT:
+            floats++;
+            break;
+        case KEYWORD_DOUBLE:
+            doubles++;
+            break;
+        default:
+            goto done;
+        }
+        p->pos++;
+    }
+
+done:;
+    int specifiers = voids + chars + shorts + ints + longs + floats + doubles;
+    if (record) {
+        if (specifiers || signs)
+            parser_error(p, parser_token(p, start),
+                         "Invalid combination of type specifiers");
+        parser_set_flags(p, record, flags);
+        return record;
+    }
+
+    int base;
+    bool valid;
+    if (voids) {
+        base = AST_TYPE_VOID;
+        valid = specifiers == 1 && !signs;
+    } else if (chars) {
+        base = AST_TYPE_CHAR;
+        valid = specifiers == 1;
+    } else if (shorts) {
+        base = AST_TYPE_SHORT;
+        valid = shorts == 1 && ints <= 1 && specifiers == shorts + ints;
+    } else if (floats) {
+        base = AST_TYPE_FLOAT;
+        valid = specifiers == 1 && !signs;
+    } else if (doubles) {
+        base = longs ? AST_TYPE_LONG_DOUBLE : AST_TYPE_DOUBLE;
+        valid = doubles == 1 && longs <= 1 && specifiers == 1 + longs && !signs;
+    } else if (longs) {
+        base = longs == 1 ? AST_TYPE_LONG : AST_TYPE_LONG_LONG;
+        valid = longs <= 2 && ints <= 1 && specifiers == longs + ints;
+    } else {
+        // 'unsigned' and 'signed' alone mean int, nothing at all is an error.
+        base = AST_TYPE_INT;
+        valid = ints == 1 || (!ints && signs);
+    }
+    if (signs > 1 || (signs && (flags & NODE_FLAG_UNSIGNED) &&
+                      (flags & NODE_FLAG_SIGNED)))
+        valid = false;
+
+    if (!valid) {
+        if (p->pos == start)
+            parser_error(p, parser_peek(p), "Expected a type");
+        parser_error(p, parser_token(p, start),
+                     "Invalid combination of type specifiers");
+    }
+
+    uint32_t type = parser_add(p, NODE_TYPE_BASE, base, start, 0, 0);
+    parser_set_flags(p, type, flags);
+    return type;
+}
+
+// Parses a parameter list, the '(' was read. Returns the list of NODE_PARAM.
+static uint32_t parser_params(struct parser *p, int *flags) {
+    uint32_t top = p->scratch_len;
+
+    // '(void)' declares no parameters, so does '()'.
+    if (parser_keyword(parser_peek(p)) == KEYWORD_VOID &&
+        parser_is_symbol(parser_peek_at(p, 1), ')'))
+        p->pos++;
+
+    while (!parser_is_symbol(parser_peek(p), ')')) {
+        if (parser_accept_operator(p, OPERATOR_ELLIPSIS)) {
+            *flags |= NODE_FLAG_VARIADIC;
+            break;
+        }
+
+        uint32_t start = p->pos;
+        uint32_t name;
+        uint32_t type = parser_declarator(p, parser_specifiers(p, NULL), &name,
+                                          DECLARATOR_OPTIONAL);
+        uint32_t param = parser_add(p, NODE_PARAM, 0,
+                                    name == UINT32_MAX ? start : name, type, 0);
+        if (name == UINT32_MAX) parser_set_flags(p, param, NODE_FLAG_UNNAMED);
+        parser_scratch_push(p, param);
+
+        if (!parser_accept_operator(p, OPERATOR_COMMA)) break;
+    }
+    parser_expect_symbol(p, ')');
+    return parser_scratch_list(p, top);
+}
+
+// Parses the array and function suffixes of a declarator applied to `type`.
+static uint32_t parser_suffixes(struct parser *p, uint32_t type) {
+    uint32_t start = p->pos;
+    if (parser_accept_operator(p, OPERATOR_LEFT_BRACKET)) {
+        uint32_t size = 0;
+        if (!parser_is_symbol(parser_peek(p), ']')) size = parser_assignment(p);
+        parser_expect_symbol(p, ']');
+        // int a[2][3] is an array of two arrays of three ints.
+        return parser_add(p, NODE_TYPE_ARRAY, 0, start,
+                          parser_suffixes(p, type), size);
+    }
+    if (parser_accept_operator(p, OPERATOR_LEFT_PAREN)) {
+        int flags = 0;
+        uint32_t params = parser_params(p, &flags);
+        uint32_t node = parser_add(p, NODE_TYPE_FUNCTION, 0, start,
+                                   parser_suffixes(p, type), params);
+        parser_set_flags(p, node, flags);
+        return node;
+    }
+    return type;
+}
+
+// Parses a declarator, returns the type it gives `type`. The index of the
+// declared name is written to `name`, UINT32_MAX if there is none.
+static uint32_t parser_declarator(struct parser *p, uint32_t type,
+                                  uint32_t *name, int mode) {
+    while (parser_is_operator(parser_peek(p), OPERATOR_STAR)) {
+        type = parser_add(p, NODE_TYPE_POINTER, 0, p->pos++, type, 0);
+        for (;;) {
+            if (parser_accept_keyword(p, KEYWORD_CONST))
+                parser_set_flags(p, type, NODE_FLAG_CONST);
+            else if (!parser_accept_keyword(p, KEYWORD_RESTRICT))
+                break;
+        }
+    }
+
+    const struct token *tok = parser_peek(p);
+    const struct token *inner = parser_peek_at(p, 1);
+    if (parser_is_operator(tok, OPERATOR_LEFT_PAREN) &&
+        (parser_is_operator(inner, OPERATOR_STAR) ||
+         (mode == DECLARATOR_NAMED && inner->type == TOKEN_TYPE_IDENTIFIER))) {
+        // the declarator within the parentheses applies to the type made by
+        // the suffixes after them, in int (*f)(void) f is a pointer to a
+        // function. The suffixes are parsed first by jumping over the
+        // parentheses, then the inner declarator.
+        uint32_t open = p->pos;
+        uint32_t close = parser_bracket_match(p, tok);
+        p->pos = close + 1;
+        type = parser_suffixes(p, type);
+        uint32_t end = p->pos;
+
+        p->pos = open + 1;
+        type = parser_declarator(p, type, name, mode);
+        if (p->pos != close)
+            parser_error(p, parser_peek(p), "Expected ')'");
+        p->pos = end;
+        return type;
+    }
+
+    *name = UINT32_MAX;
+    if (mode != DECLARATOR_ABSTRACT && tok->type == TOKEN_TYPE_IDENTIFIER)
+        *name = p->pos++;
+    else if (mode == DECLARATOR_NAMED)
+        parser_error(p, tok, "Expected an identifier");
+    return parser_suffixes(p, type);
+}
+
+static uint32_t parser_initializer(struct parser *p) {
+    if (!parser_is_symbol(parser_peek(p), '{')) return parser_assignment(p);
+
+    uint32_t start = p->pos++;
+    uint32_t top = p->scratch_len;
+    while (!parser_accept_symbol(p, '}')) {
+        parser_scratch_push(p, parser_initializer(p));
+        // a trailing ',' is allowed.
+        if (!parser_accept_operator(p, OPERATOR_COMMA)) {
+            parser_expect_symbol(p, '}');
+            break;
+        }
+    }
+    return parser_add(p, NODE_INIT_LIST, 0, start, parser_scratch_list(p, top),
+                      0);
+}
+
+// Parses the declarators of a declaration starting at `start`, the first of
+// them `type` named `name` was read already.
+static uint32_t parser_declaration_rest(struct parser *p, uint32_t start,
+                                        uint32_t base, int storage,
+                                        uint32_t type, uint32_t name) {
+    uint32_t top = p->scratch_len;
+    for (;;) {
+        uint32_t init = 0;
+        if (parser_accept_operator(p, OPERATOR_ASSIGN))
+            init = parser_initializer(p);
+        uint32_t var = parser_add(p, NODE_VAR, 0, name, type, init);
+        parser_set_flags(p, var, storage);
+        parser_scratch_push(p, var);
+
+        if (!parser_accept_operator(p, OPERATOR_COMMA)) break;
+        type = parser_declarator(p, base, &name, DECLARATOR_NAMED);
+    }
+    parser_expect_symbol(p, ';');
+    return parser_add(p, NODE_DECLARATION, 0, start,
+                      parser_scratch_list(p, top), base);
+}
+
+static uint32_t parser_declaration(struct parser *p) {
+    uint32_t start = p->pos;
+    int storage = 0;
+    uint32_t base = parser_specifiers(p, &storage);
+    if (parser_accept_symbol(p, ';'))
+        return parser_add(p, NODE_DECLARATION, 0, start,
+                          ast_add_list(&p->ast, NULL, 0), base);
+
+    uint32_t name;
+    uint32_t type = parser_declarator(p, base, &name, DECLARATOR_NAMED);
+    return parser_declaration_rest(p, start, base, storage, type, name);
+}
+
+static uint32_t parser_block_item(struct parser *p) {
+    if (parser_is_type_start(parser_peek(p))) return parser_declaration(p);
+    return parser_statement(p);
+}
+
+static uint32_t parser_compound(struct parser *p) {
+    uint32_t start = parser_expect_symbol(p, '{');
+    uint32_t top = p->scratch_len;
+    while (!parser_accept_symbol(p, '}'))
+        parser_scratch_push(p, parser_block_item(p));
+    return parser_add(p, NODE_COMPOUND, 0, start, parser_scratch_list(p, top),
+                      0);
+}
+
+// Parses '(' expression ')' of if, while and switch.
+static uint32_t parser_paren_expression(struct parser *p) {
+    parser_expect_operator(p, OPERATOR_LEFT_PAREN);
+    uint32_t expr = parser_expression(p);
+    parser_expect_symbol(p, ')');
+    return expr;
+}
+
+static uint32_t parser_for(struct parser *p, uint32_t start) {
+    parser_expect_operator(p, OPERATOR_LEFT_PAREN);
+
+    uint32_t clauses[3] = {0};
+    if (parser_is_type_start(parser_peek(p))) {
+        clauses[0] = parser_declaration(p);
+    } else {
+        if (!parser_is_symbol(parser_peek(p), ';'))
+            clauses[0] = parser_expression(p);
+        parser_expect_symbol(p, ';');
+    }
+    if (!parser_is_symbol(parser_peek(p), ';')) clauses[1] = parser_expression(p);
+    parser_expect_symbol(p, ';');
+    if (!parser_is_symbol(parser_peek(p), ')')) clauses[2] = parser_expression(p);
+    parser_expect_symbol(p, ')');
+
+    uint32_t extra = ast_add_extra(&p->ast, clauses, 3);
+    return parser_add(p, NODE_FOR, 0, start, extra, parser_statement(p));
+}
+
+static uint32_t parser_statement(struct parser *p) {
+    const struct token *tok = parser_peek(p);
+    uint32_t start = p->pos;
+
+    if (parser_is_symbol(tok, '{')) return parser_compound(p);
+    if (parser_accept_symbol(p, ';'))
+        return parser_add(p, NODE_EMPTY, 0, start, 0, 0);
+
+    // a name followed by ':' labels the statement.
+    if (tok->type == TOKEN_TYPE_IDENTIFIER &&
+        parser_is_symbol(parser_peek_at(p, 1), ':')) {
+        p->pos += 2;
+        return parser_add(p, NODE_LABEL, 0, start, parser_statement(p), 0);
+    }
+
+    int keyword = parser_keyword(tok);
+    switch (keyword) {
+    case KEYWORD_IF: {
+        p->pos++;
+        uint32_t cond = parser_paren_expression(p);
+        uint32_t branches[2] = {parser_statement(p), 0};
+        if (parser_accept_keyword(p, KEYWORD_ELSE))
+            branches[1] = parser_statement(p);
+        return parser_add(p, NODE_IF, 0, start, cond,
+                          ast_add_extra(&p->ast, branches, 2));
+    }
+    case KEYWORD_WHILE: {
+        p->pos++;
+        uint32_t cond = parser_paren_expression(p);
+        return parser_add(p, NODE_WHILE, 0, start, cond, parser_statement(p));
+    }
+    case KEYWORD_DO: {
+        p->pos++;
+        uint32_t body = parser_statement(p);
+        if (!parser_accept_keyword(p, KEYWORD_WHILE))
+            parser_error(p, parser_peek(p), "Expected 'while'");
+        uint32_t cond = parser_paren_expression(p);
+        parser_expect_symbol(p, ';');
+        return parser_add(p, NODE_DO, 0, start, body, cond);
+    }
+    case KEYWORD_FOR:
+        p->pos++;
+        return parser_for(p, start);
+    case KEYWORD_SWITCH: {
+        p->pos++;
+        uint32_t cond = parser_paren_expression(p);
+        return parser_add(p, NODE_SWITCH, 0, start, cond, parser_statement(p));
+    }
+    case KEYWORD_CASE: {
+        p->pos++;
+        uint32_t value = parser_conditional(p);
+        parser_expect_symbol(p, ':');
+        return parser_add(p, NODE_CASE, 0, start, value, parser_statement(p));
+    }
+    case KEYWORD_DEFAULT:
+        p->pos++;
+        parser_expect_symbol(p, ':');
+        return parser_add(p, NODE_DEFAULT, 0, start, 0, parser_statement(p));
+    case KEYWORD_RETURN: {
+        p->pos++;
+        uint32_t value = 0;
+        if (!parser_is_symbol(parser_peek(p), ';')) value = parser_expression(p);
+        parser_expect_symbol(p, ';');
+        return parser_add(p, NODE_RETURN, 0, start, value, 0);
+    }
+    case KEYWORD_BREAK:
+    case KEYWORD_CONTINUE:
+        p->pos++;
+        parser_expect_symbol(p, ';');
+        return parser_add(p, keyword == KEYWORD_BREAK ? NODE_BREAK
+                                                      : NODE_CONTINUE,
+                          0, start, 0, 0);
+    case KEYWORD_GOTO: {
+        p->pos++;
+        uint32_t label = parser_expect_identifier(p);
+        parser_expect_symbol(p, ';');
+        return parser_add(p, NODE_GOTO, 0, label, 0, 0);
+    }
+    }
+
+    uint32_t expr = parser_expression(p);
+    parser_expect_symbol(p, ';');
+    return parser_add(p, NODE_EXPRESSION_STMT, 0, start, expr, 0);
+}
+
+// Parses a declaration or function definition at file scope.
+static uint32_t parser_external_declaration(struct parser *p) {
+    uint32_t start = p->pos;
+    int storage = 0;
+    uint32_t base = parser_specifiers(p, &storage);
+    if (parser_accept_symbol(p, ';'))
+        return parser_add(p, NODE_DECLARATION, 0, start,
+                          ast_add_list(&p->ast, NULL, 0), base);
+
+    uint32_t name;
+    uint32_t type = parser_declarator(p, base, &name, DECLARATOR_NAMED);
+    if (ast_node(&p->ast, type)->kind == NODE_TYPE_FUNCTION &&
+        parser_is_symbol(parser_peek(p), '{')) {
+        // the braces were matched while lexing, the body is skipped in one
+        // step and parsed later, possibly on another thread.
+        uint32_t open = p->pos;
+        p->pos = parser_bracket_match(p, parser_peek(p)) + 1;
+        uint32_t function = parser_add(p, NODE_FUNCTION, 0, name, type, open);
+        parser_set_flags(p, function, storage | NODE_FLAG_BODY_PENDING);
+
+        if (p->function_count == p->function_capacity) {
+            p->function_capacity =
+                p->function_capacity ? p->function_capacity * 2 : 64;
+            p->functions = realloc(p->functions,
+                                   p->function_capacity * sizeof(uint32_t));
+        }
+        p->functions[p->function_count++] = function;
+        return function;
+    }
+    return parser_declaration_rest(p, start, base, storage, type, name);
+}
+
+// Skips a directive the preprocessor passed through, #include lines are kept
+// in the token stream but mean nothing to the parser.
+static void parser_skip_directive(struct parser *p) {
+    do {
+        p->pos++;
+    } while (parser_peek(p) != &parser_eof &&
+             !(parser_peek(p)->flags & TOKEN_FLAG_AT_LINE_START));
+}
+
+// Parses the file scope from the first token on.
+static void parser_file(struct parser *p) {
+    ast_reset(&p->ast);
+    p->pos = 0;
+    p->scratch_len = 0;
+    p->function_count = 0;
+
+    uint32_t top = p->scratch_len;
+    while (parser_peek(p) != &parser_eof) {
+        const struct token *tok = parser_peek(p);
+        if (parser_is_symbol(tok, '#') && (tok->flags & TOKEN_FLAG_AT_LINE_START)) {
+            parser_skip_directive(p);
+            continue;
+        }
+        // a stray ';' at file scope is harmless.
+        if (parser_accept_symbol(p, ';')) continue;
+        parser_scratch_push(p, parser_external_declaration(p));
+    }
+    p->ast.root = parser_add(p, NODE_TRANSLATION_UNIT, 0, 0,
+                             parser_scratch_list(p, top), 0);
+}
+
+int parser_parse(struct parser *p) {
+    p->token_count = segvector_count(p->lexer->token_vec);
+    parser_file(p);
+    return PARSE_ALL_OK;
+}
+
+int parser_parse_stream(struct parser *p) {
+    p->stream = p->lexer->stream;
+    p->block_count = 0;
+    p->token_count = 0;
+    p->quiet = true;
+
+    int result = PARSE_ALL_OK;
+    jmp_buf jmp;
+    if (setjmp(jmp)) {
+        // the lexer waits whenever the stream is full, it must be drained for
+        // the lexer to finish.
+        while (parser_pull(p)) {
+        }
+        result = PARSE_GENERAL_ERROR;
+    } else {
+        compiler_catch_errors(&jmp);
+        parser_file(p);
+    }
+    compiler_catch_errors(NULL);
+
+    p->stream = NULL;
+    p->quiet = false;
+    return result;
+}
+
+uint32_t parser_parse_body(struct parser *p, uint32_t open) {
+    p->pos = open;
+    p->token_count = segvector_count(p->lexer->token_vec);
+    p->scratch_len = 0;
+    return parser_compound(p);
+}
+
+struct parser *parser_create(struct compiler *c) {
+    struct parser *p = calloc(1, sizeof(struct parser));
+    p->compiler = c;
+    p->lexer = c->lexer;
+    ast_init(&p->ast);
+    return p;
+}
+
+void parser_free(struct parser *parser) {
+    ast_free(&parser->ast);
+    free(parser->scratch);
+    free(parser->functions);
+    free(parser->blocks);
+    free(parser);
+}
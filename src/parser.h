@@ -0,0 +1,80 @@
+#ifndef PEACHPARSER_H
+#define PEACHPARSER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ast.h"
+#include "compiler.h"
+
+enum parse_errors {
+    PARSE_ALL_OK,
+    PARSE_GENERAL_ERROR,
+};
+
+struct parser {
+    struct compiler *compiler;
+    // tokens are read from the token vector of the compiler's lexer.
+    struct lexer *lexer;
+
+    // tree of the last parse, node::token indexes lexer::token_vec.
+    struct ast ast;
+
+    // index of the next token and the amount of tokens.
+    uint32_t pos;
+    uint32_t token_count;
+
+    // items of the lists being parsed, nested lists are stacked on top of
+    // the enclosing one and moved to the ast once complete.
+    uint32_t *scratch;
+    uint32_t scratch_len;
+    uint32_t scratch_capacity;
+
+    // NODE_FUNCTION of every definition in source order. parser_parse leaves
+    // their bodies pending, see parser_parse_body.
+    uint32_t *functions;
+    uint32_t function_count;
+    uint32_t function_capacity;
+
+    // errors fail the compile without being printed, set for parsers whose
+    // failures are reported again by another parser.
+    bool quiet;
+
+    // set while the tokens are parsed as they're lexed, see
+    // parser_parse_stream. `blocks` holds the token blocks taken from it.
+    struct token_stream *stream;
+    struct token **blocks;
+    uint32_t block_count;
+    uint32_t block_capacity;
+};
+
+struct parser *parser_create(struct compiler *c);
+void parser_free(struct parser *parser);
+
+// Parses the tokens of the compiler's lexer into parser::ast. The tree of a
+// previous parse is dropped first, its storage is reused.
+// Only the file scope is parsed: function bodies are skipped in one step over
+// their matched braces and their NODE_FUNCTION is left with
+// NODE_FLAG_BODY_PENDING, listed in parser::functions.
+// Returns PARSE_ALL_OK if no errors were encountered.
+// Any errors are reported on stdout and fail the compile, see compiler_fail.
+int parser_parse(struct parser *parser);
+
+// Parses like parser_parse while the lexer runs on a thread of its own, see
+// lexer_lex_start, taking the tokens from lexer::stream as they're lexed.
+// The stream is read to its end whatever happens. Errors aren't reported:
+// the lexer may fail further on, which a serial compile would report first.
+// Returns PARSE_GENERAL_ERROR on a parse error, once lexing turned out fine
+// parser_parse reports it.
+int parser_parse_stream(struct parser *parser);
+
+// Parses the compound statement starting at the token `open` into
+// parser::ast and returns it. Bodies refer to the file scope by name only,
+// any parser of the same tokens may parse them into a tree of its own.
+uint32_t parser_parse_body(struct parser *parser, uint32_t open);
+
+// Returns the token at `index` of the lexer's token vector, as found in
+// node::token.
+struct token *parser_token(struct parser *parser, uint32_t index);
+
+#endif  // PEACHPARSER_H
@@ -0,0 +1,1298 @@
+#include "preprocessor.h"
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../helpers/buffer.h"
+#include "../helpers/vector.h"
+#include "lexer_token.h"
+
+// Token types used inside the preprocessor only, they never leave it.
+enum {
+    // '##' of a replacement list.
+    PP_TOKEN_PASTE = -1,
+    // stands in for an empty argument next to '##'.
+    PP_TOKEN_PLACEMARKER = -2,
+};
+
+// Meaning of a replacement list token, see pp_macro::body_param. Values of 0
+// and up are the index of the parameter the token names.
+enum {
+    PP_BODY_PLAIN = -1,
+    // '#' of a function-like macro, the next token is the parameter to
+    // stringify.
+    PP_BODY_STRINGIFY = -2,
+    // '##', stored as a single token.
+    PP_BODY_PASTE = -3,
+};
+
+struct pp_tokens {
+    struct token *data;
+    int len;
+    int capacity;
+};
+
+struct pp_macro {
+    // NULL terminated, borrowed from preprocessor::strings.
+    const char *name;
+    uint32_t hash;
+    // false after #undef. The storage is kept until the preprocessor is reset
+    // since tokens handed out earlier may borrow from it.
+    bool defined;
+    bool function_like;
+    bool variadic;
+    // set while the macro's expansion is read, its name isn't expanded in the
+    // meantime.
+    bool disabled;
+    // the replacement list needs neither substitution nor pasting, an
+    // expansion reads `body` in place.
+    bool simple;
+
+    // parameter names, a variadic macro's last parameter is __VA_ARGS__.
+    const char **params;
+    int param_count;
+
+    // replacement list, body_param tells what each token stands for.
+    struct token *body;
+    int *body_param;
+    int body_len;
+
+    // tokens of the last top level expansion of an object-like macro, valid
+    // while memo_generation matches preprocessor::generation.
+    struct pp_tokens memo;
+    unsigned int memo_generation;
+};
+
+// Conditional directive being read, see preprocessor::conditionals.
+struct pp_conditional {
+    // position of the #if, #ifdef or #ifndef.
+    struct pos pos;
+    // one of the groups was taken, the remaining ones are skipped.
+    bool taken;
+    bool else_seen;
+};
+
+// Value of a #if expression. Every integer is computed as intmax_t or
+// uintmax_t, C11 6.10.1p4.
+struct pp_value {
+    unsigned long long value;
+    bool is_unsigned;
+};
+
+// #if or #elif expression being evaluated, macros are expanded already.
+struct pp_eval {
+    struct preprocessor *pp;
+    const struct token *toks;
+    int pos;
+    int len;
+    // position of the directive, reported when the expression ends early.
+    struct pos directive_pos;
+    // non zero within operands left unevaluated by '&&', '||' or '?', a
+    // division by zero is no error there.
+    int unevaluated;
+};
+
+// Tokens being read ahead of the lexer, usually a macro expansion.
+struct pp_context {
+    const struct token *tokens;
+    int pos;
+    int len;
+    // macro re-enabled once the context is read, NULL for anything else.
+    struct pp_macro *macro;
+    // `tokens` is freed once the context is read.
+    bool owned;
+    // tokens of the source itself, they keep their position and flags.
+    bool source;
+};
+
+// Arguments of a function-like macro invocation. Invocations nest while
+// arguments are expanded, the storage of every level is kept for reuse.
+struct pp_invocation {
+    struct pp_tokens *args;
+    // fully macro expanded arguments, only computed when used.
+    struct pp_tokens *expanded;
+    bool *is_expanded;
+    int capacity;
+    int count;
+    // replacement list before pasting.
+    struct pp_tokens items;
+};
+
+struct preprocessor {
+    struct lexer *lexer;
+
+    // open addressing hash table of macros keyed by name, the capacity is a
+    // power of two. A name's slot is never emptied, #undef only marks the
+    // macro as not defined.
+    struct pp_macro **slots;
+    int capacity;
+    int used;
+    // struct pp_macro* of every macro defined since the last reset.
+    struct vector *macros;
+    // bumped by every #define and #undef, invalidates memoized expansions.
+    unsigned int generation;
+
+    // char* owned by the preprocessor: strings of tokens read from the lexer
+    // and pasted or stringified spellings.
+    struct vector *strings;
+
+    struct pp_context *contexts;
+    int depth;
+    int context_capacity;
+    // depth at which reading stops instead of moving on to the enclosing
+    // context, 0 to read on until the end of the source.
+    int floor;
+
+    struct pp_invocation **invocations;
+    int invocation_depth;
+    int invocation_capacity;
+
+    // token read while looking for the '(' of a function-like macro and
+    // pushed back.
+    struct token pending;
+    bool has_pending;
+    // token read from the lexer past the end of a directive.
+    struct token raw_pending;
+    bool has_raw_pending;
+    // tokens of the directive being run.
+    struct pp_tokens line;
+    // macro expanded expression of the #if or #elif being run.
+    struct pp_tokens expr;
+    // struct pp_conditional of the conditionals entered, innermost last.
+    struct vector *conditionals;
+
+    // position of the outermost macro use being expanded, every token of the
+    // expansion is reported there.
+    struct pos expansion_pos;
+    // whitespace preceded a macro name whose expansion is read next, the
+    // first token read takes its place.
+    bool whitespace_before;
+    // non zero while reading ahead for the arguments of a macro.
+    int collecting;
+    // object-like macro whose top level expansion is being recorded.
+    struct pp_macro *recording;
+    unsigned int recording_generation;
+    struct pp_tokens record;
+};
+
+// Write an error to stdout at `pos` and fail the compile.
+static void pp_error(struct preprocessor *pp, struct pos pos, const char *msg,
+                     ...) {
+    va_list args;
+    printf("[ERROR]: ");
+    va_start(args, msg);
+    vprintf(msg, args);
+    va_end(args);
+    printf("\nPreprocessor error at line: %d, col: %d at file: %s\n",
+           pos.line, pos.col, pos.filename);
+    compiler_fail(pp->lexer->compiler);
+}
+
+static void pp_tokens_push(struct pp_tokens *list, const struct token *tok) {
+    if (list->len == list->capacity) {
+        list->capacity = list->capacity ? list->capacity * 2 : 16;
+        list->data = realloc(list->data, list->capacity * sizeof(struct token));
+    }
+    list->data[list->len++] = *tok;
+}
+
+static bool pp_is_name(const struct token *tok) {
+    return tok->type == TOKEN_TYPE_IDENTIFIER || tok->type == TOKEN_TYPE_KEYWORD;
+}
+
+static bool pp_is_symbol(const struct token *tok, char c) {
+    return tok->type == TOKEN_TYPE_SYMBOL && tok->cval == c;
+}
+
+static bool pp_is_operator(const struct token *tok, int op) {
+    return tok->type == TOKEN_TYPE_OPERATOR && tok->op == op;
+}
+
+static void pp_own_string(struct preprocessor *pp, char *str) {
+    vector_push(pp->strings, &str);
+}
+
+// Takes over the string owned by `tok`, tokens inside the preprocessor are
+// copied around freely and only ever borrow.
+static void pp_adopt(struct preprocessor *pp, struct token *tok) {
+    if (tok->flags & TOKEN_FLAG_BORROWED_SVAL) return;
+    if (pp_is_name(tok) || tok->type == TOKEN_TYPE_STRING) {
+        pp_own_string(pp, (char *)tok->sval);
+        tok->flags |= TOKEN_FLAG_BORROWED_SVAL;
+    }
+}
+
+// FNV-1a
+static uint32_t pp_hash(const char *name) {
+    uint32_t hash = 2166136261u;
+    while (*name) {
+        hash ^= (unsigned char)*name++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static struct pp_macro **pp_slot(struct preprocessor *pp, const char *name,
+                                 uint32_t hash) {
+    uint32_t mask = pp->capacity - 1;
+    for (uint32_t i = hash & mask;; i = (i + 1) & mask) {
+        struct pp_macro *macro = pp->slots[i];
+        if (!macro || (macro->hash == hash && strcmp(macro->name, name) == 0))
+            return &pp->slots[i];
+    }
+}
+
+static struct pp_macro *pp_lookup(struct preprocessor *pp, const char *name) {
+    struct pp_macro *macro = *pp_slot(pp, name, pp_hash(name));
+    return macro && macro->defined ? macro : NULL;
+}
+
+static void pp_grow_table(struct preprocessor *pp) {
+    struct pp_macro **old = pp->slots;
+    int old_capacity = pp->capacity;
+    pp->capacity *= 2;
+    pp->slots = calloc(pp->capacity, sizeof(struct pp_macro *));
+    for (int i = 0; i < old_capacity; i++)
+        if (old[i]) *pp_slot(pp, old[i]->name, old[i]->hash) = old[i];
+    free(old);
+}
+
+static void pp_define_macro(struct preprocessor *pp, struct pp_macro *macro) {
+    if ((pp->used + 1) * 4 > pp->capacity * 3) pp_grow_table(pp);
+
+    // a redefined macro's old definition stays in preprocessor::macros, its
+    // tokens may still be borrowed.
+    struct pp_macro **slot = pp_slot(pp, macro->name, macro->hash);
+    if (!*slot) pp->used++;
+    *slot = macro;
+    pp->generation++;
+}
+
+static void pp_macro_free(struct pp_macro *macro) {
+    free(macro->params);
+    free(macro->body);
+    free(macro->body_param);
+    free(macro->memo.data);
+    free(macro);
+}
+
+static void pp_push_context(struct preprocessor *pp, const struct token *tokens,
+                            int len, struct pp_macro *macro, bool owned,
+                            bool source) {
+    if (pp->depth == pp->context_capacity) {
+        pp->context_capacity = pp->context_capacity * 2;
+        pp->contexts = realloc(pp->contexts,
+                               pp->context_capacity * sizeof(struct pp_context));
+    }
+    pp->contexts[pp->depth++] = (struct pp_context){
+        .tokens = tokens,
+        .len = len,
+        .macro = macro,
+        .owned = owned,
+        .source = source,
+    };
+    if (macro) macro->disabled = true;
+}
+
+// Ends the recording of a top level expansion, `keep` if it's complete and
+// may be replayed.
+static void pp_finish_recording(struct preprocessor *pp, bool keep) {
+    struct pp_macro *macro = pp->recording;
+    pp->recording = NULL;
+    if (!keep || pp->recording_generation != pp->generation) return;
+
+    free(macro->memo.data);
+    macro->memo = pp->record;
+    macro->memo_generation = pp->generation;
+    pp->record = (struct pp_tokens){0};
+}
+
+static void pp_pop_context(struct preprocessor *pp) {
+    struct pp_context *ctx = &pp->contexts[--pp->depth];
+    if (ctx->macro) {
+        ctx->macro->disabled = false;
+        // an expansion which needed tokens past its end to be read, a macro
+        // name waiting for its arguments, can't be replayed.
+        if (ctx->macro == pp->recording)
+            pp_finish_recording(pp, pp->collecting == 0);
+    }
+    if (ctx->owned) free((void *)ctx->tokens);
+}
+
+static struct pp_invocation *pp_invocation_push(struct preprocessor *pp) {
+    if (pp->invocation_depth == pp->invocation_capacity) {
+        pp->invocation_capacity = pp->invocation_capacity * 2;
+        pp->invocations =
+            realloc(pp->invocations,
+                    pp->invocation_capacity * sizeof(struct pp_invocation *));
+        for (int i = pp->invocation_depth; i < pp->invocation_capacity; i++)
+            pp->invocations[i] = NULL;
+    }
+
+    struct pp_invocation **inv = &pp->invocations[pp->invocation_depth++];
+    if (!*inv) *inv = calloc(1, sizeof(struct pp_invocation));
+    (*inv)->count = 0;
+    return *inv;
+}
+
+static void pp_invocation_add_argument(struct pp_invocation *inv) {
+    if (inv->count == inv->capacity) {
+        int capacity = inv->capacity ? inv->capacity * 2 : 4;
+        inv->args = realloc(inv->args, capacity * sizeof(struct pp_tokens));
+        inv->expanded =
+            realloc(inv->expanded, capacity * sizeof(struct pp_tokens));
+        inv->is_expanded = realloc(inv->is_expanded, capacity * sizeof(bool));
+        for (int i = inv->capacity; i < capacity; i++) {
+            inv->args[i] = (struct pp_tokens){0};
+            inv->expanded[i] = (struct pp_tokens){0};
+        }
+        inv->capacity = capacity;
+    }
+    inv->args[inv->count].len = 0;
+    inv->is_expanded[inv->count] = false;
+    inv->count++;
+}
+
+static void pp_invocation_free(struct pp_invocation *inv) {
+    for (int i = 0; i < inv->capacity; i++) {
+        free(inv->args[i].data);
+        free(inv->expanded[i].data);
+    }
+    free(inv->args);
+    free(inv->expanded);
+    free(inv->is_expanded);
+    free(inv->items.data);
+    free(inv);
+}
+
+// Reads the next token from the lexer.
+static bool pp_lex(struct preprocessor *pp, struct token *tok) {
+    if (pp->has_raw_pending) {
+        *tok = pp->raw_pending;
+        pp->has_raw_pending = false;
+        return true;
+    }
+
+    struct token *raw = lexer_read_next_token(pp->lexer);
+    if (!raw) return false;
+    pp_adopt(pp, raw);
+    trivia_token_record(pp->lexer, raw);
+    *tok = *raw;
+    free(raw);
+    return true;
+}
+
+// Reads the rest of the directive's line into preprocessor::line.
+static void pp_read_line(struct preprocessor *pp) {
+    struct token tok;
+    pp->line.len = 0;
+    while (pp_lex(pp, &tok)) {
+        if (tok.flags & TOKEN_FLAG_AT_LINE_START) {
+            pp->raw_pending = tok;
+            pp->has_raw_pending = true;
+            break;
+        }
+        pp_tokens_push(&pp->line, &tok);
+    }
+}
+
+static int pp_param_index(const struct pp_macro *macro,
+                          const struct token *tok) {
+    if (!pp_is_name(tok)) return PP_BODY_PLAIN;
+    for (int i = 0; i < macro->param_count; i++)
+        if (strcmp(macro->params[i], tok->sval) == 0) return i;
+    return PP_BODY_PLAIN;
+}
+
+// Parses the parameter list of a function-like macro, `toks` starts after the
+// '('. Returns the amount of tokens used, the closing ')' included.
+static int pp_define_params(struct preprocessor *pp, struct pp_macro *macro,
+                            const struct token *toks, int n, struct pos pos) {
+    macro->params = malloc((n + 1) * sizeof(char *));
+    int i = 0;
+    if (i < n && pp_is_symbol(&toks[i], ')')) return 1;
+
+    for (;;) {
+        if (i == n) pp_error(pp, pos, "Missing ')' in macro parameter list");
+
+        if (pp_is_operator(&toks[i], OPERATOR_ELLIPSIS)) {
+            macro->variadic = true;
+            macro->params[macro->param_count++] = "__VA_ARGS__";
+        } else if (pp_is_name(&toks[i])) {
+            macro->params[macro->param_count++] = toks[i].sval;
+        } else {
+            pp_error(pp, toks[i].pos, "Invalid macro parameter");
+        }
+        i++;
+
+        if (i < n && pp_is_symbol(&toks[i], ')')) return i + 1;
+        if (i < n && !macro->variadic && pp_is_operator(&toks[i], OPERATOR_COMMA)) {
+            i++;
+            continue;
+        }
+        pp_error(pp, i < n ? toks[i].pos : pos,
+                 "Expected ',' or ')' in macro parameter list");
+    }
+}
+
+static void pp_define(struct preprocessor *pp, const struct token *toks, int n,
+                      struct pos pos) {
+    if (!n || !pp_is_name(&toks[0])) pp_error(pp, pos, "Macro name missing");
+
+    // owned by preprocessor::macros from the start, a failed definition is
+    // freed by the next reset.
+    struct pp_macro *macro = calloc(1, sizeof(struct pp_macro));
+    vector_push(pp->macros, &macro);
+    macro->name = toks[0].sval;
+    macro->hash = pp_hash(macro->name);
+    macro->defined = true;
+
+    int i = 1;
+    // only a '(' right after the name starts a parameter list.
+    if (i < n && pp_is_operator(&toks[i], OPERATOR_LEFT_PAREN) &&
+        !(toks[i].flags & TOKEN_FLAG_WHITESPACE_BEFORE)) {
+        macro->function_like = true;
+        i++;
+        i += pp_define_params(pp, macro, toks + i, n - i, toks[0].pos);
+    }
+
+    macro->body = malloc((n - i + 1) * sizeof(struct token));
+    macro->body_param = malloc((n - i + 1) * sizeof(int));
+    macro->simple = !macro->function_like;
+    for (; i < n; i++) {
+        struct token tok = toks[i];
+        int param = PP_BODY_PLAIN;
+        if (pp_is_symbol(&tok, '#') && i + 1 < n &&
+            pp_is_symbol(&toks[i + 1], '#') &&
+            !(toks[i + 1].flags & TOKEN_FLAG_WHITESPACE_BEFORE)) {
+            param = PP_BODY_PASTE;
+            tok.spelling_len = 2;
+            macro->simple = false;
+            i++;
+        } else if (macro->function_like && pp_is_symbol(&tok, '#')) {
+            if (i + 1 == n || pp_param_index(macro, &toks[i + 1]) < 0)
+                pp_error(pp, tok.pos, "'#' is not followed by a macro parameter");
+            param = PP_BODY_STRINGIFY;
+        } else if (macro->function_like) {
+            param = pp_param_index(macro, &tok);
+        }
+
+        tok.flags &= ~TOKEN_FLAG_AT_LINE_START;
+        if (!macro->body_len) tok.flags &= ~TOKEN_FLAG_WHITESPACE_BEFORE;
+        macro->body[macro->body_len] = tok;
+        macro->body_param[macro->body_len] = param;
+        macro->body_len++;
+    }
+
+    if (macro->body_len &&
+        (macro->body_param[0] == PP_BODY_PASTE ||
+         macro->body_param[macro->body_len - 1] == PP_BODY_PASTE))
+        pp_error(pp, pos, "'##' cannot appear at either end of a macro expansion");
+
+    pp_define_macro(pp, macro);
+}
+
+static void pp_undef(struct preprocessor *pp, const struct token *toks, int n,
+                     struct pos pos) {
+    if (n != 1 || !pp_is_name(&toks[0]))
+        pp_error(pp, pos, "#undef expects a single macro name");
+
+    struct pp_macro *macro = *pp_slot(pp, toks[0].sval, pp_hash(toks[0].sval));
+    if (macro && macro->defined) {
+        macro->defined = false;
+        pp->generation++;
+    }
+}
+
+static bool pp_read(struct preprocessor *pp, struct token *tok);
+static bool pp_expand(struct preprocessor *pp, struct token *tok);
+
+static struct pp_value pp_bool(bool value) {
+    return (struct pp_value){value, false};
+}
+
+static const struct token *pp_eval_peek(struct pp_eval *e) {
+    return e->pos < e->len ? &e->toks[e->pos] : NULL;
+}
+
+static struct pp_value pp_eval_conditional(struct pp_eval *e);
+
+static struct pp_value pp_eval_unary(struct pp_eval *e) {
+    const struct token *tok = pp_eval_peek(e);
+    if (!tok) pp_error(e->pp, e->directive_pos, "Missing operand in #if expression");
+    e->pos++;
+
+    if (tok->type == TOKEN_TYPE_NUMBER) {
+        if (tok->number_type >= NUMBER_TYPE_FLOAT)
+            pp_error(e->pp, tok->pos, "Floating constant in #if expression");
+        bool is_unsigned = tok->number_type == NUMBER_TYPE_UNSIGNED_INT ||
+                           tok->number_type == NUMBER_TYPE_UNSIGNED_LONG ||
+                           tok->number_type == NUMBER_TYPE_UNSIGNED_LONG_LONG;
+        return (struct pp_value){tok->llnum, is_unsigned};
+    }
+    // identifiers left after macro expansion stand for 0, C11 6.10.1p4.
+    if (pp_is_name(tok)) return pp_bool(false);
+
+    if (tok->type == TOKEN_TYPE_OPERATOR) {
+        struct pp_value value;
+        switch (tok->op) {
+        case OPERATOR_LEFT_PAREN:
+            value = pp_eval_conditional(e);
+            if (!pp_eval_peek(e) || !pp_is_symbol(pp_eval_peek(e), ')'))
+                pp_error(e->pp, tok->pos, "Missing ')' in #if expression");
+            e->pos++;
+            return value;
+        case OPERATOR_PLUS:
+            return pp_eval_unary(e);
+        case OPERATOR_MINUS:
+            value = pp_eval_unary(e);
+            value.value = -value.value;
+            return value;
+        case OPERATOR_TILDE:
+            value = pp_eval_unary(e);
+            value.value = ~value.value;
+            return value;
+        case OPERATOR_NOT:
+            return pp_bool(!pp_eval_unary(e).value);
+        }
+    }
+    pp_error(e->pp, tok->pos, "Invalid token '%.*s' in #if expression",
+             (int)tok->spelling_len, tok->spelling);
+    return pp_bool(false);
+}
+
+// Precedence of the binary operator `tok`, higher binds tighter. 0 if `tok`
+// is no binary operator.
+static int pp_binary_precedence(const struct token *tok) {
+    if (!tok || tok->type != TOKEN_TYPE_OPERATOR) return 0;
+    switch (tok->op) {
+    case OPERATOR_STAR:
+    case OPERATOR_SLASH:
+    case OPERATOR_PERCENT:
+        return 10;
+    case OPERATOR_PLUS:
+    case OPERATOR_MINUS:
+        return 9;
+    case OPERATOR_SHIFT_LEFT:
+    case OPERATOR_SHIFT_RIGHT:
+        return 8;
+    case OPERATOR_LESS:
+    case OPERATOR_GREATER:
+    case OPERATOR_LESS_EQUAL:
+    case OPERATOR_GREATER_EQUAL:
+        return 7;
+    case OPERATOR_EQUAL:
+    case OPERATOR_NOT_EQUAL:
+        return 6;
+    case OPERATOR_AMPERSAND:
+        return 5;
+    case OPERATOR_CARET:
+        return 4;
+    case OPERATOR_PIPE:
+        return 3;
+    case OPERATOR_LOGICAL_AND:
+        return 2;
+    case OPERATOR_LOGICAL_OR:
+        return 1;
+    }
+    return 0;
+}
+
+// Applies the binary operator `op`, '&&' and '||' aside.
+static struct pp_value pp_eval_apply(struct pp_eval *e, const struct token *op,
+                                     struct pp_value lhs, struct pp_value rhs) {
+    // the usual arithmetic conversions make both operands unsigned if either
+    // is. Signed overflow wraps.
+    bool is_unsigned = lhs.is_unsigned || rhs.is_unsigned;
+    unsigned long long a = lhs.value, b = rhs.value;
+    long long sa = (long long)a, sb = (long long)b;
+
+    switch (op->op) {
+    case OPERATOR_STAR:
+        return (struct pp_value){a * b, is_unsigned};
+    case OPERATOR_SLASH:
+    case OPERATOR_PERCENT: {
+        bool div = op->op == OPERATOR_SLASH;
+        if (!b) {
+            if (!e->unevaluated)
+                pp_error(e->pp, op->pos, "Division by zero in #if expression");
+            return (struct pp_value){0, is_unsigned};
+        }
+        if (is_unsigned) return (struct pp_value){div ? a / b : a % b, true};
+        // LLONG_MIN / -1 overflows, it wraps like the other operators.
+        if (sb == -1) return (struct pp_value){div ? -a : 0, false};
+        return (struct pp_value){div ? sa / sb : sa % sb, false};
+    }
+    case OPERATOR_PLUS:
+        return (struct pp_value){a + b, is_unsigned};
+    case OPERATOR_MINUS:
+        return (struct pp_value){a - b, is_unsigned};
+    case OPERATOR_SHIFT_LEFT:
+    case OPERATOR_SHIFT_RIGHT: {
+        // a shift has the type of its left operand, a count out of range
+        // shifts every bit out.
+        bool out = (!rhs.is_unsigned && sb < 0) || b >= 64;
+        if (op->op == OPERATOR_SHIFT_LEFT)
+            return (struct pp_value){out ? 0 : a << b, lhs.is_unsigned};
+        if (lhs.is_unsigned) return (struct pp_value){out ? 0 : a >> b, true};
+        return (struct pp_value){out ? (sa < 0 ? -1 : 0) : sa >> b, false};
+    }
+    case OPERATOR_LESS:
+        return pp_bool(is_unsigned ? a < b : sa < sb);
+    case OPERATOR_GREATER:
+        return pp_bool(is_unsigned ? a > b : sa > sb);
+    case OPERATOR_LESS_EQUAL:
+        return pp_bool(is_unsigned ? a <= b : sa <= sb);
+    case OPERATOR_GREATER_EQUAL:
+        return pp_bool(is_unsigned ? a >= b : sa >= sb);
+    case OPERATOR_EQUAL:
+        return pp_bool(a == b);
+    case OPERATOR_NOT_EQUAL:
+        return pp_bool(a != b);
+    case OPERATOR_AMPERSAND:
+        return (struct pp_value){a & b, is_unsigned};
+    case OPERATOR_CARET:
+        return (struct pp_value){a ^ b, is_unsigned};
+    default:
+        return (struct pp_value){a | b, is_unsigned};
+    }
+}
+
+// Evaluates binary operators binding at least as tight as `min_precedence`
+// by precedence climbing.
+static struct pp_value pp_eval_binary(struct pp_eval *e, int min_precedence) {
+    struct pp_value lhs = pp_eval_unary(e);
+    for (;;) {
+        const struct token *op = pp_eval_peek(e);
+        int precedence = pp_binary_precedence(op);
+        if (!precedence || precedence < min_precedence) return lhs;
+        e->pos++;
+
+        if (op->op == OPERATOR_LOGICAL_AND || op->op == OPERATOR_LOGICAL_OR) {
+            bool is_and = op->op == OPERATOR_LOGICAL_AND;
+            bool unevaluated = is_and ? !lhs.value : lhs.value != 0;
+            e->unevaluated += unevaluated;
+            struct pp_value rhs = pp_eval_binary(e, precedence + 1);
+            e->unevaluated -= unevaluated;
+            lhs = pp_bool(is_and ? lhs.value && rhs.value
+                                 : lhs.value || rhs.value);
+            continue;
+        }
+
+        struct pp_value rhs = pp_eval_binary(e, precedence + 1);
+        lhs = pp_eval_apply(e, op, lhs, rhs);
+    }
+}
+
+static struct pp_value pp_eval_conditional(struct pp_eval *e) {
+    struct pp_value cond = pp_eval_binary(e, 1);
+    const struct token *tok = pp_eval_peek(e);
+    if (!tok || !pp_is_operator(tok, OPERATOR_QUESTION)) return cond;
+    e->pos++;
+
+    bool taken = cond.value != 0;
+    e->unevaluated += !taken;
+    struct pp_value lhs = pp_eval_conditional(e);
+    e->unevaluated -= !taken;
+
+    tok = pp_eval_peek(e);
+    if (!tok || !pp_is_symbol(tok, ':'))
+        pp_error(e->pp, tok ? tok->pos : e->directive_pos,
+                 "Missing ':' in #if expression");
+    e->pos++;
+
+    e->unevaluated += taken;
+    struct pp_value rhs = pp_eval_conditional(e);
+    e->unevaluated -= taken;
+
+    struct pp_value value = taken ? lhs : rhs;
+    value.is_unsigned = lhs.is_unsigned || rhs.is_unsigned;
+    return value;
+}
+
+// Reads the operand of the `defined` operator, returns the 1 or 0 token it
+// is replaced by.
+static struct token pp_defined(struct preprocessor *pp,
+                               const struct token *defined) {
+    struct token name;
+    bool ok = pp_read(pp, &name);
+    bool paren = ok && pp_is_operator(&name, OPERATOR_LEFT_PAREN);
+    if (paren) ok = pp_read(pp, &name);
+    if (!ok || !pp_is_name(&name))
+        pp_error(pp, defined->pos, "'defined' expects a macro name");
+
+    struct token close;
+    if (paren && (!pp_read(pp, &close) || !pp_is_symbol(&close, ')')))
+        pp_error(pp, defined->pos, "Missing ')' after 'defined'");
+
+    struct token value = *defined;
+    value.type = TOKEN_TYPE_NUMBER;
+    value.number_type = NUMBER_TYPE_INT;
+    value.llnum = pp_lookup(pp, name.sval) != NULL;
+    return value;
+}
+
+// Evaluates the expression of #if or #elif, `toks` follows the directive
+// name.
+static bool pp_condition(struct preprocessor *pp, const struct token *toks,
+                         int n, struct pos pos) {
+    if (!n) pp_error(pp, pos, "Missing expression in conditional directive");
+
+    // the line is macro expanded on its own, `defined` operators are
+    // replaced before their operand could be expanded.
+    int floor = pp->floor;
+    bool whitespace_before = pp->whitespace_before;
+    pp->whitespace_before = false;
+    pp_push_context(pp, toks, n, NULL, false, true);
+    pp->floor = pp->depth;
+
+    struct token tok;
+    pp->expr.len = 0;
+    while (pp_read(pp, &tok)) {
+        if (pp_is_name(&tok) && strcmp(tok.sval, "defined") == 0)
+            tok = pp_defined(pp, &tok);
+        else if (pp_expand(pp, &tok))
+            continue;
+        pp_tokens_push(&pp->expr, &tok);
+    }
+
+    pp_pop_context(pp);
+    pp->floor = floor;
+    pp->whitespace_before = whitespace_before;
+
+    struct pp_eval e = {
+        .pp = pp,
+        .toks = pp->expr.data,
+        .len = pp->expr.len,
+        .directive_pos = pos,
+    };
+    struct pp_value value = pp_eval_conditional(&e);
+    if (e.pos < e.len)
+        pp_error(pp, e.toks[e.pos].pos,
+                 "Missing binary operator before '%.*s' in #if expression",
+                 (int)e.toks[e.pos].spelling_len, e.toks[e.pos].spelling);
+    return value.value != 0;
+}
+
+// Skips the rest of a group which isn't taken. The directive ending it is
+// read next.
+static void pp_skip_group(struct preprocessor *pp) {
+    // the line after the directive may have been read already.
+    const struct token *first = pp->has_raw_pending ? &pp->raw_pending : NULL;
+    pp->has_raw_pending = false;
+    if (!lexer_skip_group(pp->lexer, first)) {
+        struct pp_conditional *cond = vector_back(pp->conditionals);
+        pp_error(pp, cond->pos, "Unterminated conditional directive");
+    }
+}
+
+// Enters a conditional, its first group is skipped unless `taken`.
+static void pp_if(struct preprocessor *pp, bool taken, struct pos pos) {
+    struct pp_conditional cond = {.pos = pos, .taken = taken};
+    vector_push(pp->conditionals, &cond);
+    if (!taken) pp_skip_group(pp);
+}
+
+// Returns the innermost conditional for #elif, #else or #endif.
+static struct pp_conditional *pp_conditional(struct preprocessor *pp,
+                                             const char *directive,
+                                             struct pos pos) {
+    struct pp_conditional *cond = vector_back_or_null(pp->conditionals);
+    if (!cond) pp_error(pp, pos, "#%s without #if", directive);
+    if (cond->else_seen && strcmp(directive, "endif") != 0)
+        pp_error(pp, pos, "#%s after #else", directive);
+    return cond;
+}
+
+// Runs #ifdef or #ifndef.
+static void pp_ifdef(struct preprocessor *pp, const struct token *toks, int n,
+                     struct pos pos, bool defined) {
+    if (n != 1 || !pp_is_name(&toks[0]))
+        pp_error(pp, pos, "#ifdef expects a single macro name");
+    pp_if(pp, (pp_lookup(pp, toks[0].sval) != NULL) == defined, pos);
+}
+
+// Runs #elif, #else or #endif.
+static void pp_else(struct preprocessor *pp, const char *name,
+                    const struct token *toks, int n, struct pos pos) {
+    struct pp_conditional *cond = pp_conditional(pp, name, pos);
+    if (strcmp(name, "endif") == 0) {
+        vector_pop(pp->conditionals);
+        return;
+    }
+
+    // once a group was taken, the expression of a later #elif isn't
+    // evaluated.
+    bool taken = !cond->taken && (strcmp(name, "else") == 0 ||
+                                  pp_condition(pp, toks, n, pos));
+    cond->else_seen = strcmp(name, "else") == 0;
+    if (!taken) {
+        pp_skip_group(pp);
+        return;
+    }
+    cond->taken = true;
+}
+
+// Runs the directive introduced by `hash`.
+static void pp_directive(struct preprocessor *pp, const struct token *hash) {
+    pp_read_line(pp);
+    struct token *toks = pp->line.data;
+    int n = pp->line.len;
+    // '#' on its own is the null directive.
+    if (!n) return;
+
+    if (!pp_is_name(&toks[0]))
+        pp_error(pp, toks[0].pos, "Invalid preprocessing directive");
+
+    const char *name = toks[0].sval;
+    if (strcmp(name, "define") == 0) {
+        pp_define(pp, toks + 1, n - 1, toks[0].pos);
+    } else if (strcmp(name, "undef") == 0) {
+        pp_undef(pp, toks + 1, n - 1, toks[0].pos);
+    } else if (strcmp(name, "if") == 0) {
+        pp_if(pp, pp_condition(pp, toks + 1, n - 1, toks[0].pos), toks[0].pos);
+    } else if (strcmp(name, "ifdef") == 0 || strcmp(name, "ifndef") == 0) {
+        pp_ifdef(pp, toks + 1, n - 1, toks[0].pos, name[2] == 'd');
+    } else if (strcmp(name, "elif") == 0 || strcmp(name, "else") == 0 ||
+               strcmp(name, "endif") == 0) {
+        pp_else(pp, name, toks + 1, n - 1, toks[0].pos);
+    } else if (strcmp(name, "include") == 0) {
+        // includes aren't resolved yet, the directive is kept in the token
+        // stream as written.
+        struct token *line = malloc((n + 1) * sizeof(struct token));
+        line[0] = *hash;
+        memcpy(line + 1, toks, n * sizeof(struct token));
+        pp_push_context(pp, line, n + 1, NULL, true, true);
+    } else if (strcmp(name, "pragma") == 0 || strcmp(name, "line") == 0) {
+        // no pragmas are supported, line markers aren't needed without
+        // includes.
+    } else if (strcmp(name, "error") == 0) {
+        struct buffer msg;
+        buffer_init(&msg);
+        for (int i = 1; i < n; i++) {
+            buffer_write(&msg, ' ');
+            buffer_write_bytes(&msg, toks[i].spelling, toks[i].spelling_len);
+        }
+        char *text = buffer_strdup(&msg);
+        buffer_release(&msg);
+        pp_own_string(pp, text);
+        pp_error(pp, hash->pos, "#error%s", text);
+    } else {
+        pp_error(pp, toks[0].pos, "Unknown preprocessing directive '%s'", name);
+    }
+}
+
+static bool pp_read_token(struct preprocessor *pp, struct token *tok);
+
+// Reads the next token without expanding it, running directives found on the
+// way. Returns false at the end of the source or at preprocessor::floor.
+static bool pp_read(struct preprocessor *pp, struct token *tok) {
+    if (!pp_read_token(pp, tok)) return false;
+    if (pp->whitespace_before) {
+        tok->flags |= TOKEN_FLAG_WHITESPACE_BEFORE;
+        pp->whitespace_before = false;
+    }
+    return true;
+}
+
+static bool pp_read_token(struct preprocessor *pp, struct token *tok) {
+    if (pp->has_pending) {
+        *tok = pp->pending;
+        pp->has_pending = false;
+        return true;
+    }
+
+    for (;;) {
+        while (pp->depth) {
+            struct pp_context *ctx = &pp->contexts[pp->depth - 1];
+            if (ctx->pos < ctx->len) {
+                *tok = ctx->tokens[ctx->pos++];
+                if (!ctx->source) {
+                    tok->pos = pp->expansion_pos;
+                    tok->flags &= ~TOKEN_FLAG_AT_LINE_START;
+                }
+                return true;
+            }
+            if (pp->depth == pp->floor) return false;
+            pp_pop_context(pp);
+        }
+
+        if (!pp_lex(pp, tok)) {
+            struct pp_conditional *cond = vector_back_or_null(pp->conditionals);
+            if (cond) pp_error(pp, cond->pos, "Unterminated conditional directive");
+            return false;
+        }
+        if (pp_is_symbol(tok, '#') && (tok->flags & TOKEN_FLAG_AT_LINE_START)) {
+            struct token hash = *tok;
+            pp_directive(pp, &hash);
+            continue;
+        }
+        return true;
+    }
+}
+
+static bool pp_next_expanded(struct preprocessor *pp, struct token *tok);
+
+// Returns the argument `param` of `inv`, fully macro expanded.
+static struct pp_tokens *pp_expanded_argument(struct preprocessor *pp,
+                                              struct pp_invocation *inv,
+                                              int param) {
+    struct pp_tokens *out = &inv->expanded[param];
+    if (inv->is_expanded[param]) return out;
+
+    // the argument is expanded on its own, reading stops at its end.
+    int floor = pp->floor;
+    bool whitespace_before = pp->whitespace_before;
+    pp->whitespace_before = false;
+    pp_push_context(pp, inv->args[param].data, inv->args[param].len, NULL,
+                    false, false);
+    pp->floor = pp->depth;
+
+    struct token tok;
+    out->len = 0;
+    while (pp_next_expanded(pp, &tok)) pp_tokens_push(out, &tok);
+
+    pp_pop_context(pp);
+    pp->floor = floor;
+    pp->whitespace_before = whitespace_before;
+    inv->is_expanded[param] = true;
+    return out;
+}
+
+// Returns the string literal token spelling the tokens of `arg`.
+static struct token pp_stringify(struct preprocessor *pp,
+                                 const struct pp_tokens *arg,
+                                 const struct token *hash) {
+    struct buffer text;
+    buffer_init(&text);
+    buffer_write(&text, '"');
+    for (int i = 0; i < arg->len; i++) {
+        const struct token *tok = &arg->data[i];
+        if (i && (tok->flags & TOKEN_FLAG_WHITESPACE_BEFORE))
+            buffer_write(&text, ' ');
+
+        // quotes and backslashes of string and character literals are
+        // escaped, the literal reads back as the spelling.
+        bool literal = tok->spelling[0] == '"' || tok->spelling[0] == '\'';
+        for (size_t j = 0; j < tok->spelling_len; j++) {
+            char c = tok->spelling[j];
+            if (literal && (c == '"' || c == '\\')) buffer_write(&text, '\\');
+            buffer_write(&text, c);
+        }
+    }
+    buffer_write(&text, '"');
+
+    size_t len = buffer_len(&text);
+    char *spelling = buffer_strdup(&text);
+    buffer_release(&text);
+    pp_own_string(pp, spelling);
+
+    struct token *lexed =
+        lexer_lex_spelling(pp->lexer, spelling, len, pp->expansion_pos);
+    if (!lexed)
+        pp_error(pp, hash->pos, "'#' does not give a valid string literal");
+
+    pp_adopt(pp, lexed);
+    struct token tok = *lexed;
+    free(lexed);
+    tok.flags |= hash->flags & TOKEN_FLAG_WHITESPACE_BEFORE;
+    return tok;
+}
+
+// Returns the token made by pasting `lhs` and `rhs` together.
+static struct token pp_paste(struct preprocessor *pp, const struct token *lhs,
+                             const struct token *rhs) {
+    if (lhs->type == PP_TOKEN_PLACEMARKER) return *rhs;
+    if (rhs->type == PP_TOKEN_PLACEMARKER) return *lhs;
+
+    size_t len = lhs->spelling_len + rhs->spelling_len;
+    char *spelling = malloc(len + 1);
+    memcpy(spelling, lhs->spelling, lhs->spelling_len);
+    memcpy(spelling + lhs->spelling_len, rhs->spelling, rhs->spelling_len);
+    spelling[len] = 0;
+    pp_own_string(pp, spelling);
+
+    // the lexer has no '##' token, it's kept as a '#' spelled '##' which
+    // stringifies correctly but is never taken for the operator.
+    if (pp_is_symbol(lhs, '#') && pp_is_symbol(rhs, '#')) {
+        struct token tok = *lhs;
+        tok.spelling = spelling;
+        tok.spelling_len = len;
+        return tok;
+    }
+
+    struct token *lexed =
+        lexer_lex_spelling(pp->lexer, spelling, len, pp->expansion_pos);
+    if (!lexed)
+        pp_error(pp, pp->expansion_pos,
+                 "Pasting '%.*s' and '%.*s' does not give a valid token",
+                 (int)lhs->spelling_len, lhs->spelling,
+                 (int)rhs->spelling_len, rhs->spelling);
+
+    pp_adopt(pp, lexed);
+    struct token tok = *lexed;
+    free(lexed);
+    tok.flags |= lhs->flags & TOKEN_FLAG_WHITESPACE_BEFORE;
+    return tok;
+}
+
+// Builds the expansion of `macro` with the arguments of `inv`, the returned
+// tokens are heap allocated.
+static struct pp_tokens pp_substitute(struct preprocessor *pp,
+                                      struct pp_macro *macro,
+                                      struct pp_invocation *inv) {
+    struct pp_tokens *items = &inv->items;
+    items->len = 0;
+
+    for (int i = 0; i < macro->body_len; i++) {
+        struct token tok = macro->body[i];
+        int param = macro->body_param[i];
+        if (param == PP_BODY_PLAIN) {
+            pp_tokens_push(items, &tok);
+            continue;
+        }
+        if (param == PP_BODY_PASTE) {
+            tok.type = PP_TOKEN_PASTE;
+            pp_tokens_push(items, &tok);
+            continue;
+        }
+        if (param == PP_BODY_STRINGIFY) {
+            i++;
+            tok = pp_stringify(pp, &inv->args[macro->body_param[i]], &tok);
+            pp_tokens_push(items, &tok);
+            continue;
+        }
+
+        // operands of '##' are pasted as written, anything else is expanded
+        // first.
+        bool raw = (i > 0 && macro->body_param[i - 1] == PP_BODY_PASTE) ||
+                   (i + 1 < macro->body_len &&
+                    macro->body_param[i + 1] == PP_BODY_PASTE);
+        struct pp_tokens *arg = raw ? &inv->args[param]
+                                    : pp_expanded_argument(pp, inv, param);
+        if (raw && !arg->len) {
+            tok.type = PP_TOKEN_PLACEMARKER;
+            pp_tokens_push(items, &tok);
+            continue;
+        }
+        for (int j = 0; j < arg->len; j++) {
+            struct token arg_tok = arg->data[j];
+            // the argument is spaced like the parameter it replaces.
+            if (j == 0)
+                arg_tok.flags = (arg_tok.flags & ~TOKEN_FLAG_WHITESPACE_BEFORE) |
+                                (tok.flags & TOKEN_FLAG_WHITESPACE_BEFORE);
+            pp_tokens_push(items, &arg_tok);
+        }
+    }
+
+    struct pp_tokens out = {0};
+    for (int i = 0; i < items->len; i++) {
+        if (items->data[i].type != PP_TOKEN_PASTE) {
+            pp_tokens_push(&out, &items->data[i]);
+            continue;
+        }
+        // a '##' never starts or ends a replacement list, both operands exist.
+        struct token lhs = out.data[--out.len];
+        struct token pasted = pp_paste(pp, &lhs, &items->data[++i]);
+        pp_tokens_push(&out, &pasted);
+    }
+
+    int len = 0;
+    for (int i = 0; i < out.len; i++)
+        if (out.data[i].type != PP_TOKEN_PLACEMARKER) out.data[len++] = out.data[i];
+    out.len = len;
+    return out;
+}
+
+// Collects the arguments of an invocation of `macro` whose '(' was just
+// read.
+static struct pp_invocation *pp_collect_arguments(struct preprocessor *pp,
+                                                  struct pp_macro *macro,
+                                                  struct pos pos) {
+    struct pp_invocation *inv = pp_invocation_push(pp);
+    pp_invocation_add_argument(inv);
+
+    int nesting = 0;
+    struct token tok;
+    for (;;) {
+        if (!pp_read(pp, &tok))
+            pp_error(pp, pos, "Unterminated argument list invoking macro '%s'",
+                     macro->name);
+
+        if (pp_is_operator(&tok, OPERATOR_LEFT_PAREN)) {
+            nesting++;
+        } else if (pp_is_symbol(&tok, ')')) {
+            if (!nesting) break;
+            nesting--;
+        } else if (pp_is_operator(&tok, OPERATOR_COMMA) && !nesting &&
+                   !(macro->variadic && inv->count == macro->param_count)) {
+            pp_invocation_add_argument(inv);
+            continue;
+        }
+        pp_tokens_push(&inv->args[inv->count - 1], &tok);
+    }
+
+    // 'f()' passes no arguments to a macro without parameters and leaving out
+    // the variadic arguments is allowed.
+    if (!macro->param_count && inv->count == 1 && !inv->args[0].len)
+        inv->count = 0;
+    if (macro->variadic && inv->count == macro->param_count - 1)
+        pp_invocation_add_argument(inv);
+    if (inv->count != macro->param_count)
+        pp_error(pp, pos, "Macro '%s' expects %d arguments, %d given",
+                 macro->name, macro->param_count, inv->count);
+    return inv;
+}
+
+// Expands `tok` if it names a macro, the expansion is read next. Returns false
+// if `tok` is not expanded.
+static bool pp_expand(struct preprocessor *pp, struct token *tok) {
+    if (!pp_is_name(tok) || (tok->flags & TOKEN_FLAG_NO_EXPAND)) return false;
+
+    struct pp_macro *macro = pp_lookup(pp, tok->sval);
+    if (!macro) return false;
+    if (macro->disabled) {
+        // the name stays unexpanded for good, even when rescanned later.
+        tok->flags |= TOKEN_FLAG_NO_EXPAND;
+        return false;
+    }
+
+    bool top = pp->depth == 0;
+    bool whitespace_before = tok->flags & TOKEN_FLAG_WHITESPACE_BEFORE;
+    if (!macro->function_like) {
+        pp->whitespace_before |= whitespace_before;
+        if (top) {
+            pp->expansion_pos = tok->pos;
+            if (macro->memo_generation == pp->generation) {
+                pp_push_context(pp, macro->memo.data, macro->memo.len, NULL,
+                                false, false);
+                return true;
+            }
+            pp->recording = macro;
+            pp->recording_generation = pp->generation;
+            pp->record.len = 0;
+        }
+
+        if (macro->simple) {
+            pp_push_context(pp, macro->body, macro->body_len, macro, false,
+                            false);
+        } else {
+            struct pp_tokens out = pp_substitute(pp, macro, pp_invocation_push(pp));
+            pp->invocation_depth--;
+            pp_push_context(pp, out.data, out.len, macro, true, false);
+        }
+        return true;
+    }
+
+    // a function-like macro name is only an invocation if a '(' follows.
+    struct pos pos = tok->pos;
+    struct token next;
+    pp->collecting++;
+    if (!pp_read(pp, &next)) {
+        pp->collecting--;
+        return false;
+    }
+    if (!pp_is_operator(&next, OPERATOR_LEFT_PAREN)) {
+        pp->collecting--;
+        pp->pending = next;
+        pp->has_pending = true;
+        return false;
+    }
+
+    struct pp_invocation *inv = pp_collect_arguments(pp, macro, pos);
+    pp->collecting--;
+    if (top) pp->expansion_pos = pos;
+
+    struct pp_tokens out = pp_substitute(pp, macro, inv);
+    pp->invocation_depth--;
+    pp_push_context(pp, out.data, out.len, macro, true, false);
+    pp->whitespace_before |= whitespace_before;
+    return true;
+}
+
+// Reads the next token, expanding macros until a token remains which isn't
+// expanded.
+static bool pp_next_expanded(struct preprocessor *pp, struct token *tok) {
+    for (;;) {
+        if (!pp_read(pp, tok)) return false;
+        if (!pp_expand(pp, tok)) return true;
+    }
+}
+
+struct token *preprocessor_next_token(struct preprocessor *pp) {
+    struct token tok;
+    if (!pp_next_expanded(pp, &tok)) return NULL;
+
+    if (pp->recording) {
+        // a replayed expansion is final, none of it is expanded again.
+        struct token memo = tok;
+        if (pp_is_name(&memo)) memo.flags |= TOKEN_FLAG_NO_EXPAND;
+        pp_tokens_push(&pp->record, &memo);
+    }
+
+    struct token *out = malloc(sizeof(struct token));
+    *out = tok;
+    return out;
+}
+
+struct preprocessor *preprocessor_create(struct lexer *lexer) {
+    struct preprocessor *pp = calloc(1, sizeof(struct preprocessor));
+    pp->lexer = lexer;
+    pp->capacity = 256;
+    pp->slots = calloc(pp->capacity, sizeof(struct pp_macro *));
+    pp->macros = vector_create(sizeof(struct pp_macro *));
+    pp->strings = vector_create(sizeof(char *));
+    pp->conditionals = vector_create(sizeof(struct pp_conditional));
+    // memo_generation of a new macro is 0, which never matches.
+    pp->generation = 1;
+    pp->context_capacity = 16;
+    pp->contexts = malloc(pp->context_capacity * sizeof(struct pp_context));
+    pp->invocation_capacity = 8;
+    pp->invocations = calloc(pp->invocation_capacity, sizeof(struct pp_invocation *));
+    return pp;
+}
+
+void preprocessor_reset(struct preprocessor *pp) {
+    // a failed compile may have left expansions behind.
+    while (pp->depth) {
+        struct pp_context *ctx = &pp->contexts[--pp->depth];
+        if (ctx->owned) free((void *)ctx->tokens);
+    }
+    pp->floor = 0;
+    pp->invocation_depth = 0;
+    pp->has_pending = false;
+    pp->has_raw_pending = false;
+    pp->collecting = 0;
+    pp->recording = NULL;
+    pp->whitespace_before = false;
+    vector_clear(pp->conditionals);
+
+    for (int i = 0; i < vector_count(pp->macros); i++)
+        pp_macro_free(*(struct pp_macro **)vector_at(pp->macros, i));
+    vector_clear(pp->macros);
+    memset(pp->slots, 0, pp->capacity * sizeof(struct pp_macro *));
+    pp->used = 0;
+
+    for (int i = 0; i < vector_count(pp->strings); i++)
+        free(*(char **)vector_at(pp->strings, i));
+    vector_clear(pp->strings);
+}
+
+void preprocessor_free(struct preprocessor *pp) {
+    preprocessor_reset(pp);
+    for (int i = 0; i < pp->invocation_capacity; i++)
+        if (pp->invocations[i]) pp_invocation_free(pp->invocations[i]);
+    free(pp->invocations);
+    free(pp->contexts);
+    free(pp->slots);
+    free(pp->line.data);
+    free(pp->expr.data);
+    free(pp->record.data);
+    vector_free(pp->macros);
+    vector_free(pp->strings);
+    vector_free(pp->conditionals);
+    free(pp);
+}
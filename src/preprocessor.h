@@ -0,0 +1,31 @@
+#ifndef PEACHPREPROCESSOR_H
+#define PEACHPREPROCESSOR_H
+
+#include "lexer.h"
+
+// The preprocessor sits between the lexer's raw token reader and the token
+// vector. It runs directives and expands macros, handing out the final token
+// stream one token at a time.
+//
+// Macro definitions are copied once into preprocessor storage. An expansion
+// is a context referencing the definition's tokens, a new token list is only
+// built when parameters are substituted or tokens are pasted. Top level
+// expansions of object-like macros are memoized until the next #define or
+// #undef.
+struct preprocessor;
+
+struct preprocessor *preprocessor_create(struct lexer *lexer);
+void preprocessor_free(struct preprocessor *pp);
+
+// Forgets every macro and releases the storage of the previous run, must be
+// called before the lexer starts a new source. Tokens handed out by the
+// previous run are no longer valid afterwards.
+void preprocessor_reset(struct preprocessor *pp);
+
+// Returns the next fully preprocessed token as a heap token owned by the
+// caller, NULL at the end of the source. The token's strings are borrowed
+// from the source or the preprocessor, see TOKEN_FLAG_BORROWED_SVAL.
+// Errors are reported on stderr and fail the compile, see compiler_fail.
+struct token *preprocessor_next_token(struct preprocessor *pp);
+
+#endif  // PEACHPREPROCESSOR_H
@@ -0,0 +1,302 @@
+#include "regalloc.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "x86.h"
+
+#define REGALLOC_BIT(reg) ((uint16_t)1 << (reg))
+
+// Registers calls preserve, the others may be clobbered by the callee.
+static const uint16_t regalloc_callee_saved =
+    REGALLOC_BIT(X86_RBX) | REGALLOC_BIT(X86_R12) | REGALLOC_BIT(X86_R13) |
+    REGALLOC_BIT(X86_R14) | REGALLOC_BIT(X86_R15);
+
+// Registers handed out in order of preference: those calls may clobber
+// first, as the function would have to save the others.
+static const uint8_t regalloc_registers[] = {
+    X86_RSI, X86_RDI, X86_R8,  X86_R9,  X86_R10,
+    X86_RBX, X86_R12, X86_R13, X86_R14, X86_R15,
+};
+
+#define REGALLOC_REGISTER_COUNT \
+    (sizeof(regalloc_registers) / sizeof(regalloc_registers[0]))
+
+// A use in a loop counts as much as 8 uses outside of it, up to 6 loops
+// deep, so the weights of long functions can't overflow.
+#define REGALLOC_MAX_DEPTH 6
+#define REGALLOC_MAX_WEIGHT ((uint32_t)1 << 30)
+
+void regalloc_init(struct regalloc *ra) {
+    memset(ra, 0, sizeof(struct regalloc));
+}
+
+void regalloc_free(struct regalloc *ra) {
+    free(ra->regs);
+    free(ra->starts);
+    free(ra->ends);
+    free(ra->weights);
+    free(ra->block_of);
+    free(ra->order);
+    free(ra->counts);
+    free(ra->calls);
+    free(ra->depths);
+    free(ra->stamps);
+    free(ra->work);
+}
+
+static void regalloc_reserve(struct regalloc *ra, struct ir_function *fn) {
+    if (fn->count + 1 > ra->value_capacity) {
+        uint32_t n = ra->value_capacity = (fn->count + 1) * 2;
+        ra->regs = realloc(ra->regs, n);
+        ra->starts = realloc(ra->starts, n * sizeof(uint32_t));
+        ra->ends = realloc(ra->ends, n * sizeof(uint32_t));
+        ra->weights = realloc(ra->weights, n * sizeof(uint32_t));
+        ra->block_of = realloc(ra->block_of, n * sizeof(uint32_t));
+        ra->order = realloc(ra->order, n * sizeof(uint32_t));
+        ra->counts = realloc(ra->counts, n * sizeof(uint32_t));
+        ra->calls = realloc(ra->calls, n * sizeof(uint32_t));
+    }
+    if (fn->block_count + 1 > ra->block_capacity) {
+        uint32_t n = ra->block_capacity = (fn->block_count + 1) * 2;
+        ra->depths = realloc(ra->depths, n * sizeof(uint32_t));
+        ra->stamps = realloc(ra->stamps, n * sizeof(uint32_t));
+        ra->work = realloc(ra->work, n * sizeof(uint32_t));
+    }
+}
+
+bool regalloc_has_location(struct ir_function *fn, uint32_t v) {
+    struct ir_inst *inst = ir_inst(fn, v);
+    switch (inst->op) {
+    case IR_CONST:
+    case IR_UNDEF:
+    case IR_SLOT:
+    case IR_GLOBAL:
+    case IR_STRING:
+    case IR_STORE:
+        return false;
+    case IR_CALL:
+        return inst->type != IR_VOID;
+    }
+    // a fused comparison only sets the flags.
+    return !ir_is_terminator(inst->op) && !(inst->flags & IR_FLAG_FUSED);
+}
+
+// Position of the terminator of `block`.
+static uint32_t regalloc_terminator(struct ir_function *fn, uint32_t block) {
+    return fn->blocks[block].end - 1;
+}
+
+// Counts the loops around each block: a jump back to an earlier block, or
+// to its own, closes a loop over the blocks in between.
+static void regalloc_depths(struct regalloc *ra, struct ir_function *fn) {
+    uint32_t *depths = ra->depths;
+    memset(depths, 0, (fn->block_count + 1) * sizeof(uint32_t));
+    for (uint32_t b = 0; b < fn->block_count; b++) {
+        uint32_t count;
+        uint32_t *succs = ir_successors(fn, b, &count);
+        for (uint32_t i = 0; i < count; i++) {
+            if (succs[i] > b) continue;
+            depths[succs[i]]++;
+            depths[b + 1]--;
+        }
+    }
+    uint32_t depth = 0;
+    for (uint32_t b = 0; b < fn->block_count; b++) {
+        depth += depths[b];
+        depths[b] = depth;
+    }
+}
+
+static void regalloc_weigh(struct regalloc *ra, uint32_t v, uint32_t block) {
+    uint32_t depth = ra->depths[block];
+    if (depth > REGALLOC_MAX_DEPTH) depth = REGALLOC_MAX_DEPTH;
+    uint32_t weight = ra->weights[v] + ((uint32_t)1 << (3 * depth));
+    ra->weights[v] = weight < REGALLOC_MAX_WEIGHT ? weight : REGALLOC_MAX_WEIGHT;
+}
+
+// Extends the interval of `v` over the blocks it's live in, from `block`
+// back to its definition. Each block is walked once per value, the stamps
+// tell the ones already walked.
+static void regalloc_live_in(struct regalloc *ra, struct ir_function *fn,
+                             uint32_t v, uint32_t block) {
+    uint32_t def = ra->block_of[v];
+    if (block == def || ra->stamps[block] == v) return;
+    uint32_t top = 0;
+    ra->stamps[block] = v;
+    ra->work[top++] = block;
+    while (top) {
+        uint32_t b = ra->work[--top];
+        if (fn->blocks[b].first < ra->starts[v])
+            ra->starts[v] = fn->blocks[b].first;
+        uint32_t count;
+        uint32_t *preds = ir_list(fn, fn->blocks[b].preds, &count);
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t pred = preds[i];
+            uint32_t end = regalloc_terminator(fn, pred);
+            if (end > ra->ends[v]) ra->ends[v] = end;
+            if (pred == def || ra->stamps[pred] == v) continue;
+            ra->stamps[pred] = v;
+            ra->work[top++] = pred;
+        }
+    }
+}
+
+static void regalloc_interval(struct regalloc *ra, struct ir_function *fn,
+                              uint32_t v) {
+    struct ir_inst *inst = ir_inst(fn, v);
+    uint32_t block = ra->block_of[v];
+    // parameters are all moved in by the prologue.
+    ra->starts[v] = inst->op == IR_PARAM ? 0 : v;
+    ra->ends[v] = v;
+    ra->weights[v] = 0;
+    regalloc_weigh(ra, v, block);
+
+    uint32_t count;
+    uint32_t *preds = ir_list(fn, fn->blocks[block].preds, &count);
+    if (inst->op == IR_PHI) {
+        // written by each predecessor before it jumps.
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t end = regalloc_terminator(fn, preds[i]);
+            if (end < ra->starts[v]) ra->starts[v] = end;
+            if (end > ra->ends[v]) ra->ends[v] = end;
+        }
+    }
+
+    uint32_t *uses = ir_uses(fn, v, &count);
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t user = uses[i];
+        uint32_t user_block = ra->block_of[user];
+        if (ir_inst(fn, user)->op != IR_PHI) {
+            regalloc_weigh(ra, v, user_block);
+            if (user > ra->ends[v]) ra->ends[v] = user;
+            regalloc_live_in(ra, fn, v, user_block);
+            continue;
+        }
+        // a phi uses its operands at the end of the predecessors they come
+        // from.
+        uint32_t pred_count, operand_count;
+        uint32_t *phi_preds =
+            ir_list(fn, fn->blocks[user_block].preds, &pred_count);
+        uint32_t *operands = ir_list(fn, ir_inst(fn, user)->a, &operand_count);
+        for (uint32_t j = 0; j < operand_count; j++) {
+            if (operands[j] != v) continue;
+            uint32_t pred = phi_preds[j];
+            uint32_t end = regalloc_terminator(fn, pred);
+            regalloc_weigh(ra, v, pred);
+            if (end > ra->ends[v]) ra->ends[v] = end;
+            regalloc_live_in(ra, fn, v, pred);
+        }
+    }
+}
+
+// True if a call clobbers registers while `v` is live: one placed strictly
+// inside its interval. Arguments end at their call and results start at it.
+static bool regalloc_crosses_call(struct regalloc *ra, uint32_t v) {
+    uint32_t start = ra->starts[v], end = ra->ends[v];
+    return end > start + 1 && ra->calls[end - 1] > ra->calls[start];
+}
+
+// True if spilling `a` costs less than spilling `b`: it has fewer uses per
+// position of its interval.
+static bool regalloc_cheaper(struct regalloc *ra, uint32_t a, uint32_t b) {
+    uint64_t length_a = ra->ends[a] - ra->starts[a] + 1;
+    uint64_t length_b = ra->ends[b] - ra->starts[b] + 1;
+    return ra->weights[a] * length_b < ra->weights[b] * length_a;
+}
+
+// Sorts the values with a location by the start of their interval, into
+// regalloc::order, and returns their amount.
+static uint32_t regalloc_sort(struct regalloc *ra, struct ir_function *fn) {
+    uint32_t *counts = ra->counts;
+    memset(counts, 0, fn->count * sizeof(uint32_t));
+    for (uint32_t v = 1; v < fn->count; v++)
+        if (regalloc_has_location(fn, v)) counts[ra->starts[v]]++;
+    uint32_t sum = 0;
+    for (uint32_t p = 0; p < fn->count; p++) {
+        uint32_t count = counts[p];
+        counts[p] = sum;
+        sum += count;
+    }
+    for (uint32_t v = 1; v < fn->count; v++)
+        if (regalloc_has_location(fn, v)) ra->order[counts[ra->starts[v]]++] = v;
+    return sum;
+}
+
+static int regalloc_pick(uint16_t free) {
+    for (uint32_t i = 0; i < REGALLOC_REGISTER_COUNT; i++)
+        if (free & REGALLOC_BIT(regalloc_registers[i]))
+            return regalloc_registers[i];
+    return X86_NO_REG;
+}
+
+// Walks the intervals by start, with the values holding a register at that
+// point active. There are never more active values than registers, so each
+// step is constant time.
+static void regalloc_scan(struct regalloc *ra, uint32_t count) {
+    uint32_t active[REGALLOC_REGISTER_COUNT];
+    uint32_t active_count = 0;
+    uint16_t free = 0;
+    for (uint32_t i = 0; i < REGALLOC_REGISTER_COUNT; i++)
+        free |= REGALLOC_BIT(regalloc_registers[i]);
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t v = ra->order[i];
+        uint32_t kept = 0;
+        for (uint32_t j = 0; j < active_count; j++) {
+            uint32_t a = active[j];
+            if (ra->ends[a] < ra->starts[v])
+                free |= REGALLOC_BIT(ra->regs[a]);
+            else
+                active[kept++] = a;
+        }
+        active_count = kept;
+
+        uint16_t allowed =
+            regalloc_crosses_call(ra, v) ? regalloc_callee_saved : 0xffff;
+        int reg = regalloc_pick(free & allowed);
+        if (reg == X86_NO_REG) {
+            // the cheapest of `v` and the values holding a register it may
+            // take goes to the stack.
+            uint32_t victim = v, index = 0;
+            for (uint32_t j = 0; j < active_count; j++) {
+                uint32_t a = active[j];
+                if (!(allowed & REGALLOC_BIT(ra->regs[a]))) continue;
+                if (regalloc_cheaper(ra, a, victim)) victim = a, index = j;
+            }
+            ra->regs[v] = X86_NO_REG;
+            if (victim == v) continue;
+            reg = ra->regs[victim];
+            ra->regs[victim] = X86_NO_REG;
+            active[index] = active[--active_count];
+        } else {
+            free &= ~REGALLOC_BIT(reg);
+        }
+        ra->regs[v] = reg;
+        ra->saved |= REGALLOC_BIT(reg) & regalloc_callee_saved;
+        active[active_count++] = v;
+    }
+}
+
+void regalloc_run(struct regalloc *ra, struct ir_function *fn) {
+    regalloc_reserve(ra, fn);
+    ra->saved = 0;
+    memset(ra->regs, X86_NO_REG, fn->count);
+    memset(ra->stamps, 0, fn->block_count * sizeof(uint32_t));
+
+    uint32_t calls = 0;
+    for (uint32_t b = 0; b < fn->block_count; b++) {
+        struct ir_block *block = &fn->blocks[b];
+        for (uint32_t v = block->first; v < block->end; v++) {
+            ra->block_of[v] = b;
+            calls += ir_inst(fn, v)->op == IR_CALL;
+            ra->calls[v] = calls;
+        }
+    }
+    ra->calls[0] = 0;
+    regalloc_depths(ra, fn);
+
+    for (uint32_t v = 1; v < fn->count; v++)
+        if (regalloc_has_location(fn, v)) regalloc_interval(ra, fn, v);
+    regalloc_scan(ra, regalloc_sort(ra, fn));
+}
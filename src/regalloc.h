@@ -0,0 +1,66 @@
+#ifndef PEACHREGALLOC_H
+#define PEACHREGALLOC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ir.h"
+
+// Assigns the values of a function in SSA form to x86-64 registers by
+// linear scan, as in "Linear Scan Register Allocation" (Poletto and Sarkar).
+//
+// Positions are the value ids: blocks are laid out in order, so an
+// instruction's id is its place in the code. Each value lives in a single
+// interval from its definition to the end of its liveness, computed by
+// walking back from every use to the definition, which visits each block a
+// value is live in once. A phi's interval starts at the terminators of its
+// predecessors, where its operands are moved in. Intervals are taken in
+// order of their start; when no register is free, the value used the least
+// per position of its interval is spilled to the stack for its whole life,
+// uses in deep loops weighing more.
+//
+// rax, rcx, rdx and r11 are never allocated, the code generator keeps them
+// for division, shifts, returns and the moves it makes. A value live across
+// a call only gets a register the call preserves.
+//
+// The arrays are reused from one function to the next, like ir_function.
+struct regalloc {
+    // register of each value, X86_NO_REG for the values spilled and those
+    // with no location, see regalloc_has_location.
+    uint8_t *regs;
+    // bit per callee saved register allocated, the function must save them.
+    uint16_t saved;
+
+    // scratch by value: interval, weight, block, and the order of the
+    // intervals, with the amount of intervals starting at each position
+    // to sort them.
+    uint32_t *starts;
+    uint32_t *ends;
+    uint32_t *weights;
+    uint32_t *block_of;
+    uint32_t *order;
+    uint32_t *counts;
+    // calls at or before each position.
+    uint32_t *calls;
+    uint32_t value_capacity;
+
+    // scratch by block: loop depth, last value found live in, and the
+    // blocks left to walk.
+    uint32_t *depths;
+    uint32_t *stamps;
+    uint32_t *work;
+    uint32_t block_capacity;
+};
+
+void regalloc_init(struct regalloc *ra);
+void regalloc_free(struct regalloc *ra);
+
+// True if the value `v` is kept in a register or on the stack. Constants,
+// addresses of slots and symbols are materialized again where they're used
+// instead, and instructions defining nothing have nothing to keep.
+bool regalloc_has_location(struct ir_function *fn, uint32_t v);
+
+// Allocates the registers of `fn`, into regalloc::regs and regalloc::saved.
+void regalloc_run(struct regalloc *ra, struct ir_function *fn);
+
+#endif  // PEACHREGALLOC_H
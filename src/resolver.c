@@ -0,0 +1,424 @@
+#include "resolver.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../helpers/intern.h"
+#include "ast.h"
+#include "lexer.h"
+#include "parser.h"
+
+// Walks the tree once in source order, entering and leaving scopes as C
+// does, and binds every use of a name to the declaration visible there. The
+// file scope is walked first, function bodies after it by resolvers of their
+// own which fall back to the file scope tables.
+
+static void resolver_error(struct resolver *r, uint32_t token, const char *msg,
+                           ...) {
+    if (r->quiet) compiler_fail(r->compiler);
+
+    struct token *tok = parser_token(r->parser, token);
+    va_list args;
+    printf("[ERROR]: ");
+    va_start(args, msg);
+    vprintf(msg, args);
+    va_end(args);
+    printf("\nSemantic error at line: %d, col: %d at file: %s\n",
+           tok->pos.line, tok->pos.col, r->compiler->pos.filename);
+    compiler_fail(r->compiler);
+}
+
+static struct node *resolver_node(struct resolver *r, uint32_t index) {
+    return ast_node(&r->parser->ast, index);
+}
+
+// Returns the interned name of the identifier at `token`.
+static uint32_t resolver_name(struct resolver *r, uint32_t token) {
+    const char *name = parser_token(r->parser, token)->sval;
+    return interner_intern(r->names, name, strlen(name));
+}
+
+static const char *resolver_spelling(struct resolver *r, uint32_t token) {
+    return parser_token(r->parser, token)->sval;
+}
+
+// Returns the node declaring the name at `token` among the ordinary
+// identifiers or among the tags, 0 if it's not declared.
+static uint32_t resolver_lookup(struct resolver *r, bool tag, uint32_t token) {
+    struct symtab *local = tag ? &r->tags : &r->ordinary;
+    uint32_t sym = symtab_lookup(local, resolver_name(r, token));
+    if (sym) return symtab_symbol(local, sym)->node;
+    if (!r->global) return 0;
+
+    // the file scope was resolved as a whole, the names bound last may have
+    // been declared after the function. Nodes are numbered in source order.
+    struct symtab *global = tag ? &r->global->tags : &r->global->ordinary;
+    const char *name = resolver_spelling(r, token);
+    sym = symtab_lookup(global, interner_find(r->global->names, name,
+                                              strlen(name)));
+    for (; sym; sym = symtab_symbol(global, sym)->shadowed) {
+        if (symtab_symbol(global, sym)->node <= r->function)
+            return symtab_symbol(global, sym)->node;
+    }
+    return 0;
+}
+
+static void resolver_enter(struct resolver *r) {
+    symtab_enter(&r->ordinary);
+    symtab_enter(&r->tags);
+}
+
+static void resolver_leave(struct resolver *r) {
+    symtab_leave(&r->ordinary);
+    symtab_leave(&r->tags);
+}
+
+static void resolve_expression(struct resolver *r, uint32_t n);
+static void resolve_statement(struct resolver *r, uint32_t n);
+static void resolve_declaration(struct resolver *r, uint32_t n, bool members);
+
+// Returns true if `n` defines what it declares, a function with a body or a
+// variable with an initializer.
+static bool resolver_is_definition(struct resolver *r, uint32_t n) {
+    struct node *node = resolver_node(r, n);
+    return node->kind == NODE_FUNCTION || (node->kind == NODE_VAR && node->b);
+}
+
+// Declares the name of `n`, a NODE_VAR, NODE_PARAM or NODE_FUNCTION, in the
+// innermost scope.
+static void resolver_declare(struct resolver *r, uint32_t n) {
+    uint32_t token = resolver_node(r, n)->token;
+    uint32_t name = resolver_name(r, token);
+
+    uint32_t previous = symtab_lookup(&r->ordinary, name);
+    if (previous) {
+        struct symbol *sym = symtab_symbol(&r->ordinary, previous);
+        // file scope names may be declared again as long as only one of the
+        // declarations defines them.
+        if (sym->depth == r->ordinary.depth &&
+            (r->ordinary.depth ||
+             (resolver_is_definition(r, sym->node) &&
+              resolver_is_definition(r, n))))
+            resolver_error(r, token, "Redefinition of '%s'",
+                           resolver_spelling(r, token));
+        // a definition stays bound, later redefinitions are still caught.
+        if (sym->depth == r->ordinary.depth &&
+            resolver_is_definition(r, sym->node))
+            return;
+    }
+    symtab_insert(&r->ordinary, name, n);
+}
+
+static void resolve_struct(struct resolver *r, uint32_t n) {
+    struct node *node = resolver_node(r, n);
+    uint32_t members = node->a;
+    uint32_t name =
+        node->flags & NODE_FLAG_UNNAMED ? 0 : resolver_name(r, node->token);
+
+    if (!members) {
+        uint32_t previous = name ? resolver_lookup(r, true, node->token) : 0;
+        if (previous)
+            node->b = previous;
+        else
+            // the first mention of a tag declares it, incomplete.
+            symtab_insert(&r->tags, name, n);
+        return;
+    }
+
+    if (name) {
+        uint32_t sym = symtab_lookup(&r->tags, name);
+        if (sym && symtab_symbol(&r->tags, sym)->depth == r->tags.depth) {
+            uint32_t previous = symtab_symbol(&r->tags, sym)->node;
+            if (resolver_node(r, previous)->a)
+                resolver_error(r, node->token, "Redefinition of 'struct %s'",
+                               resolver_spelling(r, node->token));
+            // uses of the incomplete tag lead here.
+            resolver_node(r, previous)->b = n;
+        }
+        // declared before its members, they may point to the struct itself.
+        symtab_insert(&r->tags, name, n);
+    }
+
+    uint32_t count;
+    uint32_t *items = ast_list(&r->parser->ast, members, &count);
+    for (uint32_t i = 0; i < count; i++) resolve_declaration(r, items[i], true);
+}
+
+// Resolves the type `n` down to `base`, the shared specifiers of a
+// declaration which are resolved once, 0 to resolve the whole type.
+static void resolve_type(struct resolver *r, uint32_t n, uint32_t base) {
+    while (n && n != base) {
+        struct node *node = resolver_node(r, n);
+        switch (node->kind) {
+        case NODE_TYPE_POINTER:
+            n = node->a;
+            break;
+        case NODE_TYPE_ARRAY:
+            resolve_expression(r, node->b);
+            n = node->a;
+            break;
+        case NODE_TYPE_FUNCTION: {
+            // parameter names of a declaration without a body mean nothing.
+            uint32_t count;
+            uint32_t *params = ast_list(&r->parser->ast, node->b, &count);
+            for (uint32_t i = 0; i < count; i++)
+                resolve_type(r, resolver_node(r, params[i])->a, 0);
+            n = node->a;
+            break;
+        }
+        case NODE_TYPE_STRUCT:
+            resolve_struct(r, n);
+            return;
+        default:
+            return;
+        }
+    }
+}
+
+static void resolve_list(struct resolver *r, uint32_t list,
+                         void (*resolve)(struct resolver *, uint32_t)) {
+    uint32_t count;
+    uint32_t *items = ast_list(&r->parser->ast, list, &count);
+    for (uint32_t i = 0; i < count; i++) resolve(r, items[i]);
+}
+
+static void resolve_initializer(struct resolver *r, uint32_t n) {
+    struct node *node = resolver_node(r, n);
+    if (node->kind == NODE_INIT_LIST)
+        resolve_list(r, node->a, resolve_initializer);
+    else
+        resolve_expression(r, n);
+}
+
+static void resolve_declaration(struct resolver *r, uint32_t n, bool members) {
+    struct node *decl = resolver_node(r, n);
+    uint32_t base = decl->b;
+    resolve_type(r, base, 0);
+
+    uint32_t count;
+    uint32_t *vars = ast_list(&r->parser->ast, decl->a, &count);
+    for (uint32_t i = 0; i < count; i++) {
+        struct node *var = resolver_node(r, vars[i]);
+        resolve_type(r, var->a, base);
+        // members have a namespace of their own per struct, they're looked
+        // up along with their struct's type.
+        if (members) continue;
+
+        // the name is visible in its own initializer.
+        resolver_declare(r, vars[i]);
+        if (var->b) resolve_initializer(r, var->b);
+    }
+}
+
+static void resolve_expression(struct resolver *r, uint32_t n) {
+    if (!n) return;
+    struct node *node = resolver_node(r, n);
+    switch (node->kind) {
+    case NODE_IDENTIFIER:
+        node->a = resolver_lookup(r, false, node->token);
+        if (!node->a)
+            resolver_error(r, node->token, "Undeclared identifier '%s'",
+                           resolver_spelling(r, node->token));
+        break;
+    case NODE_UNARY:
+    case NODE_POSTFIX:
+    case NODE_MEMBER:
+    case NODE_SIZEOF_EXPR:
+        resolve_expression(r, node->a);
+        break;
+    case NODE_BINARY:
+    case NODE_INDEX:
+        resolve_expression(r, node->a);
+        resolve_expression(r, node->b);
+        break;
+    case NODE_CONDITIONAL: {
+        uint32_t *branches = &r->parser->ast.extra[node->b];
+        resolve_expression(r, node->a);
+        resolve_expression(r, branches[0]);
+        resolve_expression(r, branches[1]);
+        break;
+    }
+    case NODE_CALL:
+        resolve_expression(r, node->a);
+        resolve_list(r, node->b, resolve_expression);
+        break;
+    case NODE_CAST:
+        resolve_type(r, node->a, 0);
+        resolve_expression(r, node->b);
+        break;
+    case NODE_SIZEOF_TYPE:
+        resolve_type(r, node->a, 0);
+        break;
+    }
+}
+
+static void resolve_label(struct resolver *r, uint32_t n) {
+    uint32_t token = resolver_node(r, n)->token;
+    uint32_t name = resolver_name(r, token);
+    if (symtab_lookup(&r->labels, name))
+        resolver_error(r, token, "Redefinition of label '%s'",
+                       resolver_spelling(r, token));
+    symtab_insert(&r->labels, name, n);
+}
+
+static void resolve_items(struct resolver *r, uint32_t list) {
+    uint32_t count;
+    uint32_t *items = ast_list(&r->parser->ast, list, &count);
+    for (uint32_t i = 0; i < count; i++) resolve_statement(r, items[i]);
+}
+
+static void resolve_statement(struct resolver *r, uint32_t n) {
+    if (!n) return;
+    struct node *node = resolver_node(r, n);
+    switch (node->kind) {
+    case NODE_COMPOUND:
+        resolver_enter(r);
+        resolve_items(r, node->a);
+        resolver_leave(r);
+        break;
+    case NODE_DECLARATION:
+        resolve_declaration(r, n, false);
+        break;
+    case NODE_EXPRESSION_STMT:
+    case NODE_RETURN:
+        resolve_expression(r, node->a);
+        break;
+    case NODE_IF: {
+        uint32_t *branches = &r->parser->ast.extra[node->b];
+        resolve_expression(r, node->a);
+        resolve_statement(r, branches[0]);
+        resolve_statement(r, branches[1]);
+        break;
+    }
+    case NODE_WHILE:
+    case NODE_SWITCH:
+    case NODE_CASE:
+        resolve_expression(r, node->a);
+        resolve_statement(r, node->b);
+        break;
+    case NODE_DEFAULT:
+        resolve_statement(r, node->b);
+        break;
+    case NODE_DO:
+        resolve_statement(r, node->a);
+        resolve_expression(r, node->b);
+        break;
+    case NODE_FOR: {
+        uint32_t *clauses = &r->parser->ast.extra[node->a];
+        // a declaration in the first clause is scoped to the loop.
+        resolver_enter(r);
+        if (clauses[0] && resolver_node(r, clauses[0])->kind == NODE_DECLARATION)
+            resolve_declaration(r, clauses[0], false);
+        else
+            resolve_expression(r, clauses[0]);
+        resolve_expression(r, clauses[1]);
+        resolve_expression(r, clauses[2]);
+        resolve_statement(r, node->b);
+        resolver_leave(r);
+        break;
+    }
+    case NODE_LABEL:
+        resolve_label(r, n);
+        resolve_statement(r, node->a);
+        break;
+    case NODE_GOTO:
+        if (r->goto_count == r->goto_capacity) {
+            r->goto_capacity = r->goto_capacity ? r->goto_capacity * 2 : 16;
+            r->gotos = realloc(r->gotos, r->goto_capacity * sizeof(uint32_t));
+        }
+        r->gotos[r->goto_count++] = n;
+        break;
+    }
+}
+
+static void resolve_function(struct resolver *r, uint32_t n) {
+    resolve_type(r, resolver_node(r, n)->a, 0);
+    // declared before the body, the function may call itself.
+    resolver_declare(r, n);
+}
+
+int resolver_resolve_body(struct resolver *r, uint32_t n) {
+    // a failed body leaves its scopes open.
+    if (r->ordinary.depth || r->tags.depth || r->labels.depth) {
+        symtab_reset(&r->ordinary);
+        symtab_reset(&r->tags);
+        symtab_reset(&r->labels);
+    }
+    r->function = n;
+    struct node *function = resolver_node(r, n);
+    struct node *type = resolver_node(r, function->a);
+
+    // parameters share the scope of the body's outermost block.
+    resolver_enter(r);
+    symtab_enter(&r->labels);
+    uint32_t count;
+    uint32_t *params = ast_list(&r->parser->ast, type->b, &count);
+    for (uint32_t i = 0; i < count; i++) {
+        if (resolver_node(r, params[i])->flags & NODE_FLAG_UNNAMED)
+            resolver_error(r, resolver_node(r, params[i])->token,
+                           "Parameter name omitted in function definition");
+        resolver_declare(r, params[i]);
+    }
+
+    r->goto_count = 0;
+    resolve_items(r, resolver_node(r, function->b)->a);
+    for (uint32_t i = 0; i < r->goto_count; i++) {
+        struct node *jump = resolver_node(r, r->gotos[i]);
+        uint32_t label = symtab_lookup(&r->labels, resolver_name(r, jump->token));
+        if (!label)
+            resolver_error(r, jump->token, "Undefined label '%s'",
+                           resolver_spelling(r, jump->token));
+        jump->a = symtab_symbol(&r->labels, label)->node;
+    }
+
+    symtab_leave(&r->labels);
+    resolver_leave(r);
+    return RESOLVE_ALL_OK;
+}
+
+int resolver_resolve(struct resolver *r) {
+    interner_clear(r->names);
+    symtab_reset(&r->ordinary);
+    symtab_reset(&r->tags);
+    symtab_reset(&r->labels);
+
+    struct ast *ast = &r->parser->ast;
+    uint32_t count;
+    uint32_t *items = ast_list(ast, ast_node(ast, ast->root)->a, &count);
+    for (uint32_t i = 0; i < count; i++) {
+        if (ast_node(ast, items[i])->kind == NODE_FUNCTION)
+            resolve_function(r, items[i]);
+        else
+            resolve_declaration(r, items[i], false);
+    }
+    return RESOLVE_ALL_OK;
+}
+
+struct resolver *resolver_create(struct compiler *c) {
+    struct resolver *r = calloc(1, sizeof(struct resolver));
+    r->compiler = c;
+    r->parser = c->parser;
+    r->names = interner_create();
+    symtab_init(&r->ordinary);
+    symtab_init(&r->tags);
+    symtab_init(&r->labels);
+    return r;
+}
+
+struct resolver *resolver_create_body(struct resolver *global) {
+    struct resolver *r = resolver_create(global->compiler);
+    r->parser = global->parser;
+    r->global = global;
+    return r;
+}
+
+void resolver_free(struct resolver *resolver) {
+    interner_free(resolver->names);
+    symtab_free(&resolver->ordinary);
+    symtab_free(&resolver->tags);
+    symtab_free(&resolver->labels);
+    free(resolver->gotos);
+    free(resolver);
+}
@@ -0,0 +1,70 @@
+#ifndef PEACHRESOLVER_H
+#define PEACHRESOLVER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "compiler.h"
+#include "symtab.h"
+
+enum resolve_errors {
+    RESOLVE_ALL_OK,
+    RESOLVE_GENERAL_ERROR,
+};
+
+struct resolver {
+    struct compiler *compiler;
+    // the tree being resolved and its tokens.
+    struct parser *parser;
+
+    // interned names of the identifiers, symbols are keyed by these ids.
+    struct interner *names;
+
+    // one table per namespace, C keeps tags and labels apart from the
+    // ordinary identifiers.
+    struct symtab ordinary;
+    struct symtab tags;
+    struct symtab labels;
+
+    // NODE_GOTO of the function being resolved, a label may follow the gotos
+    // jumping to it.
+    uint32_t *gotos;
+    uint32_t goto_count;
+    uint32_t goto_capacity;
+
+    // resolver of the file scope while this one resolves function bodies,
+    // NULL for the file scope resolver itself. Names missing from the own
+    // tables are looked up in the file scope tables, which are only read.
+    struct resolver *global;
+    // NODE_FUNCTION whose body is being resolved, file scope names declared
+    // after it aren't visible in it.
+    uint32_t function;
+
+    // errors fail the compile without being printed, see parser::quiet.
+    bool quiet;
+};
+
+struct resolver *resolver_create(struct compiler *c);
+// Creates a resolver of the function bodies in the file scope of `global`.
+// Several of them may resolve bodies on different threads at once.
+struct resolver *resolver_create_body(struct resolver *global);
+void resolver_free(struct resolver *resolver);
+
+// Binds the names of the parser's tree to their declarations:
+//  - NODE_IDENTIFIER::a becomes the declaring NODE_VAR, NODE_PARAM or
+//    NODE_FUNCTION.
+//  - NODE_GOTO::a becomes its NODE_LABEL.
+//  - NODE_TYPE_STRUCT::b of a tag declared before becomes the earlier
+//    NODE_TYPE_STRUCT of the tag, following b leads to the definition.
+// Only the file scope is resolved, the bodies of parser::functions are left
+// to resolver_resolve_body.
+// Returns RESOLVE_ALL_OK if no errors were encountered.
+// Any errors are reported on stdout and fail the compile, see compiler_fail.
+int resolver_resolve(struct resolver *resolver);
+
+// Resolves the parsed body of `function` with a resolver made by
+// resolver_create_body, once the file scope is resolved. Only nodes of the
+// body are written, bodies may be resolved in any order and at once.
+int resolver_resolve_body(struct resolver *resolver, uint32_t function);
+
+#endif  // PEACHRESOLVER_H
@@ -0,0 +1,80 @@
+#include "symtab.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Grows `*array` of `size` byte elements to hold at least `needed` of them.
+static void symtab_reserve(void **array, uint32_t *capacity, uint32_t needed,
+                           size_t size) {
+    if (needed <= *capacity) return;
+    uint32_t old = *capacity;
+    uint32_t grown = old ? old : 64;
+    while (grown < needed) grown *= 2;
+    *array = realloc(*array, grown * size);
+    // only bindings rely on new slots being empty, zeroing is cheap enough
+    // for every array.
+    memset((char *)*array + old * size, 0, (grown - old) * size);
+    *capacity = grown;
+}
+
+void symtab_init(struct symtab *st) {
+    memset(st, 0, sizeof(*st));
+    symtab_reset(st);
+}
+
+void symtab_free(struct symtab *st) {
+    free(st->symbols);
+    free(st->bindings);
+    free(st->undo);
+    free(st->scopes);
+    memset(st, 0, sizeof(*st));
+}
+
+void symtab_reset(struct symtab *st) {
+    // symbol 0 stands for "none".
+    symtab_reserve((void **)&st->symbols, &st->capacity, 1,
+                   sizeof(struct symbol));
+    st->count = 1;
+    if (st->bindings)
+        memset(st->bindings, 0, st->binding_capacity * sizeof(uint32_t));
+    st->undo_len = 0;
+    st->depth = 0;
+}
+
+void symtab_enter(struct symtab *st) {
+    symtab_reserve((void **)&st->scopes, &st->scope_capacity, st->depth + 1,
+                   sizeof(uint32_t));
+    st->scopes[st->depth++] = st->undo_len;
+}
+
+void symtab_leave(struct symtab *st) {
+    uint32_t mark = st->scopes[--st->depth];
+    while (st->undo_len > mark) {
+        struct symbol *sym = &st->symbols[st->undo[--st->undo_len]];
+        st->bindings[sym->name] = sym->shadowed;
+    }
+}
+
+uint32_t symtab_insert(struct symtab *st, uint32_t name, uint32_t node) {
+    symtab_reserve((void **)&st->symbols, &st->capacity, st->count + 1,
+                   sizeof(struct symbol));
+    symtab_reserve((void **)&st->bindings, &st->binding_capacity, name + 1,
+                   sizeof(uint32_t));
+
+    uint32_t index = st->count++;
+    st->symbols[index] = (struct symbol){
+        .name = name,
+        .node = node,
+        .shadowed = st->bindings[name],
+        .depth = st->depth,
+    };
+    st->bindings[name] = index;
+
+    // file scope symbols are never unbound, they need no undo entry.
+    if (st->depth) {
+        symtab_reserve((void **)&st->undo, &st->undo_capacity,
+                       st->undo_len + 1, sizeof(uint32_t));
+        st->undo[st->undo_len++] = index;
+    }
+    return index;
+}
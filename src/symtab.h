@@ -0,0 +1,71 @@
+#ifndef PEACHSYMTAB_H
+#define PEACHSYMTAB_H
+
+#include <stdint.h>
+
+// A scoped symbol table for one namespace of names, ordinary identifiers,
+// tags or labels.
+//
+// Names are interned ids, see helpers/intern.h. Since ids are dense the
+// table is an array indexed by id holding the symbol the name is bound to in
+// the innermost scope, a lookup is a single load. Entering a scope records
+// the length of the undo log, every insertion appends to it, and leaving the
+// scope walks the log back restoring each name's previous binding. Leaving
+// costs as much as the scope declared, nothing is searched.
+//
+// Symbol records live in an array and are never released before a reset,
+// later passes may keep symbol indices. Index 0 means "no symbol".
+
+struct symbol {
+    uint32_t name;
+    // AST node declaring the symbol.
+    uint32_t node;
+    // symbol the name was bound to before, restored when leaving the scope.
+    uint32_t shadowed;
+    // scope the symbol was declared in, 0 for file scope.
+    uint32_t depth;
+};
+
+struct symtab {
+    struct symbol *symbols;
+    uint32_t count;
+    uint32_t capacity;
+
+    // symbol bound to each name id, 0 if none.
+    uint32_t *bindings;
+    uint32_t binding_capacity;
+
+    // symbols inserted in the open scopes, innermost last.
+    uint32_t *undo;
+    uint32_t undo_len;
+    uint32_t undo_capacity;
+
+    // undo log length when each open scope was entered.
+    uint32_t *scopes;
+    uint32_t depth;
+    uint32_t scope_capacity;
+};
+
+void symtab_init(struct symtab *st);
+void symtab_free(struct symtab *st);
+// Drops every symbol and scope, the storage is kept.
+void symtab_reset(struct symtab *st);
+
+void symtab_enter(struct symtab *st);
+// Leaves the innermost scope, its names get their previous binding back.
+void symtab_leave(struct symtab *st);
+
+// Binds `name` to a new symbol declared by `node` in the innermost scope and
+// returns it.
+uint32_t symtab_insert(struct symtab *st, uint32_t name, uint32_t node);
+
+// Returns the symbol `name` is bound to, 0 if it's not declared.
+static inline uint32_t symtab_lookup(const struct symtab *st, uint32_t name) {
+    return name < st->binding_capacity ? st->bindings[name] : 0;
+}
+
+static inline struct symbol *symtab_symbol(struct symtab *st, uint32_t index) {
+    return &st->symbols[index];
+}
+
+#endif  // PEACHSYMTAB_H
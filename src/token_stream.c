@@ -0,0 +1,64 @@
+#include "token_stream.h"
+
+#include <stdlib.h>
+
+struct token_stream *token_stream_create(void) {
+    struct token_stream *stream =
+        aligned_alloc(TOKEN_STREAM_CACHE_LINE, sizeof(struct token_stream));
+    sem_init(&stream->filled, 0, 0);
+    sem_init(&stream->free, 0, TOKEN_STREAM_BATCHES);
+    atomic_init(&stream->head, 0);
+    atomic_init(&stream->tail, 0);
+    stream->result = 0;
+    stream->ended = false;
+    return stream;
+}
+
+void token_stream_free(struct token_stream *stream) {
+    sem_destroy(&stream->filled);
+    sem_destroy(&stream->free);
+    free(stream);
+}
+
+void token_stream_reset(struct token_stream *stream) {
+    sem_destroy(&stream->filled);
+    sem_destroy(&stream->free);
+    sem_init(&stream->filled, 0, 0);
+    sem_init(&stream->free, 0, TOKEN_STREAM_BATCHES);
+    atomic_store_explicit(&stream->head, 0, memory_order_relaxed);
+    atomic_store_explicit(&stream->tail, 0, memory_order_relaxed);
+    stream->result = 0;
+    stream->ended = false;
+}
+
+void token_stream_push(struct token_stream *stream, struct token_batch batch) {
+    while (sem_wait(&stream->free) != 0) {
+    }
+    size_t head = atomic_load_explicit(&stream->head, memory_order_relaxed);
+    stream->batches[head % TOKEN_STREAM_BATCHES] = batch;
+    // publishes the batch and every token write before it.
+    atomic_store_explicit(&stream->head, head + 1, memory_order_release);
+    sem_post(&stream->filled);
+}
+
+void token_stream_close(struct token_stream *stream, int result) {
+    stream->result = result;
+    token_stream_push(stream, (struct token_batch){0});
+}
+
+bool token_stream_pop(struct token_stream *stream, struct token_batch *batch) {
+    if (stream->ended) return false;
+
+    while (sem_wait(&stream->filled) != 0) {
+    }
+    size_t tail = atomic_load_explicit(&stream->tail, memory_order_relaxed);
+    // pairs with the release store of head in token_stream_push.
+    atomic_load_explicit(&stream->head, memory_order_acquire);
+    *batch = stream->batches[tail % TOKEN_STREAM_BATCHES];
+    atomic_store_explicit(&stream->tail, tail + 1, memory_order_release);
+    sem_post(&stream->free);
+
+    // the end of the stream is the batch without tokens.
+    if (!batch->tokens) stream->ended = true;
+    return !stream->ended;
+}
@@ -0,0 +1,70 @@
+#ifndef PEACHTOKEN_STREAM_H
+#define PEACHTOKEN_STREAM_H
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Capacity of a token_stream in batches. Once this many batches wait for the
+// parser the lexer blocks, it never runs more than
+// TOKEN_STREAM_BATCHES * SEGVECTOR_BLOCK_ELEMENTS tokens ahead.
+#define TOKEN_STREAM_BATCHES 64
+
+// Keeps the indices of each side on a cache line of their own.
+#define TOKEN_STREAM_CACHE_LINE 64
+
+// A block of lexer::token_vec, handed over once the lexer is done writing
+// to it.
+struct token_batch {
+    struct token *tokens;
+    // amount of tokens lexed up to the end of the batch.
+    uint32_t end;
+};
+
+// Single producer, single consumer ring of token batches from a lexer
+// running on a thread of its own to the parser, see lexer_lex_start.
+//
+// Tokens are handed over a whole segvector block at a time, so the indices
+// shared by both sides change once per SEGVECTOR_BLOCK_ELEMENTS tokens and
+// the token contents are only ever read by the parser after the lexer
+// released them.
+struct token_stream {
+    // next batch the lexer fills, written by the lexer only.
+    alignas(TOKEN_STREAM_CACHE_LINE) _Atomic size_t head;
+    // next batch the parser reads, written by the parser only.
+    alignas(TOKEN_STREAM_CACHE_LINE) _Atomic size_t tail;
+
+    alignas(TOKEN_STREAM_CACHE_LINE) struct token_batch
+        batches[TOKEN_STREAM_BATCHES];
+    // counts batches waiting for the parser, the parser sleeps on it.
+    sem_t filled;
+    // counts free batches, the lexer sleeps on it when the ring is full.
+    sem_t free;
+
+    // result of the lexing thread, set before the end of the stream is
+    // pushed.
+    int result;
+    // set by the parser once it popped the end of the stream.
+    bool ended;
+    pthread_t thread;
+};
+
+struct token_stream *token_stream_create(void);
+void token_stream_free(struct token_stream *stream);
+
+// Empties the stream for another lexing run, neither side may be using it.
+void token_stream_reset(struct token_stream *stream);
+
+// Hands `batch` to the parser, waiting while the ring is full.
+void token_stream_push(struct token_stream *stream, struct token_batch batch);
+// Pushes the end of the stream carrying the lexing `result`.
+void token_stream_close(struct token_stream *stream, int result);
+
+// Takes the next batch, waiting until the lexer pushes one. Returns false
+// once the end of the stream is reached.
+bool token_stream_pop(struct token_stream *stream, struct token_batch *batch);
+
+#endif  // PEACHTOKEN_STREAM_H
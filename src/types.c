@@ -0,0 +1,598 @@
+#include "types.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ast.h"
+#include "lexer.h"
+#include "parser.h"
+
+// Types are made while walking the nodes once in index order. A node is
+// added after its children, so the type of every child is known by the time
+// its parent is reached. The only exception are mentions of a struct, which
+// lead through node::b to the definition which may come later: every
+// mention of a struct shares the type of the node at the end of the chain,
+// made complete once the definition is reached.
+
+static void types_error(struct types *t, uint32_t token, const char *msg,
+                        ...) {
+    struct token *tok = parser_token(t->parser, token);
+    va_list args;
+    printf("[ERROR]: ");
+    va_start(args, msg);
+    vprintf(msg, args);
+    va_end(args);
+    printf("\nSemantic error at line: %d, col: %d at file: %s\n",
+           tok->pos.line, tok->pos.col, t->compiler->pos.filename);
+    compiler_fail(t->compiler);
+}
+
+static struct node *types_node(struct types *t, uint32_t n) {
+    return ast_node(&t->parser->ast, n);
+}
+
+static uint32_t types_add(struct types *t, struct type type) {
+    return cvector_push(t->types, &type);
+}
+
+static uint32_t types_add_integer(struct types *t, uint32_t size, int flags) {
+    return types_add(t, (struct type){.kind = TYPE_INTEGER,
+                                      .flags = flags,
+                                      .size = size,
+                                      .align = size});
+}
+
+// Pushes the types which have a fixed id, in the order of TYPE_ID_*.
+static void types_add_basic(struct types *t) {
+    types_add(t, (struct type){.kind = TYPE_VOID});
+    types_add(t, (struct type){.kind = TYPE_VOID, .size = 1, .align = 1});
+    types_add_integer(t, 1, 0);
+    types_add_integer(t, 1, TYPE_FLAG_UNSIGNED);
+    types_add_integer(t, 2, 0);
+    types_add_integer(t, 2, TYPE_FLAG_UNSIGNED);
+    types_add_integer(t, 4, 0);
+    types_add_integer(t, 4, TYPE_FLAG_UNSIGNED);
+    types_add_integer(t, 8, 0);
+    types_add_integer(t, 8, TYPE_FLAG_UNSIGNED);
+    types_add(t, (struct type){.kind = TYPE_FLOATING, .size = 4, .align = 4});
+    types_add(t, (struct type){.kind = TYPE_FLOATING, .size = 8, .align = 8});
+    types_add(t, (struct type){.kind = TYPE_FLOATING, .size = 16, .align = 16});
+}
+
+uint32_t types_pointer(struct types *t, uint32_t base) {
+    struct type *type = types_get(t, base);
+    uint32_t pointer = atomic_load_explicit(&type->pointer, memory_order_acquire);
+    if (pointer) return pointer;
+
+    pthread_mutex_lock(&t->pointer_lock);
+    pointer = atomic_load_explicit(&type->pointer, memory_order_relaxed);
+    if (!pointer) {
+        pointer = types_add(t, (struct type){.kind = TYPE_POINTER,
+                                             .flags = TYPE_FLAG_UNSIGNED,
+                                             .size = 8,
+                                             .align = 8,
+                                             .base = base});
+        atomic_store_explicit(&type->pointer, pointer, memory_order_release);
+    }
+    pthread_mutex_unlock(&t->pointer_lock);
+    return pointer;
+}
+
+uint32_t types_promote(struct types *t, uint32_t type) {
+    struct type *ty = types_get(t, type);
+    if (ty->kind == TYPE_INTEGER && ty->size < 4) return TYPE_ID_INT;
+    return type;
+}
+
+uint32_t types_common(struct types *t, uint32_t a, uint32_t b) {
+    a = types_promote(t, a);
+    b = types_promote(t, b);
+    struct type *ta = types_get(t, a);
+    struct type *tb = types_get(t, b);
+    if (ta->kind == TYPE_FLOATING || tb->kind == TYPE_FLOATING) {
+        if (ta->kind != TYPE_FLOATING) return b;
+        if (tb->kind != TYPE_FLOATING) return a;
+        return ta->size >= tb->size ? a : b;
+    }
+    if (ta->size != tb->size) return ta->size > tb->size ? a : b;
+    // the same rank, unsigned wins.
+    return ta->flags & TYPE_FLAG_UNSIGNED ? a : b;
+}
+
+int64_t types_truncate(struct types *t, uint32_t type, int64_t value) {
+    struct type *ty = types_get(t, type);
+    if (ty->size >= 8) return value;
+    int shift = 64 - ty->size * 8;
+    if (ty->flags & TYPE_FLAG_UNSIGNED)
+        return (int64_t)((uint64_t)value << shift >> shift);
+    return (int64_t)((uint64_t)value << shift) >> shift;
+}
+
+struct type_member *types_member(struct types *t, uint32_t type,
+                                 uint32_t name) {
+    struct type *ty = types_get(t, type);
+    const char *spelling = parser_token(t->parser, name)->sval;
+    for (uint32_t i = 0; i < ty->count; i++) {
+        struct type_member *m = &t->members[ty->first + i];
+        if (!strcmp(parser_token(t->parser, m->token)->sval, spelling))
+            return m;
+    }
+    return NULL;
+}
+
+uint32_t types_number(int number_type) {
+    switch (number_type) {
+    case NUMBER_TYPE_INT:
+        return TYPE_ID_INT;
+    case NUMBER_TYPE_UNSIGNED_INT:
+        return TYPE_ID_UNSIGNED_INT;
+    case NUMBER_TYPE_LONG:
+    case NUMBER_TYPE_LONG_LONG:
+        return TYPE_ID_LONG;
+    case NUMBER_TYPE_UNSIGNED_LONG:
+    case NUMBER_TYPE_UNSIGNED_LONG_LONG:
+        return TYPE_ID_UNSIGNED_LONG;
+    case NUMBER_TYPE_FLOAT:
+        return TYPE_ID_FLOAT;
+    case NUMBER_TYPE_DOUBLE:
+        return TYPE_ID_DOUBLE;
+    }
+    return TYPE_ID_LONG_DOUBLE;
+}
+
+uint32_t types_string_length(struct types *t, uint32_t n) {
+    struct node *node = types_node(t, n);
+    uint32_t length = 1;
+    for (uint32_t i = 0; i < node->b; i++)
+        length += parser_token(t->parser, node->token + i)->slen;
+    return length;
+}
+
+// Evaluates the integer constant expression `n` into `value` and its type.
+static bool types_evaluate(struct types *t, uint32_t n, int64_t *value,
+                           uint32_t *type) {
+    struct node *node = types_node(t, n);
+    switch (node->kind) {
+    case NODE_NUMBER: {
+        struct token *tok = parser_token(t->parser, node->token);
+        *type = types_number(tok->number_type);
+        if (!types_is_integer(t, *type)) return false;
+        *value = (int64_t)tok->llnum;
+        return true;
+    }
+    case NODE_SIZEOF_TYPE: {
+        struct type *ty = types_get(t, types_type_of(t, node->a));
+        if (ty->flags & TYPE_FLAG_INCOMPLETE || ty->kind == TYPE_FUNCTION)
+            return false;
+        *value = ty->size;
+        *type = TYPE_ID_UNSIGNED_LONG;
+        return true;
+    }
+    case NODE_SIZEOF_EXPR: {
+        // only names and strings, anything else needs the expression's type.
+        struct node *operand = types_node(t, node->a);
+        if (operand->kind == NODE_STRING) {
+            *value = types_string_length(t, node->a);
+        } else if (operand->kind == NODE_IDENTIFIER && operand->a &&
+                   operand->a < t->built) {
+            struct type *ty = types_get(t, types_type_of(t, operand->a));
+            if (ty->flags & TYPE_FLAG_INCOMPLETE || ty->kind == TYPE_FUNCTION)
+                return false;
+            *value = ty->size;
+        } else {
+            return false;
+        }
+        *type = TYPE_ID_UNSIGNED_LONG;
+        return true;
+    }
+    case NODE_CAST: {
+        uint32_t to = types_type_of(t, node->a);
+        if (!types_is_integer(t, to) || !types_evaluate(t, node->b, value, type))
+            return false;
+        *value = types_truncate(t, to, *value);
+        *type = to;
+        return true;
+    }
+    case NODE_UNARY: {
+        if (!types_evaluate(t, node->a, value, type)) return false;
+        *type = types_promote(t, *type);
+        switch (node->op) {
+        case OPERATOR_PLUS:
+            break;
+        case OPERATOR_MINUS:
+            *value = -(uint64_t)*value;
+            break;
+        case OPERATOR_TILDE:
+            *value = ~*value;
+            break;
+        case OPERATOR_NOT:
+            *value = !*value;
+            *type = TYPE_ID_INT;
+            break;
+        default:
+            return false;
+        }
+        *value = types_truncate(t, *type, *value);
+        return true;
+    }
+    case NODE_CONDITIONAL: {
+        uint32_t *branches = &t->parser->ast.extra[node->b];
+        int64_t cond, lhs, rhs;
+        uint32_t cond_type, lhs_type, rhs_type;
+        if (!types_evaluate(t, node->a, &cond, &cond_type) ||
+            !types_evaluate(t, branches[0], &lhs, &lhs_type) ||
+            !types_evaluate(t, branches[1], &rhs, &rhs_type))
+            return false;
+        *type = types_common(t, lhs_type, rhs_type);
+        *value = types_truncate(t, *type, cond ? lhs : rhs);
+        return true;
+    }
+    case NODE_BINARY:
+        break;
+    default:
+        return false;
+    }
+
+    int64_t lhs, rhs;
+    uint32_t lhs_type, rhs_type;
+    if (!types_evaluate(t, node->a, &lhs, &lhs_type)) return false;
+    // && and || don't need their right operand to be evaluable when the left
+    // one decides, but C asks for it anyway.
+    if (!types_evaluate(t, node->b, &rhs, &rhs_type)) return false;
+
+    uint32_t common = types_common(t, lhs_type, rhs_type);
+    bool is_unsigned = types_is_unsigned(t, common);
+    uint64_t ul = (uint64_t)types_truncate(t, common, lhs);
+    uint64_t ur = (uint64_t)types_truncate(t, common, rhs);
+    lhs = types_truncate(t, common, lhs);
+    rhs = types_truncate(t, common, rhs);
+    *type = common;
+
+    switch (node->op) {
+    case OPERATOR_PLUS:
+        *value = ul + ur;
+        break;
+    case OPERATOR_MINUS:
+        *value = ul - ur;
+        break;
+    case OPERATOR_STAR:
+        *value = ul * ur;
+        break;
+    case OPERATOR_SLASH:
+    case OPERATOR_PERCENT:
+        if (!rhs) types_error(t, node->token, "Division by zero in a constant");
+        if (is_unsigned)
+            *value = node->op == OPERATOR_SLASH ? ul / ur : ul % ur;
+        else if (rhs == -1)
+            *value = node->op == OPERATOR_SLASH ? -(uint64_t)lhs : 0;
+        else
+            *value = node->op == OPERATOR_SLASH ? lhs / rhs : lhs % rhs;
+        break;
+    case OPERATOR_AMPERSAND:
+        *value = ul & ur;
+        break;
+    case OPERATOR_PIPE:
+        *value = ul | ur;
+        break;
+    case OPERATOR_CARET:
+        *value = ul ^ ur;
+        break;
+    case OPERATOR_SHIFT_LEFT:
+    case OPERATOR_SHIFT_RIGHT: {
+        // the left operand alone decides the type of a shift.
+        *type = types_promote(t, lhs_type);
+        uint32_t bits = types_get(t, *type)->size * 8;
+        lhs = types_truncate(t, *type, lhs);
+        int count = (int)(rhs & (bits - 1));
+        if (node->op == OPERATOR_SHIFT_LEFT)
+            *value = (uint64_t)lhs << count;
+        else if (types_is_unsigned(t, *type))
+            *value = (uint64_t)types_truncate(t, *type, lhs) >> count;
+        else
+            *value = lhs >> count;
+        break;
+    }
+    case OPERATOR_LESS:
+    case OPERATOR_GREATER:
+    case OPERATOR_LESS_EQUAL:
+    case OPERATOR_GREATER_EQUAL: {
+        int order = is_unsigned ? (ul > ur) - (ul < ur) : (lhs > rhs) - (lhs < rhs);
+        switch (node->op) {
+        case OPERATOR_LESS:
+            *value = order < 0;
+            break;
+        case OPERATOR_GREATER:
+            *value = order > 0;
+            break;
+        case OPERATOR_LESS_EQUAL:
+            *value = order <= 0;
+            break;
+        default:
+            *value = order >= 0;
+            break;
+        }
+        *type = TYPE_ID_INT;
+        break;
+    }
+    case OPERATOR_EQUAL:
+        *value = ul == ur;
+        *type = TYPE_ID_INT;
+        break;
+    case OPERATOR_NOT_EQUAL:
+        *value = ul != ur;
+        *type = TYPE_ID_INT;
+        break;
+    case OPERATOR_LOGICAL_AND:
+        *value = lhs && rhs;
+        *type = TYPE_ID_INT;
+        break;
+    case OPERATOR_LOGICAL_OR:
+        *value = lhs || rhs;
+        *type = TYPE_ID_INT;
+        break;
+    case OPERATOR_COMMA:
+        *value = rhs;
+        *type = rhs_type;
+        break;
+    default:
+        // assignments.
+        return false;
+    }
+    *value = types_truncate(t, *type, *value);
+    return true;
+}
+
+bool types_constant(struct types *t, uint32_t n, int64_t *value) {
+    uint32_t type;
+    int64_t result;
+    if (!n || !types_evaluate(t, n, &result, &type) || !types_is_integer(t, type))
+        return false;
+    *value = result;
+    return true;
+}
+
+static uint32_t types_base(struct node *node) {
+    bool is_unsigned = node->flags & NODE_FLAG_UNSIGNED;
+    switch (node->op) {
+    case AST_TYPE_VOID:
+        return TYPE_ID_VOID;
+    case AST_TYPE_CHAR:
+        return is_unsigned ? TYPE_ID_UNSIGNED_CHAR : TYPE_ID_CHAR;
+    case AST_TYPE_SHORT:
+        return is_unsigned ? TYPE_ID_UNSIGNED_SHORT : TYPE_ID_SHORT;
+    case AST_TYPE_INT:
+        return is_unsigned ? TYPE_ID_UNSIGNED_INT : TYPE_ID_INT;
+    case AST_TYPE_LONG:
+    case AST_TYPE_LONG_LONG:
+        return is_unsigned ? TYPE_ID_UNSIGNED_LONG : TYPE_ID_LONG;
+    case AST_TYPE_FLOAT:
+        return TYPE_ID_FLOAT;
+    case AST_TYPE_DOUBLE:
+        return TYPE_ID_DOUBLE;
+    }
+    return TYPE_ID_LONG_DOUBLE;
+}
+
+static uint32_t types_array(struct types *t, uint32_t element, uint64_t count,
+                            bool incomplete, uint32_t token) {
+    struct type *e = types_get(t, element);
+    if (e->kind == TYPE_FUNCTION || e->kind == TYPE_VOID ||
+        e->flags & TYPE_FLAG_INCOMPLETE)
+        types_error(t, token, "Array of an incomplete type");
+    if (count * e->size > UINT32_MAX)
+        types_error(t, token, "Array is too large");
+    return types_add(t, (struct type){.kind = TYPE_ARRAY,
+                                      .flags = incomplete ? TYPE_FLAG_INCOMPLETE : 0,
+                                      .size = count * e->size,
+                                      .align = e->align,
+                                      .base = element,
+                                      .count = count});
+}
+
+// Returns the type shared by every mention of the struct at `n`, made
+// incomplete on the first mention.
+static uint32_t types_struct(struct types *t, uint32_t n) {
+    while (types_node(t, n)->b) n = types_node(t, n)->b;
+    if (t->node_types[n]) return t->node_types[n];
+
+    struct node *node = types_node(t, n);
+    int flags = TYPE_FLAG_INCOMPLETE;
+    if (node->op == AST_TYPE_UNION) flags |= TYPE_FLAG_UNION;
+    t->node_types[n] =
+        types_add(t, (struct type){.kind = TYPE_STRUCT, .flags = flags, .node = n});
+    return t->node_types[n];
+}
+
+static void types_layout(struct types *t, uint32_t n, uint32_t id) {
+    struct ast *ast = &t->parser->ast;
+    struct node *node = types_node(t, n);
+    bool is_union = node->op == AST_TYPE_UNION;
+    uint32_t first = t->member_count;
+    uint64_t size = 0;
+    uint32_t align = 1;
+
+    uint32_t count;
+    uint32_t *decls = ast_list(ast, node->a, &count);
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t var_count;
+        uint32_t *vars = ast_list(ast, types_node(t, decls[i])->a, &var_count);
+        for (uint32_t j = 0; j < var_count; j++) {
+            struct node *var = types_node(t, vars[j]);
+            struct type *member = types_get(t, t->node_types[vars[j]]);
+            // a flexible array member ends the struct.
+            bool flexible = member->kind == TYPE_ARRAY &&
+                            member->flags & TYPE_FLAG_INCOMPLETE &&
+                            i == count - 1 && j == var_count - 1 && !is_union;
+            if (!flexible && (member->flags & TYPE_FLAG_INCOMPLETE ||
+                              member->kind == TYPE_VOID ||
+                              member->kind == TYPE_FUNCTION))
+                types_error(t, var->token, "Member '%s' has an incomplete type",
+                            parser_token(t->parser, var->token)->sval);
+
+            uint64_t offset = 0;
+            if (!is_union) {
+                offset = (size + member->align - 1) / member->align * member->align;
+                size = offset + member->size;
+            } else if (member->size > size) {
+                size = member->size;
+            }
+            if (member->align > align) align = member->align;
+
+            if (t->member_count == t->member_capacity) {
+                t->member_capacity =
+                    t->member_capacity ? t->member_capacity * 2 : 64;
+                t->members = realloc(t->members, t->member_capacity *
+                                                     sizeof(struct type_member));
+            }
+            t->members[t->member_count++] = (struct type_member){
+                .token = var->token,
+                .type = t->node_types[vars[j]],
+                .offset = offset};
+        }
+    }
+    size = (size + align - 1) / align * align;
+    if (size > UINT32_MAX) types_error(t, node->token, "Struct is too large");
+
+    struct type *type = types_get(t, id);
+    type->flags &= ~TYPE_FLAG_INCOMPLETE;
+    type->size = size;
+    type->align = align;
+    type->first = first;
+    type->count = t->member_count - first;
+}
+
+static uint32_t types_function(struct types *t, uint32_t n) {
+    struct node *node = types_node(t, n);
+    uint32_t ret = t->node_types[node->a];
+    int ret_kind = types_get(t, ret)->kind;
+    if (ret_kind == TYPE_ARRAY || ret_kind == TYPE_FUNCTION)
+        types_error(t, node->token, "Function can't return an array or a function");
+
+    uint32_t first = t->param_count;
+    uint32_t count;
+    uint32_t *params = ast_list(&t->parser->ast, node->b, &count);
+    for (uint32_t i = 0; i < count; i++) {
+        if (t->param_count == t->param_capacity) {
+            t->param_capacity = t->param_capacity ? t->param_capacity * 2 : 64;
+            t->params = realloc(t->params, t->param_capacity * sizeof(uint32_t));
+        }
+        t->params[t->param_count++] = t->node_types[params[i]];
+    }
+    int flags = node->flags & NODE_FLAG_VARIADIC ? TYPE_FLAG_VARIADIC : 0;
+    return types_add(t, (struct type){.kind = TYPE_FUNCTION,
+                                      .flags = flags,
+                                      .size = 1,
+                                      .align = 1,
+                                      .base = ret,
+                                      .count = count,
+                                      .first = first});
+}
+
+// Returns the type declared by the NODE_VAR `n`, an array without a size
+// takes it from its initializer.
+static uint32_t types_var(struct types *t, uint32_t n) {
+    struct node *var = types_node(t, n);
+    uint32_t type = t->node_types[var->a];
+    struct type *ty = types_get(t, type);
+    if (ty->kind != TYPE_ARRAY || !(ty->flags & TYPE_FLAG_INCOMPLETE) || !var->b)
+        return type;
+
+    struct node *init = types_node(t, var->b);
+    uint32_t count;
+    if (init->kind == NODE_INIT_LIST)
+        ast_list(&t->parser->ast, init->a, &count);
+    else if (init->kind == NODE_STRING)
+        count = types_string_length(t, var->b);
+    else
+        return type;
+    return types_array(t, ty->base, count, false, var->token);
+}
+
+// Parameters of array type are pointers, parameters of function type
+// pointers to the function.
+static uint32_t types_param(struct types *t, uint32_t n) {
+    struct node *param = types_node(t, n);
+    uint32_t type = t->node_types[param->a];
+    struct type *ty = types_get(t, type);
+    if (ty->kind == TYPE_ARRAY) return types_pointer(t, ty->base);
+    if (ty->kind == TYPE_FUNCTION) return types_pointer(t, type);
+    return type;
+}
+
+static uint32_t types_of_node(struct types *t, uint32_t n) {
+    struct node *node = types_node(t, n);
+    switch (node->kind) {
+    case NODE_TYPE_BASE:
+        return types_base(node);
+    case NODE_TYPE_POINTER:
+        return types_pointer(t, t->node_types[node->a]);
+    case NODE_TYPE_ARRAY: {
+        int64_t count = 0;
+        if (node->b && !types_constant(t, node->b, &count))
+            types_error(t, node->token, "Array size must be an integer constant");
+        if (count < 0) types_error(t, node->token, "Array size is negative");
+        return types_array(t, t->node_types[node->a], count, !node->b,
+                           node->token);
+    }
+    case NODE_TYPE_FUNCTION:
+        return types_function(t, n);
+    case NODE_TYPE_STRUCT: {
+        uint32_t id = types_struct(t, n);
+        if (node->a) types_layout(t, n, id);
+        return id;
+    }
+    case NODE_VAR:
+        return types_var(t, n);
+    case NODE_PARAM:
+        return types_param(t, n);
+    case NODE_FUNCTION:
+        return t->node_types[node->a];
+    }
+    return 0;
+}
+
+void types_build(struct types *t) {
+    struct ast *ast = &t->parser->ast;
+    if (ast->count > t->node_capacity) {
+        t->node_capacity = ast->capacity;
+        t->node_types =
+            realloc(t->node_types, t->node_capacity * sizeof(uint32_t));
+    }
+    // struct types may have been made ahead for the new nodes already.
+    for (uint32_t i = t->built; i < ast->count; i++) t->node_types[i] = 0;
+    for (uint32_t i = t->built; i < ast->count; i++) {
+        uint32_t type = types_of_node(t, i);
+        if (type) t->node_types[i] = type;
+        t->built = i + 1;
+    }
+}
+
+void types_reset(struct types *t) {
+    cvector_free(t->types);
+    t->types = cvector_create(sizeof(struct type));
+    types_add_basic(t);
+    t->built = 0;
+    t->member_count = 0;
+    t->param_count = 0;
+}
+
+struct types *types_create(struct compiler *c) {
+    struct types *t = calloc(1, sizeof(struct types));
+    t->compiler = c;
+    t->parser = c->parser;
+    t->types = cvector_create(sizeof(struct type));
+    pthread_mutex_init(&t->pointer_lock, NULL);
+    types_add_basic(t);
+    return t;
+}
+
+void types_free(struct types *t) {
+    cvector_free(t->types);
+    pthread_mutex_destroy(&t->pointer_lock);
+    free(t->node_types);
+    free(t->members);
+    free(t->params);
+    free(t);
+}
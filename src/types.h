@@ -0,0 +1,170 @@
+#ifndef PEACHTYPES_H
+#define PEACHTYPES_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../helpers/cvector.h"
+#include "compiler.h"
+
+// C types of the parsed tree. Each type has a 32-bit id, the type nodes,
+// declarations and functions of the tree are mapped to the id of their type
+// once by types_build. Type 0 means "none".
+
+// Kinds of struct type.
+enum {
+    TYPE_VOID,
+    TYPE_INTEGER,
+    TYPE_FLOATING,
+    TYPE_POINTER,
+    TYPE_ARRAY,
+    TYPE_FUNCTION,
+    TYPE_STRUCT,
+};
+
+// type::flags
+enum {
+    TYPE_FLAG_UNSIGNED = 0b0001,
+    // struct without members and array without a size.
+    TYPE_FLAG_INCOMPLETE = 0b0010,
+    // function taking '...'.
+    TYPE_FLAG_VARIADIC = 0b0100,
+    TYPE_FLAG_UNION = 0b1000,
+};
+
+// Ids of the arithmetic types and void, the same for every compile. long
+// long is held as long, they only differ in name on x86-64.
+enum {
+    TYPE_ID_NONE,
+    TYPE_ID_VOID,
+    TYPE_ID_CHAR,
+    TYPE_ID_UNSIGNED_CHAR,
+    TYPE_ID_SHORT,
+    TYPE_ID_UNSIGNED_SHORT,
+    TYPE_ID_INT,
+    TYPE_ID_UNSIGNED_INT,
+    TYPE_ID_LONG,
+    TYPE_ID_UNSIGNED_LONG,
+    TYPE_ID_FLOAT,
+    TYPE_ID_DOUBLE,
+    TYPE_ID_LONG_DOUBLE,
+    TYPE_ID_BASIC_COUNT
+};
+
+struct type {
+    uint8_t kind;
+    uint8_t flags;
+    uint32_t size;
+    uint32_t align;
+    // pointed to type, array element or function return type.
+    uint32_t base;
+    // array length, amount of parameters or of struct members.
+    uint32_t count;
+    // first of the parameters in types::params or of the members in
+    // types::members.
+    uint32_t first;
+    // NODE_TYPE_STRUCT every mention of the struct leads to.
+    uint32_t node;
+    // pointer to this type, made on first use by types_pointer.
+    _Atomic uint32_t pointer;
+};
+
+struct type_member {
+    // token of the member's name.
+    uint32_t token;
+    uint32_t type;
+    uint32_t offset;
+};
+
+struct types {
+    struct compiler *compiler;
+    struct parser *parser;
+
+    // struct type by id. Pointer types may be made by several threads at once
+    // while functions are lowered, the elements never move.
+    struct cvector *types;
+    pthread_mutex_t pointer_lock;
+
+    // type of each node up to `built`, see types_type_of.
+    uint32_t *node_types;
+    uint32_t node_capacity;
+    uint32_t built;
+
+    struct type_member *members;
+    uint32_t member_count;
+    uint32_t member_capacity;
+
+    // parameter types of the function types.
+    uint32_t *params;
+    uint32_t param_count;
+    uint32_t param_capacity;
+};
+
+struct types *types_create(struct compiler *c);
+void types_free(struct types *types);
+
+// Drops the types of the last compile, only the basic types are left.
+void types_reset(struct types *types);
+
+// Gives a type to every node of the parser's tree added since the last build:
+// type nodes get the type they spell, NODE_VAR and NODE_FUNCTION the type they
+// declare and NODE_PARAM its adjusted type, arrays and functions become
+// pointers. Runs in one pass in node order, a node's children come before it.
+// Errors are reported on stdout and fail the compile, see compiler_fail.
+void types_build(struct types *types);
+
+static inline struct type *types_get(struct types *types, uint32_t id) {
+    return cvector_at(types->types, id);
+}
+
+// Returns the type of the node `n`, 0 for nodes without one. Only valid for
+// nodes typed by types_build.
+static inline uint32_t types_type_of(struct types *types, uint32_t n) {
+    return types->node_types[n];
+}
+
+// Returns the pointer to `base`, making it on first use. Safe to call from
+// several threads at once.
+uint32_t types_pointer(struct types *types, uint32_t base);
+
+// Returns the member of the struct `type` named like the token `name`, NULL
+// if there is none.
+struct type_member *types_member(struct types *types, uint32_t type,
+                                 uint32_t name);
+
+// Integer promotion of `type`, the type itself if it isn't promoted.
+uint32_t types_promote(struct types *types, uint32_t type);
+// Common type of the usual arithmetic conversions of `a` and `b`.
+uint32_t types_common(struct types *types, uint32_t a, uint32_t b);
+
+// Returns `value` converted to the integer or pointer `type`, sign or zero
+// extended from its width.
+int64_t types_truncate(struct types *types, uint32_t type, int64_t value);
+
+// Returns the type of the NUMBER_TYPE_* of a literal.
+uint32_t types_number(int number_type);
+// Returns the length of the concatenated NODE_STRING `n` with its terminating
+// NULL character.
+uint32_t types_string_length(struct types *types, uint32_t n);
+
+// Evaluates the integer constant expression `n`. Returns false if it isn't
+// one, `value` is left as is then.
+bool types_constant(struct types *types, uint32_t n, int64_t *value);
+
+static inline bool types_is_integer(struct types *types, uint32_t id) {
+    return types_get(types, id)->kind == TYPE_INTEGER;
+}
+
+// True for the integer and pointer types, which fit in a register.
+static inline bool types_is_scalar(struct types *types, uint32_t id) {
+    int kind = types_get(types, id)->kind;
+    return kind == TYPE_INTEGER || kind == TYPE_POINTER;
+}
+
+static inline bool types_is_unsigned(struct types *types, uint32_t id) {
+    return types_get(types, id)->flags & TYPE_FLAG_UNSIGNED;
+}
+
+#endif  // PEACHTYPES_H
@@ -0,0 +1,644 @@
+#include "x86.h"
+
+#include <elf.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "object.h"
+
+// Instructions are encoded the way an assembler would pick for them: the
+// shortest immediate and displacement forms, REX only where it's needed. An
+// instruction takes at most 15 bytes and one relocation, of the symbol
+// operand it may have.
+
+// Encoding of one instruction.
+struct x86_code {
+    uint8_t bytes[16];
+    uint8_t length;
+    // offset of the 32-bit field the relocation patches, 0 for none.
+    uint8_t reloc;
+};
+
+// x86_inst::op of each ALU group operation, as the /digit of its encoding.
+static const uint8_t x86_alu_digits[X86_OP_COUNT] = {
+    [X86_ADD] = 0, [X86_OR] = 1,  [X86_AND] = 4,
+    [X86_SUB] = 5, [X86_XOR] = 6, [X86_CMP] = 7,
+};
+
+static const uint8_t x86_unary_digits[X86_OP_COUNT] = {
+    [X86_NOT] = 2, [X86_NEG] = 3, [X86_DIV] = 6, [X86_IDIV] = 7,
+};
+
+static const uint8_t x86_shift_digits[X86_OP_COUNT] = {
+    [X86_SHL] = 4, [X86_SHR] = 5, [X86_SAR] = 7,
+};
+
+void x86_function_init(struct x86_function *f) {
+    memset(f, 0, sizeof(*f));
+}
+
+void x86_function_free(struct x86_function *f) {
+    free(f->insts);
+    free(f->bytes);
+    free(f->layout);
+    free(f->labels);
+}
+
+void x86_function_reset(struct x86_function *f) {
+    f->count = 0;
+    f->label_count = 0;
+}
+
+// Grows the array at `*items` of `*capacity` elements of `size` bytes to
+// hold at least `needed` of them.
+static void *x86_reserve(void *items, uint32_t *capacity, uint32_t needed,
+                         size_t size) {
+    if (needed <= *capacity) return items;
+    uint32_t grown = *capacity ? *capacity * 2 : 64;
+    while (grown < needed) grown *= 2;
+    *capacity = grown;
+    return realloc(items, grown * size);
+}
+
+uint32_t x86_new_label(struct x86_function *f) {
+    return f->label_count++;
+}
+
+struct x86_inst *x86_emit(struct x86_function *f, int op, int size,
+                          struct x86_operand dst, struct x86_operand src) {
+    f->insts = x86_reserve(f->insts, &f->capacity, f->count + 1,
+                           sizeof(struct x86_inst));
+    struct x86_inst *inst = &f->insts[f->count++];
+    *inst = (struct x86_inst){.op = op, .size = size, .dst = dst, .src = src};
+    return inst;
+}
+
+static void x86_byte(struct x86_code *c, uint8_t byte) {
+    c->bytes[c->length++] = byte;
+}
+
+static void x86_imm_bytes(struct x86_code *c, int64_t value, int size) {
+    for (int i = 0; i < size; i++) x86_byte(c, (uint64_t)value >> (i * 8));
+}
+
+static bool x86_fits8(int64_t value) {
+    return value >= INT8_MIN && value <= INT8_MAX;
+}
+
+static bool x86_fits32(int64_t value) {
+    return value >= INT32_MIN && value <= INT32_MAX;
+}
+
+// Size of the immediate of an instruction of `size` bytes, they're at most
+// 32 bits and sign extended to 64.
+static int x86_imm_size(int size) {
+    return size == 8 ? 4 : size;
+}
+
+// Emits the prefixes and opcode of an instruction with the register field
+// `reg` and the operand `rm`. `byte_reg` and `byte_rm` tell whether they are
+// byte registers, spl to dil need a REX prefix to be told from ah to bh.
+// Opcodes above 0xff are two bytes, 0x0f and the low byte.
+static void x86_prefix(struct x86_code *c, int size, unsigned opcode, int reg,
+                       const struct x86_operand *rm, bool byte_reg,
+                       bool byte_rm) {
+    if (size == 2) x86_byte(c, 0x66);
+    uint8_t rex = size == 8 ? 0x48 : 0;
+    if (reg >= 8) rex |= 0x44;
+    if (byte_reg && reg >= 4 && reg < 8) rex |= 0x40;
+    if (rm->kind == X86_OPERAND_REG) {
+        if (rm->base >= 8) rex |= 0x41;
+        if (byte_rm && rm->base >= 4 && rm->base < 8) rex |= 0x40;
+    } else if (rm->kind == X86_OPERAND_MEM) {
+        if (rm->base != X86_NO_REG && rm->base >= 8) rex |= 0x41;
+        if (rm->index != X86_NO_REG && rm->index >= 8) rex |= 0x42;
+    }
+    if (rex) x86_byte(c, rex);
+    if (opcode > 0xff) x86_byte(c, opcode >> 8);
+    x86_byte(c, opcode);
+}
+
+// Emits the ModRM byte, SIB and displacement addressing `rm`.
+static void x86_modrm(struct x86_code *c, int reg, const struct x86_operand *rm) {
+    reg &= 7;
+    if (rm->kind == X86_OPERAND_REG) {
+        x86_byte(c, 0xc0 | reg << 3 | (rm->base & 7));
+        return;
+    }
+    if (rm->kind != X86_OPERAND_MEM) {
+        // rip relative, the relocation fills the displacement.
+        x86_byte(c, reg << 3 | 5);
+        c->reloc = c->length;
+        x86_imm_bytes(c, 0, 4);
+        return;
+    }
+    int base = rm->base & 7;
+    bool sib = rm->index != X86_NO_REG || base == X86_RSP;
+    // rbp and r13 have no form without a displacement.
+    int mod = rm->disp == 0 && base != X86_RBP ? 0 : x86_fits8(rm->disp) ? 1 : 2;
+    x86_byte(c, mod << 6 | reg << 3 | (sib ? 4 : base));
+    if (sib) {
+        static const uint8_t scales[9] = {[1] = 0, [2] = 1, [4] = 2, [8] = 3};
+        int index = rm->index == X86_NO_REG ? 4 : rm->index & 7;
+        int scale = rm->index == X86_NO_REG ? 0 : scales[rm->scale];
+        x86_byte(c, scale << 6 | index << 3 | base);
+    }
+    if (mod == 1) x86_byte(c, rm->disp);
+    if (mod == 2) x86_imm_bytes(c, rm->disp, 4);
+}
+
+static void x86_rm(struct x86_code *c, int size, unsigned opcode, int reg,
+                   const struct x86_operand *rm, bool byte_reg, bool byte_rm) {
+    x86_prefix(c, size, opcode, reg, rm, byte_reg, byte_rm);
+    x86_modrm(c, reg, rm);
+}
+
+// Instruction with a register field and a register or memory operand, the
+// register one being either operand.
+static void x86_rm_pair(struct x86_code *c, const struct x86_inst *inst,
+                        unsigned to_rm, unsigned to_reg) {
+    bool byte = inst->size == 1;
+    if (inst->src.kind == X86_OPERAND_REG)
+        x86_rm(c, inst->size, to_rm - byte, inst->src.base, &inst->dst, byte,
+               byte);
+    else
+        x86_rm(c, inst->size, to_reg - byte, inst->dst.base, &inst->src, byte,
+               byte);
+}
+
+static void x86_encode_mov(struct x86_code *c, const struct x86_inst *inst) {
+    const struct x86_operand *dst = &inst->dst;
+    int64_t value = inst->src.value;
+    int size = inst->size;
+    if (inst->src.kind != X86_OPERAND_IMM) {
+        x86_rm_pair(c, inst, 0x89, 0x8b);
+        return;
+    }
+    if (dst->kind == X86_OPERAND_REG) {
+        // a 32-bit move clears the upper half, movabs only when needed.
+        if (size == 8 && !x86_fits32(value) && (uint64_t)value <= UINT32_MAX)
+            size = 4;
+        if (size != 8 || !x86_fits32(value)) {
+            // the register is in the opcode, B8+r with an immediate of the
+            // operation's size.
+            uint8_t rex = size == 8 ? 0x48 : 0;
+            if (dst->base >= 8) rex |= 0x41;
+            if (size == 1 && dst->base >= 4 && dst->base < 8) rex |= 0x40;
+            if (size == 2) x86_byte(c, 0x66);
+            if (rex) x86_byte(c, rex);
+            x86_byte(c, (size == 1 ? 0xb0 : 0xb8) + (dst->base & 7));
+            x86_imm_bytes(c, value, size);
+            return;
+        }
+    }
+    x86_rm(c, size, size == 1 ? 0xc6 : 0xc7, 0, dst, false, true);
+    x86_imm_bytes(c, value, x86_imm_size(size));
+}
+
+static void x86_encode_alu(struct x86_code *c, const struct x86_inst *inst) {
+    int digit = x86_alu_digits[inst->op];
+    if (inst->src.kind != X86_OPERAND_IMM) {
+        x86_rm_pair(c, inst, digit * 8 + 1, digit * 8 + 3);
+        return;
+    }
+    int64_t value = inst->src.value;
+    // the accumulator has a form without ModRM when the immediate is long.
+    bool acc = inst->dst.kind == X86_OPERAND_REG && inst->dst.base == X86_RAX;
+    if (acc && (inst->size == 1 || !x86_fits8(value))) {
+        if (inst->size == 2) x86_byte(c, 0x66);
+        if (inst->size == 8) x86_byte(c, 0x48);
+        x86_byte(c, digit * 8 + (inst->size == 1 ? 4 : 5));
+        x86_imm_bytes(c, value, x86_imm_size(inst->size));
+    } else if (inst->size == 1) {
+        x86_rm(c, 1, 0x80, digit, &inst->dst, false, true);
+        x86_byte(c, value);
+    } else if (x86_fits8(value)) {
+        x86_rm(c, inst->size, 0x83, digit, &inst->dst, false, false);
+        x86_byte(c, value);
+    } else {
+        x86_rm(c, inst->size, 0x81, digit, &inst->dst, false, false);
+        x86_imm_bytes(c, value, x86_imm_size(inst->size));
+    }
+}
+
+// Encodes every instruction but the jumps to labels, which x86_assemble
+// lays out itself.
+static void x86_encode(struct x86_code *c, const struct x86_inst *inst) {
+    const struct x86_operand *dst = &inst->dst, *src = &inst->src;
+    int size = inst->size;
+    bool byte = size == 1;
+    c->length = 0;
+    c->reloc = 0;
+    switch (inst->op) {
+    case X86_LABEL:
+        break;
+    case X86_CASE:
+        // filled in by x86_assemble once the labels are laid out.
+        x86_imm_bytes(c, 0, 4);
+        break;
+    case X86_MOV:
+        x86_encode_mov(c, inst);
+        break;
+    case X86_MOVSX:
+        if (inst->src_size == 4)
+            x86_rm(c, size, 0x63, dst->base, src, false, false);
+        else
+            x86_rm(c, size, inst->src_size == 1 ? 0x0fbe : 0x0fbf, dst->base,
+                   src, false, inst->src_size == 1);
+        break;
+    case X86_MOVZX:
+        // writing the 32-bit register zero extends to 64 bits already.
+        if (inst->src_size == 4)
+            x86_rm(c, 4, 0x8b, dst->base, src, false, false);
+        else
+            x86_rm(c, size, inst->src_size == 1 ? 0x0fb6 : 0x0fb7, dst->base,
+                   src, false, inst->src_size == 1);
+        break;
+    case X86_LEA:
+        x86_rm(c, size, 0x8d, dst->base, src, false, false);
+        break;
+    case X86_ADD:
+    case X86_OR:
+    case X86_AND:
+    case X86_SUB:
+    case X86_XOR:
+    case X86_CMP:
+        x86_encode_alu(c, inst);
+        break;
+    case X86_TEST:
+        if (src->kind == X86_OPERAND_IMM) {
+            if (dst->kind == X86_OPERAND_REG && dst->base == X86_RAX) {
+                if (size == 2) x86_byte(c, 0x66);
+                if (size == 8) x86_byte(c, 0x48);
+                x86_byte(c, byte ? 0xa8 : 0xa9);
+            } else {
+                x86_rm(c, size, byte ? 0xf6 : 0xf7, 0, dst, false, byte);
+            }
+            x86_imm_bytes(c, src->value, x86_imm_size(size));
+        } else {
+            // test is symmetric, the register goes in the reg field.
+            const struct x86_operand *reg = src, *rm = dst;
+            if (src->kind != X86_OPERAND_REG) reg = dst, rm = src;
+            x86_rm(c, size, byte ? 0x84 : 0x85, reg->base, rm, byte, byte);
+        }
+        break;
+    case X86_BT:
+        x86_rm(c, size, 0x0fa3, src->base, dst, false, false);
+        break;
+    case X86_IMUL:
+        if (src->kind == X86_OPERAND_IMM) {
+            bool short_imm = x86_fits8(src->value);
+            x86_rm(c, size, short_imm ? 0x6b : 0x69, dst->base, dst, false,
+                   false);
+            x86_imm_bytes(c, src->value, short_imm ? 1 : x86_imm_size(size));
+        } else {
+            x86_rm(c, size, 0x0faf, dst->base, src, false, false);
+        }
+        break;
+    case X86_NOT:
+    case X86_NEG:
+    case X86_DIV:
+    case X86_IDIV:
+        x86_rm(c, size, byte ? 0xf6 : 0xf7, x86_unary_digits[inst->op], dst,
+               false, byte);
+        break;
+    case X86_SHL:
+    case X86_SHR:
+    case X86_SAR: {
+        int digit = x86_shift_digits[inst->op];
+        if (src->kind == X86_OPERAND_REG) {
+            x86_rm(c, size, byte ? 0xd2 : 0xd3, digit, dst, false, byte);
+        } else if (src->value == 1) {
+            x86_rm(c, size, byte ? 0xd0 : 0xd1, digit, dst, false, byte);
+        } else {
+            x86_rm(c, size, byte ? 0xc0 : 0xc1, digit, dst, false, byte);
+            x86_byte(c, src->value);
+        }
+        break;
+    }
+    case X86_CQO:
+        if (size == 2) x86_byte(c, 0x66);
+        if (size == 8) x86_byte(c, 0x48);
+        x86_byte(c, 0x99);
+        break;
+    case X86_SETCC:
+        x86_rm(c, 1, 0x0f90 + inst->cond, 0, dst, false, true);
+        break;
+    case X86_JMP:
+    case X86_CALL:
+        if (dst->kind == X86_OPERAND_SYMBOL) {
+            x86_byte(c, inst->op == X86_CALL ? 0xe8 : 0xe9);
+            c->reloc = c->length;
+            x86_imm_bytes(c, 0, 4);
+        } else {
+            // the operand size of indirect jumps and calls is 64 bits.
+            x86_rm(c, 4, 0xff, inst->op == X86_CALL ? 2 : 4, dst, false, false);
+        }
+        break;
+    case X86_RET:
+        x86_byte(c, 0xc3);
+        break;
+    case X86_LEAVE:
+        x86_byte(c, 0xc9);
+        break;
+    case X86_PUSH:
+    case X86_POP:
+        if (dst->kind == X86_OPERAND_IMM) {
+            bool short_imm = x86_fits8(dst->value);
+            x86_byte(c, short_imm ? 0x6a : 0x68);
+            x86_imm_bytes(c, dst->value, short_imm ? 1 : 4);
+            break;
+        }
+        if (dst->base >= 8) x86_byte(c, 0x41);
+        x86_byte(c, (inst->op == X86_PUSH ? 0x50 : 0x58) + (dst->base & 7));
+        break;
+    }
+}
+
+static bool x86_is_label_jump(const struct x86_inst *inst) {
+    return (inst->op == X86_JMP || inst->op == X86_JCC) &&
+           inst->dst.kind == X86_OPERAND_LABEL;
+}
+
+// Relocation of the symbol operand of `inst`.
+static const struct x86_operand *x86_reloc_operand(const struct x86_inst *inst,
+                                                   uint32_t *type) {
+    const struct x86_operand *o = &inst->dst;
+    if (o->kind != X86_OPERAND_SYMBOL && o->kind != X86_OPERAND_GOT)
+        o = &inst->src;
+    // the relaxable GOT loads let the linker turn them into a lea when the
+    // symbol ends up in the executable.
+    if (o->kind == X86_OPERAND_GOT && inst->op == X86_MOV && inst->size == 8)
+        *type = R_X86_64_REX_GOTPCRELX;
+    else if (o->kind == X86_OPERAND_GOT &&
+             (inst->op == X86_CALL || inst->op == X86_JMP))
+        *type = R_X86_64_GOTPCRELX;
+    else if (o->kind == X86_OPERAND_GOT)
+        *type = R_X86_64_GOTPCREL;
+    else if ((inst->op == X86_CALL || inst->op == X86_JMP) && o == &inst->dst)
+        *type = R_X86_64_PLT32;
+    else
+        *type = R_X86_64_PC32;
+    return o;
+}
+
+uint32_t x86_assemble(struct x86_function *f, struct object *object,
+                      int section) {
+    f->layout = x86_reserve(f->layout, &f->layout_capacity, f->count,
+                            sizeof(struct x86_layout));
+    f->labels = x86_reserve(f->labels, &f->labels_capacity, f->label_count,
+                            sizeof(uint32_t));
+
+    // encodes everything once, jumps to labels start out short.
+    f->byte_count = 0;
+    for (uint32_t i = 0; i < f->count; i++) {
+        struct x86_inst *inst = &f->insts[i];
+        struct x86_layout *layout = &f->layout[i];
+        layout->start = f->byte_count;
+        if (x86_is_label_jump(inst)) {
+            layout->length = 2;
+            layout->reloc = 0;
+            continue;
+        }
+        struct x86_code code;
+        x86_encode(&code, inst);
+        f->bytes = x86_reserve(f->bytes, &f->byte_capacity,
+                               f->byte_count + code.length, 1);
+        memcpy(f->bytes + f->byte_count, code.bytes, code.length);
+        f->byte_count += code.length;
+        layout->length = code.length;
+        layout->reloc = code.reloc;
+    }
+
+    // lays out the function and lengthens the jumps whose target is out of
+    // reach, until all of them reach. Jumps only grow, which ends it.
+    uint32_t size;
+    for (bool changed = true; changed;) {
+        changed = false;
+        size = 0;
+        for (uint32_t i = 0; i < f->count; i++) {
+            f->layout[i].offset = size;
+            if (f->insts[i].op == X86_LABEL)
+                f->labels[f->insts[i].dst.value] = size;
+            size += f->layout[i].length;
+        }
+        for (uint32_t i = 0; i < f->count; i++) {
+            struct x86_layout *layout = &f->layout[i];
+            if (!x86_is_label_jump(&f->insts[i]) || layout->length != 2)
+                continue;
+            int64_t disp = (int64_t)f->labels[f->insts[i].dst.value] -
+                           (layout->offset + 2);
+            if (x86_fits8(disp)) continue;
+            layout->length = f->insts[i].op == X86_JMP ? 5 : 6;
+            changed = true;
+        }
+    }
+
+    uint32_t start = object_append(object, section, NULL, size, 16);
+    uint8_t *out = object_data(object, section, start);
+    for (uint32_t i = 0; i < f->count; i++) {
+        struct x86_inst *inst = &f->insts[i];
+        struct x86_layout *layout = &f->layout[i];
+        uint8_t *at = out + layout->offset;
+        if (x86_is_label_jump(inst)) {
+            int32_t disp = (int32_t)(f->labels[inst->dst.value] -
+                                     (layout->offset + layout->length));
+            if (layout->length == 2) {
+                at[0] = inst->op == X86_JMP ? 0xeb : 0x70 + inst->cond;
+                at[1] = disp;
+                continue;
+            }
+            if (inst->op == X86_JMP) {
+                *at++ = 0xe9;
+            } else {
+                *at++ = 0x0f;
+                *at++ = 0x80 + inst->cond;
+            }
+            memcpy(at, &disp, 4);
+            continue;
+        }
+        if (inst->op == X86_CASE) {
+            int32_t entry = (int32_t)(f->labels[inst->dst.value] -
+                                      f->labels[inst->src.value]);
+            memcpy(at, &entry, 4);
+            continue;
+        }
+        memcpy(at, f->bytes + layout->start, layout->length);
+        if (!layout->reloc) continue;
+        // rip is past the instruction, immediates may follow the field.
+        uint32_t type;
+        const struct x86_operand *o = x86_reloc_operand(inst, &type);
+        // the address of a label of the function needs no relocation.
+        if (o->kind == X86_OPERAND_LABEL) {
+            int32_t disp = (int32_t)(f->labels[o->value] -
+                                     (layout->offset + layout->length));
+            memcpy(at + layout->reloc, &disp, 4);
+            continue;
+        }
+        object_reloc(object, section, start + layout->offset + layout->reloc,
+                     o->value, type,
+                     (int64_t)o->disp - (layout->length - layout->reloc));
+    }
+    return start;
+}
+
+static const char *x86_register_names[4][X86_REGISTER_COUNT] = {
+    {"al", "cl", "dl", "bl", "spl", "bpl", "sil", "dil", "r8b", "r9b", "r10b",
+     "r11b", "r12b", "r13b", "r14b", "r15b"},
+    {"ax", "cx", "dx", "bx", "sp", "bp", "si", "di", "r8w", "r9w", "r10w",
+     "r11w", "r12w", "r13w", "r14w", "r15w"},
+    {"eax", "ecx", "edx", "ebx", "esp", "ebp", "esi", "edi", "r8d", "r9d",
+     "r10d", "r11d", "r12d", "r13d", "r14d", "r15d"},
+    {"rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi", "r8", "r9", "r10",
+     "r11", "r12", "r13", "r14", "r15"},
+};
+
+static const char *x86_op_names[X86_OP_COUNT] = {
+    [X86_MOV] = "mov",   [X86_MOVSX] = "movsx", [X86_MOVZX] = "movzx",
+    [X86_LEA] = "lea",   [X86_ADD] = "add",     [X86_OR] = "or",
+    [X86_AND] = "and",   [X86_SUB] = "sub",     [X86_XOR] = "xor",
+    [X86_CMP] = "cmp",   [X86_TEST] = "test",   [X86_IMUL] = "imul",
+    [X86_BT] = "bt",
+    [X86_NOT] = "not",   [X86_NEG] = "neg",     [X86_DIV] = "div",
+    [X86_IDIV] = "idiv", [X86_SHL] = "shl",     [X86_SHR] = "shr",
+    [X86_SAR] = "sar",   [X86_JMP] = "jmp",     [X86_CALL] = "call",
+    [X86_RET] = "ret",   [X86_LEAVE] = "leave", [X86_PUSH] = "push",
+    [X86_POP] = "pop",
+};
+
+static const char *x86_condition_names[16] = {
+    "o", "no", "b", "ae", "e", "ne", "be", "a",
+    "s", "ns", "p", "np", "l", "ge", "le", "g",
+};
+
+static const char *x86_register_name(int reg, int size) {
+    static const uint8_t rows[9] = {[1] = 0, [2] = 1, [4] = 2, [8] = 3};
+    return x86_register_names[rows[size]][reg];
+}
+
+static void x86_print_operand(const struct x86_operand *o, int size,
+                              struct object *object, const char *name,
+                              bool sized, FILE *out) {
+    static const char *ptr[9] = {[1] = "BYTE", [2] = "WORD", [4] = "DWORD",
+                                 [8] = "QWORD"};
+    switch (o->kind) {
+    case X86_OPERAND_REG:
+        fputs(x86_register_name(o->base, size), out);
+        return;
+    case X86_OPERAND_IMM:
+        fprintf(out, "%" PRId64, o->value);
+        return;
+    case X86_OPERAND_LABEL:
+        fprintf(out, ".L%s.%" PRId64, name, o->value);
+        return;
+    }
+    if (sized) fprintf(out, "%s PTR ", ptr[size]);
+    if (o->kind == X86_OPERAND_GOT) {
+        fprintf(out, "[rip + %s@GOTPCREL]",
+                object_symbol_name(object, o->value));
+        return;
+    }
+    if (o->kind == X86_OPERAND_SYMBOL) {
+        fprintf(out, "[rip + %s", object_symbol_name(object, o->value));
+    } else {
+        fprintf(out, "[%s", x86_register_names[3][o->base]);
+        if (o->index != X86_NO_REG)
+            fprintf(out, " + %s*%d", x86_register_names[3][o->index], o->scale);
+    }
+    if (o->disp) fprintf(out, " %c %d", o->disp < 0 ? '-' : '+',
+                         o->disp < 0 ? -o->disp : o->disp);
+    fputc(']', out);
+}
+
+void x86_print(struct x86_function *f, struct object *object,
+               const char *name, FILE *out) {
+    fprintf(out, "%s:\n", name);
+    for (uint32_t i = 0; i < f->count; i++) {
+        struct x86_inst *inst = &f->insts[i];
+        const struct x86_operand *dst = &inst->dst, *src = &inst->src;
+        int size = inst->size, src_size = size;
+        switch (inst->op) {
+        case X86_LABEL:
+            fprintf(out, ".L%s.%" PRId64 ":\n", name, dst->value);
+            continue;
+        case X86_CASE:
+            fprintf(out, "\t.long .L%s.%" PRId64 " - .L%s.%" PRId64 "\n", name,
+                    dst->value, name, src->value);
+            continue;
+        case X86_CQO:
+            fprintf(out, "\t%s\n", size == 8 ? "cqo" : size == 4 ? "cdq" : "cwd");
+            continue;
+        case X86_SETCC:
+            fprintf(out, "\tset%s ", x86_condition_names[inst->cond]);
+            x86_print_operand(dst, 1, object, name, true, out);
+            fputc('\n', out);
+            continue;
+        case X86_JCC:
+            fprintf(out, "\tj%s ", x86_condition_names[inst->cond]);
+            x86_print_operand(dst, 8, object, name, false, out);
+            fputc('\n', out);
+            continue;
+        case X86_JMP:
+        case X86_CALL:
+            fprintf(out, "\t%s ", x86_op_names[inst->op]);
+            if (dst->kind == X86_OPERAND_SYMBOL)
+                fprintf(out, "%s@PLT", object_symbol_name(object, dst->value));
+            else
+                x86_print_operand(dst, 8, object, name, true, out);
+            fputc('\n', out);
+            continue;
+        case X86_PUSH:
+        case X86_POP:
+            size = 8;
+            break;
+        case X86_MOV:
+            // printed as encoded, see x86_encode_mov.
+            if (size == 8 && src->kind == X86_OPERAND_IMM &&
+                dst->kind == X86_OPERAND_REG && !x86_fits32(src->value) &&
+                (uint64_t)src->value <= UINT32_MAX)
+                size = src_size = 4;
+            break;
+        case X86_MOVSX:
+        case X86_MOVZX:
+            src_size = inst->src_size;
+            if (src_size == 4) {
+                // movsxd, and a 32-bit mov zero extending.
+                fputs(inst->op == X86_MOVSX ? "\tmovsxd " : "\tmov ", out);
+                x86_print_operand(dst, inst->op == X86_MOVSX ? size : 4, object,
+                                  name, true, out);
+                fputs(", ", out);
+                x86_print_operand(src, 4, object, name, true, out);
+                fputc('\n', out);
+                continue;
+            }
+            break;
+        case X86_SHL:
+        case X86_SHR:
+        case X86_SAR:
+            src_size = 1;
+            break;
+        case X86_LEA:
+            if (src->kind == X86_OPERAND_LABEL) {
+                fputs("\tlea ", out);
+                x86_print_operand(dst, size, object, name, true, out);
+                fprintf(out, ", [rip + .L%s.%" PRId64 "]\n", name, src->value);
+                continue;
+            }
+            src_size = 8;
+            break;
+        }
+        fprintf(out, "\t%s", x86_op_names[inst->op]);
+        if (dst->kind != X86_OPERAND_NONE) {
+            fputc(' ', out);
+            x86_print_operand(dst, size, object, name, true, out);
+        }
+        if (src->kind != X86_OPERAND_NONE) {
+            fputs(", ", out);
+            x86_print_operand(src, src_size, object, name,
+                              inst->op != X86_LEA, out);
+        }
+        fputc('\n', out);
+    }
+}
@@ -0,0 +1,226 @@
+#ifndef PEACHX86_H
+#define PEACHX86_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+struct object;
+
+// x86-64 machine instructions of one function, encoded straight into the
+// sections of an object file without going through an assembler. The code
+// generator appends instructions to an x86_function, x86_assemble lays them
+// out, picks the shortest form of every jump and encodes them.
+
+// Registers, numbered as in their encoding.
+enum {
+    X86_RAX,
+    X86_RCX,
+    X86_RDX,
+    X86_RBX,
+    X86_RSP,
+    X86_RBP,
+    X86_RSI,
+    X86_RDI,
+    X86_R8,
+    X86_R9,
+    X86_R10,
+    X86_R11,
+    X86_R12,
+    X86_R13,
+    X86_R14,
+    X86_R15,
+    X86_REGISTER_COUNT,
+    // memory operand without an index register.
+    X86_NO_REG = 0xff,
+};
+
+// Condition codes, numbered as in their encoding.
+enum {
+    X86_CC_O,
+    X86_CC_NO,
+    X86_CC_B,
+    X86_CC_AE,
+    X86_CC_E,
+    X86_CC_NE,
+    X86_CC_BE,
+    X86_CC_A,
+    X86_CC_S,
+    X86_CC_NS,
+    X86_CC_P,
+    X86_CC_NP,
+    X86_CC_L,
+    X86_CC_GE,
+    X86_CC_LE,
+    X86_CC_G,
+};
+
+// Opcodes, see x86_inst. Two operand instructions compute `dst` op `src`
+// into `dst` as in Intel syntax.
+enum {
+    X86_NONE,
+    // pseudo instruction placing label `dst`.
+    X86_LABEL,
+    // pseudo instruction, the 32-bit entry of a jump table: the offset of
+    // label `dst` from label `src`.
+    X86_CASE,
+
+    X86_MOV,
+    // `src` of x86_inst::src_size bytes extended to `dst`.
+    X86_MOVSX,
+    X86_MOVZX,
+    X86_LEA,
+    X86_ADD,
+    X86_OR,
+    X86_AND,
+    X86_SUB,
+    X86_XOR,
+    X86_CMP,
+    X86_TEST,
+    // copies bit `src` of `dst` to the carry flag.
+    X86_BT,
+    X86_IMUL,
+    // single operand `dst`.
+    X86_NOT,
+    X86_NEG,
+    X86_DIV,
+    X86_IDIV,
+    // `dst` shifted by `src`, cl or an immediate.
+    X86_SHL,
+    X86_SHR,
+    X86_SAR,
+    // sign extends rax into rdx, cwd, cdq or cqo by size.
+    X86_CQO,
+    // sets the byte `dst` to the condition x86_inst::cond.
+    X86_SETCC,
+    // jump to the label or address `dst`.
+    X86_JMP,
+    X86_JCC,
+    // call of the symbol or address `dst`.
+    X86_CALL,
+    X86_RET,
+    X86_LEAVE,
+    X86_PUSH,
+    X86_POP,
+
+    X86_OP_COUNT
+};
+
+// Kinds of x86_operand.
+enum {
+    X86_OPERAND_NONE,
+    // register `base`.
+    X86_OPERAND_REG,
+    // the immediate `value`.
+    X86_OPERAND_IMM,
+    // memory at `base` + `index` * `scale` + `disp`.
+    X86_OPERAND_MEM,
+    // label `value` of the function. Memory at the label, addressed relative
+    // to rip, for X86_LEA.
+    X86_OPERAND_LABEL,
+    // memory at symbol `value` + `disp`, addressed relative to rip. Calls of
+    // a symbol call it directly.
+    X86_OPERAND_SYMBOL,
+    // memory holding the address of symbol `value`, its GOT entry.
+    X86_OPERAND_GOT,
+};
+
+struct x86_operand {
+    uint8_t kind;
+    uint8_t base;
+    uint8_t index;
+    uint8_t scale;
+    int32_t disp;
+    int64_t value;
+};
+
+struct x86_inst {
+    uint8_t op;
+    // size of the operation in bytes: 1, 2, 4 or 8.
+    uint8_t size;
+    // size of the source of X86_MOVSX and X86_MOVZX.
+    uint8_t src_size;
+    // condition of X86_SETCC and X86_JCC.
+    uint8_t cond;
+    struct x86_operand dst;
+    struct x86_operand src;
+};
+
+// Instructions of the function being generated. Reset and reused for every
+// function, like ir_function.
+struct x86_function {
+    struct x86_inst *insts;
+    uint32_t count;
+    uint32_t capacity;
+    uint32_t label_count;
+
+    // scratch of x86_assemble: encoded bytes, and the offset, length, first
+    // byte and relocated field of every instruction.
+    uint8_t *bytes;
+    uint32_t byte_count;
+    uint32_t byte_capacity;
+    struct x86_layout {
+        uint32_t offset;
+        uint32_t start;
+        uint8_t length;
+        uint8_t reloc;
+    } *layout;
+    uint32_t layout_capacity;
+    // offset of each label, or the index of its instruction for
+    // x86_peephole.
+    uint32_t *labels;
+    uint32_t labels_capacity;
+};
+
+void x86_function_init(struct x86_function *f);
+void x86_function_free(struct x86_function *f);
+void x86_function_reset(struct x86_function *f);
+
+static inline struct x86_operand x86_reg(int reg) {
+    return (struct x86_operand){.kind = X86_OPERAND_REG, .base = reg};
+}
+
+static inline struct x86_operand x86_imm(int64_t value) {
+    return (struct x86_operand){.kind = X86_OPERAND_IMM, .value = value};
+}
+
+static inline struct x86_operand x86_mem(int base, int32_t disp) {
+    return (struct x86_operand){
+        .kind = X86_OPERAND_MEM, .base = base, .index = X86_NO_REG, .disp = disp};
+}
+
+static inline struct x86_operand x86_label(uint32_t label) {
+    return (struct x86_operand){.kind = X86_OPERAND_LABEL, .value = label};
+}
+
+static inline struct x86_operand x86_symbol(uint32_t symbol, int32_t addend) {
+    return (struct x86_operand){
+        .kind = X86_OPERAND_SYMBOL, .disp = addend, .value = symbol};
+}
+
+static inline struct x86_operand x86_got(uint32_t symbol) {
+    return (struct x86_operand){.kind = X86_OPERAND_GOT, .value = symbol};
+}
+
+// Returns a new label of the function.
+uint32_t x86_new_label(struct x86_function *f);
+
+// Appends an instruction and returns it, the caller may set its other
+// fields.
+struct x86_inst *x86_emit(struct x86_function *f, int op, int size,
+                          struct x86_operand dst, struct x86_operand src);
+
+// Rewrites the instructions of the function into cheaper ones doing the
+// same, see x86_peephole.c.
+void x86_peephole(struct x86_function *f);
+
+// Encodes the function at the end of the section `section` of `object`,
+// its relocations included, and returns the offset it starts at.
+uint32_t x86_assemble(struct x86_function *f, struct object *object,
+                      int section);
+
+// Prints the function in Intel syntax as GNU as reads it, for debugging.
+// Symbols are named after those of `object`.
+void x86_print(struct x86_function *f, struct object *object,
+               const char *name, FILE *out);
+
+#endif  // PEACHX86_H
@@ -0,0 +1,255 @@
+#include "x86.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+// Peephole optimization of the instructions of a function before they're
+// assembled, the last step of -O1. Every instruction is looked up in a table
+// of rules by opcode; a rule looks at the instruction and the few after it,
+// rewrites them and deletes those it makes useless by turning them into
+// X86_NONE. The function is compacted once every rule ran.
+//
+// The scans of the rules are bounded, so the pass is linear. The code
+// generator never leaves the flags set for another block: they're dead at
+// labels, jumps, calls and returns, and until an instruction writes them
+// again.
+
+// Longest scans of the rules.
+enum {
+    // instructions looked at for what reads the flags next.
+    X86_PEEPHOLE_WINDOW = 16,
+    // jumps to jumps followed by a jump.
+    X86_PEEPHOLE_HOPS = 8,
+};
+
+// Index of the first instruction after `i` which isn't deleted, f->count if
+// there is none.
+static uint32_t x86_peephole_next(struct x86_function *f, uint32_t i) {
+    do i++;
+    while (i < f->count && f->insts[i].op == X86_NONE);
+    return i;
+}
+
+static bool x86_peephole_same(const struct x86_operand *a,
+                              const struct x86_operand *b) {
+    return a->kind == b->kind && a->base == b->base && a->index == b->index &&
+           a->scale == b->scale && a->disp == b->disp && a->value == b->value;
+}
+
+// True if the address of the memory operand `o` depends on `reg`.
+static bool x86_peephole_addresses(const struct x86_operand *o, int reg) {
+    return o->kind == X86_OPERAND_MEM && (o->base == reg || o->index == reg);
+}
+
+static bool x86_peephole_is_zero(const struct x86_operand *o) {
+    return o->kind == X86_OPERAND_IMM && o->value == 0;
+}
+
+// True if nothing reads the flags before they're written again after `i`.
+static bool x86_peephole_flags_dead(struct x86_function *f, uint32_t i) {
+    for (uint32_t n = 0; n < X86_PEEPHOLE_WINDOW; n++) {
+        i = x86_peephole_next(f, i);
+        if (i == f->count) return true;
+        struct x86_inst *inst = &f->insts[i];
+        switch (inst->op) {
+        case X86_JCC:
+        case X86_SETCC:
+            return false;
+        case X86_LABEL:
+        case X86_JMP:
+        case X86_CALL:
+        case X86_RET:
+        case X86_ADD:
+        case X86_OR:
+        case X86_AND:
+        case X86_SUB:
+        case X86_XOR:
+        case X86_CMP:
+        case X86_TEST:
+        case X86_BT:
+        case X86_IMUL:
+        case X86_NEG:
+        case X86_DIV:
+        case X86_IDIV:
+            return true;
+        case X86_SHL:
+        case X86_SHR:
+        case X86_SAR:
+            // a shift by 0 leaves them alone.
+            if (inst->src.kind == X86_OPERAND_IMM && inst->src.value) return true;
+            break;
+        }
+    }
+    return false;
+}
+
+// Index of the first instruction run at `label`, f->count if it's past the
+// end or too far to look.
+static uint32_t x86_peephole_at(struct x86_function *f, uint32_t label) {
+    uint32_t i = f->labels[label];
+    for (uint32_t n = 0; n < X86_PEEPHOLE_WINDOW && i < f->count; n++, i++)
+        if (f->insts[i].op != X86_LABEL && f->insts[i].op != X86_NONE) return i;
+    return f->count;
+}
+
+// True if `label` is placed right after the instruction `i`, with only
+// labels in between.
+static bool x86_peephole_falls_to(struct x86_function *f, uint32_t i,
+                                  uint32_t label) {
+    for (i = x86_peephole_next(f, i); i < f->count; i = x86_peephole_next(f, i)) {
+        if (f->insts[i].op != X86_LABEL) return false;
+        if (f->insts[i].dst.value == label) return true;
+    }
+    return false;
+}
+
+// Sends the jump `inst` straight to where the jumps it leads to go.
+static void x86_peephole_thread(struct x86_function *f, struct x86_inst *inst) {
+    for (uint32_t hops = 0; hops < X86_PEEPHOLE_HOPS; hops++) {
+        uint32_t at = x86_peephole_at(f, inst->dst.value);
+        if (at == f->count) return;
+        struct x86_inst *jump = &f->insts[at];
+        if (jump->op != X86_JMP || jump->dst.kind != X86_OPERAND_LABEL ||
+            jump->dst.value == inst->dst.value)
+            return;
+        inst->dst = jump->dst;
+    }
+}
+
+// Nothing reaches the instructions after the jump or return `i` up to the
+// next label.
+static void x86_peephole_unreachable(struct x86_function *f, uint32_t i) {
+    for (i++; i < f->count && f->insts[i].op != X86_LABEL; i++)
+        f->insts[i].op = X86_NONE;
+}
+
+static void x86_peephole_mov(struct x86_function *f, uint32_t i) {
+    struct x86_inst *inst = &f->insts[i];
+    // a 32-bit move clears the upper half, it's only useless on 64 bits.
+    if (inst->size == 8 && x86_peephole_same(&inst->dst, &inst->src)) {
+        inst->op = X86_NONE;
+        return;
+    }
+    if (inst->size >= 4 && inst->dst.kind == X86_OPERAND_REG &&
+        x86_peephole_is_zero(&inst->src) && x86_peephole_flags_dead(f, i)) {
+        *inst = (struct x86_inst){.op = X86_XOR, .size = 4, .dst = inst->dst,
+                                  .src = inst->dst};
+        return;
+    }
+
+    uint32_t j = x86_peephole_next(f, i);
+    if (j == f->count) return;
+    struct x86_inst *after = &f->insts[j];
+    if (after->op != X86_MOV || after->size != inst->size || inst->size < 4)
+        return;
+    // a value moved back where it came from, which still addresses the same
+    // memory.
+    if (x86_peephole_same(&after->dst, &inst->src) &&
+        x86_peephole_same(&after->src, &inst->dst) &&
+        (after->size == 8 || after->dst.kind == X86_OPERAND_MEM) &&
+        !(inst->dst.kind == X86_OPERAND_REG &&
+          x86_peephole_addresses(&inst->src, inst->dst.base))) {
+        after->op = X86_NONE;
+        return;
+    }
+    // a value stored and loaded back is taken from where it was stored
+    // from.
+    if (inst->dst.kind == X86_OPERAND_MEM &&
+        (inst->src.kind == X86_OPERAND_REG || inst->src.kind == X86_OPERAND_IMM) &&
+        after->dst.kind == X86_OPERAND_REG &&
+        x86_peephole_same(&after->src, &inst->dst))
+        after->src = inst->src;
+}
+
+// Drops the operations of an identity operand, add 0, and -1 and the like.
+static void x86_peephole_identity(struct x86_function *f, uint32_t i) {
+    struct x86_inst *inst = &f->insts[i];
+    int64_t identity = inst->op == X86_AND ? -1 : 0;
+    // 32-bit operations clear the upper half.
+    if (inst->size == 8 && inst->src.kind == X86_OPERAND_IMM &&
+        inst->src.value == identity && x86_peephole_flags_dead(f, i))
+        inst->op = X86_NONE;
+}
+
+static void x86_peephole_imul(struct x86_function *f, uint32_t i) {
+    struct x86_inst *inst = &f->insts[i];
+    if (inst->src.kind != X86_OPERAND_IMM || inst->src.value <= 0 ||
+        (inst->src.value & (inst->src.value - 1)) ||
+        !x86_peephole_flags_dead(f, i))
+        return;
+    if (inst->src.value == 1) {
+        if (inst->size == 8) inst->op = X86_NONE;
+        return;
+    }
+    inst->op = X86_SHL;
+    inst->src.value = __builtin_ctzll(inst->src.value);
+}
+
+static void x86_peephole_jmp(struct x86_function *f, uint32_t i) {
+    struct x86_inst *inst = &f->insts[i];
+    if (inst->dst.kind == X86_OPERAND_LABEL) {
+        x86_peephole_thread(f, inst);
+        if (x86_peephole_falls_to(f, i, inst->dst.value)) {
+            inst->op = X86_NONE;
+            return;
+        }
+    }
+    x86_peephole_unreachable(f, i);
+}
+
+static void x86_peephole_jcc(struct x86_function *f, uint32_t i) {
+    struct x86_inst *inst = &f->insts[i];
+    x86_peephole_thread(f, inst);
+    if (x86_peephole_falls_to(f, i, inst->dst.value)) {
+        inst->op = X86_NONE;
+        return;
+    }
+    // jcc over a jump: the jump is taken on the opposite condition.
+    uint32_t j = x86_peephole_next(f, i);
+    if (j == f->count) return;
+    struct x86_inst *jump = &f->insts[j];
+    if (jump->op != X86_JMP || jump->dst.kind != X86_OPERAND_LABEL ||
+        !x86_peephole_falls_to(f, j, inst->dst.value))
+        return;
+    x86_peephole_thread(f, jump);
+    inst->cond ^= 1;
+    inst->dst = jump->dst;
+    jump->op = X86_NONE;
+}
+
+// An entry of a jump table goes where the jumps it leads to go too.
+static void x86_peephole_case(struct x86_function *f, uint32_t i) {
+    x86_peephole_thread(f, &f->insts[i]);
+}
+
+// Rule of each opcode.
+static void (*const x86_peephole_rules[X86_OP_COUNT])(struct x86_function *,
+                                                      uint32_t) = {
+    [X86_CASE] = x86_peephole_case,    [X86_MOV] = x86_peephole_mov,
+    [X86_ADD] = x86_peephole_identity, [X86_OR] = x86_peephole_identity,
+    [X86_AND] = x86_peephole_identity, [X86_SUB] = x86_peephole_identity,
+    [X86_XOR] = x86_peephole_identity, [X86_SHL] = x86_peephole_identity,
+    [X86_SHR] = x86_peephole_identity, [X86_SAR] = x86_peephole_identity,
+    [X86_IMUL] = x86_peephole_imul,    [X86_JMP] = x86_peephole_jmp,
+    [X86_JCC] = x86_peephole_jcc,      [X86_RET] = x86_peephole_unreachable,
+};
+
+void x86_peephole(struct x86_function *f) {
+    if (f->label_count > f->labels_capacity) {
+        f->labels_capacity = f->label_count * 2;
+        f->labels = realloc(f->labels, f->labels_capacity * sizeof(uint32_t));
+    }
+    for (uint32_t i = 0; i < f->count; i++)
+        if (f->insts[i].op == X86_LABEL) f->labels[f->insts[i].dst.value] = i;
+
+    for (uint32_t i = 0; i < f->count; i++) {
+        void (*rule)(struct x86_function *, uint32_t) =
+            x86_peephole_rules[f->insts[i].op];
+        if (rule) rule(f, i);
+    }
+
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < f->count; i++)
+        if (f->insts[i].op != X86_NONE) f->insts[count++] = f->insts[i];
+    f->count = count;
+}
@@ -1 +1,9 @@
-'\n' 'a'
+int square(int x) {
+    return x * x;
+}
+
+int main(void) {
+    int total = 0;
+    for (int i = 0; i < 10; i++) total += square(i);
+    return total == 285 ? 0 : 1;
+}
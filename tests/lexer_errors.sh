@@ -0,0 +1,31 @@
+#!/bin/sh
+# Each lexical error is reported with its own message.
+
+main="$(pwd)/main"
+dir=$(mktemp -d) || exit 1
+trap 'rm -rf "$dir"' EXIT
+status=0
+
+# expect <message> <source>
+expect() {
+    printf '%s\n' "$2" > "$dir/t.c"
+    if "$main" -o "$dir/t.o" "$dir/t.c" > "$dir/out"; then
+        echo "lexer_errors: '$2' compiled"
+        status=1
+    elif ! grep -qF "$1" "$dir/out"; then
+        echo "lexer_errors: '$2' didn't report '$1':"
+        cat "$dir/out"
+        status=1
+    fi
+}
+
+expect "Bracket closes a different kind of bracket, ']' does not close '('" \
+    'int main(void) { int a[3]; return (a[0]]; }'
+expect "Opening bracket at line: 1, col: 36" \
+    'int main(void) { int a[3]; return (a[0]]; }'
+expect "Invalid expression closure" 'int main(void) { return 0; }}'
+expect "Bracket not closed" 'int main(void) { return 0;'
+expect "String not closed" 'int main(void) { "abc; }'
+expect "Invalid numeric literal" 'int x = 08;'
+expect "Lexical analysis input error" 'int x = 1 \ 2;'
+exit $status
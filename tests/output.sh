@@ -0,0 +1,49 @@
+#!/bin/sh
+# The object replaces the file a symbolic link points to, keeps the mode of
+# the file it replaces and is written in place into a FIFO.
+
+main="$(pwd)/main"
+dir=$(mktemp -d) || exit 1
+trap 'rm -rf "$dir"' EXIT
+cd "$dir" || exit 1
+printf 'int main(void) { return 0; }\n' > t.c
+status=0
+
+fail() {
+    echo "output: $1"
+    status=1
+}
+
+echo old > real.o
+ln -s real.o link.o
+mkdir sub
+ln -s ../real.o sub/link.o
+"$main" -o link.o t.c || fail "compile through a link"
+[ -L link.o ] || fail "the link was replaced"
+[ "$(head -c 4 real.o | od -An -c | tr -d ' ')" = "177ELF" ] ||
+    fail "the link target wasn't written"
+echo old > real.o
+"$main" -o sub/link.o t.c || fail "compile through a relative link"
+[ -L sub/link.o ] && cmp -s real.o link.o ||
+    fail "the relative link wasn't followed"
+
+echo old > exe.o
+chmod 751 exe.o
+"$main" -o exe.o t.c || fail "compile over an executable"
+[ "$(stat -c %a exe.o)" = 751 ] || fail "the mode wasn't kept"
+
+mkfifo fifo
+cat fifo > from_fifo &
+reader=$!
+"$main" -o fifo t.c || fail "compile into a FIFO"
+if [ -p fifo ]; then
+    wait $reader
+else
+    # nothing opens the FIFO the reader waits on anymore.
+    kill $reader
+    fail "the FIFO was replaced"
+fi
+cmp -s from_fifo real.o || fail "the FIFO didn't get the object"
+
+[ -z "$(ls -A | grep '^\.')" ] || fail "a temporary file was left behind"
+exit $status
@@ -0,0 +1,63 @@
+#!/bin/sh
+# Functions generated in parallel are joined in the order of the source: a
+# program of a few hundred functions with their own literals, statics and
+# switches compiles to the same object whatever the amount of threads, and
+# that object runs.
+
+main="$(pwd)/main"
+dir=$(mktemp -d) || exit 1
+trap 'rm -rf "$dir"' EXIT
+status=0
+
+fail() {
+    echo "parallel: $1"
+    status=1
+}
+
+awk 'BEGIN {
+    functions = 400
+    print "int printf(const char *fmt, ...);"
+    print "int strcmp(const char *a, const char *b);"
+    for (f = 0; f < functions; f++) {
+        print "static int calls" f ";"
+        print "long f" f "(long x) {"
+        print "    static long last;"
+        print "    const char *name = \"f" f "\";"
+        print "    const char *shared = \"shared by every function\";"
+        print "    calls" f "++;"
+        print "    switch (x % " (f % 7 + 3) ") {"
+        for (c = 0; c < f % 7 + 3; c++)
+            print "    case " c ": x = (x * " (f + c + 2) " + " c ") % 1000003; break;"
+        print "    }"
+        if (f) print "    if (x % 3 == 0) x += f" (f - 1) "(x / 7);"
+        print "    last = x + strcmp(name, shared) + calls" f ";"
+        print "    return last;"
+        print "}"
+    }
+    print "int main(void) {"
+    print "    long sum = 0;"
+    print "    for (long i = 0; i < 20; i++) sum = sum * 3 + f" (functions - 1) "(i) % 1000003;"
+    print "    printf(\"%ld\\n\", sum);"
+    print "    return 0;"
+    print "}"
+}' > "$dir/many.c"
+
+"$main" -j 1 -o "$dir/1.o" "$dir/many.c" > /dev/null ||
+    fail "doesn't compile on one thread"
+for threads in 2 4 8; do
+    "$main" -j $threads -o "$dir/$threads.o" "$dir/many.c" > /dev/null ||
+        fail "doesn't compile on $threads threads"
+    cmp -s "$dir/1.o" "$dir/$threads.o" ||
+        fail "the object of $threads threads differs from one thread's"
+done
+
+"$main" --pipelined -j 4 -o "$dir/pipelined.o" "$dir/many.c" > /dev/null ||
+    fail "doesn't compile pipelined"
+cmp -s "$dir/1.o" "$dir/pipelined.o" ||
+    fail "the pipelined object differs from the serial one"
+
+cc -o "$dir/many" "$dir/8.o" && "$dir/many" > "$dir/out" ||
+    fail "the object doesn't run"
+cc -w -o "$dir/reference" "$dir/many.c" && "$dir/reference" > "$dir/expected"
+cmp -s "$dir/out" "$dir/expected" || fail "the program differs from cc's"
+exit $status
@@ -0,0 +1,46 @@
+#!/bin/sh
+# Compiles each program of tests/programs to an object at -O0 and at -O1,
+# links it with cc and compares what it prints and its exit status with the
+# .expected file next to it, which is the output of the same program built
+# by cc. -O1 must change nothing a program does. The program is also run
+# from memory by --run, in the process of main and in a child with --fork,
+# which must print and exit just the same.
+
+main="$(pwd)/main"
+programs="$(pwd)/tests/programs"
+dir=$(mktemp -d) || exit 1
+trap 'rm -rf "$dir"' EXIT
+status=0
+
+fail() {
+    echo "programs: $1"
+    status=1
+}
+
+for source in "$programs"/*.c; do
+    for level in -O0 -O1; do
+        name=$(basename "$source" .c)
+        build="$dir/$name$level"
+        if ! "$main" $level -o "$build.o" "$source" > "$build.log"; then
+            fail "$name doesn't compile at $level"
+            continue
+        fi
+        if ! cc -o "$build" "$build.o"; then
+            fail "$name doesn't link at $level"
+            continue
+        fi
+        # the shell reports a program killed by a signal on stderr.
+        { "$build"; echo "exit $?"; } > "$build.out" 2> "$build.err"
+        diff "$programs/$name.expected" "$build.out" > "$build.diff" ||
+            { fail "$name differs from cc at $level"; cat "$build.diff"; }
+
+        for run in --run "--run --fork"; do
+            { "$main" $level $run "$source"; echo "exit $?"; } \
+                > "$build.out" 2> "$build.err"
+            diff "$programs/$name.expected" "$build.out" > "$build.diff" ||
+                { fail "$name differs from cc with $level $run"; cat "$build.diff"; }
+        done
+    done
+done
+
+exit $status
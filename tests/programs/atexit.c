@@ -0,0 +1,27 @@
+// Handlers given to atexit run once main is done, the last one given first,
+// and exit called deep in the program ends it with its status.
+
+int printf(const char *f, ...);
+int atexit(void (*handler)(void));
+void exit(int status);
+
+static int calls;
+
+static void first(void) { printf("first, after %d call\n", calls); }
+
+static void second(void) {
+    calls++;
+    printf("second\n");
+}
+
+static int leave(int depth) {
+    if (depth == 3) exit(depth + 4);
+    return leave(depth + 1) + 1;
+}
+
+int main(void) {
+    atexit(first);
+    atexit(second);
+    printf("main\n");
+    return leave(0);
+}
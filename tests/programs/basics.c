@@ -0,0 +1,97 @@
+// Calls, arithmetic, control flow and the data sections of an object.
+
+int printf(const char *fmt, ...);
+void *malloc(unsigned long n);
+int strcmp(const char *a, const char *b);
+
+struct point { int x; int y; char tag; long z; };
+static int counter = 3;
+int table[5] = {1, 2, 3, 4, 5};
+char greeting[] = "hello";
+const char *names[] = {"zero", "one", "two"};
+int *tp = &table[0];
+int *tp2 = table + 2;
+long big = 0x123456789abcLL;
+struct point origin = {1, 2, 'o', 99};
+int zeros[100];
+unsigned char uc = 200;
+short sh = -5;
+
+static int fib(int n) { return n < 2 ? n : fib(n - 1) + fib(n - 2); }
+
+int many(int a, int b, int c, int d, int e, int f, int g, int h, int i) {
+    return a + 2*b + 3*c + 4*d + 5*e + 6*f + 7*g + 8*h + 9*i;
+}
+
+long divs(long a, long b) { return a / b * 1000 + a % b; }
+unsigned udivs(unsigned a, unsigned b) { return a / b * 1000 + a % b; }
+
+int sw(int x) {
+    switch (x) {
+    case 1: return 10;
+    case 2: case 3: return 20;
+    case 100: return 30;
+    case -7: return 40;
+    default: return 0;
+    }
+}
+
+int next(void) { static int n = 10; return n++; }
+
+int sum_struct(struct point *p) { return p->x + p->y + p->tag + (int)p->z; }
+
+int loops(int n) {
+    int s = 0;
+    for (int i = 0; i < n; i++) {
+        if (i % 3 == 0) continue;
+        if (i > 50) break;
+        s += i;
+    }
+    int j = 0;
+    while (j < 10) j += 3;
+    do { s += j; j--; } while (j > 5);
+    return s;
+}
+
+int shifts(int x, unsigned y, char c) {
+    return (x >> 2) + (int)(y >> 3) + (x << 4) + (c >> 1);
+}
+
+int cmp(char a, unsigned char b, short c) { return (a < 0) + (b > 100) * 2 + (c == -5) * 4; }
+
+int main(void) {
+    printf("fib %d\n", fib(15));
+    printf("many %d\n", many(1, 2, 3, 4, 5, 6, 7, 8, 9));
+    printf("divs %ld %ld %u\n", divs(-17, 5), divs(100, 7), udivs(4000000000u, 7));
+    printf("sw %d %d %d %d %d %d\n", sw(1), sw(2), sw(3), sw(100), sw(-7), sw(5));
+    int first = next();
+    printf("static %d %d %d\n", first, next(), counter);
+    printf("table %d %d %d %s %s\n", table[4], *tp, *tp2, greeting, names[2]);
+    printf("big %lx\n", big);
+    printf("origin %d\n", sum_struct(&origin));
+    printf("loops %d\n", loops(100));
+    printf("shifts %d\n", shifts(-100, 1000, -9));
+    printf("cmp %d %d %d\n", cmp(-1, 200, -5), uc, sh);
+    struct point p;
+    p.x = 5; p.y = 6; p.tag = 1; p.z = 7;
+    printf("local %d\n", sum_struct(&p));
+    int arr[10];
+    for (int i = 0; i < 10; i++) arr[i] = i * i;
+    int *q = arr;
+    long total = 0;
+    while (q < arr + 10) total += *q++;
+    printf("arr %ld %d\n", total, zeros[50]);
+    char *m = malloc(16);
+    m[0] = 'h'; m[1] = 'i'; m[2] = 0;
+    printf("%s %d\n", m, strcmp(m, "hi"));
+    int x = 5;
+    int *px = &x;
+    *px += 10;
+    printf("x %d %d\n", x, x > 10 && x < 20 || x == 0);
+    unsigned char cc = 250;
+    cc += 10;
+    printf("cc %d\n", cc);
+    int (*fp)(int) = sw;
+    printf("fp %d\n", fp(100));
+    return counter == 3 ? 0 : 1;
+}
@@ -0,0 +1,58 @@
+// Lines joined by a backslash newline: macros defined over several lines,
+// object-like and function-like, a statement split across lines, and
+// conditions of #if and #elif continued in taken and untaken groups.
+
+int printf(const char *f, ...);
+
+#define GREETING \
+    "hello"
+#define LIMIT \
+    3 \
+    + 4
+#define ADD(a, b) \
+    ((a) + (b))
+#define SWAP(type, a, b) \
+    do {                 \
+        type tmp = (a);  \
+        (a) = (b);       \
+        (b) = tmp;       \
+    } while (0)
+#define TWICE\
+(x) ((x) * 2)
+
+#if defined(LIMIT) && \
+    LIMIT > 5
+#define TAKEN 1
+#else
+#define TAKEN 0
+#endif
+
+#if 0
+#if 1 && \
+    1
+this group isn't C, nor is the one it's nested in
+#endif
+#elif 1 && \
+    0
+#define UNTAKEN 1
+#else
+#define UNTAKEN 2
+#endif
+
+#ifdef NOT_DEFINED
+neither is this one, which ends at a directive split after its '#'
+# \
+else
+#define SPLIT_ELSE 3
+#endif
+
+int main(void) {
+    int a = 1, b = 2;
+    SWAP(int, a, b);
+    int total = ADD(a, \
+                    b) + LIMIT;
+    printf("%s %d %d %d\n", GREETING, a, b, total);
+    printf("%d\n", TWICE(21));
+    printf("%d %d %d\n", TAKEN, UNTAKEN, SPLIT_ELSE);
+    return LIMIT;
+}
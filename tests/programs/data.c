@@ -0,0 +1,81 @@
+// Aggregates, wide and narrow integers, gotos and fall through.
+
+int printf(const char *fmt, ...);
+int puts(const char *s);
+
+struct big { int a[40]; char name[16]; long tail; };
+struct pair { long a; long b; };
+
+static struct big gb = {{1, 2, 3}, "gb", 77};
+struct pair pairs[3] = {{1, 2}, {3, 4}, {5, 6}};
+struct pair *pp = &pairs[1];
+long *pb = &pairs[2].b;
+char *ptrs[] = {"a", "bb", "ccc"};
+char matrix[2][3] = {{1, 2, 3}, {4, 5, 6}};
+
+long seven(long a, long b, long c, long d, long e, long f, long g) {
+    return a - b + c - d + e - f + g * 100;
+}
+long eight(long a, long b, long c, long d, long e, long f, long g, long h) {
+    return seven(a, b, c, d, e, f, g) * 10 + h;
+}
+
+int gotos(int n) {
+    int i = 0, s = 0;
+again:
+    s += i;
+    i++;
+    if (i < n) goto again;
+    return s;
+}
+
+int fall(int x) {
+    int r = 0;
+    switch (x) {
+    case 0: r += 1;
+    case 1: r += 10;
+        break;
+    case 2: {
+        switch (x * 2) { case 4: r = 400; break; default: r = -1; }
+        break;
+    }
+    default: r = 99;
+    }
+    return r;
+}
+
+
+int sumbig(struct big *b) { int s = 0; for (int i = 0; i < 40; i++) s += b->a[i]; return s + (int)b->tail; }
+
+int main(void) {
+    struct big local = {{0}};
+    printf("zero %d %ld\n", sumbig(&local), local.tail);
+    struct big copy = gb;
+    printf("copy %d %s %ld\n", sumbig(&copy), copy.name, copy.tail);
+    printf("pairs %ld %ld %ld\n", pp->a, *pb, pairs[0].b);
+    printf("ptrs %s %s %c %d\n", ptrs[1], ptrs[2], *ptrs[0], matrix[1][2]);
+    printf("seven %ld eight %ld\n", seven(1, 2, 3, 4, 5, 6, 7), eight(1, 2, 3, 4, 5, 6, 7, 8));
+    printf("%d %d %d %d %d %d %d %d %d %d\n", 1, 2, 3, 4, 5, 6, 7, 8, 9, 10);
+    printf("gotos %d\n", gotos(10));
+    printf("fall %d %d %d %d\n", fall(0), fall(1), fall(2), fall(3));
+    long long x = 1LL << 40;
+    unsigned long u = -1;
+    printf("ll %lld %lu %d\n", x * 3 - 7, u / 3, u > 5);
+    int neg = -2147483647 - 1;
+    printf("neg %d %d\n", neg, neg / 2);
+    char c = 'a';
+    c = c + 1;
+    printf("char %c %d\n", c, (char)200);
+    int arr[3][4];
+    for (int i = 0; i < 3; i++) for (int j = 0; j < 4; j++) arr[i][j] = i * 10 + j;
+    printf("2d %d %d\n", arr[2][3], arr[1][0]);
+    int *p = &arr[0][0];
+    int **pp2 = &p;
+    printf("pp %d\n", (*pp2)[5]);
+    printf("tern %d %d\n", x > 5 ? 1 : 2, !x);
+    unsigned short us = 65535;
+    us++;
+    printf("us %d\n", us);
+    puts("done");
+    return 0;
+}
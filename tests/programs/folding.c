@@ -0,0 +1,33 @@
+// Constants, narrowing conversions and branches -O1 folds.
+
+int printf(const char *f, ...);
+int g;
+int f(int x) {
+    int a = 3, b = 4;
+    int c = a * b + 2;          // 14
+    unsigned char uc = 250; uc += 10;  // 4
+    signed char sc = 127; sc++;        // -128
+    short s = 40000;                   // -25536
+    unsigned u = 0xffffffffu; u >>= 4;
+    long l = 1L << 40; l >>= 3;
+    int sh = -16 >> 2;
+    int d = -7 / 2, r = -7 % 2;
+    unsigned ud = 0xfffffff0u / 3u;
+    int k = 0;
+    if (c == 14) k = 1; else k = 2;
+    switch (c) { case 1: k += 100; break; case 14: k += 10; break; default: k += 1000; }
+    int z = x * 0 + (x & 0) + (x | -1);
+    int id = (x + 0) * 1 - 0;
+    while (0) { g++; }
+    for (int i = 0; i < 3; i++) if (a > b) g += 5; else g += 1;
+    unsigned long big = (unsigned long)-1 / 7;
+    int cmpu = (unsigned)-1 > 5u;
+    int cmps = -1 > 5;
+    printf("%d %d %d %d %u %ld %d %d %d %u %d %d %d %lu %d %d\n", c, uc, sc, s, u, l, sh, d, r, ud, k, z, id, big, cmpu, cmps);
+    return k + (a < b ? x : -x);
+}
+int main() {
+    int r = f(7);
+    printf("%d %d\n", r, g);
+    return 0;
+}
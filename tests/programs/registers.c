@@ -0,0 +1,149 @@
+// Register pressure: more live values than registers, across calls and
+// loops, and calls passing ten arguments, some of them on the stack.
+
+int printf(const char *fmt, ...);
+
+long many(long a, long b, long c, long d, long e, long f, long g, long h, long i) {
+    return a + 2*b + 3*c + 4*d + 5*e + 6*f + 7*g + 8*h + 9*i;
+}
+
+int swap_loop(int n) {
+    int a = 1, b = 2, c = 3;
+    for (int i = 0; i < n; i++) {
+        int t = a;
+        a = b;
+        b = c;
+        c = t;
+    }
+    return a * 100 + b * 10 + c;
+}
+
+int fib(int n) {
+    if (n < 2) return n;
+    return fib(n - 1) + fib(n - 2);
+}
+
+int pressure(int x) {
+    int a = x + 1, b = x + 2, c = x + 3, d = x + 4, e = x + 5, f = x + 6;
+    int g = x + 7, h = x + 8, i = x + 9, j = x + 10, k = x + 11, l = x + 12;
+    int m = x + 13, n = x + 14, o = x + 15, p = x + 16;
+    int s = 0;
+    for (int q = 0; q < 3; q++) {
+        s += a * b - c + d * e - f + g * h - i + j * k - l + m * n - o + p;
+        a++; p--; h ^= q;
+    }
+    return s + fib(a % 5) + a + b + c + d + e + f + g + h + i + j + k + l + m + n + o + p;
+}
+
+int across(int x) {
+    int a = x * 3, b = x * 5, c = x * 7, d = x * 11, e = x * 13, f = x * 17, g = x * 19;
+    int r = fib(5);
+    r += fib(6);
+    return r + a + b + c + d + e + f + g;
+}
+
+unsigned char bytes(unsigned char a, signed char b, short c) {
+    return a / 3 + b % 5 + c / 7 + (a >> 1) + (b >> 2);
+}
+
+long shifts(long a, int s) {
+    return (a << s) + (a >> (s + 1)) + ((unsigned long)a >> 3) + (1L << 40);
+}
+
+int args_perm(int a, int b, int c, int d, int e, int f) {
+    return a * 1 + b * 10 + c * 100 + d * 1000 + e * 10000 + f * 100000;
+}
+
+int perm(int a, int b, int c, int d, int e, int f) {
+    return args_perm(f, e, d, c, b, a) + args_perm(b, a, d, c, f, e);
+}
+
+int gcd(int a, int b) {
+    while (b) {
+        int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+int sw(int x) {
+    switch (x) {
+    case 1: return 10;
+    case 5: return 50;
+    case 100: return 1000;
+    default: return -1;
+    }
+}
+
+int global_arr[10];
+int *gp = global_arr;
+
+int id(int x) { return x; }
+
+long rot(int n) {
+    long a = 1, b = 2, c = 3, d = 4, e = 5, f = 6, g = 7, h = 8;
+    for (int i = 0; i < n; i++) {
+        long t = a; a = b; b = c; c = d; d = e; e = f; f = g; g = h; h = t + id(i);
+    }
+    return a + 10 * b + 100 * c + 1000 * d + 10000 * e + 100000 * f + 1000000 * g + 10000000 * h;
+}
+
+long ten(long a, long b, long c, long d, long e, long f, long g, long h, long i, long j) {
+    return a + 2 * b + 3 * c + 4 * d + 5 * e + 6 * f + 7 * g + 8 * h + 9 * i + 10 * j;
+}
+
+int ten_mixed(char a, int b, short c, long d, unsigned char e, int f, long g, short h, char i, unsigned j) {
+    return a - b + c - (int)d + e - f + (int)g - h + i * 1000 + (int)(j / 2);
+}
+
+// ten arguments, each computed with a call, while values stay live.
+long ten_nested(int x) {
+    int a = x * 3, b = x * 5, c = x * 7, d = x * 11;
+    long r = ten(id(x), id(x + 1), fib(10), a, b, id(c), d, ten(1, 2, 3, 4, 5, 6, 7, 8, 9, 10), id(-x), fib(5));
+    return r + a + b + c + d;
+}
+// the loop closes with a branch, the values leaving it are the phis of the
+// loop as they were before the branch.
+int swap_do(int n) {
+    int a = 1, b = 2, c = 3;
+    do {
+        int t = a;
+        a = b;
+        b = c;
+        c = t;
+    } while (--n > 0);
+    return a * 100 + b * 10 + c;
+}
+
+int last_before(int n) {
+    int i = 0, prev = -1;
+    do {
+        prev = i;
+        i++;
+    } while (i < n);
+    return prev * 10 + i;
+}
+
+int main(void) {
+    printf("many %ld\n", many(1, 2, 3, 4, 5, 6, 7, 8, 9));
+    for (int n = 0; n < 5; n++) printf("swap %d %d\n", n, swap_loop(n));
+    for (int n = 1; n < 4; n++) printf("swap_do %d %d %d\n", n, swap_do(n), last_before(n));
+    printf("fib %d\n", fib(20));
+    printf("pressure %d %d\n", pressure(1), pressure(-7));
+    printf("across %d\n", across(3));
+    printf("bytes %d %d\n", bytes(200, -100, -3000), bytes(7, 9, 11));
+    printf("shifts %ld %ld\n", shifts(12345, 3), shifts(99, 5));
+    printf("perm %d\n", perm(1, 2, 3, 4, 5, 6));
+    printf("gcd %d %d\n", gcd(1071, 462), gcd(17, 5));
+    printf("sw %d %d %d %d\n", sw(1), sw(5), sw(100), sw(7));
+    for (int i = 0; i < 10; i++) global_arr[i] = i * i;
+    int s = 0;
+    for (int i = 0; i < 10; i++) s += gp[i];
+    printf("arr %d\n", s);
+    for (int n = 0; n < 12; n += 3) printf("rot %d %ld\n", n, rot(n));
+    printf("ten %ld %ld\n", ten(1, 2, 3, 4, 5, 6, 7, 8, 9, 10), ten(-1, -2, -3, -4, -5, -6, -7, -8, -9, -10));
+    printf("ten_mixed %d\n", ten_mixed(-3, 100000, -300, 1L << 33, 250, 7, -(1L << 40) + 5, 32000, 99, 4000000000u));
+    printf("ten_nested %ld %ld\n", ten_nested(2), ten_nested(-9));
+    return 0;
+}
@@ -0,0 +1,14 @@
+// A program killed by a signal: what it printed before is kept and its exit
+// status is 128 plus the number of the signal, SIGTERM here.
+
+int printf(const char *f, ...);
+int fflush(void *stream);
+int raise(int signal);
+
+int main(void) {
+    printf("before the signal\n");
+    fflush(0);
+    raise(15);
+    printf("after the signal\n");
+    return 0;
+}
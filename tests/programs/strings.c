@@ -0,0 +1,28 @@
+// String literals: repeated ones, those ending others, and some with a 0
+// before their terminator. tests/string_pool.sh checks how they are pooled.
+
+int printf(const char *, ...);
+int strcmp(const char *, const char *);
+const char *g1 = "hello world\n";
+const char *g2 = "world\n";
+const char *g3 = "abc" + 1;
+char arr[] = "array stays in data";
+const char *nul = "a\0b";
+const char *nul2 = "\0b";
+const char *get(int i) {
+    static const char *s = "world\n";
+    static const char *t[] = {"x", "yx", "zyx", "x"};
+    if (i < 4) return t[i];
+    return s;
+}
+int main(void) {
+    printf("hello world\n");
+    printf("world\n");
+    printf("%s%s", g1, g2);
+    printf("%s %s\n", g3, arr);
+    printf("%d %d %d %d\n", nul[0], nul[1], nul[2], nul2[1]);
+    for (int i = 0; i < 5; i++) printf("[%s]", get(i));
+    printf("\n%d %d\n", strcmp(get(4), g2), strcmp("", ""));
+    printf("%s|%s\n", "", "longer tail" + 7);
+    return 0;
+}
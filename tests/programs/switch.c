@@ -0,0 +1,81 @@
+// Switches lowered to jump tables, bit tests, compares and the search tree
+// over them, with 32-bit, 64-bit, unsigned, char and negative values.
+
+int printf(const char *f, ...);
+int dense(int x) {
+    switch (x) {
+    case 0: return 10; case 1: return 11; case 2: return 12; case 3: return 13;
+    case 4: return 14; case 5: return 15; case 7: return 17; case 9: return 19;
+    case 10: return 20; case 11: return 21;
+    }
+    return -1;
+}
+int neg(int x) {
+    switch (x) { case -5: return 1; case -4: return 2; case -3: return 3; case -2: return 4; case -1: return 5; case 0: return 6; default: return 7; }
+}
+int vowel(int c) {
+    switch (c) { case 'a': case 'e': case 'i': case 'o': case 'u': return 1; case 'y': return 2; case 'A': case 'E': return 3; }
+    return 0;
+}
+int sparse(int x) {
+    switch (x) { case 1: return 1; case 100: return 2; case 1000: return 3; case 10000: return 4; case 100000: return 5;
+    case 1000000: return 6; case -7: return 7; case 2147483647: return 8; case -2147483647 - 1: return 9; }
+    return 0;
+}
+long big(long x) {
+    switch (x) { case 1L << 40: return 1; case (1L << 40) + 1: return 2; case (1L << 40) + 2: return 3; case (1L << 40) + 3: return 4;
+    case (1L << 40) + 5: return 5; case -(1L << 50): return 6; case 3: return 7; case 4: return 8; case 6: return 9; case 8: return 10; case 60: return 11; }
+    return 0;
+}
+unsigned us(unsigned x) {
+    switch (x) { case 0xffffffffu: return 1; case 0xfffffffeu: return 2; case 0x80000000u: return 3; case 0: return 4; case 1: return 5; case 2: return 6; case 3: return 7; }
+    return 0;
+}
+int mixed(int x) {
+    int r = 0;
+    switch (x) {
+    case 1: r += 1;
+    case 2: r += 2; break;
+    case 3: case 4: case 5: case 6: case 7: case 8: r = x * 3; break;
+    case 20: case 22: case 24: case 26: r = 100; break;
+    case 50: case 51: case 52: case 53: case 54: case 55: case 56: case 57: r = x; break;
+    case 500: r = 5; break;
+    default: r = -x;
+    }
+    return r;
+}
+int chars(char c) {
+    switch (c) { case -1: return 1; case 0: return 2; case 1: return 3; case 2: return 4; case 100: return 5; case -100: return 6; }
+    return 0;
+}
+int classes(int c) {
+    switch (c) {
+    case 'a': case 'e': case 'i': case 'o': case 'u':
+    case 'A': case 'E': case 'I': case 'O': case 'U': return 1;
+    case ' ': case '\t': case '\n': case '\r': return 2;
+    case '0': case '1': case '2': case '3': case '4':
+    case '5': case '6': case '7': case '8': case '9': return 3;
+    }
+    return 0;
+}
+int main() {
+    unsigned long s = 0;
+    for (int i = -20; i < 40; i++) s = s * 31 + dense(i) + 3 * neg(i) + 7 * vowel(i + 80) + 11 * vowel(i + 120);
+    printf("a %lu\n", s);
+    int vals[] = {1, 100, 1000, 10000, 100000, 1000000, -7, 2147483647, -2147483647 - 1, 0, 5, -1, 99};
+    for (int i = 0; i < 13; i++) s = s * 31 + sparse(vals[i]);
+    printf("b %lu\n", s);
+    long bv[] = {1L << 40, (1L << 40) + 1, (1L << 40) + 2, (1L << 40) + 3, (1L << 40) + 4, (1L << 40) + 5, -(1L << 50), 3, 4, 5, 6, 7, 8, 60, 61, 0};
+    for (int i = 0; i < 16; i++) s = s * 31 + big(bv[i]);
+    printf("c %lu\n", s);
+    unsigned uv[] = {0xffffffffu, 0xfffffffeu, 0x80000000u, 0, 1, 2, 3, 4, 0x7fffffff};
+    for (int i = 0; i < 9; i++) s = s * 31 + us(uv[i]);
+    printf("d %lu\n", s);
+    for (int i = -3; i < 600; i++) s = s * 31 + mixed(i);
+    printf("e %lu\n", s);
+    for (int i = -130; i < 130; i++) s = s * 31 + chars((char)i);
+    printf("f %lu\n", s);
+    for (int i = -10; i < 300; i++) s = s * 31 + classes(i);
+    printf("g %lu\n", s);
+    return 0;
+}
@@ -0,0 +1,23 @@
+#!/bin/sh
+# Runs the unit tests of tests/unit, built by `make check`, and the scripts
+# of tests driving the compiler.
+
+cd "$(dirname "$0")/.." || exit 1
+status=0
+
+for test in tests/unit/*.c; do
+    if ! "${test%.c}"; then
+        echo "FAIL ${test%.c}"
+        status=1
+    fi
+done
+
+for test in tests/*.sh; do
+    [ "$test" = tests/run.sh ] && continue
+    if ! "$test"; then
+        echo "FAIL $test"
+        status=1
+    fi
+done
+
+exit $status
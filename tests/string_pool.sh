@@ -0,0 +1,55 @@
+#!/bin/sh
+# The literals of tests/programs/strings.c are pooled: those without a 0
+# before their terminator go to a mergeable string section, each kept once
+# and none of them the tail of another, the others to .rodata.
+
+main="$(pwd)/main"
+dir=$(mktemp -d) || exit 1
+trap 'rm -rf "$dir"' EXIT
+status=0
+
+fail() {
+    echo "string_pool: $1"
+    status=1
+}
+
+"$main" -o "$dir/strings.o" tests/programs/strings.c > /dev/null || {
+    fail "strings.c doesn't compile"
+    exit 1
+}
+
+# size, entry size and flags of the section named $1.
+section() {
+    readelf -SW "$dir/strings.o" | sed 's/^ *\[ *[0-9]*\] *//' |
+        awk -v name="$1" '$1 == name { print $5, $6, $7 }'
+}
+
+set -- $(section .rodata.str1.1)
+[ "$#" = 3 ] || fail "no .rodata.str1.1 section"
+[ "$2" = 01 ] || fail ".rodata.str1.1 has entries of $2 bytes"
+[ "$3" = AMS ] || fail ".rodata.str1.1 has flags $3, not AMS"
+
+# the strings of the section, one per line, their newlines written ~.
+objcopy -O binary --only-section=.rodata.str1.1 "$dir/strings.o" \
+    "$dir/section" && tr '\n\0' '~\n' < "$dir/section" > "$dir/pooled"
+for literal in 'hello world~' '~%d %d~' '%d %d %d %d~' abc 'longer tail' zyx; do
+    grep -qxF "$literal" "$dir/pooled" || fail "'$literal' isn't pooled"
+done
+awk '{ pooled[NR] = $0 }
+END {
+    for (i = 1; i <= NR; i++)
+        for (j = 1; j <= NR; j++) {
+            a = pooled[i]
+            b = pooled[j]
+            if (i != j && length(a) <= length(b) &&
+                substr(b, length(b) - length(a) + 1) == a)
+                print "string_pool: \"" a "\" is kept apart from \"" b "\""
+        }
+}' "$dir/pooled" > "$dir/shared"
+[ -s "$dir/shared" ] && { cat "$dir/shared"; status=1; }
+
+# "a\0b" and "\0b" can't be merged by the linker, the latter ends the
+# former.
+set -- $(section .rodata)
+[ "$#" = 3 ] && [ $((0x$1)) = 4 ] || fail "the literals with a 0 aren't merged in .rodata"
+exit $status
@@ -0,0 +1,66 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "../../helpers/buffer.h"
+
+static int failures;
+
+#define CHECK(condition)                                                    \
+    do {                                                                    \
+        if (!(condition)) {                                                 \
+            fprintf(stderr, "buffer: %s:%d: %s\n", __FILE__, __LINE__,      \
+                    #condition);                                            \
+            failures++;                                                     \
+        }                                                                   \
+    } while (0)
+
+// A struct embedding a buffer, returned by value as object_section and
+// codegen are moved around.
+struct holder {
+    int tag;
+    struct buffer text;
+};
+
+static struct holder make_holder(const char *text) {
+    struct holder holder = {.tag = 1};
+    buffer_init(&holder.text);
+    buffer_printf(&holder.text, "%s", text);
+    return holder;
+}
+
+int main(void) {
+    // an inline buffer copied by value has its own contents.
+    struct holder small = make_holder("short");
+    CHECK(buffer_len(&small.text) == 5);
+    CHECK(!memcmp(buffer_ptr(&small.text), "short", 5));
+    struct holder copy = small;
+    buffer_write(&small.text, '!');
+    CHECK(buffer_len(&copy.text) == 5);
+    CHECK(!memcmp(buffer_ptr(&copy.text), "short", 5));
+    buffer_release(&small.text);
+
+    // a grown buffer copied by value is moved.
+    char long_text[300];
+    memset(long_text, 'x', sizeof(long_text) - 1);
+    long_text[sizeof(long_text) - 1] = 0;
+    struct holder large = make_holder(long_text);
+    CHECK(buffer_len(&large.text) == sizeof(long_text) - 1);
+    struct holder moved = large;
+    CHECK(!strcmp(buffer_ptr(&moved.text), long_text));
+    buffer_release(&moved.text);
+
+    // printf isn't truncated and leaves the terminator out of the length.
+    struct buffer formatted;
+    buffer_init(&formatted);
+    for (int i = 0; i < 1000; i++) buffer_printf(&formatted, "%04d,", i);
+    CHECK(buffer_len(&formatted) == 5000);
+    CHECK(!strncmp((char *)buffer_ptr(&formatted) + 4995, "0999,", 6));
+    buffer_clear(&formatted);
+    buffer_write_bytes(&formatted, "ab", 2);
+    CHECK(buffer_read(&formatted) == 'a' && buffer_peek(&formatted) == 'b');
+    buffer_release(&formatted);
+
+    if (failures) return 1;
+    printf("buffer: ok\n");
+    return 0;
+}
@@ -0,0 +1,143 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../../helpers/buffer.h"
+#include "../../src/compiler.h"
+
+// One compiler compiles a source, fails on broken ones and on a source far
+// larger than the first, and each time it's reset produces the object a
+// fresh compiler produces for the same source.
+
+static int failures;
+
+static const char small[] =
+    "int printf(const char *fmt, ...);\n"
+    "static int twice(int x) { return x * 2; }\n"
+    "int main(void) { printf(\"%d\\n\", twice(21)); return 0; }\n";
+
+// each fails in a different phase, after part of the tree has been built.
+static const char *broken[] = {
+    "int main(void) { return 'a; }\n",
+    "int f(int x) { return x; }\nint main(void) { return f(1; }\n",
+    "int main(void) { return missing; }\n",
+    "#if 1\nint main(void) { return 0; }\n",
+    "struct s { int a; };\nint main(void) { struct s v; return v.b; }\n",
+};
+
+// Writes a source of `functions` functions calling each other to `source`.
+static void generate(struct buffer *source, int functions) {
+    buffer_printf(source, "int printf(const char *fmt, ...);\n");
+    buffer_printf(source, "long f0(long x) { return x + 1; }\n");
+    for (int i = 1; i < functions; i++)
+        buffer_printf(source,
+                      "long f%d(long x) {\n"
+                      "    const char *name = \"f%d\";\n"
+                      "    switch (x %% 3) { case 0: x += %d; break; "
+                      "case 1: x ^= %d; break; }\n"
+                      "    return f%d(x) + name[1];\n"
+                      "}\n",
+                      i, i, i, i * 7, i - 1);
+    buffer_printf(source, "int main(void) { printf(\"%%ld\\n\", f%d(1)); "
+                          "return 0; }\n",
+                  functions - 1);
+}
+
+// Compiles `len` bytes of `src` with `c` into `object`, returns the result.
+static int compile(struct compiler *c, const char *src, size_t len,
+                   struct buffer *object) {
+    buffer_clear(object);
+    compiler_reset_from_memory(c, src, len, "reuse.c", object);
+    return compile_file(c);
+}
+
+// Compiles `src` with a compiler of its own into `object`.
+static void compile_fresh(const char *src, size_t len, struct buffer *object) {
+    buffer_init(object);
+    struct compiler *c = compiler_create_from_memory(src, len, "reuse.c",
+                                                     object, 0);
+    if (compile_file(c) != COMPILER_FILE_COMPILED_OK) {
+        fprintf(stderr, "compiler_reuse: a fresh compile failed\n");
+        failures++;
+    }
+    compiler_free(c);
+}
+
+static void check_same(struct buffer *a, struct buffer *b, const char *what) {
+    if (buffer_len(a) != buffer_len(b) ||
+        memcmp(buffer_ptr(a), buffer_ptr(b), buffer_len(a))) {
+        fprintf(stderr, "compiler_reuse: %s differs from a fresh compile\n",
+                what);
+        failures++;
+    }
+}
+
+int main(void) {
+    struct buffer small_object, large_source, large_object, object;
+    buffer_init(&object);
+    buffer_init(&large_source);
+    generate(&large_source, 2000);
+    compile_fresh(small, sizeof(small) - 1, &small_object);
+    compile_fresh(buffer_ptr(&large_source), buffer_len(&large_source),
+                  &large_object);
+
+    struct compiler *c =
+        compiler_create_from_memory(small, sizeof(small) - 1, "reuse.c",
+                                    &object, 0);
+    if (compile_file(c) != COMPILER_FILE_COMPILED_OK) {
+        fprintf(stderr, "compiler_reuse: the first compile failed\n");
+        failures++;
+    }
+    check_same(&object, &small_object, "the first object");
+
+    // the diagnostics of the broken sources are expected, they're dropped.
+    fflush(stdout);
+    int saved_stdout = dup(1), saved_stderr = dup(2);
+    for (size_t i = 0; i < sizeof(broken) / sizeof(*broken); i++) {
+        int null = open("/dev/null", O_WRONLY);
+        dup2(null, 1);
+        dup2(null, 2);
+        close(null);
+        int result = compile(c, broken[i], strlen(broken[i]), &object);
+        fflush(stdout);
+        dup2(saved_stdout, 1);
+        dup2(saved_stderr, 2);
+        if (result != COMPILER_FAILED_WITH_ERRORS || buffer_len(&object)) {
+            fprintf(stderr, "compiler_reuse: broken source %zu compiled\n", i);
+            failures++;
+        }
+
+        // the context still compiles what it compiled before.
+        if (compile(c, small, sizeof(small) - 1, &object) !=
+            COMPILER_FILE_COMPILED_OK) {
+            fprintf(stderr, "compiler_reuse: broken source %zu broke the "
+                            "compiler\n", i);
+            failures++;
+        }
+        check_same(&object, &small_object, "the object after a failure");
+    }
+    close(saved_stdout);
+    close(saved_stderr);
+
+    // a larger source grows the storage a smaller one left behind, and the
+    // small one still fits in it afterwards.
+    if (compile(c, buffer_ptr(&large_source), buffer_len(&large_source),
+                &object) != COMPILER_FILE_COMPILED_OK) {
+        fprintf(stderr, "compiler_reuse: the large source failed\n");
+        failures++;
+    }
+    check_same(&object, &large_object, "the large object");
+    compile(c, small, sizeof(small) - 1, &object);
+    check_same(&object, &small_object, "the object after the large one");
+
+    compiler_free(c);
+    buffer_release(&object);
+    buffer_release(&small_object);
+    buffer_release(&large_source);
+    buffer_release(&large_object);
+    if (failures) return 1;
+    printf("compiler_reuse: %zu failed compiles, ok\n",
+           sizeof(broken) / sizeof(*broken));
+    return 0;
+}
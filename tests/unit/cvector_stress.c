@@ -0,0 +1,80 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../../helpers/cvector.h"
+
+// Writers push disjoint ranges of values into one cvector while a reader
+// keeps taking snapshots. Every snapshot must only grow and only show
+// completely written elements, and once the writers are done every value
+// must be in the vector exactly once.
+
+#define WRITERS 8
+#define PUSHES_PER_WRITER 200000
+#define VALUES ((long)WRITERS * PUSHES_PER_WRITER)
+
+static struct cvector *vector;
+static atomic_bool writing = true;
+static atomic_int failures;
+
+static void fail(const char *message, long value) {
+    fprintf(stderr, "cvector_stress: %s (%ld)\n", message, value);
+    atomic_fetch_add(&failures, 1);
+}
+
+static void *writer(void *arg) {
+    long first = (long)arg * PUSHES_PER_WRITER;
+    for (long i = 0; i < PUSHES_PER_WRITER; i++) {
+        // the value and its complement, a torn element doesn't match.
+        long element[2] = {first + i, ~(first + i)};
+        cvector_push(vector, element);
+    }
+    return NULL;
+}
+
+static void check_element(size_t index) {
+    long *element = cvector_at(vector, index);
+    if (element[0] < 0 || element[0] >= VALUES || element[1] != ~element[0])
+        fail("torn or invalid element", (long)index);
+}
+
+static void *reader(void *arg) {
+    (void)arg;
+    size_t last = 0;
+    while (atomic_load(&writing)) {
+        size_t count = cvector_snapshot(vector);
+        if (count < last) fail("snapshot shrank", (long)count);
+        for (size_t i = last; i < count; i++) check_element(i);
+        last = count;
+    }
+    return NULL;
+}
+
+int main(void) {
+    vector = cvector_create(2 * sizeof(long));
+    pthread_t writers[WRITERS], reading;
+    pthread_create(&reading, NULL, reader, NULL);
+    for (long i = 0; i < WRITERS; i++)
+        pthread_create(&writers[i], NULL, writer, (void *)i);
+    for (int i = 0; i < WRITERS; i++) pthread_join(writers[i], NULL);
+    atomic_store(&writing, false);
+    pthread_join(reading, NULL);
+
+    size_t count = cvector_snapshot(vector);
+    if (count != (size_t)VALUES) fail("wrong final count", (long)count);
+    unsigned char *seen = calloc(VALUES, 1);
+    for (size_t i = 0; i < count; i++) {
+        check_element(i);
+        long value = *(long *)cvector_at(vector, i);
+        if (value < 0 || value >= VALUES) continue;
+        if (seen[value]++) fail("value pushed once seen twice", value);
+    }
+    free(seen);
+    cvector_free(vector);
+
+    if (atomic_load(&failures)) return 1;
+    printf("cvector_stress: %ld values from %d writers, ok\n", VALUES,
+           WRITERS);
+    return 0;
+}
@@ -0,0 +1,159 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../../helpers/buffer.h"
+#include "../../helpers/segvector.h"
+#include "../../src/ast.h"
+#include "../../src/bodies.h"
+#include "../../src/compiler.h"
+#include "../../src/lexer.h"
+#include "../../src/parser.h"
+
+// A compile with COMPILER_FLAG_LAZY_BODIES parses the file scope alone: every
+// body is left pending, and one is parsed when it's asked for. The errors of
+// a body are only reported when that body is asked for, each time it is.
+
+static int failures;
+
+#define CHECK(condition)                                                    \
+    do {                                                                    \
+        if (!(condition)) {                                                 \
+            fprintf(stderr, "lazy_bodies: %s:%d: %s\n", __FILE__,           \
+                    __LINE__, #condition);                                  \
+            failures++;                                                     \
+        }                                                                   \
+    } while (0)
+
+static const char source[] =
+    "int helper(int x) { int y = x * 2; return y + 1; }\n"
+    "int undeclared(void) { return missing; }\n"
+    "int syntax(void) { return 1 + ; }\n"
+    "int main(void) { return helper(20); }\n";
+
+static FILE *report;
+static int saved_stdout;
+
+// Sends stdout to a file of its own until the report is read by
+// capture_end.
+static void capture_begin(void) {
+    report = tmpfile();
+    fflush(stdout);
+    saved_stdout = dup(1);
+    dup2(fileno(report), 1);
+}
+
+// Restores stdout and reads what was reported since capture_begin into
+// `text` of `size` bytes.
+static void capture_end(char *text, size_t size) {
+    fflush(stdout);
+    dup2(saved_stdout, 1);
+    close(saved_stdout);
+    rewind(report);
+    size_t len = fread(text, 1, size - 1, report);
+    text[len] = 0;
+    fclose(report);
+}
+
+// Returns the NODE_FUNCTION of the definition named `name`, 0 if none.
+static uint32_t function_named(struct compiler *c, const char *name) {
+    struct parser *p = c->parser;
+    for (uint32_t i = 0; i < p->function_count; i++) {
+        struct node *node = ast_node(&p->ast, p->functions[i]);
+        struct token *token = segvector_at(c->lexer->token_vec, node->token);
+        if (token->spelling_len == strlen(name) &&
+            !memcmp(token->spelling, name, token->spelling_len))
+            return p->functions[i];
+    }
+    return 0;
+}
+
+static bool pending(struct compiler *c, uint32_t function) {
+    return ast_node(&c->parser->ast, function)->flags & NODE_FLAG_BODY_PENDING;
+}
+
+int main(void) {
+    char text[4096];
+    struct buffer object;
+    buffer_init(&object);
+
+    // the errors are in bodies, a full compile reports them.
+    capture_begin();
+    struct compiler *c = compiler_create_from_memory(
+        source, sizeof(source) - 1, "lazy.c", &object, 0);
+    int result = compile_file(c);
+    capture_end(text, sizeof(text));
+    CHECK(result == COMPILER_FAILED_WITH_ERRORS);
+    CHECK(strstr(text, "Parse error at line: 3"));
+    compiler_free(c);
+
+    // phase one alone succeeds, reports nothing and leaves every body as
+    // the token range of its braces.
+    buffer_clear(&object);
+    capture_begin();
+    c = compiler_create_from_memory(source, sizeof(source) - 1, "lazy.c",
+                                    &object, COMPILER_FLAG_LAZY_BODIES);
+    result = compile_file(c);
+    capture_end(text, sizeof(text));
+    CHECK(result == COMPILER_FILE_COMPILED_OK);
+    CHECK(!*text);
+    CHECK(c->parser->function_count == 4);
+    for (uint32_t i = 0; i < c->parser->function_count; i++) {
+        uint32_t function = c->parser->functions[i];
+        CHECK(pending(c, function));
+        struct token *open = segvector_at(
+            c->lexer->token_vec, ast_node(&c->parser->ast, function)->b);
+        CHECK(open->type == TOKEN_TYPE_SYMBOL && open->cval == '{');
+    }
+
+    uint32_t helper = function_named(c, "helper");
+    uint32_t undeclared = function_named(c, "undeclared");
+    uint32_t syntax = function_named(c, "syntax");
+    uint32_t main_function = function_named(c, "main");
+    CHECK(helper && undeclared && syntax && main_function);
+
+    // one body on demand, the others stay pending. Asking again gives the
+    // same body without parsing it again.
+    uint32_t body = bodies_parse_function(c->bodies, helper);
+    CHECK(body);
+    CHECK(!pending(c, helper));
+    CHECK(ast_node(&c->parser->ast, body)->kind == NODE_COMPOUND);
+    CHECK(pending(c, undeclared) && pending(c, syntax) &&
+          pending(c, main_function));
+    uint32_t count = c->parser->ast.count;
+    CHECK(bodies_parse_function(c->bodies, helper) == body);
+    CHECK(c->parser->ast.count == count);
+
+    // a broken body is reported when it's asked for, and again the next
+    // time, it stays pending.
+    capture_begin();
+    body = bodies_parse_function(c->bodies, undeclared);
+    capture_end(text, sizeof(text));
+    CHECK(!body);
+    CHECK(strstr(text, "missing"));
+    CHECK(pending(c, undeclared));
+    capture_begin();
+    body = bodies_parse_function(c->bodies, undeclared);
+    capture_end(text, sizeof(text));
+    CHECK(!body && strstr(text, "missing"));
+
+    capture_begin();
+    body = bodies_parse_function(c->bodies, syntax);
+    capture_end(text, sizeof(text));
+    CHECK(!body);
+    CHECK(strstr(text, "Parse error at line: 3"));
+    CHECK(pending(c, syntax));
+
+    // the failures leave the others to parse.
+    capture_begin();
+    body = bodies_parse_function(c->bodies, main_function);
+    capture_end(text, sizeof(text));
+    CHECK(body && !*text);
+    CHECK(!pending(c, main_function));
+
+    compiler_free(c);
+    buffer_release(&object);
+    if (failures) return 1;
+    printf("lazy_bodies: ok\n");
+    return 0;
+}
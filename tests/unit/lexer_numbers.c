@@ -0,0 +1,274 @@
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../../helpers/buffer.h"
+#include "../../helpers/segvector.h"
+#include "../../src/compiler.h"
+#include "../../src/lexer.h"
+#include "../../src/lexer_token.h"
+
+// Each numeric literal lexes to its value and to the type C11 6.4.4 gives
+// it, whatever its base, its suffix and wherever its digits fall in the
+// words the scanner reads them by, and the ones that don't fit or aren't
+// numbers are refused with their own error.
+
+static int failures;
+
+#define CHECK(condition)                                                    \
+    do {                                                                    \
+        if (!(condition)) {                                                 \
+            fprintf(stderr, "lexer_numbers: %s:%d: %s\n", __FILE__,         \
+                    __LINE__, #condition);                                  \
+            failures++;                                                     \
+        }                                                                   \
+    } while (0)
+
+// Integer literals, their type and value.
+static const struct {
+    const char *source;
+    int type;
+    unsigned long long value;
+} integers[] = {
+    {"0", NUMBER_TYPE_INT, 0},
+    {"7", NUMBER_TYPE_INT, 7},
+    {"2147483647", NUMBER_TYPE_INT, 2147483647},
+    // unsuffixed decimal is never unsigned.
+    {"2147483648", NUMBER_TYPE_LONG, 2147483648},
+    {"4294967295", NUMBER_TYPE_LONG, 4294967295},
+    {"9223372036854775807", NUMBER_TYPE_LONG, 9223372036854775807ull},
+    // hex and octal take the unsigned type before the next wider one.
+    {"0x7fffffff", NUMBER_TYPE_INT, 0x7fffffff},
+    {"0x80000000", NUMBER_TYPE_UNSIGNED_INT, 0x80000000},
+    {"0xFFFFFFFF", NUMBER_TYPE_UNSIGNED_INT, 0xffffffff},
+    {"0x100000000", NUMBER_TYPE_LONG, 0x100000000},
+    {"0x7fffffffffffffff", NUMBER_TYPE_LONG, 0x7fffffffffffffff},
+    {"0xffffffffffffffff", NUMBER_TYPE_UNSIGNED_LONG, 0xffffffffffffffff},
+    {"0XaBcDeF", NUMBER_TYPE_INT, 0xabcdef},
+    {"0x0000000000000000001", NUMBER_TYPE_INT, 1},
+    {"0b1011", NUMBER_TYPE_INT, 11},
+    {"0B11111111111111111111111111111111", NUMBER_TYPE_UNSIGNED_INT,
+     0xffffffff},
+    {"0777", NUMBER_TYPE_INT, 0777},
+    {"00", NUMBER_TYPE_INT, 0},
+    {"017777777777", NUMBER_TYPE_INT, 017777777777},
+    {"020000000000", NUMBER_TYPE_UNSIGNED_INT, 020000000000},
+    {"01777777777777777777777", NUMBER_TYPE_UNSIGNED_LONG,
+     01777777777777777777777},
+    // suffixes, in either case and order.
+    {"1u", NUMBER_TYPE_UNSIGNED_INT, 1},
+    {"1U", NUMBER_TYPE_UNSIGNED_INT, 1},
+    {"1l", NUMBER_TYPE_LONG, 1},
+    {"1L", NUMBER_TYPE_LONG, 1},
+    {"1ul", NUMBER_TYPE_UNSIGNED_LONG, 1},
+    {"1LU", NUMBER_TYPE_UNSIGNED_LONG, 1},
+    {"1ll", NUMBER_TYPE_LONG_LONG, 1},
+    {"1LL", NUMBER_TYPE_LONG_LONG, 1},
+    {"1ULL", NUMBER_TYPE_UNSIGNED_LONG_LONG, 1},
+    {"1llu", NUMBER_TYPE_UNSIGNED_LONG_LONG, 1},
+    {"4294967295u", NUMBER_TYPE_UNSIGNED_INT, 4294967295},
+    {"4294967296u", NUMBER_TYPE_UNSIGNED_LONG, 4294967296},
+    {"2147483648l", NUMBER_TYPE_LONG, 2147483648},
+    {"18446744073709551615u", NUMBER_TYPE_UNSIGNED_LONG,
+     18446744073709551615ull},
+    {"18446744073709551615ull", NUMBER_TYPE_UNSIGNED_LONG_LONG,
+     18446744073709551615ull},
+    {"0xffffffffffffffffll", NUMBER_TYPE_UNSIGNED_LONG_LONG,
+     0xffffffffffffffff},
+    // runs of digits ending before, on and after the 8 byte words.
+    {"1234567", NUMBER_TYPE_INT, 1234567},
+    {"12345678", NUMBER_TYPE_INT, 12345678},
+    {"123456789", NUMBER_TYPE_INT, 123456789},
+    {"1234567812345678", NUMBER_TYPE_LONG, 1234567812345678},
+    {"12345678123456781", NUMBER_TYPE_LONG, 12345678123456781},
+    {"123456789012345678", NUMBER_TYPE_LONG, 123456789012345678},
+    {"1000000000000000000", NUMBER_TYPE_LONG, 1000000000000000000},
+    {"9999999999999999999u", NUMBER_TYPE_UNSIGNED_LONG,
+     9999999999999999999ull},
+    {"0000000000000000000000007", NUMBER_TYPE_INT, 7},
+};
+
+// Floating literals and their type, their value is the one strtod (strtof
+// for float) reads from them.
+static const struct {
+    const char *source;
+    int type;
+} floats[] = {
+    {"1.5", NUMBER_TYPE_DOUBLE},
+    {"1.", NUMBER_TYPE_DOUBLE},
+    {"0.25", NUMBER_TYPE_DOUBLE},
+    {"1e10", NUMBER_TYPE_DOUBLE},
+    {"1E-3", NUMBER_TYPE_DOUBLE},
+    {"2.5e+3", NUMBER_TYPE_DOUBLE},
+    {"6.02214076e23", NUMBER_TYPE_DOUBLE},
+    {"0123.5", NUMBER_TYPE_DOUBLE},
+    {"1.5f", NUMBER_TYPE_FLOAT},
+    {"1.F", NUMBER_TYPE_FLOAT},
+    {"3e2f", NUMBER_TYPE_FLOAT},
+    {"1.5L", NUMBER_TYPE_LONG_DOUBLE},
+    {"1e-2l", NUMBER_TYPE_LONG_DOUBLE},
+    {"0x1p4", NUMBER_TYPE_DOUBLE},
+    {"0x1.8p1", NUMBER_TYPE_DOUBLE},
+    {"0XA.Bp-2", NUMBER_TYPE_DOUBLE},
+    {"0x1p-1f", NUMBER_TYPE_FLOAT},
+    {"3.14159265358979323846", NUMBER_TYPE_DOUBLE},
+    {"12345678.87654321", NUMBER_TYPE_DOUBLE},
+    {"123456789012345678901234567890.5", NUMBER_TYPE_DOUBLE},
+    {"1.7976931348623157e308", NUMBER_TYPE_DOUBLE},
+    {"4.9406564584124654e-324", NUMBER_TYPE_DOUBLE},
+};
+
+// Sources that don't lex and the message they're refused with.
+static const struct {
+    const char *source;
+    const char *message;
+} errors[] = {
+    {"18446744073709551616", "too large"},
+    {"18446744073709551616u", "too large"},
+    {"99999999999999999999999", "too large"},
+    // no signed type holds it and unsuffixed decimal has no unsigned one.
+    {"9223372036854775808", "too large"},
+    {"0x10000000000000000", "too large"},
+    {"0200000000000000000000000", "too large"},
+    {"08", "Invalid numeric literal"},
+    {"0x", "Invalid numeric literal"},
+    {"0b", "Invalid numeric literal"},
+    {"0b102", "Invalid numeric literal"},
+    {"1e", "Invalid numeric literal"},
+    {"1e+", "Invalid numeric literal"},
+    {"0x1.8", "Invalid numeric literal"},
+    {"1.2.3", "Invalid numeric literal"},
+    {"12abc", "Invalid numeric literal"},
+    {"1lL", "Invalid numeric literal"},
+    {"1uu", "Invalid numeric literal"},
+    {"1.5u", "Invalid numeric literal"},
+};
+
+static struct buffer object;
+
+// Lexes `source` alone, returns its compiler with one token or NULL.
+static struct compiler *lex(const char *source) {
+    buffer_init(&object);
+    struct compiler *c = compiler_create_from_memory(
+        source, strlen(source), "numbers.c", &object, 0);
+    c->lexer = lexer_create(c);
+    if (lexer_lex(c->lexer) != LEXICAL_ANALYSIS_ALL_OK ||
+        segvector_count(c->lexer->token_vec) != 1) {
+        fprintf(stderr, "lexer_numbers: '%s' isn't one token\n", source);
+        failures++;
+        compiler_free(c);
+        return NULL;
+    }
+    struct token *token = segvector_at(c->lexer->token_vec, 0);
+    if (token->type != TOKEN_TYPE_NUMBER) {
+        fprintf(stderr, "lexer_numbers: '%s' isn't a number\n", source);
+        failures++;
+        compiler_free(c);
+        return NULL;
+    }
+    return c;
+}
+
+// Checks `source` fails to lex, reporting `message`.
+static void check_error(const char *source, const char *message) {
+    char report[512] = "";
+    FILE *out = tmpfile();
+    fflush(stdout);
+    int saved_stdout = dup(1);
+    dup2(fileno(out), 1);
+    buffer_init(&object);
+    struct compiler *c = compiler_create_from_memory(
+        source, strlen(source), "numbers.c", &object, 0);
+    jmp_buf jmp;
+    int failed = 0;
+    compiler_catch_errors(&jmp);
+    if (setjmp(jmp))
+        failed = 1;
+    else {
+        c->lexer = lexer_create(c);
+        lexer_lex(c->lexer);
+    }
+    compiler_catch_errors(NULL);
+    fflush(stdout);
+    dup2(saved_stdout, 1);
+    close(saved_stdout);
+    rewind(out);
+    size_t len = fread(report, 1, sizeof(report) - 1, out);
+    report[len] = 0;
+    fclose(out);
+    compiler_free(c);
+
+    if (!failed)
+        fprintf(stderr, "lexer_numbers: '%s' lexed\n", source);
+    else if (!strstr(report, message))
+        fprintf(stderr, "lexer_numbers: '%s' didn't report '%s': %s", source,
+                message, report);
+    else
+        return;
+    failures++;
+}
+
+int main(void) {
+    size_t integer_count = sizeof(integers) / sizeof(*integers);
+    for (size_t i = 0; i < integer_count; i++) {
+        struct compiler *c = lex(integers[i].source);
+        if (!c) continue;
+        struct token *token = segvector_at(c->lexer->token_vec, 0);
+        if (token->number_type != integers[i].type ||
+            (unsigned long long)token->llnum != integers[i].value) {
+            fprintf(stderr,
+                    "lexer_numbers: '%s' is %llu of type %d, not %llu of "
+                    "type %d\n",
+                    integers[i].source, (unsigned long long)token->llnum,
+                    token->number_type, integers[i].value, integers[i].type);
+            failures++;
+        }
+        CHECK(token->spelling_len == strlen(integers[i].source));
+        compiler_free(c);
+    }
+
+    size_t float_count = sizeof(floats) / sizeof(*floats);
+    for (size_t i = 0; i < float_count; i++) {
+        struct compiler *c = lex(floats[i].source);
+        if (!c) continue;
+        struct token *token = segvector_at(c->lexer->token_vec, 0);
+        double value = floats[i].type == NUMBER_TYPE_FLOAT
+                           ? strtof(floats[i].source, NULL)
+                           : strtod(floats[i].source, NULL);
+        if (token->number_type != floats[i].type || token->dval != value) {
+            fprintf(stderr,
+                    "lexer_numbers: '%s' is %a of type %d, not %a of type "
+                    "%d\n",
+                    floats[i].source, token->dval, token->number_type, value,
+                    floats[i].type);
+            failures++;
+        }
+        compiler_free(c);
+    }
+
+    // a literal is as long as its digits whatever follows it.
+    struct compiler *c = compiler_create_from_memory(
+        "x=123456789+0x10-07;", 20, "numbers.c", &object, 0);
+    c->lexer = lexer_create(c);
+    CHECK(lexer_lex(c->lexer) == LEXICAL_ANALYSIS_ALL_OK);
+    CHECK(segvector_count(c->lexer->token_vec) == 8);
+    struct token *token = segvector_peek_at(c->lexer->token_vec, 2);
+    CHECK(token && token->llnum == 123456789 && token->spelling_len == 9);
+    token = segvector_peek_at(c->lexer->token_vec, 4);
+    CHECK(token && token->llnum == 16 && token->spelling_len == 4);
+    token = segvector_peek_at(c->lexer->token_vec, 6);
+    CHECK(token && token->type == TOKEN_TYPE_NUMBER && token->llnum == 7);
+    compiler_free(c);
+
+    size_t error_count = sizeof(errors) / sizeof(*errors);
+    for (size_t i = 0; i < error_count; i++)
+        check_error(errors[i].source, errors[i].message);
+
+    buffer_release(&object);
+    if (failures) return 1;
+    printf("lexer_numbers: %zu integers, %zu floats, %zu errors, ok\n",
+           integer_count, float_count, error_count);
+    return 0;
+}
@@ -0,0 +1,185 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "../../helpers/buffer.h"
+#include "../../helpers/segvector.h"
+#include "../../src/compiler.h"
+#include "../../src/lexer.h"
+#include "../../src/lexer_token.h"
+
+// Every operator is recognized on its own, the longest operator is always
+// taken, and nothing is read past the end of the input to do it.
+
+static int failures;
+
+static const struct {
+    int op;
+    const char *spelling;
+} operators[] = {
+    {OPERATOR_PLUS, "+"},
+    {OPERATOR_MINUS, "-"},
+    {OPERATOR_STAR, "*"},
+    {OPERATOR_SLASH, "/"},
+    {OPERATOR_PERCENT, "%"},
+    {OPERATOR_LESS, "<"},
+    {OPERATOR_GREATER, ">"},
+    {OPERATOR_ASSIGN, "="},
+    {OPERATOR_NOT, "!"},
+    {OPERATOR_TILDE, "~"},
+    {OPERATOR_AMPERSAND, "&"},
+    {OPERATOR_PIPE, "|"},
+    {OPERATOR_CARET, "^"},
+    {OPERATOR_QUESTION, "?"},
+    {OPERATOR_COMMA, ","},
+    {OPERATOR_DOT, "."},
+    {OPERATOR_LEFT_PAREN, "("},
+    {OPERATOR_LEFT_BRACKET, "["},
+    {OPERATOR_INCREMENT, "++"},
+    {OPERATOR_DECREMENT, "--"},
+    {OPERATOR_ARROW, "->"},
+    {OPERATOR_PLUS_ASSIGN, "+="},
+    {OPERATOR_MINUS_ASSIGN, "-="},
+    {OPERATOR_STAR_ASSIGN, "*="},
+    {OPERATOR_SLASH_ASSIGN, "/="},
+    {OPERATOR_PERCENT_ASSIGN, "%="},
+    {OPERATOR_LESS_EQUAL, "<="},
+    {OPERATOR_GREATER_EQUAL, ">="},
+    {OPERATOR_EQUAL, "=="},
+    {OPERATOR_NOT_EQUAL, "!="},
+    {OPERATOR_LOGICAL_AND, "&&"},
+    {OPERATOR_LOGICAL_OR, "||"},
+    {OPERATOR_SHIFT_LEFT, "<<"},
+    {OPERATOR_SHIFT_RIGHT, ">>"},
+    {OPERATOR_AMPERSAND_ASSIGN, "&="},
+    {OPERATOR_PIPE_ASSIGN, "|="},
+    {OPERATOR_CARET_ASSIGN, "^="},
+    {OPERATOR_SHIFT_LEFT_ASSIGN, "<<="},
+    {OPERATOR_SHIFT_RIGHT_ASSIGN, ">>="},
+    {OPERATOR_ELLIPSIS, "..."},
+};
+
+// Sources and the tokens they split into, separated by spaces. Only the
+// first `len` bytes of a source are lexed when `len` isn't 0, the rest
+// would make a longer operator.
+static const struct {
+    const char *source;
+    size_t len;
+    const char *tokens;
+} splits[] = {
+    {"a+++b", 0, "a ++ + b"},
+    {"a---b", 0, "a -- - b"},
+    {"a-->b", 0, "a -- > b"},
+    {"a->b", 0, "a -> b"},
+    {"a->>b", 0, "a -> > b"},
+    {"a>>=b", 0, "a >>= b"},
+    {"a>>>=b", 0, "a >> >= b"},
+    {"a<<<=b", 0, "a << <= b"},
+    {"a<<==b", 0, "a <<= = b"},
+    {"a<=>b", 0, "a <= > b"},
+    {"a&&&b", 0, "a && & b"},
+    {"a|||b", 0, "a || | b"},
+    {"a!==b", 0, "a != = b"},
+    {"a===b", 0, "a == = b"},
+    {"a+=-b", 0, "a += - b"},
+    {"a/=b", 0, "a /= b"},
+    {"a..b", 0, "a . . b"},
+    {"a....b", 0, "a ... . b"},
+    {"f(a,...)", 0, "f ( a , ... )"},
+    {"s.a->b[0]", 0, "s . a -> b [ 0 ]"},
+    {"a<<=", 3, "a <<"},
+    {"a<<=", 2, "a <"},
+    {"a>>=", 3, "a >>"},
+    {"a...", 3, "a . ."},
+    {"a+=", 2, "a +"},
+    {"a->", 2, "a -"},
+    {"a&&", 2, "a &"},
+};
+
+static struct compiler *lex(const char *source, size_t len) {
+    static struct buffer object;
+    buffer_init(&object);
+    struct compiler *c =
+        compiler_create_from_memory(source, len, "operators.c", &object, 0);
+    c->lexer = lexer_create(c);
+    if (lexer_lex(c->lexer) != LEXICAL_ANALYSIS_ALL_OK) {
+        fprintf(stderr, "lexer_operators: '%.*s' doesn't lex\n", (int)len,
+                source);
+        failures++;
+    }
+    return c;
+}
+
+// Checks `source` lexes to the tokens spelled in `tokens`, an operator
+// spelling only matching an operator token of that operator.
+static void check(const char *source, size_t len, const char *tokens) {
+    struct compiler *c = lex(source, len);
+    struct segvector *vec = c->lexer->token_vec;
+    char expected[64];
+    snprintf(expected, sizeof(expected), "%s", tokens);
+    int index = 0;
+    for (char *spelling = strtok(expected, " "); spelling;
+         spelling = strtok(NULL, " "), index++) {
+        struct token *token = segvector_peek_at(vec, index);
+        if (!token || token->spelling_len != strlen(spelling) ||
+            memcmp(token->spelling, spelling, token->spelling_len) ||
+            (token->type == TOKEN_TYPE_OPERATOR &&
+             strcmp(operator_spelling(token->op), spelling))) {
+            fprintf(stderr,
+                    "lexer_operators: token %d of '%.*s' isn't '%s'\n", index,
+                    (int)len, source, spelling);
+            failures++;
+            break;
+        }
+    }
+    int count = segvector_count(vec);
+    if (count != index) {
+        fprintf(stderr, "lexer_operators: '%.*s' has %d tokens, not %d\n",
+                (int)len, source, count, index);
+        failures++;
+    }
+    compiler_free(c);
+}
+
+int main(void) {
+    int count = sizeof(operators) / sizeof(*operators);
+    if (count != OPERATOR_COUNT - 1) {
+        fprintf(stderr, "lexer_operators: %d operators tested of %d\n", count,
+                OPERATOR_COUNT - 1);
+        failures++;
+    }
+    for (int i = 0; i < count; i++) {
+        // each operator between two names, and written on its own.
+        char source[32];
+        const char *closing = operators[i].op == OPERATOR_LEFT_PAREN     ? ")"
+                              : operators[i].op == OPERATOR_LEFT_BRACKET ? "]"
+                                                                         : "";
+        snprintf(source, sizeof(source), "a %s b %s", operators[i].spelling,
+                 closing);
+        struct compiler *c = lex(source, strlen(source));
+        struct token *token = segvector_peek_at(c->lexer->token_vec, 1);
+        if (!token || token->type != TOKEN_TYPE_OPERATOR ||
+            token->op != operators[i].op) {
+            fprintf(stderr, "lexer_operators: '%s' isn't its operator\n",
+                    operators[i].spelling);
+            failures++;
+        }
+        compiler_free(c);
+        snprintf(source, sizeof(source), "a%sb%s", operators[i].spelling,
+                 closing);
+        char tokens[32];
+        snprintf(tokens, sizeof(tokens), "a %s b%s%s", operators[i].spelling,
+                 *closing ? " " : "", closing);
+        check(source, strlen(source), tokens);
+    }
+
+    for (size_t i = 0; i < sizeof(splits) / sizeof(*splits); i++) {
+        const char *source = splits[i].source;
+        check(source, splits[i].len ? splits[i].len : strlen(source),
+              splits[i].tokens);
+    }
+
+    if (failures) return 1;
+    printf("lexer_operators: %d operators, %zu splits, ok\n", count,
+           sizeof(splits) / sizeof(*splits));
+    return 0;
+}
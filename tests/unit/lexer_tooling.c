@@ -0,0 +1,110 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "../../helpers/buffer.h"
+#include "../../helpers/segvector.h"
+#include "../../src/compiler.h"
+#include "../../src/lexer.h"
+
+// The tooling profile compiles the same source the compile profile does,
+// directives included, and its raw tokens and trivia reproduce the source
+// byte for byte.
+
+static const char source[] =
+    "// leading comment\n"
+    "#define SQUARE(x) \\\n"
+    "    ((x) * (x))\n"
+    "#define LIMIT 10\n"
+    "#ifdef NOT_DEFINED\n"
+    "this group is inactive and isn't C at all\n"
+    "#else\n"
+    "int square(int x) { return SQUARE(x); }   /* trailing */\n"
+    "#endif\n"
+    "#if 0\n"
+    "#else\n"
+    "#endif\n"
+    "#if LIMIT < 5\n"
+    "#if 1\n"
+    "  nested ' quote\n"
+    "#endif\n"
+    "#elif LIMIT > 5\n"
+    "int five = 5;\n"
+    "#endif\n"
+    "\n"
+    "int main(void) {\n"
+    "\tint total = 0;\n"
+    "\tfor (int i = 0; i < LIMIT; i++) total += square(i);\n"
+    "\treturn total == 285 ? 0 : 1;\n"
+    "}\n";
+
+static int compile(int flags, struct compiler **out) {
+    static struct buffer object;
+    buffer_init(&object);
+    *out = compiler_create_from_memory(source, sizeof(source) - 1, "tooling.c",
+                                       &object, flags);
+    int result = compile_file(*out);
+    buffer_release(&object);
+    return result;
+}
+
+// Appends the trivia preceding raw token `index` to `text`.
+static void append_trivia(struct lexer *lexer, int index, struct buffer *text) {
+    int count;
+    struct trivia *trivia = lexer_trivia(lexer, index, &count);
+    for (int i = 0; i < count; i++)
+        buffer_write_bytes(text, trivia[i].text, trivia[i].len);
+}
+
+int main(void) {
+    int failures = 0;
+    struct compiler *plain, *tooling;
+    if (compile(0, &plain) != COMPILER_FILE_COMPILED_OK) {
+        fprintf(stderr, "lexer_tooling: the compile profile failed\n");
+        failures++;
+    }
+    if (compile(COMPILER_FLAG_LEX_TOOLING, &tooling) !=
+        COMPILER_FILE_COMPILED_OK) {
+        fprintf(stderr, "lexer_tooling: the tooling profile failed\n");
+        failures++;
+    }
+
+    // the parser got the same tokens.
+    struct segvector *a = plain->lexer->token_vec;
+    struct segvector *b = tooling->lexer->token_vec;
+    if (segvector_count(a) != segvector_count(b)) {
+        fprintf(stderr, "lexer_tooling: %d tokens compiled, %d with tooling\n",
+                segvector_count(a), segvector_count(b));
+        failures++;
+    }
+
+    struct lexer *lexer = tooling->lexer;
+    struct buffer text;
+    buffer_init(&text);
+    int count = segvector_count(lexer->raw_tokens);
+    for (int i = 0; i < count; i++) {
+        append_trivia(lexer, i, &text);
+        struct token *token = segvector_at(lexer->raw_tokens, i);
+        buffer_write_bytes(&text, token->spelling, token->spelling_len);
+    }
+    append_trivia(lexer, count, &text);
+    if (buffer_len(&text) != sizeof(source) - 1 ||
+        memcmp(buffer_ptr(&text), source, sizeof(source) - 1)) {
+        fprintf(stderr, "lexer_tooling: the source came back as:\n%.*s\n",
+                (int)buffer_len(&text), (char *)buffer_ptr(&text));
+        failures++;
+    }
+    // the compile profile records neither.
+    int plain_trivia;
+    lexer_trivia(plain->lexer, 0, &plain_trivia);
+    if (segvector_count(plain->lexer->raw_tokens) || plain_trivia) {
+        fprintf(stderr, "lexer_tooling: the compile profile kept trivia\n");
+        failures++;
+    }
+
+    buffer_release(&text);
+    compiler_free(plain);
+    compiler_free(tooling);
+    if (failures) return 1;
+    printf("lexer_tooling: %d raw tokens, ok\n", count);
+    return 0;
+}
@@ -0,0 +1,191 @@
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../../helpers/buffer.h"
+#include "../../helpers/segvector.h"
+#include "../../src/compiler.h"
+#include "../../src/lexer.h"
+#include "../../src/token_stream.h"
+
+// A compile with COMPILER_FLAG_PIPELINED, the parser taking the tokens from
+// the ring as the lexer thread produces them, makes the object a serial
+// compile makes, byte for byte: for the programs of tests/programs and for a
+// source of many times the tokens the ring holds, which fills it over and
+// over. A broken source is reported as a serial compile reports it.
+
+static int failures;
+
+// Tokens the ring holds at once.
+#define RING_TOKENS (TOKEN_STREAM_BATCHES * SEGVECTOR_BLOCK_ELEMENTS)
+
+static const char *broken[] = {
+    // a parse error early, a lexical error far later.
+    "int main(void) { return 1 +; }\nint f(void) { return 'a; }\n",
+    "int main(void) { return 0 }\n",
+    "int main(void) { return \"abc; }\n",
+};
+
+// Writes a source of `functions` functions to `source`.
+static void generate(struct buffer *source, int functions) {
+    buffer_printf(source, "int printf(const char *fmt, ...);\n");
+    buffer_printf(source, "long f0(long x) { return x + 1; }\n");
+    for (int i = 1; i < functions; i++)
+        buffer_printf(source,
+                      "long f%d(long x) {\n"
+                      "    long a[4] = {x, %d, x * %d, -x};\n"
+                      "    for (int i = 0; i < 4; i++) x += a[i] ^ (i << %d);\n"
+                      "    return f%d(x %% 1000003) + \"f%d\"[1];\n"
+                      "}\n",
+                      i, i, i % 17, i % 5, i - 1, i);
+    buffer_printf(source, "int main(void) { printf(\"%%ld\\n\", f%d(1)); "
+                          "return 0; }\n",
+                  functions - 1);
+}
+
+// Compiles `len` bytes of `src` with `flags` into `object`, what's reported
+// goes to `report` if it's not NULL. Returns the result and writes the amount
+// of tokens to `tokens`.
+static int compile(const char *src, size_t len, int flags,
+                   struct buffer *object, struct buffer *report,
+                   int *tokens) {
+    FILE *out = NULL;
+    int saved_stdout = -1;
+    if (report) {
+        out = tmpfile();
+        fflush(stdout);
+        saved_stdout = dup(1);
+        dup2(fileno(out), 1);
+    }
+    buffer_init(object);
+    struct compiler *c =
+        compiler_create_from_memory(src, len, "pipelined.c", object, flags);
+    int result = compile_file(c);
+    if (tokens) *tokens = segvector_count(c->lexer->token_vec);
+    compiler_free(c);
+    if (report) {
+        fflush(stdout);
+        dup2(saved_stdout, 1);
+        close(saved_stdout);
+        rewind(out);
+        buffer_init(report);
+        int ch;
+        while ((ch = fgetc(out)) != EOF) buffer_write(report, ch);
+        fclose(out);
+    }
+    return result;
+}
+
+static bool same(struct buffer *a, struct buffer *b) {
+    return buffer_len(a) == buffer_len(b) &&
+           !memcmp(buffer_ptr(a), buffer_ptr(b), buffer_len(a));
+}
+
+// Checks the pipelined object of `src` is the serial one.
+static void check(const char *src, size_t len, const char *name) {
+    struct buffer serial, pipelined;
+    int serial_tokens, pipelined_tokens;
+    int result = compile(src, len, 0, &serial, NULL, &serial_tokens);
+    if (result != COMPILER_FILE_COMPILED_OK) {
+        fprintf(stderr, "pipelined: %s doesn't compile\n", name);
+        failures++;
+    }
+    if (compile(src, len, COMPILER_FLAG_PIPELINED, &pipelined, NULL,
+                &pipelined_tokens) != result) {
+        fprintf(stderr, "pipelined: %s fails pipelined only\n", name);
+        failures++;
+    } else if (serial_tokens != pipelined_tokens || !same(&serial, &pipelined)) {
+        fprintf(stderr, "pipelined: the object of %s differs\n", name);
+        failures++;
+    }
+    buffer_release(&serial);
+    buffer_release(&pipelined);
+}
+
+// Returns the contents of `path`, NULL if it can't be read.
+static char *read_file(const char *path, size_t *len) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    fseek(f, 0, SEEK_END);
+    *len = ftell(f);
+    rewind(f);
+    char *data = malloc(*len + 1);
+    if (fread(data, 1, *len, f) != *len) {
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+    return data;
+}
+
+int main(void) {
+    int programs = 0;
+    DIR *dir = opendir("tests/programs");
+    if (!dir) {
+        fprintf(stderr, "pipelined: tests/programs can't be read\n");
+        return 1;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir))) {
+        size_t name_len = strlen(entry->d_name);
+        if (name_len < 3 || strcmp(entry->d_name + name_len - 2, ".c"))
+            continue;
+        char path[512];
+        snprintf(path, sizeof(path), "tests/programs/%s", entry->d_name);
+        size_t len;
+        char *src = read_file(path, &len);
+        if (!src) {
+            fprintf(stderr, "pipelined: %s can't be read\n", path);
+            failures++;
+            continue;
+        }
+        check(src, len, path);
+        free(src);
+        programs++;
+    }
+    closedir(dir);
+    if (!programs) {
+        fprintf(stderr, "pipelined: no programs in tests/programs\n");
+        failures++;
+    }
+
+    struct buffer large, object;
+    buffer_init(&large);
+    generate(&large, 3000);
+    int tokens;
+    compile(buffer_ptr(&large), buffer_len(&large), 0, &object, NULL, &tokens);
+    buffer_release(&object);
+    if (tokens < 8 * RING_TOKENS) {
+        fprintf(stderr, "pipelined: the large source has %d tokens, the ring "
+                        "holds %d\n", tokens, RING_TOKENS);
+        failures++;
+    }
+    check(buffer_ptr(&large), buffer_len(&large), "the large source");
+    buffer_release(&large);
+
+    for (size_t i = 0; i < sizeof(broken) / sizeof(*broken); i++) {
+        struct buffer serial_report, pipelined_report, serial, pipelined;
+        int serial_result = compile(broken[i], strlen(broken[i]), 0, &serial,
+                                    &serial_report, NULL);
+        int pipelined_result =
+            compile(broken[i], strlen(broken[i]), COMPILER_FLAG_PIPELINED,
+                    &pipelined, &pipelined_report, NULL);
+        if (serial_result != COMPILER_FAILED_WITH_ERRORS ||
+            pipelined_result != COMPILER_FAILED_WITH_ERRORS ||
+            !same(&serial_report, &pipelined_report)) {
+            fprintf(stderr, "pipelined: broken source %zu is reported "
+                            "differently\n", i);
+            failures++;
+        }
+        buffer_release(&serial_report);
+        buffer_release(&pipelined_report);
+        buffer_release(&serial);
+        buffer_release(&pipelined);
+    }
+
+    if (failures) return 1;
+    printf("pipelined: %d programs and %d tokens, ok\n", programs, tokens);
+    return 0;
+}
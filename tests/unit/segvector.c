@@ -0,0 +1,64 @@
+#include <stdio.h>
+
+#include "../../helpers/segvector.h"
+
+static int failures;
+
+#define CHECK(condition)                                                    \
+    do {                                                                    \
+        if (!(condition)) {                                                 \
+            fprintf(stderr, "segvector: %s:%d: %s\n", __FILE__, __LINE__,   \
+                    #condition);                                            \
+            failures++;                                                     \
+        }                                                                   \
+    } while (0)
+
+#define ELEMENTS (SEGVECTOR_BLOCK_ELEMENTS * SEGVECTOR_DIRECTORY_INCREMENT * 4)
+
+struct element {
+    long value;
+    char tag;
+};
+
+int main(void) {
+    // pointers returned by push stay valid while the blocks and the
+    // directory grow.
+    static struct element *pushed[ELEMENTS];
+    struct segvector *vec = segvector_create(sizeof(struct element));
+    CHECK(segvector_empty(vec) && !segvector_back_or_null(vec));
+    for (long i = 0; i < ELEMENTS; i++) {
+        struct element e = {i * 7, (char)i};
+        pushed[i] = segvector_push(vec, &e);
+    }
+    CHECK(segvector_count(vec) == ELEMENTS);
+    CHECK(vec->block_capacity > SEGVECTOR_DIRECTORY_INCREMENT);
+    for (long i = 0; i < ELEMENTS; i++) {
+        CHECK(pushed[i] == segvector_at(vec, i));
+        CHECK(pushed[i]->value == i * 7 && pushed[i]->tag == (char)i);
+    }
+    CHECK(!segvector_peek_at(vec, ELEMENTS) && !segvector_peek_at(vec, -1));
+    CHECK(segvector_back_or_null(vec) == pushed[ELEMENTS - 1]);
+
+    // blocks are contiguous and hold the elements in order.
+    long seen = 0;
+    for (int b = 0; b < segvector_block_count(vec); b++) {
+        int n;
+        struct element *block = segvector_block(vec, b, &n);
+        CHECK(n == SEGVECTOR_BLOCK_ELEMENTS);
+        for (int i = 0; i < n; i++) CHECK(&block[i] == pushed[seen++]);
+    }
+    CHECK(seen == ELEMENTS);
+
+    // pop and clear keep the blocks, pushes reuse the same addresses.
+    segvector_pop(vec);
+    CHECK(segvector_back_or_null(vec) == pushed[ELEMENTS - 2]);
+    segvector_clear(vec);
+    CHECK(segvector_empty(vec) && segvector_block_count(vec) == 0);
+    struct element e = {-1, 'x'};
+    CHECK(segvector_push(vec, &e) == pushed[0]);
+    segvector_free(vec);
+
+    if (failures) return 1;
+    printf("segvector: %d elements, ok\n", ELEMENTS);
+    return 0;
+}
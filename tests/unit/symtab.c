@@ -0,0 +1,114 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "../../src/symtab.h"
+
+static int failures;
+
+#define CHECK(condition)                                                    \
+    do {                                                                    \
+        if (!(condition)) {                                                 \
+            fprintf(stderr, "symtab: %s:%d: %s\n", __FILE__, __LINE__,      \
+                    #condition);                                            \
+            failures++;                                                     \
+        }                                                                   \
+    } while (0)
+
+// Name ids, as an interner would hand them out.
+enum { X = 1, Y, Z };
+
+int main(void) {
+    struct symtab st;
+    symtab_init(&st);
+    CHECK(symtab_lookup(&st, X) == 0);
+
+    // a file scope name shadowed by two nested scopes, then redeclared in
+    // the inner one.
+    uint32_t file_x = symtab_insert(&st, X, 100);
+    CHECK(symtab_lookup(&st, X) == file_x);
+    CHECK(symtab_symbol(&st, file_x)->depth == 0);
+    CHECK(symtab_symbol(&st, file_x)->shadowed == 0);
+
+    symtab_enter(&st);
+    uint32_t outer_x = symtab_insert(&st, X, 101);
+    uint32_t outer_y = symtab_insert(&st, Y, 102);
+    CHECK(symtab_lookup(&st, X) == outer_x);
+    CHECK(symtab_symbol(&st, outer_x)->shadowed == file_x);
+    CHECK(symtab_symbol(&st, outer_x)->depth == 1);
+    CHECK(symtab_symbol(&st, outer_y)->shadowed == 0);
+
+    symtab_enter(&st);
+    uint32_t inner_x = symtab_insert(&st, X, 103);
+    uint32_t again_x = symtab_insert(&st, X, 104);
+    CHECK(symtab_lookup(&st, X) == again_x);
+    CHECK(symtab_lookup(&st, Y) == outer_y);
+    CHECK(symtab_symbol(&st, inner_x)->shadowed == outer_x);
+    CHECK(symtab_symbol(&st, again_x)->shadowed == inner_x);
+    CHECK(symtab_symbol(&st, again_x)->depth == 2);
+
+    // leaving unwinds the redeclaration as well, back to the outer binding.
+    symtab_leave(&st);
+    CHECK(symtab_lookup(&st, X) == outer_x);
+    CHECK(symtab_lookup(&st, Y) == outer_y);
+    symtab_leave(&st);
+    CHECK(symtab_lookup(&st, X) == file_x);
+    CHECK(symtab_lookup(&st, Y) == 0);
+
+    // the records of left scopes stay for later passes.
+    CHECK(symtab_symbol(&st, inner_x)->node == 103);
+    CHECK(symtab_symbol(&st, outer_y)->name == Y);
+
+    // a scope declaring nothing leaves the bindings alone, and a file scope
+    // name declared after a scope was left has no undo entry to lose.
+    symtab_enter(&st);
+    symtab_leave(&st);
+    uint32_t file_z = symtab_insert(&st, Z, 105);
+    symtab_enter(&st);
+    symtab_insert(&st, Z, 106);
+    symtab_leave(&st);
+    CHECK(symtab_lookup(&st, Z) == file_z);
+    CHECK(symtab_lookup(&st, X) == file_x);
+
+    // ids past the bindings are unbound, binding one grows the bindings
+    // without binding the ids before it.
+    CHECK(symtab_lookup(&st, 100000) == 0);
+    symtab_enter(&st);
+    uint32_t far = symtab_insert(&st, 100000, 107);
+    CHECK(symtab_lookup(&st, 100000) == far);
+    CHECK(symtab_lookup(&st, 99999) == 0);
+    CHECK(symtab_lookup(&st, X) == file_x);
+    symtab_leave(&st);
+    CHECK(symtab_lookup(&st, 100000) == 0);
+
+    // a name shadowed at each of 1000 depths gets each binding back in
+    // turn.
+    uint32_t nested[1000];
+    for (int i = 0; i < 1000; i++) {
+        symtab_enter(&st);
+        nested[i] = symtab_insert(&st, Y, 200 + i);
+        if (i % 3 == 0) symtab_insert(&st, X, 200 + i);
+    }
+    for (int i = 999; i >= 0; i--) {
+        CHECK(symtab_lookup(&st, Y) == nested[i]);
+        symtab_leave(&st);
+    }
+    CHECK(symtab_lookup(&st, Y) == 0);
+    CHECK(symtab_lookup(&st, X) == file_x);
+    CHECK(st.depth == 0 && st.undo_len == 0);
+
+    // a reset forgets every symbol and scope, indices start over.
+    symtab_enter(&st);
+    symtab_insert(&st, Y, 300);
+    symtab_reset(&st);
+    CHECK(st.depth == 0);
+    CHECK(symtab_lookup(&st, X) == 0);
+    CHECK(symtab_lookup(&st, Y) == 0);
+    CHECK(symtab_lookup(&st, Z) == 0);
+    CHECK(symtab_insert(&st, Y, 301) == file_x);
+    CHECK(symtab_symbol(&st, file_x)->shadowed == 0);
+
+    symtab_free(&st);
+    if (failures) return 1;
+    printf("symtab: ok\n");
+    return 0;
+}
@@ -0,0 +1,207 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../../helpers/utf8.h"
+
+// utf8_validate agrees with a decoder written from the definition of UTF-8
+// on malformed sequences placed across the 16 byte blocks the vectorized
+// check reads, and on random buffers, the vectorized check agrees with the
+// scalar one and both report the first bad sequence where it starts.
+
+static int failures;
+
+#define CHECK(condition)                                                    \
+    do {                                                                    \
+        if (!(condition)) {                                                 \
+            fprintf(stderr, "utf8: %s:%d: %s\n", __FILE__, __LINE__,        \
+                    #condition);                                            \
+            failures++;                                                     \
+        }                                                                   \
+    } while (0)
+
+static const struct {
+    const char *bytes;
+    int valid;
+} sequences[] = {
+    {"\xC2\x80", 1},
+    {"\xDF\xBF", 1},
+    {"\xE0\xA0\x80", 1},
+    {"\xED\x9F\xBF", 1},
+    {"\xEE\x80\x80", 1},
+    {"\xEF\xBF\xBF", 1},
+    {"\xF0\x90\x80\x80", 1},
+    {"\xF4\x8F\xBF\xBF", 1},
+    // overlong.
+    {"\xC0\x80", 0},
+    {"\xC1\xBF", 0},
+    {"\xE0\x80\x80", 0},
+    {"\xE0\x9F\xBF", 0},
+    {"\xF0\x80\x80\x80", 0},
+    {"\xF0\x8F\xBF\xBF", 0},
+    // surrogates.
+    {"\xED\xA0\x80", 0},
+    {"\xED\xBF\xBF", 0},
+    // past U+10FFFF.
+    {"\xF4\x90\x80\x80", 0},
+    {"\xF5\x80\x80\x80", 0},
+    {"\xF7\xBF\xBF\xBF", 0},
+    {"\xF8\x88\x80\x80\x80", 0},
+    {"\xFF", 0},
+    // continuations without a lead, leads without their continuations.
+    {"\x80", 0},
+    {"\xBF\x80", 0},
+    {"\xC2\x41", 0},
+    {"\xE2\x28\xA1", 0},
+    {"\xE2\x82\x41", 0},
+    {"\xF0\x9F\x41\x80", 0},
+    {"\xF0\x9F\x98\x41", 0},
+    {"\xC2\xC2\x80", 0},
+};
+
+// Checks [data, data+len) the way the definition reads: a lead tells the
+// length, the rest are continuations, and the code point they make is
+// neither overlong, a surrogate nor past U+10FFFF.
+static int reference(const unsigned char *data, size_t len, size_t *offset) {
+    size_t i = 0;
+    while (i < len) {
+        unsigned char c = data[i];
+        if (c < 0x80) {
+            i++;
+            continue;
+        }
+        size_t n;
+        uint32_t code_point, least;
+        if ((c & 0xE0) == 0xC0)
+            n = 2, code_point = c & 0x1F, least = 0x80;
+        else if ((c & 0xF0) == 0xE0)
+            n = 3, code_point = c & 0x0F, least = 0x800;
+        else if ((c & 0xF8) == 0xF0)
+            n = 4, code_point = c & 0x07, least = 0x10000;
+        else
+            break;
+        if (len - i < n) break;
+        size_t k = 1;
+        for (; k < n && (data[i + k] & 0xC0) == 0x80; k++)
+            code_point = code_point << 6 | (data[i + k] & 0x3F);
+        if (k < n || code_point < least || code_point > 0x10FFFF ||
+            (code_point >= 0xD800 && code_point <= 0xDFFF))
+            break;
+        i += n;
+    }
+    *offset = i;
+    return i == len;
+}
+
+// Checks every validator gives the reference's answer on `data`, `what`
+// names it in failures.
+static void check(const unsigned char *data, size_t len, const char *what) {
+    size_t expected_offset, offset = (size_t)-1, scalar_offset = (size_t)-1;
+    int expected = reference(data, len, &expected_offset);
+    int valid = utf8_validate((const char *)data, len, &offset);
+    int scalar = utf8_validate_scalar((const char *)data, len, &scalar_offset);
+    int vector = utf8_validate_vector((const char *)data, len);
+    if (valid != expected || scalar != expected || vector != expected ||
+        (!expected && (offset != expected_offset ||
+                       scalar_offset != expected_offset))) {
+        fprintf(stderr,
+                "utf8: %s of %zu bytes is %s at %zu, validate %d at %zu, "
+                "scalar %d at %zu, vector %d\n",
+                what, len, expected ? "valid" : "invalid", expected_offset,
+                valid, offset, scalar, scalar_offset, vector);
+        failures++;
+    }
+}
+
+static uint64_t state = 0x9E3779B97F4A7C15;
+
+static uint32_t next(void) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return (uint32_t)(state >> 32);
+}
+
+// Writes the encoding of `code_point` to `out`, returns its length.
+static int encode(uint32_t code_point, unsigned char *out) {
+    if (code_point < 0x80) {
+        out[0] = code_point;
+        return 1;
+    }
+    if (code_point < 0x800) {
+        out[0] = 0xC0 | code_point >> 6;
+        out[1] = 0x80 | (code_point & 0x3F);
+        return 2;
+    }
+    if (code_point < 0x10000) {
+        out[0] = 0xE0 | code_point >> 12;
+        out[1] = 0x80 | (code_point >> 6 & 0x3F);
+        out[2] = 0x80 | (code_point & 0x3F);
+        return 3;
+    }
+    out[0] = 0xF0 | code_point >> 18;
+    out[1] = 0x80 | (code_point >> 12 & 0x3F);
+    out[2] = 0x80 | (code_point >> 6 & 0x3F);
+    out[3] = 0x80 | (code_point & 0x3F);
+    return 4;
+}
+
+int main(void) {
+    // each sequence after 0 to 40 bytes of ASCII, so that it straddles the
+    // blocks at every position, followed by ASCII or cut anywhere.
+    unsigned char buffer[256];
+    size_t count = sizeof(sequences) / sizeof(*sequences);
+    for (size_t i = 0; i < count; i++) {
+        size_t n = strlen(sequences[i].bytes);
+        size_t offset;
+        CHECK(reference((const unsigned char *)sequences[i].bytes, n,
+                        &offset) == sequences[i].valid);
+        for (size_t at = 0; at <= 40; at++) {
+            memset(buffer, 'a', sizeof(buffer));
+            memcpy(buffer + at, sequences[i].bytes, n);
+            for (size_t len = at + 1; len <= 64; len++)
+                check(buffer, len, sequences[i].bytes);
+        }
+    }
+
+    // every scalar value round trips through the validator and decoder.
+    for (uint32_t code_point = 0; code_point <= 0x10FFFF; code_point++) {
+        if (code_point == 0xD800) code_point = 0xE000;
+        unsigned char out[4];
+        int n = encode(code_point, out), len;
+        if (!utf8_validate((const char *)out, n, NULL) ||
+            utf8_decode((const char *)out, (const char *)out + n, &len) !=
+                code_point ||
+            len != n) {
+            fprintf(stderr, "utf8: U+%04X doesn't round trip\n", code_point);
+            failures++;
+            break;
+        }
+    }
+
+    // random text, left whole or with a few bytes overwritten.
+    int buffers = 200000;
+    for (int i = 0; i < buffers; i++) {
+        size_t len = 0, limit = next() % 200;
+        while (len + 4 <= limit) {
+            uint32_t kind = next() % 4, code_point;
+            do {
+                code_point = kind == 0   ? next() % 0x80
+                             : kind == 1 ? 0x80 + next() % 0x780
+                             : kind == 2 ? 0x800 + next() % 0xF800
+                                         : 0x10000 + next() % 0x100000;
+            } while (code_point >= 0xD800 && code_point <= 0xDFFF);
+            len += encode(code_point, buffer + len);
+        }
+        if (len && next() % 2) {
+            int changes = 1 + next() % 3;
+            while (changes--) buffer[next() % len] = next();
+        }
+        if (len && next() % 8 == 0) len -= 1 + next() % (len < 3 ? len : 3);
+        check(buffer, len, "random buffer");
+    }
+
+    if (failures) return 1;
+    printf("utf8: %zu sequences, %d random buffers, ok\n", count, buffers);
+    return 0;
+}